@@ -0,0 +1,753 @@
+// micro-benchmarks de los caminos calientes de formato y dibujo: JSON de
+// documentos generados (siempre los mismos, de 100 B a 16 MB) y algunas
+// utilidades. mide tiempo por operación, memoria reservada y throughput;
+// --json deja el resultado en un archivo y --compare lo compara con el de
+// otro commit. con BENCH_MOCK_SERVER también mide mongo_ops.c (páginas,
+// conteos, volcado y copia) contra el servidor de prueba en el mismo
+// proceso, sin depender de un mongod
+
+#include "json_display.h"
+#include "utils.h"
+#ifdef BENCH_MOCK_SERVER
+#include "mock_server.h"
+#include "mongo_copy.h"
+#include "mongo_ops.h"
+#endif
+#include <mongoc/mongoc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+// cada caso corre al menos esto (y MIN_ITERATIONS veces)
+#define DEFAULT_MIN_TIME_MS 300
+#define MIN_ITERATIONS 5
+
+// pantalla donde se dibuja (una ventana de visor grande)
+#define DISPLAY_ROWS 60
+#define DISPLAY_COLS 120
+
+// más lento que esto contra --compare cuenta como regresión
+#define DEFAULT_THRESHOLD_PCT 10.0
+
+#define MAX_RESULTS 128
+
+// tamaños de documento; el último queda bajo el máximo de BSON
+static const struct {
+  const char *name;
+  size_t bytes;
+} SIZES[] = {
+    {"100B", 100},
+    {"1KB", 1024},
+    {"16KB", 16 * 1024},
+    {"256KB", 256 * 1024},
+    {"1MB", 1024 * 1024},
+    {"16MB", 16 * 1024 * 1024 - 256 * 1024},
+};
+#define SIZE_COUNT ((int)(sizeof(SIZES) / sizeof(SIZES[0])))
+// con --quick no se pasa de éste
+#define QUICK_MAX_BYTES (1024 * 1024)
+
+#ifdef BENCH_MOCK_SERVER
+// colección del servidor de prueba (menos documentos con --quick)
+#define MOCK_DB "bench"
+#define MOCK_COLL "docs"
+#define MOCK_COPY "copy"
+#define MOCK_DOCS 20000
+#define QUICK_MOCK_DOCS 2000
+#define MOCK_DOC_SIZE 512
+#define MOCK_PAGE 100
+#endif
+
+// memoria pedida (bytes y llamadas) desde que arrancó, por hilo: lo que
+// reservan el servidor de prueba y los hilos de mongoc no se suma al caso
+static _Thread_local unsigned long long alloc_bytes;
+static _Thread_local unsigned long long alloc_calls;
+
+// con BENCH_WRAP_MALLOC el linker (--wrap) manda acá malloc/calloc/realloc
+// del código del repo; libbson se cuenta con su vtable. sin eso sólo se
+// cuenta lo que reserva libbson
+#ifdef BENCH_WRAP_MALLOC
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+#define REAL_MALLOC __real_malloc
+#define REAL_CALLOC __real_calloc
+#define REAL_REALLOC __real_realloc
+#else
+#define REAL_MALLOC malloc
+#define REAL_CALLOC calloc
+#define REAL_REALLOC realloc
+#endif
+
+static void *counted_malloc(size_t size) {
+  alloc_calls++;
+  alloc_bytes += size;
+  return REAL_MALLOC(size);
+}
+
+static void *counted_calloc(size_t count, size_t size) {
+  alloc_calls++;
+  alloc_bytes += count * size;
+  return REAL_CALLOC(count, size);
+}
+
+// se cuenta el tamaño pedido entero, como si fuera una reserva nueva
+static void *counted_realloc(void *ptr, size_t size) {
+  alloc_calls++;
+  alloc_bytes += size;
+  return REAL_REALLOC(ptr, size);
+}
+
+#ifdef BENCH_WRAP_MALLOC
+void *__wrap_malloc(size_t size) { return counted_malloc(size); }
+void *__wrap_calloc(size_t count, size_t size) {
+  return counted_calloc(count, size);
+}
+void *__wrap_realloc(void *ptr, size_t size) {
+  return counted_realloc(ptr, size);
+}
+#endif
+
+static void count_bson_allocations(void) {
+  // aligned_alloc (libbson nuevas) queda con el de libbson, sin contar
+  static bson_mem_vtable_t vtable = {
+      .malloc = counted_malloc,
+      .calloc = counted_calloc,
+      .realloc = counted_realloc,
+      .free = free,
+  };
+  bson_mem_set_vtable(&vtable);
+}
+
+// xorshift64*: la misma semilla da siempre el mismo documento
+static uint32_t rng_next(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return (uint32_t)((*state * 2685821657736338717ULL) >> 32);
+}
+
+// con escapes, UTF-8 y uno que no entra en una línea
+static const char *const WORDS[] = {
+    "alpha",
+    "beta",
+    "customer@example.com",
+    "quote \"inside\"",
+    "line\nbreak",
+    "tab\tseparated",
+    "ñandú über café",
+    "✓ done",
+    "a longer value that does not fit in one line of the viewer and has "
+    "to wrap around at least once, maybe twice on a narrow terminal",
+};
+#define WORD_COUNT ((int)(sizeof(WORDS) / sizeof(WORDS[0])))
+
+static void gen_value(bson_t *parent, const char *key, uint64_t *rng,
+                      int depth) {
+  uint32_t r = rng_next(rng);
+  switch (r % (depth > 0 ? 9 : 7)) {
+  case 0:
+    BSON_APPEND_UTF8(parent, key, WORDS[(r >> 8) % WORD_COUNT]);
+    break;
+  case 1:
+    BSON_APPEND_INT32(parent, key, (int32_t)(r >> 4) - 100000);
+    break;
+  case 2:
+    BSON_APPEND_INT64(parent, key, (int64_t)r * 1000003LL);
+    break;
+  case 3:
+    BSON_APPEND_DOUBLE(parent, key, (double)r / 7.0);
+    break;
+  case 4:
+    BSON_APPEND_BOOL(parent, key, (r >> 8) & 1);
+    break;
+  case 5:
+    BSON_APPEND_DATE_TIME(parent, key, 1700000000000LL + (int64_t)r);
+    break;
+  case 6:
+    BSON_APPEND_NULL(parent, key);
+    break;
+  case 7: {
+    bson_t child;
+    BSON_APPEND_DOCUMENT_BEGIN(parent, key, &child);
+    int fields = 1 + (int)((r >> 8) % 5);
+    for (int i = 0; i < fields; i++) {
+      char name[16];
+      snprintf(name, sizeof(name), "k%d", i);
+      gen_value(&child, name, rng, depth - 1);
+    }
+    bson_append_document_end(parent, &child);
+    break;
+  }
+  default: {
+    bson_t child;
+    BSON_APPEND_ARRAY_BEGIN(parent, key, &child);
+    int items = 1 + (int)((r >> 8) % 6);
+    for (int i = 0; i < items; i++) {
+      char index[16];
+      snprintf(index, sizeof(index), "%d", i);
+      gen_value(&child, index, rng, depth - 1);
+    }
+    bson_append_array_end(parent, &child);
+    break;
+  }
+  }
+}
+
+// campos de tipos y anidamiento variados (0 a 5 niveles) hasta llegar a
+// target bytes
+static bson_t *gen_document(size_t target, uint64_t seed) {
+  bson_t *doc = bson_new();
+  uint64_t rng = seed;
+  BSON_APPEND_INT64(doc, "_id", (int64_t)seed);
+  for (int i = 0; doc->len < target; i++) {
+    char key[32];
+    snprintf(key, sizeof(key), "field_%d", i);
+    gen_value(doc, key, &rng, i % 6);
+  }
+  return doc;
+}
+
+typedef struct {
+  char name[64];      // función/caso
+  size_t input_bytes; // por operación; 0 si no aplica
+  long long iterations;
+  double ns_per_op;
+  double bytes_per_op;
+  double allocs_per_op;
+  double mb_per_s; // 0 si no aplica
+} bench_result_t;
+
+typedef struct {
+  const char *filter;
+  int64_t min_time_us;
+  bool quick;
+  bench_result_t results[MAX_RESULTS];
+  int count;
+} bench_t;
+
+// que el compilador no descarte lo que calcula cada operación
+static volatile long long sink;
+
+typedef void (*bench_fn)(void *arg);
+
+static void run_case(bench_t *bench, const char *name, size_t input_bytes,
+                     bench_fn fn, void *arg) {
+  if ((bench->filter && !strstr(name, bench->filter)) ||
+      bench->count == MAX_RESULTS) {
+    return;
+  }
+
+  // una vuelta de calentamiento (caché, páginas nuevas)
+  fn(arg);
+
+  // de a tandas que se duplican, así el reloj pesa poco en lo que se mide
+  long long iterations = 0;
+  long long batch = 1;
+  unsigned long long bytes_before = alloc_bytes;
+  unsigned long long calls_before = alloc_calls;
+  int64_t start = bson_get_monotonic_time();
+  int64_t elapsed = 0;
+  while (elapsed < bench->min_time_us || iterations < MIN_ITERATIONS) {
+    for (long long i = 0; i < batch; i++) {
+      fn(arg);
+    }
+    iterations += batch;
+    elapsed = bson_get_monotonic_time() - start;
+    if (elapsed < bench->min_time_us / 10) {
+      batch *= 2;
+    }
+  }
+
+  bench_result_t *result = &bench->results[bench->count++];
+  safe_strncpy(result->name, name, sizeof(result->name));
+  result->input_bytes = input_bytes;
+  result->iterations = iterations;
+  result->ns_per_op = (double)elapsed * 1000.0 / (double)iterations;
+  result->bytes_per_op =
+      (double)(alloc_bytes - bytes_before) / (double)iterations;
+  result->allocs_per_op =
+      (double)(alloc_calls - calls_before) / (double)iterations;
+  result->mb_per_s = input_bytes > 0 ? (double)input_bytes /
+                                           (result->ns_per_op / 1e9) / 1e6
+                                     : 0;
+
+  printf("%-40s %14.1f %12.0f %10.1f", result->name, result->ns_per_op,
+         result->bytes_per_op, result->allocs_per_op);
+  if (input_bytes > 0) {
+    printf(" %10.1f", result->mb_per_s);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+typedef struct {
+  const bson_t *doc;
+  const char *text; // JSON editable del documento
+  WINDOW *win;
+  int scroll;
+} doc_arg_t;
+
+static void bench_format(void *arg) {
+  doc_arg_t *a = arg;
+  char *json = json_format_bson(a->doc);
+  sink += json ? json[0] : 0;
+  bson_free(json);
+}
+
+static void bench_format_editable(void *arg) {
+  doc_arg_t *a = arg;
+  char *json = json_format_bson_editable(a->doc, DISPLAY_COLS);
+  sink += json ? json[0] : 0;
+  free(json);
+}
+
+static void bench_count_lines(void *arg) {
+  doc_arg_t *a = arg;
+  sink += json_count_lines(a->text, DISPLAY_COLS);
+}
+
+static void bench_display(void *arg) {
+  doc_arg_t *a = arg;
+  sink += json_display_string(a->win, a->text, 0, 0, DISPLAY_ROWS,
+                              DISPLAY_COLS, a->scroll);
+}
+
+typedef struct {
+  const long long *values;
+  int count;
+  int next;
+} number_arg_t;
+
+static void bench_format_number(void *arg) {
+  number_arg_t *a = arg;
+  char buffer[32];
+  format_number(a->values[a->next], buffer, sizeof(buffer));
+  a->next = (a->next + 1) % a->count;
+  sink += buffer[0];
+}
+
+static void bench_str_dup(void *arg) {
+  char *copy = str_dup(arg);
+  sink += copy[0];
+  free(copy);
+}
+
+// pantalla en memoria (sale a /dev/null) para dibujar; NULL si no hay
+// terminfo para TERM
+static SCREEN *open_screen(FILE **out, FILE **in) {
+  *out = fopen(NULL_DEVICE, "w");
+  *in = fopen(NULL_DEVICE, "r");
+  SCREEN *screen =
+      *out && *in ? newterm(getenv("TERM") ? NULL : "xterm", *out, *in)
+                  : NULL;
+  if (!screen) {
+    if (*out) {
+      fclose(*out);
+    }
+    if (*in) {
+      fclose(*in);
+    }
+    return NULL;
+  }
+  if (has_colors()) {
+    start_color();
+    json_init_colors();
+  }
+  return screen;
+}
+
+static void bench_documents(bench_t *bench) {
+  FILE *out = NULL, *in = NULL;
+  SCREEN *screen = open_screen(&out, &in);
+  WINDOW *win = screen ? newpad(DISPLAY_ROWS, DISPLAY_COLS) : NULL;
+  if (!win) {
+    fprintf(stderr, "No curses screen (TERM?): skipping json_display_string"
+                    "\n");
+  }
+
+  for (int s = 0; s < SIZE_COUNT; s++) {
+    if (bench->quick && SIZES[s].bytes > QUICK_MAX_BYTES) {
+      continue;
+    }
+
+    bson_t *doc = gen_document(SIZES[s].bytes, 0x9E3779B97F4A7C15ULL + s);
+    char *text = json_format_bson_editable(doc, DISPLAY_COLS);
+    if (!text) {
+      fprintf(stderr, "Failed to format the %s document\n", SIZES[s].name);
+      bson_destroy(doc);
+      continue;
+    }
+    size_t text_bytes = strlen(text);
+    doc_arg_t arg = {doc, text, win, 0};
+    char name[64];
+
+    snprintf(name, sizeof(name), "json_format_bson/%s", SIZES[s].name);
+    run_case(bench, name, doc->len, bench_format, &arg);
+    snprintf(name, sizeof(name), "json_format_bson_editable/%s",
+             SIZES[s].name);
+    run_case(bench, name, doc->len, bench_format_editable, &arg);
+    snprintf(name, sizeof(name), "json_count_lines/%s", SIZES[s].name);
+    run_case(bench, name, text_bytes, bench_count_lines, &arg);
+
+    if (win) {
+      // la primera pantalla, y una del medio (hay que recorrer hasta ahí)
+      snprintf(name, sizeof(name), "json_display_string/%s/top",
+               SIZES[s].name);
+      run_case(bench, name, text_bytes, bench_display, &arg);
+      arg.scroll = json_count_lines(text, DISPLAY_COLS) / 2;
+      if (arg.scroll > DISPLAY_ROWS) {
+        snprintf(name, sizeof(name), "json_display_string/%s/middle",
+                 SIZES[s].name);
+        run_case(bench, name, text_bytes, bench_display, &arg);
+      }
+    }
+
+    free(text);
+    bson_destroy(doc);
+  }
+
+  if (win) {
+    delwin(win);
+  }
+  if (screen) {
+    endwin();
+    delscreen(screen);
+    fclose(out);
+    fclose(in);
+  }
+}
+
+static void bench_utils(bench_t *bench) {
+  static const long long small[] = {0, 7, 42, 999};
+  static const long long large[] = {1234567, -98765432, 9223372036854775807LL,
+                                    -4611686018427387904LL};
+  number_arg_t numbers = {small, 4, 0};
+  run_case(bench, "format_number/small", 0, bench_format_number, &numbers);
+  numbers = (number_arg_t){large, 4, 0};
+  run_case(bench, "format_number/large", 0, bench_format_number, &numbers);
+
+  static const struct {
+    const char *name;
+    size_t bytes;
+  } strings[] = {{"16B", 16}, {"256B", 256}, {"4KB", 4096}, {"64KB", 65536}};
+  for (int i = 0; i < 4; i++) {
+    char *text = malloc(strings[i].bytes + 1);
+    if (!text) {
+      continue;
+    }
+    for (size_t j = 0; j < strings[i].bytes; j++) {
+      text[j] = (char)('a' + j % 26);
+    }
+    text[strings[i].bytes] = '\0';
+
+    char name[64];
+    snprintf(name, sizeof(name), "str_dup/%s", strings[i].name);
+    run_case(bench, name, strings[i].bytes, bench_str_dup, text);
+    free(text);
+  }
+}
+
+#ifdef BENCH_MOCK_SERVER
+typedef struct {
+  mongo_context_t *ctx;
+  const bson_t *filter; // NULL: todos
+  long long skip;
+  long long expected; // documentos que tiene que ver cada vuelta
+  bool failed;
+} mongo_arg_t;
+
+static void mongo_check(mongo_arg_t *a, long long seen, const char *what) {
+  if (seen != a->expected && !a->failed) {
+    fprintf(stderr, "%s: %lld documents instead of %lld (%s)\n", what, seen,
+            a->expected, mongo_get_error(a->ctx));
+    a->failed = true;
+  }
+}
+
+static void bench_find_page(void *arg) {
+  mongo_arg_t *a = arg;
+  int count = 0;
+  bson_t **docs = mongo_find_documents(a->ctx, MOCK_DB, MOCK_COLL, a->filter,
+                                       NULL, a->skip, MOCK_PAGE, &count);
+  mongo_check(a, count, "mongo_find_documents");
+  sink += count;
+  mongo_free_documents(docs, count);
+}
+
+static void bench_count(void *arg) {
+  mongo_arg_t *a = arg;
+  long long count =
+      mongo_count_documents(a->ctx, MOCK_DB, MOCK_COLL, a->filter);
+  mongo_check(a, count, "mongo_count_documents");
+  sink += count;
+}
+
+static bool count_doc(const bson_t *doc, void *user_data) {
+  *(long long *)user_data += 1;
+  sink += doc->len;
+  return true;
+}
+
+static void bench_find_each(void *arg) {
+  mongo_arg_t *a = arg;
+  long long count = 0;
+  mongo_find_each(a->ctx, MOCK_DB, MOCK_COLL, a->filter, NULL, 0, 0,
+                  count_doc, &count);
+  mongo_check(a, count, "mongo_find_each");
+}
+
+static void bench_copy(void *arg) {
+  mongo_arg_t *a = arg;
+  if (!mongo_copy_collection(a->ctx, MOCK_DB, MOCK_COLL, a->ctx, MOCK_DB,
+                             MOCK_COPY, true, NULL, NULL)) {
+    mongo_check(a, -1, "mongo_copy_collection");
+  }
+}
+
+// mongo_ops.c contra el servidor de prueba: lo que cuesta del lado de la
+// interfaz (protocolo, BSON, copias) sin la red ni el disco de un mongod
+static void bench_mongo(bench_t *bench) {
+  long long docs = bench->quick ? QUICK_MOCK_DOCS : MOCK_DOCS;
+  mock_server_t *server = mock_server_new(&(mock_config_t){.port = 0});
+  if (!server ||
+      !mock_server_generate(server, MOCK_DB, MOCK_COLL, docs, MOCK_DOC_SIZE,
+                            1) ||
+      !mock_server_start(server)) {
+    fprintf(stderr, "No mock server: skipping mongo_ops\n");
+    mock_server_free(server);
+    return;
+  }
+
+  char uri[128];
+  snprintf(uri, sizeof(uri), "mongodb://127.0.0.1:%d/?directConnection=true",
+           mock_server_port(server));
+  mongo_init();
+  mongo_context_t *ctx = mongo_context_new();
+  if (!ctx || !mongo_connect(ctx, uri)) {
+    fprintf(stderr, "Cannot connect to the mock server: %s\n",
+            ctx ? mongo_get_error(ctx) : "out of memory");
+    mongo_context_free(ctx);
+    mock_server_free(server);
+    return;
+  }
+
+  // lo que pesa la colección, para los MB/s del volcado y la copia
+  size_t total_bytes = 0;
+  mongo_arg_t arg = {ctx, NULL, 0, docs, false};
+  long long avg = mongo_avg_document_size(ctx, MOCK_DB, MOCK_COLL);
+  if (avg > 0) {
+    total_bytes = (size_t)(avg * docs);
+  }
+
+  arg.expected = MOCK_PAGE;
+  run_case(bench, "mongo_find_documents/first_page", 0, bench_find_page,
+           &arg);
+  arg.skip = docs - MOCK_PAGE;
+  run_case(bench, "mongo_find_documents/last_page", 0, bench_find_page, &arg);
+
+  arg.expected = docs;
+  run_case(bench, "mongo_count_documents/all", 0, bench_count, &arg);
+  bson_t *filter = BCON_NEW("group", BCON_INT32(3));
+  arg.filter = filter;
+  arg.expected = docs / 10;
+  run_case(bench, "mongo_count_documents/filter", 0, bench_count, &arg);
+  arg.filter = NULL;
+
+  arg.expected = docs;
+  run_case(bench, "mongo_find_each/export", total_bytes, bench_find_each,
+           &arg);
+  run_case(bench, "mongo_copy_collection/import", total_bytes, bench_copy,
+           &arg);
+
+  bson_destroy(filter);
+  mongo_context_free(ctx);
+  mock_server_free(server);
+  mongo_cleanup();
+}
+#endif
+
+static bool write_json(const bench_t *bench, const char *path) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    fprintf(stderr, "Cannot write %s\n", path);
+    return false;
+  }
+
+  fprintf(f, "{\n  \"version\": 1,\n");
+#ifdef BENCH_WRAP_MALLOC
+  fprintf(f, "  \"allocations\": \"all\",\n");
+#else
+  fprintf(f, "  \"allocations\": \"libbson\",\n");
+#endif
+  fprintf(f, "  \"min_time_ms\": %lld,\n",
+          (long long)(bench->min_time_us / 1000));
+  fprintf(f, "  \"results\": [\n");
+  for (int i = 0; i < bench->count; i++) {
+    const bench_result_t *r = &bench->results[i];
+    fprintf(f,
+            "    {\"name\": \"%s\", \"input_bytes\": %zu, "
+            "\"iterations\": %lld, \"ns_per_op\": %.1f, "
+            "\"bytes_per_op\": %.1f, \"allocs_per_op\": %.2f, "
+            "\"mb_per_s\": %.2f}%s\n",
+            r->name, r->input_bytes, r->iterations, r->ns_per_op,
+            r->bytes_per_op, r->allocs_per_op, r->mb_per_s,
+            i + 1 < bench->count ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+
+  fclose(f);
+  return true;
+}
+
+static char *read_file(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return NULL;
+  }
+
+  size_t size = 0, capacity = 4096;
+  char *text = malloc(capacity);
+  size_t n;
+  while (text && (n = fread(text + size, 1, capacity - size - 1, f)) > 0) {
+    size += n;
+    if (capacity - size == 1) {
+      char *grown = realloc(text, capacity * 2);
+      if (!grown) {
+        free(text);
+        text = NULL;
+        break;
+      }
+      text = grown;
+      capacity *= 2;
+    }
+  }
+  fclose(f);
+  if (text) {
+    text[size] = '\0';
+  }
+  return text;
+}
+
+// tiempos contra un resultado anterior (de --json); false si algún caso
+// empeoró más que threshold por ciento
+static bool compare(const bench_t *bench, const char *path,
+                    double threshold) {
+  char *text = read_file(path);
+  bson_error_t error;
+  bson_t *baseline =
+      text ? bson_new_from_json((const uint8_t *)text, -1, &error) : NULL;
+  free(text);
+  if (!baseline) {
+    fprintf(stderr, "Cannot read baseline %s\n", path);
+    return false;
+  }
+
+  printf("\n%-40s %14s %14s %8s\n", "vs baseline", "old ns/op", "new ns/op",
+         "change");
+  bool ok = true;
+  bson_iter_t iter, results;
+  if (bson_iter_init_find(&iter, baseline, "results") &&
+      BSON_ITER_HOLDS_ARRAY(&iter) && bson_iter_recurse(&iter, &results)) {
+    while (bson_iter_next(&results)) {
+      bson_iter_t field;
+      const char *name = NULL;
+      double old_ns = 0;
+      if (!BSON_ITER_HOLDS_DOCUMENT(&results) ||
+          !bson_iter_recurse(&results, &field)) {
+        continue;
+      }
+      while (bson_iter_next(&field)) {
+        if (strcmp(bson_iter_key(&field), "name") == 0 &&
+            BSON_ITER_HOLDS_UTF8(&field)) {
+          name = bson_iter_utf8(&field, NULL);
+        } else if (strcmp(bson_iter_key(&field), "ns_per_op") == 0 &&
+                   BSON_ITER_HOLDS_NUMBER(&field)) {
+          old_ns = bson_iter_as_double(&field);
+        }
+      }
+
+      for (int i = 0; name && old_ns > 0 && i < bench->count; i++) {
+        const bench_result_t *r = &bench->results[i];
+        if (strcmp(r->name, name) != 0) {
+          continue;
+        }
+        double change = (r->ns_per_op - old_ns) / old_ns * 100.0;
+        bool regressed = change > threshold;
+        ok = ok && !regressed;
+        printf("%-40s %14.1f %14.1f %+7.1f%%%s\n", name, old_ns,
+               r->ns_per_op, change, regressed ? "  SLOWER" : "");
+      }
+    }
+  }
+
+  bson_destroy(baseline);
+  return ok;
+}
+
+static void usage(const char *program) {
+  printf("Usage: %s [options]\n"
+         "  --json FILE       Also write the results to FILE as JSON\n"
+         "  --compare FILE    Compare against an earlier --json result\n"
+         "  --threshold PCT   Slower than this counts as a regression "
+         "(default %.0f)\n"
+         "  --filter TEXT     Only the cases whose name contains TEXT\n"
+         "  --min-time MS     Minimum time per case (default %d)\n"
+         "  --quick           Documents up to 1MB only, and a smaller\n"
+         "                    collection for the mongo_ops cases\n",
+         program, DEFAULT_THRESHOLD_PCT, DEFAULT_MIN_TIME_MS);
+}
+
+int main(int argc, char *argv[]) {
+  static bench_t bench;
+  bench.min_time_us = DEFAULT_MIN_TIME_MS * 1000LL;
+  const char *json_path = NULL;
+  const char *baseline_path = NULL;
+  double threshold = DEFAULT_THRESHOLD_PCT;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--json") == 0 && has_value) {
+      json_path = argv[++i];
+    } else if (strcmp(argv[i], "--compare") == 0 && has_value) {
+      baseline_path = argv[++i];
+    } else if (strcmp(argv[i], "--threshold") == 0 && has_value) {
+      threshold = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--filter") == 0 && has_value) {
+      bench.filter = argv[++i];
+    } else if (strcmp(argv[i], "--min-time") == 0 && has_value) {
+      bench.min_time_us = atoll(argv[++i]) * 1000LL;
+    } else if (strcmp(argv[i], "--quick") == 0) {
+      bench.quick = true;
+    } else {
+      usage(argv[0]);
+      return strcmp(argv[i], "--help") == 0 ? 0 : 2;
+    }
+  }
+
+  count_bson_allocations();
+
+  printf("%-40s %14s %12s %10s %10s\n", "benchmark", "ns/op", "B/op",
+         "allocs/op", "MB/s");
+  bench_documents(&bench);
+  bench_utils(&bench);
+#ifdef BENCH_MOCK_SERVER
+  bench_mongo(&bench);
+#endif
+
+  bool ok = true;
+  if (json_path) {
+    ok = write_json(&bench, json_path);
+  }
+  if (baseline_path) {
+    ok = compare(&bench, baseline_path, threshold) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+// el servidor de prueba solo, para apuntarle la interfaz (o replay) sin
+// un mongod: genera bench.docs (o carga archivos JSON) y atiende hasta
+// Ctrl-C
+
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include "mock_server.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_PORT 27099
+#define DEFAULT_NS "bench.docs"
+#define DEFAULT_DOCS 10000
+#define DEFAULT_DOC_SIZE 512
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig) {
+  (void)sig;
+  stop_requested = 1;
+}
+
+static void usage(const char *program) {
+  printf("Usage: %s [options]\n"
+         "\n"
+         "Serves an in-memory dataset over the MongoDB wire protocol on\n"
+         "127.0.0.1, for benchmarks that should not depend on a real server.\n"
+         "\n"
+         "  --port N           Port to listen on, 0 for any (default %d)\n"
+         "  --ns DB.COLL       Collection for generated documents "
+         "(default %s)\n"
+         "  --docs N           Number of generated documents (default %d)\n"
+         "  --doc-size BYTES   Approximate document size (default %d)\n"
+         "  --seed N           Seed for the generated documents\n"
+         "  --load DB.COLL=FILE\n"
+         "                     Also load JSON documents from FILE "
+         "(repeatable)\n"
+         "  --latency MS       Delay before every reply\n"
+         "  --bandwidth KB/S   Limit replies to KB/S kilobytes per second\n"
+         "  --batch N          At most N documents per batch\n",
+         program, DEFAULT_PORT, DEFAULT_NS, DEFAULT_DOCS, DEFAULT_DOC_SIZE);
+}
+
+// "db.coll" en sus dos partes; false si falta alguna
+static bool split_ns(const char *ns, size_t length, char *db, size_t db_size,
+                     char *coll, size_t coll_size) {
+  const char *dot = memchr(ns, '.', length);
+  if (!dot || dot == ns || dot + 1 == ns + length) {
+    return false;
+  }
+  snprintf(db, db_size, "%.*s", (int)(dot - ns), ns);
+  snprintf(coll, coll_size, "%.*s", (int)(ns + length - dot - 1), dot + 1);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  mock_config_t config = {.port = DEFAULT_PORT};
+  const char *ns = DEFAULT_NS;
+  long long docs = DEFAULT_DOCS;
+  long long doc_size = DEFAULT_DOC_SIZE;
+  unsigned long long seed = 1;
+  const char *loads[64];
+  int load_count = 0;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--port") == 0 && has_value) {
+      config.port = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--ns") == 0 && has_value) {
+      ns = argv[++i];
+    } else if (strcmp(argv[i], "--docs") == 0 && has_value) {
+      docs = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "--doc-size") == 0 && has_value) {
+      doc_size = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+      seed = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--load") == 0 && has_value &&
+               load_count < (int)(sizeof(loads) / sizeof(loads[0]))) {
+      loads[load_count++] = argv[++i];
+    } else if (strcmp(argv[i], "--latency") == 0 && has_value) {
+      config.latency_ms = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--bandwidth") == 0 && has_value) {
+      config.bandwidth = atoll(argv[++i]) * 1024;
+    } else if (strcmp(argv[i], "--batch") == 0 && has_value) {
+      config.batch_docs = atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return strcmp(argv[i], "--help") == 0 ? 0 : 2;
+    }
+  }
+
+  char db[128], coll[128];
+  if (config.port < 0 || config.port > 65535 || docs < 0 || doc_size < 0 ||
+      !split_ns(ns, strlen(ns), db, sizeof(db), coll, sizeof(coll))) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  mock_server_t *server = mock_server_new(&config);
+  if (!server) {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+  if (docs > 0 &&
+      !mock_server_generate(server, db, coll, docs, (size_t)doc_size, seed)) {
+    fprintf(stderr, "Cannot generate %lld documents\n", docs);
+    mock_server_free(server);
+    return 1;
+  }
+
+  for (int i = 0; i < load_count; i++) {
+    const char *eq = strchr(loads[i], '=');
+    char load_db[128], load_coll[128];
+    bson_error_t error;
+    if (!eq || !split_ns(loads[i], (size_t)(eq - loads[i]), load_db,
+                         sizeof(load_db), load_coll, sizeof(load_coll))) {
+      usage(argv[0]);
+      mock_server_free(server);
+      return 2;
+    }
+    if (!mock_server_load(server, load_db, load_coll, eq + 1, &error)) {
+      fprintf(stderr, "Cannot load %s: %s\n", eq + 1, error.message);
+      mock_server_free(server);
+      return 1;
+    }
+  }
+
+  if (!mock_server_start(server)) {
+    mock_server_free(server);
+    return 1;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = on_signal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("Listening on mongodb://127.0.0.1:%d/?directConnection=true\n",
+         mock_server_port(server));
+  fflush(stdout);
+  while (!stop_requested) {
+    sleep(1); // la señal la interrumpe
+  }
+
+  mock_server_free(server);
+  return 0;
+}
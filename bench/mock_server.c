@@ -0,0 +1,2626 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#if defined(__APPLE__) && !defined(_DARWIN_C_SOURCE)
+#define _DARWIN_C_SOURCE
+#endif
+
+#include "mock_server.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <regex.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS: SO_NOSIGPIPE en el socket
+#endif
+
+#define OP_REPLY 1
+#define OP_QUERY 2004
+#define OP_MSG 2013
+#define MSG_CHECKSUM_PRESENT 0x1u
+#define MSG_MORE_TO_COME 0x2u
+
+#define MAX_BSON_SIZE (16 * 1024 * 1024)
+#define MAX_MESSAGE_SIZE 48000000
+#define MAX_WRITE_BATCH 100000
+#define MAX_WIRE_VERSION 17 // 6.0: OP_MSG, sin sesiones ni compresión
+
+// un batch no pasa de esto (lo que queda del máximo es para la respuesta)
+#define BATCH_BYTES (MAX_BSON_SIZE - 16 * 1024)
+#define DEFAULT_FIRST_BATCH 101
+
+// cada cuánto se mira si hay que parar
+#define POLL_MS 100
+// de a cuánto se escribe con ancho de banda limitado
+#define BANDWIDTH_CHUNK 16384
+
+#define NAME_SIZE 128
+#define REGEX_CACHE 16
+
+// documento compartido entre la colección y los cursores que lo leen; un
+// update pone uno nuevo en la colección y los cursores siguen con el viejo
+typedef struct {
+  bson_t *bson;
+  int refs;
+} mock_doc_t;
+
+typedef struct {
+  char db[NAME_SIZE];
+  char name[NAME_SIZE];
+  mock_doc_t **docs; // en orden natural
+  long long count;
+  long long capacity;
+  long long data_size;
+  bson_t **indexes; // especificaciones, la primera la de _id
+  int index_count;
+} mock_coll_t;
+
+typedef struct {
+  int64_t id;
+  char ns[NAME_SIZE * 2];
+  mock_doc_t **docs;
+  long long count;
+  long long next;
+  bson_t *projection; // NULL: documentos enteros
+  bool single_batch;
+} mock_cursor_t;
+
+typedef struct mock_conn {
+  mock_server_t *server;
+  int fd;
+  int id;
+  pthread_t thread;
+  bool done;
+  struct mock_conn *next;
+} mock_conn_t;
+
+struct mock_server {
+  mock_config_t config;
+  pthread_mutex_t lock; // datos, cursores y conexiones
+
+  mock_coll_t **colls;
+  int coll_count;
+  mock_cursor_t **cursors;
+  int cursor_count;
+  int64_t next_cursor_id;
+  uint64_t next_oid; // _id de los documentos que llegan sin uno
+
+  int listen_fd;
+  int port;
+  pthread_t accept_thread;
+  bool started;
+  bool stopping;
+  mock_conn_t *conns;
+  int next_conn_id;
+};
+
+static void sleep_us(int64_t us) {
+  if (us <= 0) {
+    return;
+  }
+  struct timespec ts = {.tv_sec = us / 1000000,
+                        .tv_nsec = (long)(us % 1000000) * 1000};
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+  }
+}
+
+static int32_t read_le32(const uint8_t *p) {
+  return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+                   (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+static void write_le32(uint8_t *p, int32_t value) {
+  uint32_t v = (uint32_t)value;
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static mock_doc_t *doc_new(bson_t *bson) {
+  mock_doc_t *doc = malloc(sizeof(mock_doc_t));
+  if (!doc) {
+    bson_destroy(bson);
+    return NULL;
+  }
+  doc->bson = bson;
+  doc->refs = 1;
+  return doc;
+}
+
+static void doc_release(mock_doc_t *doc) {
+  if (doc && --doc->refs == 0) {
+    bson_destroy(doc->bson);
+    free(doc);
+  }
+}
+
+static void release_docs(mock_doc_t **docs, long long count) {
+  for (long long i = 0; i < count; i++) {
+    doc_release(docs[i]);
+  }
+  free(docs);
+}
+
+// _id nuevo: siempre los mismos en el mismo orden
+static void next_oid(mock_server_t *server, bson_oid_t *oid) {
+  uint8_t bytes[12] = {0x65, 0x00, 0x00, 0x00};
+  uint64_t n = server->next_oid++;
+  for (int i = 0; i < 8; i++) {
+    bytes[11 - i] = (uint8_t)(n >> (i * 8));
+  }
+  bson_oid_init_from_data(oid, bytes);
+}
+
+// copia del documento con _id (primero, si no tenía)
+static bson_t *with_id(mock_server_t *server, const bson_t *doc) {
+  bson_iter_t iter;
+  if (bson_iter_init_find(&iter, doc, "_id")) {
+    return bson_copy(doc);
+  }
+
+  bson_t *copy = bson_new();
+  bson_oid_t oid;
+  next_oid(server, &oid);
+  BSON_APPEND_OID(copy, "_id", &oid);
+  if (bson_iter_init(&iter, doc)) {
+    while (bson_iter_next(&iter)) {
+      bson_append_iter(copy, NULL, 0, &iter);
+    }
+  }
+  return copy;
+}
+
+static void coll_free(mock_coll_t *coll) {
+  release_docs(coll->docs, coll->count);
+  for (int i = 0; i < coll->index_count; i++) {
+    bson_destroy(coll->indexes[i]);
+  }
+  free(coll->indexes);
+  free(coll);
+}
+
+static bool coll_add_index(mock_coll_t *coll, bson_t *spec) {
+  bson_t **grown =
+      realloc(coll->indexes, (coll->index_count + 1) * sizeof(bson_t *));
+  if (!grown) {
+    bson_destroy(spec);
+    return false;
+  }
+  coll->indexes = grown;
+  coll->indexes[coll->index_count++] = spec;
+  return true;
+}
+
+static mock_coll_t *coll_find(mock_server_t *server, const char *db,
+                              const char *name) {
+  for (int i = 0; i < server->coll_count; i++) {
+    mock_coll_t *coll = server->colls[i];
+    if (strcmp(coll->db, db) == 0 && strcmp(coll->name, name) == 0) {
+      return coll;
+    }
+  }
+  return NULL;
+}
+
+// la colección, creándola (con el índice de _id) si no existe
+static mock_coll_t *coll_get(mock_server_t *server, const char *db,
+                             const char *name) {
+  mock_coll_t *coll = coll_find(server, db, name);
+  if (coll) {
+    return coll;
+  }
+
+  coll = calloc(1, sizeof(mock_coll_t));
+  mock_coll_t **grown = realloc(server->colls, (server->coll_count + 1) *
+                                                   sizeof(mock_coll_t *));
+  bson_t *spec = BCON_NEW("v", BCON_INT32(2), "key", "{", "_id",
+                          BCON_INT32(1), "}", "name", BCON_UTF8("_id_"));
+  if (!coll || !grown || !spec || !coll_add_index(coll, spec)) {
+    if (grown) {
+      server->colls = grown;
+    }
+    free(coll ? coll->indexes : NULL);
+    free(coll);
+    return NULL;
+  }
+
+  snprintf(coll->db, sizeof(coll->db), "%s", db);
+  snprintf(coll->name, sizeof(coll->name), "%s", name);
+  server->colls = grown;
+  server->colls[server->coll_count++] = coll;
+  return coll;
+}
+
+static void coll_drop(mock_server_t *server, mock_coll_t *coll) {
+  for (int i = 0; i < server->coll_count; i++) {
+    if (server->colls[i] == coll) {
+      memmove(&server->colls[i], &server->colls[i + 1],
+              (server->coll_count - i - 1) * sizeof(mock_coll_t *));
+      server->coll_count--;
+      break;
+    }
+  }
+  coll_free(coll);
+}
+
+// agregar un documento (la colección se queda con la referencia)
+static bool coll_append(mock_coll_t *coll, mock_doc_t *doc) {
+  if (coll->count == coll->capacity) {
+    long long capacity = coll->capacity ? coll->capacity * 2 : 1024;
+    mock_doc_t **grown = realloc(coll->docs, capacity * sizeof(mock_doc_t *));
+    if (!grown) {
+      doc_release(doc);
+      return false;
+    }
+    coll->docs = grown;
+    coll->capacity = capacity;
+  }
+  coll->docs[coll->count++] = doc;
+  coll->data_size += doc->bson->len;
+  return true;
+}
+
+static void coll_remove(mock_coll_t *coll, long long index) {
+  mock_doc_t *doc = coll->docs[index];
+  coll->data_size -= doc->bson->len;
+  memmove(&coll->docs[index], &coll->docs[index + 1],
+          (coll->count - index - 1) * sizeof(mock_doc_t *));
+  coll->count--;
+  doc_release(doc);
+}
+
+static void coll_replace(mock_coll_t *coll, long long index,
+                         mock_doc_t *doc) {
+  coll->data_size += (long long)doc->bson->len - coll->docs[index]->bson->len;
+  doc_release(coll->docs[index]);
+  coll->docs[index] = doc;
+}
+
+// orden de tipos de BSON al comparar valores de distinto tipo
+static int type_rank(bson_type_t type) {
+  switch (type) {
+  case BSON_TYPE_MINKEY:
+    return 1;
+  case BSON_TYPE_EOD:
+  case BSON_TYPE_UNDEFINED:
+  case BSON_TYPE_NULL:
+    return 2;
+  case BSON_TYPE_INT32:
+  case BSON_TYPE_INT64:
+  case BSON_TYPE_DOUBLE:
+  case BSON_TYPE_DECIMAL128:
+    return 3;
+  case BSON_TYPE_SYMBOL:
+  case BSON_TYPE_UTF8:
+    return 4;
+  case BSON_TYPE_DOCUMENT:
+    return 5;
+  case BSON_TYPE_ARRAY:
+    return 6;
+  case BSON_TYPE_BINARY:
+    return 7;
+  case BSON_TYPE_OID:
+    return 8;
+  case BSON_TYPE_BOOL:
+    return 9;
+  case BSON_TYPE_DATE_TIME:
+    return 10;
+  case BSON_TYPE_TIMESTAMP:
+    return 11;
+  case BSON_TYPE_REGEX:
+    return 12;
+  case BSON_TYPE_MAXKEY:
+    return 14;
+  default:
+    return 13;
+  }
+}
+
+static int compare_bytes(const uint8_t *a, size_t a_len, const uint8_t *b,
+                         size_t b_len) {
+  int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+  if (cmp != 0) {
+    return cmp < 0 ? -1 : 1;
+  }
+  return (a_len > b_len) - (a_len < b_len);
+}
+
+static const char *iter_text(const bson_iter_t *iter, uint32_t *length) {
+  return BSON_ITER_HOLDS_SYMBOL(iter) ? bson_iter_symbol(iter, length)
+                                      : bson_iter_utf8(iter, length);
+}
+
+// comparar dos valores como mongod (NULL es un campo que no está, igual
+// a null); documentos y arrays, byte a byte
+static int compare_values(const bson_iter_t *a, const bson_iter_t *b) {
+  bson_type_t ta = a ? bson_iter_type(a) : BSON_TYPE_NULL;
+  bson_type_t tb = b ? bson_iter_type(b) : BSON_TYPE_NULL;
+  int ra = type_rank(ta), rb = type_rank(tb);
+  if (ra != rb) {
+    return ra < rb ? -1 : 1;
+  }
+  if (ra == 2) {
+    return 0;
+  }
+
+  switch (ra) {
+  case 3: {
+    bool ints = (ta == BSON_TYPE_INT32 || ta == BSON_TYPE_INT64) &&
+                (tb == BSON_TYPE_INT32 || tb == BSON_TYPE_INT64);
+    if (ints) {
+      int64_t x = bson_iter_as_int64(a), y = bson_iter_as_int64(b);
+      return (x > y) - (x < y);
+    }
+    double x = bson_iter_as_double(a), y = bson_iter_as_double(b);
+    return (x > y) - (x < y);
+  }
+  case 4: {
+    uint32_t a_len, b_len;
+    const char *x = iter_text(a, &a_len), *y = iter_text(b, &b_len);
+    return compare_bytes((const uint8_t *)x, a_len, (const uint8_t *)y,
+                         b_len);
+  }
+  case 5:
+  case 6: {
+    uint32_t a_len, b_len;
+    const uint8_t *x, *y;
+    if (ra == 5) {
+      bson_iter_document(a, &a_len, &x);
+      bson_iter_document(b, &b_len, &y);
+    } else {
+      bson_iter_array(a, &a_len, &x);
+      bson_iter_array(b, &b_len, &y);
+    }
+    return compare_bytes(x, a_len, y, b_len);
+  }
+  case 7: {
+    uint32_t a_len, b_len;
+    const uint8_t *x, *y;
+    bson_subtype_t subtype;
+    bson_iter_binary(a, &subtype, &a_len, &x);
+    bson_iter_binary(b, &subtype, &b_len, &y);
+    if (a_len != b_len) {
+      return a_len < b_len ? -1 : 1;
+    }
+    return compare_bytes(x, a_len, y, b_len);
+  }
+  case 8: {
+    int cmp = bson_oid_compare(bson_iter_oid(a), bson_iter_oid(b));
+    return (cmp > 0) - (cmp < 0);
+  }
+  case 9:
+    return (int)bson_iter_bool(a) - (int)bson_iter_bool(b);
+  case 10: {
+    int64_t x = bson_iter_date_time(a), y = bson_iter_date_time(b);
+    return (x > y) - (x < y);
+  }
+  case 11: {
+    uint32_t at, ai, bt, bi;
+    bson_iter_timestamp(a, &at, &ai);
+    bson_iter_timestamp(b, &bt, &bi);
+    uint64_t x = (uint64_t)at << 32 | ai, y = (uint64_t)bt << 32 | bi;
+    return (x > y) - (x < y);
+  }
+  case 12: {
+    const char *options;
+    int cmp = strcmp(bson_iter_regex(a, &options), bson_iter_regex(b, NULL));
+    return (cmp > 0) - (cmp < 0);
+  }
+  default:
+    return 0;
+  }
+}
+
+// valor de un camino con puntos ("a.b.c")
+static bool find_path(const bson_t *doc, const char *path, bson_iter_t *out) {
+  bson_iter_t iter;
+  return bson_iter_init(&iter, doc) &&
+         bson_iter_find_descendant(&iter, path, out);
+}
+
+// contexto de un filtro: el error y las expresiones ya compiladas
+typedef struct {
+  char error[256];
+  struct {
+    char *pattern;
+    bool icase;
+    regex_t re;
+  } regex[REGEX_CACHE];
+  int regex_count;
+} query_t;
+
+static void query_free(query_t *q) {
+  for (int i = 0; i < q->regex_count; i++) {
+    free(q->regex[i].pattern);
+    regfree(&q->regex[i].re);
+  }
+  q->regex_count = 0;
+}
+
+static int query_error(query_t *q, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(q->error, sizeof(q->error), fmt, args);
+  va_end(args);
+  return -1;
+}
+
+// expresiones POSIX extendidas: alcanza para lo que arma la búsqueda de
+// la interfaz (texto literal escapado, opción i)
+static regex_t *get_regex(query_t *q, const char *pattern,
+                          const char *options) {
+  bool icase = options && strchr(options, 'i');
+  for (int i = 0; i < q->regex_count; i++) {
+    if (q->regex[i].icase == icase &&
+        strcmp(q->regex[i].pattern, pattern) == 0) {
+      return &q->regex[i].re;
+    }
+  }
+  if (q->regex_count == REGEX_CACHE) {
+    query_error(q, "too many regular expressions");
+    return NULL;
+  }
+
+  int flags = REG_EXTENDED | REG_NOSUB | (icase ? REG_ICASE : 0);
+  if (regcomp(&q->regex[q->regex_count].re, pattern, flags) != 0) {
+    query_error(q, "invalid regular expression: %s", pattern);
+    return NULL;
+  }
+  q->regex[q->regex_count].pattern = bson_strdup(pattern);
+  q->regex[q->regex_count].icase = icase;
+  return &q->regex[q->regex_count++].re;
+}
+
+// el campo (o algún elemento si es un array) coincide con la expresión
+static int match_regex(query_t *q, const bson_iter_t *field,
+                       const char *pattern, const char *options) {
+  regex_t *re = get_regex(q, pattern, options);
+  if (!re) {
+    return -1;
+  }
+  if (!field) {
+    return 0;
+  }
+  if (BSON_ITER_HOLDS_UTF8(field) || BSON_ITER_HOLDS_SYMBOL(field)) {
+    uint32_t length;
+    return regexec(re, iter_text(field, &length), 0, NULL, 0) == 0;
+  }
+  if (BSON_ITER_HOLDS_ARRAY(field)) {
+    bson_iter_t child;
+    bson_iter_recurse(field, &child);
+    while (bson_iter_next(&child)) {
+      if (match_regex(q, &child, pattern, options) == 1) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+// igualdad como en un filtro: un array coincide si algún elemento es
+// igual; un campo que no está es igual a null
+static bool equals(const bson_iter_t *field, const bson_iter_t *value) {
+  if (compare_values(field, value) == 0) {
+    return true;
+  }
+  if (field && BSON_ITER_HOLDS_ARRAY(field) && !BSON_ITER_HOLDS_ARRAY(value)) {
+    bson_iter_t child;
+    bson_iter_recurse(field, &child);
+    while (bson_iter_next(&child)) {
+      if (compare_values(&child, value) == 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// $gt/$gte/$lt/$lte: sólo entre valores del mismo tipo (o algún elemento)
+static bool compares(const bson_iter_t *field, const bson_iter_t *value,
+                     const char *op) {
+  if (!field) {
+    return false;
+  }
+  if (BSON_ITER_HOLDS_ARRAY(field) && !BSON_ITER_HOLDS_ARRAY(value)) {
+    bson_iter_t child;
+    bson_iter_recurse(field, &child);
+    while (bson_iter_next(&child)) {
+      if (compares(&child, value, op)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  if (type_rank(bson_iter_type(field)) != type_rank(bson_iter_type(value))) {
+    return false;
+  }
+
+  int cmp = compare_values(field, value);
+  if (strcmp(op, "$gt") == 0) {
+    return cmp > 0;
+  }
+  if (strcmp(op, "$gte") == 0) {
+    return cmp >= 0;
+  }
+  if (strcmp(op, "$lt") == 0) {
+    return cmp < 0;
+  }
+  return cmp <= 0;
+}
+
+static int match_in(query_t *q, const bson_iter_t *field,
+                    const bson_iter_t *list) {
+  if (!BSON_ITER_HOLDS_ARRAY(list)) {
+    return query_error(q, "$in needs an array");
+  }
+  bson_iter_t item;
+  bson_iter_recurse(list, &item);
+  while (bson_iter_next(&item)) {
+    int match;
+    if (BSON_ITER_HOLDS_REGEX(&item)) {
+      const char *options;
+      const char *pattern = bson_iter_regex(&item, &options);
+      match = match_regex(q, field, pattern, options);
+    } else {
+      match = equals(field, &item);
+    }
+    if (match != 0) {
+      return match;
+    }
+  }
+  return 0;
+}
+
+static int match_condition(query_t *q, const bson_t *doc, const char *path,
+                           const bson_iter_t *cond);
+
+// {campo: {$op: valor, ...}}: todos los operadores tienen que cumplirse
+static int match_operators(query_t *q, const bson_t *doc, const char *path,
+                           const bson_iter_t *field, const bson_iter_t *ops) {
+  bson_iter_t op;
+  bson_iter_recurse(ops, &op);
+  while (bson_iter_next(&op)) {
+    const char *name = bson_iter_key(&op);
+    int match;
+    if (strcmp(name, "$eq") == 0) {
+      match = equals(field, &op);
+    } else if (strcmp(name, "$ne") == 0) {
+      match = !equals(field, &op);
+    } else if (strcmp(name, "$gt") == 0 || strcmp(name, "$gte") == 0 ||
+               strcmp(name, "$lt") == 0 || strcmp(name, "$lte") == 0) {
+      match = compares(field, &op, name);
+    } else if (strcmp(name, "$in") == 0) {
+      match = match_in(q, field, &op);
+    } else if (strcmp(name, "$nin") == 0) {
+      match = match_in(q, field, &op);
+      match = match < 0 ? match : !match;
+    } else if (strcmp(name, "$exists") == 0) {
+      match = (field != NULL) == bson_iter_as_bool(&op);
+    } else if (strcmp(name, "$size") == 0) {
+      match = 0;
+      if (field && BSON_ITER_HOLDS_ARRAY(field)) {
+        bson_iter_t child;
+        long long count = 0;
+        bson_iter_recurse(field, &child);
+        while (bson_iter_next(&child)) {
+          count++;
+        }
+        match = count == bson_iter_as_int64(&op);
+      }
+    } else if (strcmp(name, "$regex") == 0) {
+      const char *options = NULL;
+      const char *pattern;
+      bson_iter_t sibling;
+      if (BSON_ITER_HOLDS_REGEX(&op)) {
+        pattern = bson_iter_regex(&op, &options);
+      } else if (BSON_ITER_HOLDS_UTF8(&op)) {
+        pattern = bson_iter_utf8(&op, NULL);
+      } else {
+        return query_error(q, "$regex has to be a string");
+      }
+      bson_iter_recurse(ops, &sibling);
+      if (bson_iter_find(&sibling, "$options") &&
+          BSON_ITER_HOLDS_UTF8(&sibling)) {
+        options = bson_iter_utf8(&sibling, NULL);
+      }
+      match = match_regex(q, field, pattern, options);
+    } else if (strcmp(name, "$options") == 0) {
+      continue; // va con $regex
+    } else if (strcmp(name, "$not") == 0) {
+      match = match_condition(q, doc, path, &op);
+      match = match < 0 ? match : !match;
+    } else {
+      return query_error(q, "unknown operator: %s", name);
+    }
+    if (match <= 0) {
+      return match;
+    }
+  }
+  return 1;
+}
+
+static bool is_operator_doc(const bson_iter_t *value) {
+  bson_iter_t child;
+  return BSON_ITER_HOLDS_DOCUMENT(value) &&
+         bson_iter_recurse(value, &child) && bson_iter_next(&child) &&
+         bson_iter_key(&child)[0] == '$';
+}
+
+// {path: cond} sobre doc: 1 coincide, 0 no, -1 error (en q->error)
+static int match_condition(query_t *q, const bson_t *doc, const char *path,
+                           const bson_iter_t *cond) {
+  bson_iter_t found;
+  const bson_iter_t *field = find_path(doc, path, &found) ? &found : NULL;
+
+  if (is_operator_doc(cond)) {
+    return match_operators(q, doc, path, field, cond);
+  }
+  if (BSON_ITER_HOLDS_REGEX(cond)) {
+    const char *options;
+    const char *pattern = bson_iter_regex(cond, &options);
+    return match_regex(q, field, pattern, options);
+  }
+  return equals(field, cond);
+}
+
+static int match_filter(query_t *q, const bson_t *doc, const bson_t *filter);
+
+// $and/$or/$nor: un array de filtros
+static int match_logical(query_t *q, const bson_t *doc,
+                         const bson_iter_t *list, const char *op) {
+  if (!BSON_ITER_HOLDS_ARRAY(list)) {
+    return query_error(q, "%s needs an array", op);
+  }
+  bool is_and = strcmp(op, "$and") == 0;
+  bool any = false;
+  bson_iter_t item;
+  bson_iter_recurse(list, &item);
+  while (bson_iter_next(&item)) {
+    uint32_t length;
+    const uint8_t *data;
+    bson_t clause;
+    if (!BSON_ITER_HOLDS_DOCUMENT(&item)) {
+      return query_error(q, "%s entries have to be documents", op);
+    }
+    bson_iter_document(&item, &length, &data);
+    if (!bson_init_static(&clause, data, length)) {
+      return query_error(q, "invalid document in %s", op);
+    }
+    int match = match_filter(q, doc, &clause);
+    if (match < 0) {
+      return match;
+    }
+    if (is_and && !match) {
+      return 0;
+    }
+    any = any || match;
+  }
+  if (is_and) {
+    return 1;
+  }
+  return strcmp(op, "$or") == 0 ? any : !any;
+}
+
+static int match_filter(query_t *q, const bson_t *doc, const bson_t *filter) {
+  bson_iter_t iter;
+  if (!filter || !bson_iter_init(&iter, filter)) {
+    return 1;
+  }
+  while (bson_iter_next(&iter)) {
+    const char *key = bson_iter_key(&iter);
+    int match;
+    if (strcmp(key, "$and") == 0 || strcmp(key, "$or") == 0 ||
+        strcmp(key, "$nor") == 0) {
+      match = match_logical(q, doc, &iter, key);
+    } else if (strcmp(key, "$comment") == 0) {
+      continue;
+    } else if (key[0] == '$') {
+      return query_error(q, "unknown top level operator: %s", key);
+    } else {
+      match = match_condition(q, doc, key, &iter);
+    }
+    if (match <= 0) {
+      return match;
+    }
+  }
+  return 1;
+}
+
+static int compare_sorted(const bson_t *sort, const mock_doc_t *a,
+                          const mock_doc_t *b) {
+  bson_iter_t key;
+  if (!bson_iter_init(&key, sort)) {
+    return 0;
+  }
+  while (bson_iter_next(&key)) {
+    bson_iter_t fa, fb;
+    const char *path = bson_iter_key(&key);
+    bool has_a = find_path(a->bson, path, &fa);
+    bool has_b = find_path(b->bson, path, &fb);
+    int cmp = compare_values(has_a ? &fa : NULL, has_b ? &fb : NULL);
+    if (cmp != 0) {
+      return bson_iter_as_int64(&key) < 0 ? -cmp : cmp;
+    }
+  }
+  return 0;
+}
+
+// orden estable (merge sort): a igual clave queda el orden natural
+static bool sort_docs(mock_doc_t **docs, long long count, const bson_t *sort) {
+  if (count < 2 || !sort || bson_empty(sort)) {
+    return true;
+  }
+
+  // {$natural: -1}: el orden natural al revés (así lee el visor la última
+  // página)
+  bson_iter_t natural;
+  if (bson_iter_init_find(&natural, sort, "$natural")) {
+    for (long long i = 0, j = count - 1;
+         bson_iter_as_int64(&natural) < 0 && i < j; i++, j--) {
+      mock_doc_t *doc = docs[i];
+      docs[i] = docs[j];
+      docs[j] = doc;
+    }
+    return true;
+  }
+  mock_doc_t **scratch = malloc(count * sizeof(mock_doc_t *));
+  if (!scratch) {
+    return false;
+  }
+
+  for (long long width = 1; width < count; width *= 2) {
+    for (long long lo = 0; lo < count; lo += 2 * width) {
+      long long mid = lo + width < count ? lo + width : count;
+      long long hi = lo + 2 * width < count ? lo + 2 * width : count;
+      long long i = lo, j = mid, k = lo;
+      while (i < mid && j < hi) {
+        scratch[k++] = compare_sorted(sort, docs[j], docs[i]) < 0
+                           ? docs[j++]
+                           : docs[i++];
+      }
+      while (i < mid) {
+        scratch[k++] = docs[i++];
+      }
+      while (j < hi) {
+        scratch[k++] = docs[j++];
+      }
+    }
+    memcpy(docs, scratch, count * sizeof(mock_doc_t *));
+  }
+  free(scratch);
+  return true;
+}
+
+// proyección de primer nivel ("a.b" incluye o excluye todo "a"); NULL
+// si no cambia nada
+static bson_t *project(const bson_t *doc, const bson_t *projection) {
+  bson_iter_t spec;
+  bool inclusion = false;
+  bool keep_id = true;
+  if (!projection || !bson_iter_init(&spec, projection)) {
+    return NULL;
+  }
+  while (bson_iter_next(&spec)) {
+    if (strcmp(bson_iter_key(&spec), "_id") == 0) {
+      keep_id = bson_iter_as_bool(&spec);
+    } else if (bson_iter_as_bool(&spec)) {
+      inclusion = true;
+    }
+  }
+
+  bson_t *out = bson_new();
+  bson_iter_t iter;
+  bson_iter_init(&iter, doc);
+  while (bson_iter_next(&iter)) {
+    const char *key = bson_iter_key(&iter);
+    size_t key_len = strlen(key);
+    bool listed = false, value = false;
+    bson_iter_init(&spec, projection);
+    while (bson_iter_next(&spec)) {
+      const char *path = bson_iter_key(&spec);
+      if (strncmp(path, key, key_len) == 0 &&
+          (path[key_len] == '\0' || path[key_len] == '.')) {
+        listed = true;
+        value = bson_iter_as_bool(&spec);
+        break;
+      }
+    }
+
+    bool keep;
+    if (strcmp(key, "_id") == 0) {
+      keep = keep_id;
+    } else {
+      keep = inclusion ? listed && value : !(listed && !value);
+    }
+    if (keep) {
+      bson_append_iter(out, key, (int)key_len, &iter);
+    }
+  }
+  return out;
+}
+
+// copia de doc con path puesto en value (o sacado si value es NULL); los
+// documentos intermedios que falten se crean
+static void set_path(const bson_t *doc, const char *path,
+                     const bson_iter_t *value, bson_t *out) {
+  const char *dot = strchr(path, '.');
+  size_t len = dot ? (size_t)(dot - path) : strlen(path);
+  bool seen = false;
+
+  bson_iter_t iter;
+  if (doc && bson_iter_init(&iter, doc)) {
+    while (bson_iter_next(&iter)) {
+      const char *key = bson_iter_key(&iter);
+      if (strlen(key) != len || strncmp(key, path, len) != 0) {
+        bson_append_iter(out, NULL, 0, &iter);
+        continue;
+      }
+      seen = true;
+      if (!dot) {
+        if (value) {
+          bson_append_iter(out, key, -1, value);
+        }
+      } else if (BSON_ITER_HOLDS_DOCUMENT(&iter) ||
+                 BSON_ITER_HOLDS_ARRAY(&iter)) {
+        bool array = BSON_ITER_HOLDS_ARRAY(&iter);
+        uint32_t length;
+        const uint8_t *data;
+        bson_t sub, child;
+        if (array) {
+          bson_iter_array(&iter, &length, &data);
+          bson_append_array_begin(out, key, -1, &child);
+        } else {
+          bson_iter_document(&iter, &length, &data);
+          bson_append_document_begin(out, key, -1, &child);
+        }
+        bson_init_static(&sub, data, length);
+        set_path(&sub, dot + 1, value, &child);
+        if (array) {
+          bson_append_array_end(out, &child);
+        } else {
+          bson_append_document_end(out, &child);
+        }
+      } else if (value) {
+        // un escalar en el camino pasa a ser documento
+        bson_t child;
+        bson_append_document_begin(out, key, -1, &child);
+        set_path(NULL, dot + 1, value, &child);
+        bson_append_document_end(out, &child);
+      } else {
+        bson_append_iter(out, NULL, 0, &iter);
+      }
+    }
+  }
+
+  if (!seen && value) {
+    if (dot) {
+      bson_t child;
+      bson_append_document_begin(out, path, (int)len, &child);
+      set_path(NULL, dot + 1, value, &child);
+      bson_append_document_end(out, &child);
+    } else {
+      bson_append_iter(out, path, (int)len, value);
+    }
+  }
+}
+
+// documento después de un update ($set/$unset o reemplazo conservando
+// _id); NULL con el motivo en q->error
+static bson_t *apply_update(query_t *q, const bson_t *doc,
+                            const bson_iter_t *update) {
+  uint32_t length;
+  const uint8_t *data;
+  bson_t spec;
+  if (!BSON_ITER_HOLDS_DOCUMENT(update)) {
+    query_error(q, "only document updates are supported");
+    return NULL;
+  }
+  bson_iter_document(update, &length, &data);
+  bson_init_static(&spec, data, length);
+
+  if (!is_operator_doc(update)) {
+    bson_t *out = bson_new();
+    bson_iter_t id, iter;
+    if (bson_iter_init_find(&id, doc, "_id")) {
+      bson_append_iter(out, "_id", 3, &id);
+    }
+    bson_iter_init(&iter, &spec);
+    while (bson_iter_next(&iter)) {
+      if (strcmp(bson_iter_key(&iter), "_id") != 0) {
+        bson_append_iter(out, NULL, 0, &iter);
+      }
+    }
+    return out;
+  }
+
+  bson_t *current = bson_copy(doc);
+  bson_iter_t op;
+  bson_iter_init(&op, &spec);
+  while (bson_iter_next(&op)) {
+    const char *name = bson_iter_key(&op);
+    bool set = strcmp(name, "$set") == 0;
+    if ((!set && strcmp(name, "$unset") != 0) ||
+        !BSON_ITER_HOLDS_DOCUMENT(&op)) {
+      query_error(q, "unsupported update operator: %s", name);
+      bson_destroy(current);
+      return NULL;
+    }
+
+    bson_iter_t field;
+    bson_iter_recurse(&op, &field);
+    while (bson_iter_next(&field)) {
+      bson_t *next = bson_new();
+      set_path(current, bson_iter_key(&field), set ? &field : NULL, next);
+      bson_destroy(current);
+      current = next;
+    }
+  }
+  return current;
+}
+
+static mock_cursor_t *cursor_find(mock_server_t *server, int64_t id) {
+  for (int i = 0; i < server->cursor_count; i++) {
+    if (server->cursors[i]->id == id) {
+      return server->cursors[i];
+    }
+  }
+  return NULL;
+}
+
+static void cursor_close(mock_server_t *server, mock_cursor_t *cursor) {
+  for (int i = 0; i < server->cursor_count; i++) {
+    if (server->cursors[i] == cursor) {
+      server->cursors[i] = server->cursors[--server->cursor_count];
+      break;
+    }
+  }
+  release_docs(cursor->docs, cursor->count);
+  if (cursor->projection) {
+    bson_destroy(cursor->projection);
+  }
+  free(cursor);
+}
+
+// cursor sobre docs (se queda con el array y sus referencias)
+static mock_cursor_t *cursor_new(mock_server_t *server, const char *db,
+                                 const char *coll, mock_doc_t **docs,
+                                 long long count) {
+  mock_cursor_t *cursor = calloc(1, sizeof(mock_cursor_t));
+  mock_cursor_t **grown =
+      realloc(server->cursors,
+              (server->cursor_count + 1) * sizeof(mock_cursor_t *));
+  if (grown) {
+    server->cursors = grown;
+  }
+  if (!cursor || !grown) {
+    free(cursor);
+    release_docs(docs, count);
+    return NULL;
+  }
+
+  cursor->id = server->next_cursor_id++;
+  snprintf(cursor->ns, sizeof(cursor->ns), "%s.%s", db, coll);
+  cursor->docs = docs;
+  cursor->count = count;
+  server->cursors[server->cursor_count++] = cursor;
+  return cursor;
+}
+
+// "cursor": {firstBatch|nextBatch, id, ns}; el cursor se cierra cuando
+// se termina
+static void append_batch(mock_server_t *server, bson_t *reply,
+                         mock_cursor_t *cursor, bool first,
+                         long long batch_size) {
+  long long max = batch_size > 0 ? batch_size
+                  : first        ? DEFAULT_FIRST_BATCH
+                                 : LLONG_MAX;
+  if (server->config.batch_docs > 0 && max > server->config.batch_docs) {
+    max = server->config.batch_docs;
+  }
+
+  bson_t doc, batch;
+  BSON_APPEND_DOCUMENT_BEGIN(reply, "cursor", &doc);
+  bson_append_array_begin(&doc, first ? "firstBatch" : "nextBatch", -1,
+                          &batch);
+  size_t bytes = 0;
+  for (long long n = 0; n < max && cursor->next < cursor->count; n++) {
+    const bson_t *source = cursor->docs[cursor->next]->bson;
+    bson_t *projected = project(source, cursor->projection);
+    const bson_t *out = projected ? projected : source;
+    if (n > 0 && bytes + out->len > BATCH_BYTES) {
+      if (projected) {
+        bson_destroy(projected);
+      }
+      break;
+    }
+
+    char buffer[16];
+    const char *key;
+    size_t key_len = bson_uint32_to_string((uint32_t)n, &key, buffer,
+                                           sizeof(buffer));
+    bson_append_document(&batch, key, (int)key_len, out);
+    bytes += out->len;
+    cursor->next++;
+    if (projected) {
+      bson_destroy(projected);
+    }
+  }
+  bson_append_array_end(&doc, &batch);
+
+  bool done = cursor->next >= cursor->count || cursor->single_batch;
+  BSON_APPEND_INT64(&doc, "id", done ? 0 : cursor->id);
+  BSON_APPEND_UTF8(&doc, "ns", cursor->ns);
+  bson_append_document_end(reply, &doc);
+
+  if (done) {
+    cursor_close(server, cursor);
+  }
+}
+
+// un comando en curso
+typedef struct {
+  mock_server_t *server;
+  mock_conn_t *conn;
+  const char *db;
+  const bson_t *command;
+  bson_iter_t first; // primer campo: nombre y argumento
+  bson_t *reply;
+  query_t query;
+
+  // error (si el comando devuelve false)
+  int code;
+  const char *code_name;
+  char errmsg[256];
+} mock_cmd_t;
+
+typedef bool (*command_fn)(mock_cmd_t *cmd);
+
+static bool fail(mock_cmd_t *cmd, int code, const char *code_name,
+                 const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(cmd->errmsg, sizeof(cmd->errmsg), fmt, args);
+  va_end(args);
+  cmd->code = code;
+  cmd->code_name = code_name;
+  return false;
+}
+
+static bool fail_query(mock_cmd_t *cmd) {
+  return fail(cmd, 2, "BadValue", "%s", cmd->query.error);
+}
+
+// campo del comando que tiene que ser un documento (vacío si no está)
+static bool get_doc(mock_cmd_t *cmd, const char *key, bson_t *out) {
+  bson_iter_t iter;
+  if (!bson_iter_init_find(&iter, cmd->command, key)) {
+    bson_init(out);
+    return true;
+  }
+  uint32_t length;
+  const uint8_t *data;
+  if (!BSON_ITER_HOLDS_DOCUMENT(&iter)) {
+    return fail(cmd, 14, "TypeMismatch", "'%s' has to be a document", key);
+  }
+  bson_iter_document(&iter, &length, &data);
+  if (!bson_init_static(out, data, length)) {
+    return fail(cmd, 2, "BadValue", "invalid document in '%s'", key);
+  }
+  return true;
+}
+
+static long long get_int(const bson_t *doc, const char *key,
+                         long long fallback) {
+  bson_iter_t iter;
+  if (doc && bson_iter_init_find(&iter, doc, key) &&
+      (BSON_ITER_HOLDS_NUMBER(&iter) || BSON_ITER_HOLDS_BOOL(&iter))) {
+    return bson_iter_as_int64(&iter);
+  }
+  return fallback;
+}
+
+static bool get_bool(const bson_t *doc, const char *key, bool fallback) {
+  bson_iter_t iter;
+  if (doc && bson_iter_init_find(&iter, doc, key)) {
+    return bson_iter_as_bool(&iter);
+  }
+  return fallback;
+}
+
+// nombre de la colección: el argumento del comando
+static const char *target(mock_cmd_t *cmd) {
+  if (!BSON_ITER_HOLDS_UTF8(&cmd->first)) {
+    fail(cmd, 73, "InvalidNamespace", "collection name has to be a string");
+    return NULL;
+  }
+  return bson_iter_utf8(&cmd->first, NULL);
+}
+
+// documentos de la colección que pasan el filtro, retenidos y en orden
+// natural; false si el filtro es inválido
+static bool select_docs(mock_cmd_t *cmd, mock_coll_t *coll,
+                        const bson_t *filter, mock_doc_t ***docs,
+                        long long *count) {
+  *docs = NULL;
+  *count = 0;
+  if (!coll || coll->count == 0) {
+    return true;
+  }
+
+  mock_doc_t **out = malloc(coll->count * sizeof(mock_doc_t *));
+  if (!out) {
+    return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+  }
+  long long n = 0;
+  for (long long i = 0; i < coll->count; i++) {
+    int match = match_filter(&cmd->query, coll->docs[i]->bson, filter);
+    if (match < 0) {
+      release_docs(out, n);
+      return fail_query(cmd);
+    }
+    if (match) {
+      coll->docs[i]->refs++;
+      out[n++] = coll->docs[i];
+    }
+  }
+  *docs = out;
+  *count = n;
+  return true;
+}
+
+// dejar [skip, skip + limit) (limit 0: todos)
+static void slice_docs(mock_doc_t **docs, long long *count, long long skip,
+                       long long limit) {
+  if (skip < 0) {
+    skip = 0;
+  }
+  if (skip > *count) {
+    skip = *count;
+  }
+  for (long long i = 0; i < skip; i++) {
+    doc_release(docs[i]);
+  }
+  memmove(docs, docs + skip, (*count - skip) * sizeof(mock_doc_t *));
+  *count -= skip;
+
+  if (limit > 0 && limit < *count) {
+    for (long long i = limit; i < *count; i++) {
+      doc_release(docs[i]);
+    }
+    *count = limit;
+  }
+}
+
+static bool cmd_hello(mock_cmd_t *cmd) {
+  BSON_APPEND_BOOL(cmd->reply, "helloOk", true);
+  BSON_APPEND_BOOL(cmd->reply, "ismaster", true);
+  BSON_APPEND_BOOL(cmd->reply, "isWritablePrimary", true);
+  BSON_APPEND_INT32(cmd->reply, "maxBsonObjectSize", MAX_BSON_SIZE);
+  BSON_APPEND_INT32(cmd->reply, "maxMessageSizeBytes", MAX_MESSAGE_SIZE);
+  BSON_APPEND_INT32(cmd->reply, "maxWriteBatchSize", MAX_WRITE_BATCH);
+  bson_append_now_utc(cmd->reply, "localTime", -1);
+  BSON_APPEND_INT32(cmd->reply, "connectionId", cmd->conn ? cmd->conn->id : 0);
+  BSON_APPEND_INT32(cmd->reply, "minWireVersion", 0);
+  BSON_APPEND_INT32(cmd->reply, "maxWireVersion", MAX_WIRE_VERSION);
+  BSON_APPEND_BOOL(cmd->reply, "readOnly", false);
+  return true;
+}
+
+static bool cmd_ok(mock_cmd_t *cmd) {
+  (void)cmd;
+  return true;
+}
+
+static bool cmd_build_info(mock_cmd_t *cmd) {
+  BSON_APPEND_UTF8(cmd->reply, "version", "6.0.0-mock");
+  bson_t version;
+  BSON_APPEND_ARRAY_BEGIN(cmd->reply, "versionArray", &version);
+  BSON_APPEND_INT32(&version, "0", 6);
+  BSON_APPEND_INT32(&version, "1", 0);
+  BSON_APPEND_INT32(&version, "2", 0);
+  BSON_APPEND_INT32(&version, "3", 0);
+  bson_append_array_end(cmd->reply, &version);
+  BSON_APPEND_INT32(cmd->reply, "maxBsonObjectSize", MAX_BSON_SIZE);
+  return true;
+}
+
+static bool cmd_list_databases(mock_cmd_t *cmd) {
+  mock_server_t *server = cmd->server;
+  bool name_only = get_bool(cmd->command, "nameOnly", false);
+  long long total = 0;
+
+  bson_t list;
+  BSON_APPEND_ARRAY_BEGIN(cmd->reply, "databases", &list);
+  int n = 0;
+  for (int i = 0; i < server->coll_count; i++) {
+    // cada base una vez, en el orden en que aparece
+    const char *db = server->colls[i]->db;
+    bool seen = false;
+    for (int j = 0; j < i && !seen; j++) {
+      seen = strcmp(server->colls[j]->db, db) == 0;
+    }
+    if (seen) {
+      continue;
+    }
+
+    long long size = 0;
+    for (int j = i; j < server->coll_count; j++) {
+      if (strcmp(server->colls[j]->db, db) == 0) {
+        size += server->colls[j]->data_size;
+      }
+    }
+    total += size;
+
+    char buffer[16];
+    const char *key;
+    bson_uint32_to_string((uint32_t)n++, &key, buffer, sizeof(buffer));
+    bson_t entry;
+    BSON_APPEND_DOCUMENT_BEGIN(&list, key, &entry);
+    BSON_APPEND_UTF8(&entry, "name", db);
+    if (!name_only) {
+      BSON_APPEND_INT64(&entry, "sizeOnDisk", size);
+      BSON_APPEND_BOOL(&entry, "empty", size == 0);
+    }
+    bson_append_document_end(&list, &entry);
+  }
+  bson_append_array_end(cmd->reply, &list);
+
+  if (!name_only) {
+    BSON_APPEND_INT64(cmd->reply, "totalSize", total);
+  }
+  return true;
+}
+
+// devuelve todos los documentos armados de una vez en un cursor
+static bool reply_cursor(mock_cmd_t *cmd, const char *coll, bson_t **docs,
+                         long long count) {
+  mock_doc_t **wrapped = malloc((count > 0 ? count : 1) * sizeof(*wrapped));
+  long long n = 0;
+  for (long long i = 0; i < count; i++) {
+    mock_doc_t *doc = wrapped ? doc_new(docs[i]) : NULL;
+    if (!doc) {
+      if (!wrapped) {
+        bson_destroy(docs[i]);
+      }
+      continue;
+    }
+    wrapped[n++] = doc;
+  }
+  if (!wrapped || n < count) {
+    release_docs(wrapped, n);
+    return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+  }
+
+  mock_cursor_t *cursor = cursor_new(cmd->server, cmd->db, coll, wrapped, n);
+  if (!cursor) {
+    return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+  }
+  bson_t opts;
+  if (!get_doc(cmd, "cursor", &opts)) {
+    cursor_close(cmd->server, cursor);
+    return false;
+  }
+  append_batch(cmd->server, cmd->reply, cursor, true,
+               get_int(&opts, "batchSize", 0));
+  return true;
+}
+
+static bool cmd_list_collections(mock_cmd_t *cmd) {
+  mock_server_t *server = cmd->server;
+  bool name_only = get_bool(cmd->command, "nameOnly", false);
+  bson_t filter;
+  if (!get_doc(cmd, "filter", &filter)) {
+    return false;
+  }
+
+  bson_t **docs = malloc((server->coll_count + 1) * sizeof(bson_t *));
+  if (!docs) {
+    return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+  }
+  long long count = 0;
+  for (int i = 0; i < server->coll_count; i++) {
+    mock_coll_t *coll = server->colls[i];
+    if (strcmp(coll->db, cmd->db) != 0) {
+      continue;
+    }
+
+    bson_t *info = BCON_NEW("name", BCON_UTF8(coll->name), "type",
+                            BCON_UTF8("collection"));
+    if (!name_only) {
+      BCON_APPEND(info, "options", "{", "}", "info", "{", "readOnly",
+                  BCON_BOOL(false), "}");
+    }
+    int match = match_filter(&cmd->query, info, &filter);
+    if (match <= 0) {
+      bson_destroy(info);
+      if (match < 0) {
+        for (long long j = 0; j < count; j++) {
+          bson_destroy(docs[j]);
+        }
+        free(docs);
+        return fail_query(cmd);
+      }
+      continue;
+    }
+    docs[count++] = info;
+  }
+
+  bool ok = reply_cursor(cmd, "$cmd.listCollections", docs, count);
+  free(docs);
+  return ok;
+}
+
+static bool cmd_list_indexes(mock_cmd_t *cmd) {
+  const char *name = target(cmd);
+  if (!name) {
+    return false;
+  }
+  mock_coll_t *coll = coll_find(cmd->server, cmd->db, name);
+  if (!coll) {
+    return fail(cmd, 26, "NamespaceNotFound", "ns does not exist: %s.%s",
+                cmd->db, name);
+  }
+
+  bson_t **docs = malloc(coll->index_count * sizeof(bson_t *));
+  if (!docs) {
+    return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+  }
+  for (int i = 0; i < coll->index_count; i++) {
+    docs[i] = bson_copy(coll->indexes[i]);
+  }
+  bool ok = reply_cursor(cmd, name, docs, coll->index_count);
+  free(docs);
+  return ok;
+}
+
+static bool cmd_create_indexes(mock_cmd_t *cmd) {
+  const char *name = target(cmd);
+  bson_iter_t iter, spec;
+  if (!name) {
+    return false;
+  }
+  if (!bson_iter_init_find(&iter, cmd->command, "indexes") ||
+      !BSON_ITER_HOLDS_ARRAY(&iter)) {
+    return fail(cmd, 2, "BadValue", "'indexes' has to be an array");
+  }
+
+  bool created = !coll_find(cmd->server, cmd->db, name);
+  mock_coll_t *coll = coll_get(cmd->server, cmd->db, name);
+  if (!coll) {
+    return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+  }
+  int before = coll->index_count;
+
+  bson_iter_recurse(&iter, &spec);
+  while (bson_iter_next(&spec)) {
+    uint32_t length;
+    const uint8_t *data;
+    bson_t index;
+    bson_iter_t index_name;
+    if (!BSON_ITER_HOLDS_DOCUMENT(&spec)) {
+      return fail(cmd, 2, "BadValue", "index specs have to be documents");
+    }
+    bson_iter_document(&spec, &length, &data);
+    if (!bson_init_static(&index, data, length) ||
+        !bson_iter_init_find(&index_name, &index, "name") ||
+        !BSON_ITER_HOLDS_UTF8(&index_name)) {
+      return fail(cmd, 9, "FailedToParse", "index spec without a name");
+    }
+
+    bool exists = false;
+    for (int i = 0; i < coll->index_count && !exists; i++) {
+      bson_iter_t other;
+      exists = bson_iter_init_find(&other, coll->indexes[i], "name") &&
+               strcmp(bson_iter_utf8(&other, NULL),
+                      bson_iter_utf8(&index_name, NULL)) == 0;
+    }
+    if (!exists && !coll_add_index(coll, bson_copy(&index))) {
+      return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+    }
+  }
+
+  BSON_APPEND_INT32(cmd->reply, "numIndexesBefore", before);
+  BSON_APPEND_INT32(cmd->reply, "numIndexesAfter", coll->index_count);
+  BSON_APPEND_BOOL(cmd->reply, "createdCollectionAutomatically", created);
+  return true;
+}
+
+static bool cmd_create(mock_cmd_t *cmd) {
+  const char *name = target(cmd);
+  if (!name) {
+    return false;
+  }
+  if (coll_find(cmd->server, cmd->db, name)) {
+    return fail(cmd, 48, "NamespaceExists", "Collection %s.%s already exists.",
+                cmd->db, name);
+  }
+  if (!coll_get(cmd->server, cmd->db, name)) {
+    return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+  }
+  return true;
+}
+
+// como mongod 7: borrar algo que no existe no es error
+static bool cmd_drop(mock_cmd_t *cmd) {
+  const char *name = target(cmd);
+  if (!name) {
+    return false;
+  }
+  mock_coll_t *coll = coll_find(cmd->server, cmd->db, name);
+  if (coll) {
+    coll_drop(cmd->server, coll);
+  }
+  return true;
+}
+
+static bool cmd_drop_database(mock_cmd_t *cmd) {
+  mock_server_t *server = cmd->server;
+  for (int i = server->coll_count - 1; i >= 0; i--) {
+    if (strcmp(server->colls[i]->db, cmd->db) == 0) {
+      coll_drop(server, server->colls[i]);
+    }
+  }
+  return true;
+}
+
+static bool cmd_coll_stats(mock_cmd_t *cmd) {
+  const char *name = target(cmd);
+  if (!name) {
+    return false;
+  }
+  mock_coll_t *coll = coll_find(cmd->server, cmd->db, name);
+  long long count = coll ? coll->count : 0;
+  long long size = coll ? coll->data_size : 0;
+
+  char ns[NAME_SIZE * 2];
+  snprintf(ns, sizeof(ns), "%s.%s", cmd->db, name);
+  BSON_APPEND_UTF8(cmd->reply, "ns", ns);
+  BSON_APPEND_INT64(cmd->reply, "count", count);
+  BSON_APPEND_INT64(cmd->reply, "size", size);
+  BSON_APPEND_INT64(cmd->reply, "avgObjSize", count ? size / count : 0);
+  BSON_APPEND_INT64(cmd->reply, "storageSize", size);
+  BSON_APPEND_INT32(cmd->reply, "nindexes", coll ? coll->index_count : 0);
+  BSON_APPEND_INT64(cmd->reply, "totalIndexSize", 0);
+  return true;
+}
+
+static bool cmd_count(mock_cmd_t *cmd) {
+  const char *name = target(cmd);
+  bson_t filter;
+  if (!name || !get_doc(cmd, "query", &filter)) {
+    return false;
+  }
+
+  mock_doc_t **docs;
+  long long count;
+  if (!select_docs(cmd, coll_find(cmd->server, cmd->db, name), &filter, &docs,
+                   &count)) {
+    return false;
+  }
+  slice_docs(docs, &count, get_int(cmd->command, "skip", 0),
+             get_int(cmd->command, "limit", 0));
+  release_docs(docs, count);
+  BSON_APPEND_INT64(cmd->reply, "n", count);
+  return true;
+}
+
+static bool cmd_find(mock_cmd_t *cmd) {
+  const char *name = target(cmd);
+  bson_t filter, sort, projection;
+  if (!name || !get_doc(cmd, "filter", &filter) ||
+      !get_doc(cmd, "sort", &sort) ||
+      !get_doc(cmd, "projection", &projection)) {
+    return false;
+  }
+
+  mock_doc_t **docs;
+  long long count;
+  if (!select_docs(cmd, coll_find(cmd->server, cmd->db, name), &filter, &docs,
+                   &count)) {
+    return false;
+  }
+  if (!sort_docs(docs, count, &sort)) {
+    release_docs(docs, count);
+    return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+  }
+
+  // limit negativo: un solo batch
+  long long limit = get_int(cmd->command, "limit", 0);
+  bool single = get_bool(cmd->command, "singleBatch", false) || limit < 0;
+  slice_docs(docs, &count, get_int(cmd->command, "skip", 0),
+             limit < 0 ? -limit : limit);
+
+  mock_cursor_t *cursor = cursor_new(cmd->server, cmd->db, name, docs, count);
+  if (!cursor) {
+    return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+  }
+  cursor->single_batch = single;
+  if (!bson_empty(&projection)) {
+    cursor->projection = bson_copy(&projection);
+  }
+  append_batch(cmd->server, cmd->reply, cursor, true,
+               get_int(cmd->command, "batchSize", 0));
+  return true;
+}
+
+static bool cmd_get_more(mock_cmd_t *cmd) {
+  int64_t id = bson_iter_as_int64(&cmd->first);
+  mock_cursor_t *cursor = cursor_find(cmd->server, id);
+  if (!cursor) {
+    return fail(cmd, 43, "CursorNotFound", "cursor id %lld not found",
+                (long long)id);
+  }
+  append_batch(cmd->server, cmd->reply, cursor, false,
+               get_int(cmd->command, "batchSize", 0));
+  return true;
+}
+
+static bool cmd_kill_cursors(mock_cmd_t *cmd) {
+  bson_iter_t ids;
+  if (!bson_iter_init_find(&ids, cmd->command, "cursors") ||
+      !BSON_ITER_HOLDS_ARRAY(&ids)) {
+    return fail(cmd, 14, "TypeMismatch", "'cursors' has to be an array");
+  }
+
+  bson_t killed, missing;
+  int killed_count = 0, missing_count = 0;
+  bson_init(&killed);
+  bson_init(&missing);
+  bson_iter_t id;
+  bson_iter_recurse(&ids, &id);
+  while (bson_iter_next(&id)) {
+    mock_cursor_t *cursor = cursor_find(cmd->server, bson_iter_as_int64(&id));
+    bson_t *list = cursor ? &killed : &missing;
+    int *count = cursor ? &killed_count : &missing_count;
+    char buffer[16];
+    const char *key;
+    size_t key_len = bson_uint32_to_string((uint32_t)(*count)++, &key,
+                                           buffer, sizeof(buffer));
+    bson_append_int64(list, key, (int)key_len, bson_iter_as_int64(&id));
+    if (cursor) {
+      cursor_close(cmd->server, cursor);
+    }
+  }
+  BSON_APPEND_ARRAY(cmd->reply, "cursorsKilled", &killed);
+  BSON_APPEND_ARRAY(cmd->reply, "cursorsNotFound", &missing);
+  bson_destroy(&killed);
+  bson_destroy(&missing);
+  return true;
+}
+
+// $group de conteo: _id constante y acumuladores {$sum: número}
+static bson_t *group_count(mock_cmd_t *cmd, const bson_iter_t *stage,
+                           long long count) {
+  bson_iter_t field;
+  bson_iter_recurse(stage, &field);
+  bson_t *out = bson_new();
+  while (bson_iter_next(&field)) {
+    const char *key = bson_iter_key(&field);
+    if (strcmp(key, "_id") == 0) {
+      if (BSON_ITER_HOLDS_DOCUMENT(&field) ||
+          (BSON_ITER_HOLDS_UTF8(&field) &&
+           bson_iter_utf8(&field, NULL)[0] == '$')) {
+        bson_destroy(out);
+        fail(cmd, 40324, "Location40324",
+             "$group: only a constant _id is supported");
+        return NULL;
+      }
+      bson_append_iter(out, "_id", 3, &field);
+      continue;
+    }
+
+    bson_iter_t acc;
+    if (!BSON_ITER_HOLDS_DOCUMENT(&field) ||
+        !bson_iter_recurse(&field, &acc) || !bson_iter_next(&acc) ||
+        strcmp(bson_iter_key(&acc), "$sum") != 0 ||
+        !BSON_ITER_HOLDS_NUMBER(&acc)) {
+      bson_destroy(out);
+      fail(cmd, 40324, "Location40324",
+           "$group: only {$sum: <number>} is supported");
+      return NULL;
+    }
+    if (BSON_ITER_HOLDS_DOUBLE(&acc)) {
+      BSON_APPEND_DOUBLE(out, key, bson_iter_double(&acc) * (double)count);
+    } else if (bson_iter_as_int64(&acc) * count <= INT32_MAX) {
+      BSON_APPEND_INT32(out, key,
+                        (int32_t)(bson_iter_as_int64(&acc) * count));
+    } else {
+      BSON_APPEND_INT64(out, key, bson_iter_as_int64(&acc) * count);
+    }
+  }
+  return out;
+}
+
+// una etapa del pipeline sobre el conjunto de trabajo
+static bool run_stage(mock_cmd_t *cmd, const bson_iter_t *stage,
+                      mock_doc_t ***docs, long long *count) {
+  const char *name = bson_iter_key(stage);
+  uint32_t length = 0;
+  const uint8_t *data = NULL;
+  bson_t spec;
+  if (BSON_ITER_HOLDS_DOCUMENT(stage)) {
+    bson_iter_document(stage, &length, &data);
+    bson_init_static(&spec, data, length);
+  } else {
+    bson_init(&spec);
+  }
+
+  if (strcmp(name, "$match") == 0) {
+    long long n = 0;
+    for (long long i = 0; i < *count; i++) {
+      int match = match_filter(&cmd->query, (*docs)[i]->bson, &spec);
+      if (match < 0) {
+        return fail_query(cmd);
+      }
+      if (match) {
+        (*docs)[n++] = (*docs)[i];
+      } else {
+        doc_release((*docs)[i]);
+      }
+    }
+    *count = n;
+    return true;
+  }
+  if (strcmp(name, "$sort") == 0) {
+    return sort_docs(*docs, *count, &spec) ||
+           fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+  }
+  if (strcmp(name, "$skip") == 0) {
+    slice_docs(*docs, count, bson_iter_as_int64(stage), 0);
+    return true;
+  }
+  if (strcmp(name, "$limit") == 0) {
+    slice_docs(*docs, count, 0, bson_iter_as_int64(stage));
+    return true;
+  }
+  if (strcmp(name, "$project") == 0) {
+    for (long long i = 0; i < *count; i++) {
+      bson_t *projected = project((*docs)[i]->bson, &spec);
+      mock_doc_t *doc = projected ? doc_new(projected) : NULL;
+      if (!doc) {
+        return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+      }
+      doc_release((*docs)[i]);
+      (*docs)[i] = doc;
+    }
+    return true;
+  }
+
+  bson_t *single = NULL;
+  if (strcmp(name, "$count") == 0 && BSON_ITER_HOLDS_UTF8(stage)) {
+    single = *count > 0 ? BCON_NEW(bson_iter_utf8(stage, NULL),
+                                   BCON_INT32((int32_t)*count))
+                        : NULL;
+  } else if (strcmp(name, "$group") == 0 && BSON_ITER_HOLDS_DOCUMENT(stage)) {
+    if (*count > 0 && !(single = group_count(cmd, stage, *count))) {
+      return false;
+    }
+  } else {
+    return fail(cmd, 40324, "Location40324",
+                "Unrecognized pipeline stage name: '%s'", name);
+  }
+
+  // $count y $group: un documento (o ninguno si no había nada)
+  for (long long i = 0; i < *count; i++) {
+    doc_release((*docs)[i]);
+  }
+  *count = 0;
+  if (single) {
+    mock_doc_t *doc = doc_new(single);
+    mock_doc_t **grown = doc ? realloc(*docs, sizeof(mock_doc_t *)) : NULL;
+    if (!grown) {
+      doc_release(doc);
+      return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+    }
+    *docs = grown;
+    (*docs)[(*count)++] = doc;
+  }
+  return true;
+}
+
+static bool cmd_aggregate(mock_cmd_t *cmd) {
+  const char *name = target(cmd);
+  bson_iter_t pipeline, stage;
+  if (!name) {
+    return false;
+  }
+  if (!bson_iter_init_find(&pipeline, cmd->command, "pipeline") ||
+      !BSON_ITER_HOLDS_ARRAY(&pipeline)) {
+    return fail(cmd, 14, "TypeMismatch", "'pipeline' has to be an array");
+  }
+
+  mock_doc_t **docs;
+  long long count;
+  if (!select_docs(cmd, coll_find(cmd->server, cmd->db, name), NULL, &docs,
+                   &count)) {
+    return false;
+  }
+
+  bson_iter_recurse(&pipeline, &stage);
+  while (bson_iter_next(&stage)) {
+    bson_iter_t op;
+    if (!BSON_ITER_HOLDS_DOCUMENT(&stage) || !bson_iter_recurse(&stage, &op) ||
+        !bson_iter_next(&op) || !run_stage(cmd, &op, &docs, &count)) {
+      release_docs(docs, count);
+      return cmd->code ? false
+                       : fail(cmd, 14, "TypeMismatch",
+                              "pipeline stages have to be documents");
+    }
+  }
+
+  mock_cursor_t *cursor = cursor_new(cmd->server, cmd->db, name, docs, count);
+  bson_t opts;
+  if (!cursor) {
+    return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+  }
+  if (!get_doc(cmd, "cursor", &opts)) {
+    cursor_close(cmd->server, cursor);
+    return false;
+  }
+  append_batch(cmd->server, cmd->reply, cursor, true,
+               get_int(&opts, "batchSize", 0));
+  return true;
+}
+
+// writeErrors: [{index, code, errmsg}]
+static void write_error(bson_t *errors, int *count, long long index, int code,
+                        const char *message) {
+  char buffer[16];
+  const char *key;
+  bson_uint32_to_string((uint32_t)(*count)++, &key, buffer, sizeof(buffer));
+  bson_t entry;
+  BSON_APPEND_DOCUMENT_BEGIN(errors, key, &entry);
+  BSON_APPEND_INT32(&entry, "index", (int32_t)index);
+  BSON_APPEND_INT32(&entry, "code", code);
+  BSON_APPEND_UTF8(&entry, "errmsg", message);
+  bson_append_document_end(errors, &entry);
+}
+
+// los documentos de una escritura: en el cuerpo o en una secuencia de
+// OP_MSG (ya juntadas en el comando como array)
+static bool write_items(mock_cmd_t *cmd, const char *key, bson_iter_t *items) {
+  bson_iter_t iter;
+  if (!bson_iter_init_find(&iter, cmd->command, key) ||
+      !BSON_ITER_HOLDS_ARRAY(&iter)) {
+    return fail(cmd, 14, "TypeMismatch", "'%s' has to be an array", key);
+  }
+  bson_iter_recurse(&iter, items);
+  return true;
+}
+
+static bool cmd_insert(mock_cmd_t *cmd) {
+  const char *name = target(cmd);
+  bson_iter_t item;
+  if (!name || !write_items(cmd, "documents", &item)) {
+    return false;
+  }
+  mock_coll_t *coll = coll_get(cmd->server, cmd->db, name);
+  if (!coll) {
+    return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+  }
+
+  long long n = 0;
+  while (bson_iter_next(&item)) {
+    uint32_t length;
+    const uint8_t *data;
+    bson_t doc;
+    if (!BSON_ITER_HOLDS_DOCUMENT(&item)) {
+      continue;
+    }
+    bson_iter_document(&item, &length, &data);
+    if (!bson_init_static(&doc, data, length)) {
+      continue;
+    }
+    mock_doc_t *entry = doc_new(with_id(cmd->server, &doc));
+    if (!entry || !coll_append(coll, entry)) {
+      return fail(cmd, 146, "ExceededMemoryLimit", "out of memory");
+    }
+    n++;
+  }
+  BSON_APPEND_INT64(cmd->reply, "n", n);
+  return true;
+}
+
+// upsert: los campos de igualdad del filtro y después el update
+static bson_t *upsert_doc(mock_cmd_t *cmd, const bson_iter_t *query,
+                          const bson_iter_t *update) {
+  bson_t base;
+  bson_init(&base);
+  if (BSON_ITER_HOLDS_DOCUMENT(query)) {
+    bson_iter_t field;
+    bson_iter_recurse(query, &field);
+    while (bson_iter_next(&field)) {
+      if (bson_iter_key(&field)[0] != '$' && !is_operator_doc(&field) &&
+          !strchr(bson_iter_key(&field), '.')) {
+        bson_append_iter(&base, NULL, 0, &field);
+      }
+    }
+  }
+  bson_t *updated = apply_update(&cmd->query, &base, update);
+  bson_destroy(&base);
+  if (!updated) {
+    return NULL;
+  }
+  bson_t *doc = with_id(cmd->server, updated);
+  bson_destroy(updated);
+  return doc;
+}
+
+static bool cmd_update(mock_cmd_t *cmd) {
+  const char *name = target(cmd);
+  bson_iter_t item;
+  if (!name || !write_items(cmd, "updates", &item)) {
+    return false;
+  }
+  bool ordered = get_bool(cmd->command, "ordered", true);
+  mock_coll_t *coll = coll_find(cmd->server, cmd->db, name);
+
+  long long matched = 0, modified = 0;
+  bson_t errors, upserted;
+  int error_count = 0, upserted_count = 0;
+  bson_init(&errors);
+  bson_init(&upserted);
+
+  for (long long index = 0; bson_iter_next(&item); index++) {
+    bson_iter_t q, u;
+    bson_t filter, statement;
+    uint32_t length;
+    const uint8_t *data;
+    if (!BSON_ITER_HOLDS_DOCUMENT(&item)) {
+      continue;
+    }
+    bson_iter_document(&item, &length, &data);
+    bson_init_static(&statement, data, length);
+    if (!bson_iter_init_find(&q, &statement, "q") ||
+        !BSON_ITER_HOLDS_DOCUMENT(&q) ||
+        !bson_iter_init_find(&u, &statement, "u")) {
+      write_error(&errors, &error_count, index, 9, "missing q or u");
+      if (ordered) {
+        break;
+      }
+      continue;
+    }
+    bson_iter_document(&q, &length, &data);
+    bson_init_static(&filter, data, length);
+    bool multi = get_bool(&statement, "multi", false);
+
+    bool failed = false, found = false;
+    for (long long i = 0; coll && i < coll->count && !failed; i++) {
+      int match = match_filter(&cmd->query, coll->docs[i]->bson, &filter);
+      if (match <= 0) {
+        failed = match < 0;
+        continue;
+      }
+      found = true;
+      matched++;
+      bson_t *updated = apply_update(&cmd->query, coll->docs[i]->bson, &u);
+      mock_doc_t *doc = updated ? doc_new(updated) : NULL;
+      if (!doc) {
+        failed = true;
+        break;
+      }
+      if (bson_equal(updated, coll->docs[i]->bson)) {
+        doc_release(doc);
+      } else {
+        coll_replace(coll, i, doc);
+        modified++;
+      }
+      if (!multi) {
+        break;
+      }
+    }
+
+    if (!failed && !found && get_bool(&statement, "upsert", false)) {
+      bson_t *doc = upsert_doc(cmd, &q, &u);
+      mock_doc_t *entry = doc ? doc_new(doc) : NULL;
+      if (!coll) {
+        coll = coll_get(cmd->server, cmd->db, name);
+      }
+      bson_iter_t id;
+      if (!entry || !coll || !bson_iter_init_find(&id, doc, "_id")) {
+        doc_release(entry);
+        failed = true;
+      } else {
+        char buffer[16];
+        const char *key;
+        bson_t up;
+        bson_uint32_to_string((uint32_t)upserted_count++, &key, buffer,
+                              sizeof(buffer));
+        BSON_APPEND_DOCUMENT_BEGIN(&upserted, key, &up);
+        BSON_APPEND_INT32(&up, "index", (int32_t)index);
+        bson_append_iter(&up, "_id", 3, &id);
+        bson_append_document_end(&upserted, &up);
+        matched++;
+        failed = !coll_append(coll, entry);
+      }
+    }
+
+    if (failed) {
+      write_error(&errors, &error_count, index, 9,
+                  cmd->query.error[0] ? cmd->query.error : "update failed");
+      cmd->query.error[0] = '\0';
+      if (ordered) {
+        break;
+      }
+    }
+  }
+
+  BSON_APPEND_INT64(cmd->reply, "n", matched);
+  BSON_APPEND_INT64(cmd->reply, "nModified", modified);
+  if (upserted_count > 0) {
+    BSON_APPEND_ARRAY(cmd->reply, "upserted", &upserted);
+  }
+  if (error_count > 0) {
+    BSON_APPEND_ARRAY(cmd->reply, "writeErrors", &errors);
+  }
+  bson_destroy(&upserted);
+  bson_destroy(&errors);
+  return true;
+}
+
+static bool cmd_delete(mock_cmd_t *cmd) {
+  const char *name = target(cmd);
+  bson_iter_t item;
+  if (!name || !write_items(cmd, "deletes", &item)) {
+    return false;
+  }
+  bool ordered = get_bool(cmd->command, "ordered", true);
+  mock_coll_t *coll = coll_find(cmd->server, cmd->db, name);
+
+  long long n = 0;
+  bson_t errors;
+  int error_count = 0;
+  bson_init(&errors);
+
+  for (long long index = 0; bson_iter_next(&item); index++) {
+    bson_iter_t q;
+    bson_t filter, statement;
+    uint32_t length;
+    const uint8_t *data;
+    if (!BSON_ITER_HOLDS_DOCUMENT(&item)) {
+      continue;
+    }
+    bson_iter_document(&item, &length, &data);
+    bson_init_static(&statement, data, length);
+    if (!bson_iter_init_find(&q, &statement, "q") ||
+        !BSON_ITER_HOLDS_DOCUMENT(&q)) {
+      write_error(&errors, &error_count, index, 9, "missing q");
+      if (ordered) {
+        break;
+      }
+      continue;
+    }
+    bson_iter_document(&q, &length, &data);
+    bson_init_static(&filter, data, length);
+    bool one = get_int(&statement, "limit", 0) == 1;
+
+    for (long long i = 0; coll && i < coll->count;) {
+      int match = match_filter(&cmd->query, coll->docs[i]->bson, &filter);
+      if (match < 0) {
+        write_error(&errors, &error_count, index, 2, cmd->query.error);
+        break;
+      }
+      if (!match) {
+        i++;
+        continue;
+      }
+      coll_remove(coll, i);
+      n++;
+      if (one) {
+        break;
+      }
+    }
+    if (error_count > 0 && ordered) {
+      break;
+    }
+  }
+
+  BSON_APPEND_INT64(cmd->reply, "n", n);
+  if (error_count > 0) {
+    BSON_APPEND_ARRAY(cmd->reply, "writeErrors", &errors);
+  }
+  bson_destroy(&errors);
+  return true;
+}
+
+static const struct {
+  const char *name;
+  command_fn fn;
+} COMMANDS[] = {
+    {"hello", cmd_hello},
+    {"isMaster", cmd_hello},
+    {"ismaster", cmd_hello},
+    {"ping", cmd_ok},
+    {"endSessions", cmd_ok},
+    {"buildInfo", cmd_build_info},
+    {"buildinfo", cmd_build_info},
+    {"listDatabases", cmd_list_databases},
+    {"listCollections", cmd_list_collections},
+    {"listIndexes", cmd_list_indexes},
+    {"createIndexes", cmd_create_indexes},
+    {"create", cmd_create},
+    {"drop", cmd_drop},
+    {"dropDatabase", cmd_drop_database},
+    {"collStats", cmd_coll_stats},
+    {"count", cmd_count},
+    {"find", cmd_find},
+    {"getMore", cmd_get_more},
+    {"killCursors", cmd_kill_cursors},
+    {"aggregate", cmd_aggregate},
+    {"insert", cmd_insert},
+    {"update", cmd_update},
+    {"delete", cmd_delete},
+};
+
+// correr un comando y armar la respuesta (con ok)
+static void run_command(mock_server_t *server, mock_conn_t *conn,
+                        const char *db, const bson_t *command,
+                        bson_t *reply) {
+  mock_cmd_t cmd = {.server = server,
+                    .conn = conn,
+                    .db = db,
+                    .command = command,
+                    .reply = reply};
+  bson_init(reply);
+
+  if (!bson_iter_init(&cmd.first, command) || !bson_iter_next(&cmd.first)) {
+    fail(&cmd, 2, "BadValue", "empty command");
+  } else {
+    const char *name = bson_iter_key(&cmd.first);
+    command_fn fn = NULL;
+    for (size_t i = 0; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]); i++) {
+      if (strcmp(COMMANDS[i].name, name) == 0) {
+        fn = COMMANDS[i].fn;
+        break;
+      }
+    }
+
+    pthread_mutex_lock(&server->lock);
+    bool ok = fn ? fn(&cmd)
+                 : fail(&cmd, 59, "CommandNotFound", "no such command: '%s'",
+                        name);
+    pthread_mutex_unlock(&server->lock);
+    query_free(&cmd.query);
+    if (ok) {
+      BSON_APPEND_DOUBLE(reply, "ok", 1.0);
+      return;
+    }
+  }
+
+  // lo que se haya agregado antes del error no va
+  bson_reinit(reply);
+  BSON_APPEND_DOUBLE(reply, "ok", 0.0);
+  BSON_APPEND_UTF8(reply, "errmsg", cmd.errmsg);
+  BSON_APPEND_INT32(reply, "code", cmd.code);
+  BSON_APPEND_UTF8(reply, "codeName", cmd.code_name);
+}
+
+static bool server_stopping(mock_server_t *server) {
+  pthread_mutex_lock(&server->lock);
+  bool stopping = server->stopping;
+  pthread_mutex_unlock(&server->lock);
+  return stopping;
+}
+
+static bool recv_all(mock_conn_t *conn, uint8_t *data, size_t length) {
+  while (length > 0) {
+    struct pollfd pfd = {.fd = conn->fd, .events = POLLIN};
+    int ready = poll(&pfd, 1, POLL_MS);
+    if (server_stopping(conn->server) || (ready < 0 && errno != EINTR)) {
+      return false;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+    ssize_t n = recv(conn->fd, data, length, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    length -= (size_t)n;
+  }
+  return true;
+}
+
+static bool send_all(int fd, const uint8_t *data, size_t length) {
+  while (length > 0) {
+    ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    length -= (size_t)n;
+  }
+  return true;
+}
+
+// respuesta con la latencia y el ancho de banda configurados
+static bool send_message(mock_conn_t *conn, const uint8_t *data,
+                         size_t length) {
+  const mock_config_t *config = &conn->server->config;
+  sleep_us(config->latency_ms * 1000LL);
+  if (config->bandwidth <= 0) {
+    return send_all(conn->fd, data, length);
+  }
+
+  while (length > 0) {
+    size_t chunk = length < BANDWIDTH_CHUNK ? length : BANDWIDTH_CHUNK;
+    int64_t start = bson_get_monotonic_time();
+    if (!send_all(conn->fd, data, chunk)) {
+      return false;
+    }
+    data += chunk;
+    length -= chunk;
+    int64_t due = (int64_t)chunk * 1000000 / config->bandwidth;
+    sleep_us(due - (bson_get_monotonic_time() - start));
+  }
+  return true;
+}
+
+static bool reply_msg(mock_conn_t *conn, int32_t request_id,
+                      const bson_t *reply) {
+  size_t length = 16 + 4 + 1 + reply->len;
+  uint8_t *message = malloc(length);
+  if (!message) {
+    return false;
+  }
+  write_le32(message, (int32_t)length);
+  write_le32(message + 4, 0);
+  write_le32(message + 8, request_id);
+  write_le32(message + 12, OP_MSG);
+  write_le32(message + 16, 0);
+  message[20] = 0; // sección de tipo 0: el cuerpo
+  memcpy(message + 21, bson_get_data(reply), reply->len);
+  bool ok = send_message(conn, message, length);
+  free(message);
+  return ok;
+}
+
+static bool reply_legacy(mock_conn_t *conn, int32_t request_id,
+                         const bson_t *reply) {
+  size_t length = 16 + 20 + reply->len;
+  uint8_t *message = calloc(1, length);
+  if (!message) {
+    return false;
+  }
+  write_le32(message, (int32_t)length);
+  write_le32(message + 8, request_id);
+  write_le32(message + 12, OP_REPLY);
+  // responseFlags, cursorID (8), startingFrom en 0
+  write_le32(message + 32, 1); // numberReturned
+  memcpy(message + 36, bson_get_data(reply), reply->len);
+  bool ok = send_message(conn, message, length);
+  free(message);
+  return ok;
+}
+
+// OP_MSG: el cuerpo y las secuencias de documentos (insert, update,
+// delete) juntadas como arrays del comando
+static bool handle_msg(mock_conn_t *conn, int32_t request_id,
+                       const uint8_t *data, size_t length) {
+  if (length < 5) {
+    return false;
+  }
+  uint32_t flags = (uint32_t)read_le32(data);
+  size_t end = length - ((flags & MSG_CHECKSUM_PRESENT) ? 4 : 0);
+  size_t pos = 4;
+
+  bson_t command, body;
+  bool has_body = false;
+  bson_init(&command);
+  while (pos < end) {
+    uint8_t kind = data[pos++];
+    if (pos + 4 > end) {
+      break;
+    }
+    int32_t size = read_le32(data + pos);
+    if (size < 5 || pos + (size_t)size > end) {
+      break;
+    }
+
+    if (kind == 0 && !has_body &&
+        bson_init_static(&body, data + pos, (size_t)size)) {
+      bson_t merged;
+      bson_copy_to(&body, &merged);
+      bson_iter_t iter;
+      bson_iter_init(&iter, &command);
+      while (bson_iter_next(&iter)) {
+        bson_append_iter(&merged, NULL, 0, &iter);
+      }
+      bson_destroy(&command);
+      command = merged;
+      has_body = true;
+    } else if (kind == 1) {
+      const char *identifier = (const char *)data + pos + 4;
+      size_t id_len = strnlen(identifier, (size_t)size - 4);
+      size_t doc = pos + 4 + id_len + 1;
+      bson_t array;
+      bson_append_array_begin(&command, identifier, (int)id_len, &array);
+      for (uint32_t n = 0; doc + 4 <= pos + (size_t)size; n++) {
+        int32_t doc_size = read_le32(data + doc);
+        bson_t item;
+        if (doc_size < 5 || doc + (size_t)doc_size > pos + (size_t)size ||
+            !bson_init_static(&item, data + doc, (size_t)doc_size)) {
+          break;
+        }
+        char buffer[16];
+        const char *key;
+        size_t key_len = bson_uint32_to_string(n, &key, buffer,
+                                               sizeof(buffer));
+        bson_append_document(&array, key, (int)key_len, &item);
+        doc += (size_t)doc_size;
+      }
+      bson_append_array_end(&command, &array);
+    }
+    pos += (size_t)size;
+  }
+
+  if (!has_body) {
+    bson_destroy(&command);
+    return false;
+  }
+
+  bson_iter_t db_iter;
+  const char *db = bson_iter_init_find(&db_iter, &command, "$db") &&
+                           BSON_ITER_HOLDS_UTF8(&db_iter)
+                       ? bson_iter_utf8(&db_iter, NULL)
+                       : "admin";
+  bson_t reply;
+  run_command(conn->server, conn, db, &command, &reply);
+  bool ok = (flags & MSG_MORE_TO_COME) || reply_msg(conn, request_id, &reply);
+  bson_destroy(&reply);
+  bson_destroy(&command);
+  return ok;
+}
+
+// OP_QUERY: sólo comandos (el primer hello de los drivers)
+static bool handle_query(mock_conn_t *conn, int32_t request_id,
+                         const uint8_t *data, size_t length) {
+  if (length < 4) {
+    return false;
+  }
+  const char *ns = (const char *)data + 4;
+  size_t ns_len = strnlen(ns, length - 4);
+  size_t pos = 4 + ns_len + 1 + 8; // numberToSkip, numberToReturn
+  if (pos + 5 > length) {
+    return false;
+  }
+  int32_t size = read_le32(data + pos);
+  bson_t query;
+  if (size < 5 || pos + (size_t)size > length ||
+      !bson_init_static(&query, data + pos, (size_t)size)) {
+    return false;
+  }
+
+  // {$query: {...}, $readPreference: ...}
+  bson_t command = query;
+  bson_iter_t inner;
+  uint32_t inner_len;
+  const uint8_t *inner_data;
+  if (bson_iter_init_find(&inner, &query, "$query") &&
+      BSON_ITER_HOLDS_DOCUMENT(&inner)) {
+    bson_iter_document(&inner, &inner_len, &inner_data);
+    bson_init_static(&command, inner_data, inner_len);
+  }
+
+  char db[NAME_SIZE];
+  const char *dot = memchr(ns, '.', ns_len);
+  size_t db_len = dot ? (size_t)(dot - ns) : ns_len;
+  snprintf(db, sizeof(db), "%.*s", (int)db_len, ns);
+
+  bson_t reply;
+  if (dot && strcmp(dot, ".$cmd") == 0) {
+    run_command(conn->server, conn, db, &command, &reply);
+  } else {
+    bson_init(&reply);
+    BSON_APPEND_UTF8(&reply, "$err", "legacy queries are not supported");
+    BSON_APPEND_INT32(&reply, "code", 352);
+  }
+  bool ok = reply_legacy(conn, request_id, &reply);
+  bson_destroy(&reply);
+  return ok;
+}
+
+static void *conn_thread(void *arg) {
+  mock_conn_t *conn = arg;
+  for (;;) {
+    uint8_t header[16];
+    if (!recv_all(conn, header, sizeof(header))) {
+      break;
+    }
+    int32_t length = read_le32(header);
+    int32_t request_id = read_le32(header + 4);
+    int32_t opcode = read_le32(header + 12);
+    if (length < 16 || length > MAX_MESSAGE_SIZE) {
+      break;
+    }
+
+    size_t body_len = (size_t)length - 16;
+    uint8_t *body = malloc(body_len > 0 ? body_len : 1);
+    if (!body || !recv_all(conn, body, body_len)) {
+      free(body);
+      break;
+    }
+    bool ok = false; // otros opcodes (OP_COMPRESSED...) cortan la conexión
+    if (opcode == OP_MSG) {
+      ok = handle_msg(conn, request_id, body, body_len);
+    } else if (opcode == OP_QUERY) {
+      ok = handle_query(conn, request_id, body, body_len);
+    }
+    free(body);
+    if (!ok) {
+      break;
+    }
+  }
+
+  close(conn->fd);
+  pthread_mutex_lock(&conn->server->lock);
+  conn->done = true;
+  pthread_mutex_unlock(&conn->server->lock);
+  return NULL;
+}
+
+// esperar (y liberar) las conexiones terminadas, o todas al parar
+static void reap_connections(mock_server_t *server, bool all) {
+  pthread_mutex_lock(&server->lock);
+  mock_conn_t **link = &server->conns;
+  while (*link) {
+    mock_conn_t *conn = *link;
+    if (!all && !conn->done) {
+      link = &conn->next;
+      continue;
+    }
+    *link = conn->next;
+    pthread_mutex_unlock(&server->lock);
+    pthread_join(conn->thread, NULL);
+    free(conn);
+    pthread_mutex_lock(&server->lock);
+  }
+  pthread_mutex_unlock(&server->lock);
+}
+
+static void *accept_thread(void *arg) {
+  mock_server_t *server = arg;
+  while (!server_stopping(server)) {
+    reap_connections(server, false);
+
+    struct pollfd pfd = {.fd = server->listen_fd, .events = POLLIN};
+    if (poll(&pfd, 1, POLL_MS) <= 0) {
+      continue;
+    }
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+    mock_conn_t *conn = calloc(1, sizeof(mock_conn_t));
+    if (!conn) {
+      close(fd);
+      continue;
+    }
+    conn->server = server;
+    conn->fd = fd;
+
+    pthread_mutex_lock(&server->lock);
+    conn->id = ++server->next_conn_id;
+    if (pthread_create(&conn->thread, NULL, conn_thread, conn) != 0) {
+      pthread_mutex_unlock(&server->lock);
+      close(fd);
+      free(conn);
+      continue;
+    }
+    conn->next = server->conns;
+    server->conns = conn;
+    pthread_mutex_unlock(&server->lock);
+  }
+  return NULL;
+}
+
+mock_server_t *mock_server_new(const mock_config_t *config) {
+  mock_server_t *server = calloc(1, sizeof(mock_server_t));
+  if (!server) {
+    return NULL;
+  }
+  if (config) {
+    server->config = *config;
+  }
+  pthread_mutex_init(&server->lock, NULL);
+  server->next_cursor_id = 1;
+  server->listen_fd = -1;
+  return server;
+}
+
+// texto de relleno de un documento generado
+static void fill_text(char *out, size_t length, uint64_t *rng) {
+  static const char ALPHABET[] = "abcdefghijklmnopqrstuvwxyz      ";
+  for (size_t i = 0; i < length; i++) {
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 7;
+    *rng ^= *rng << 17;
+    out[i] = ALPHABET[*rng % (sizeof(ALPHABET) - 1)];
+  }
+  out[length] = '\0';
+}
+
+// documento número i de unos doc_size bytes: _id crecientes, campos de
+// varios tipos y el resto en "payload"
+static bson_t *generate_doc(long long i, size_t doc_size, uint64_t seed,
+                            char *text) {
+  uint64_t rng = (seed ^ (uint64_t)i * 0x9e3779b97f4a7c15ull) | 1;
+  uint8_t bytes[12] = {0x64, 0x00, 0x00, (uint8_t)seed};
+  for (int b = 0; b < 8; b++) {
+    bytes[11 - b] = (uint8_t)((uint64_t)i >> (b * 8));
+  }
+  bson_oid_t oid;
+  bson_oid_init_from_data(&oid, bytes);
+
+  char name[32];
+  char tag_a[8], tag_b[8];
+  snprintf(name, sizeof(name), "doc %lld", i);
+  snprintf(tag_a, sizeof(tag_a), "t%lld", i % 5);
+  snprintf(tag_b, sizeof(tag_b), "t%lld", i % 7);
+  fill_text(text, 40, &rng);
+
+  bson_t *doc = BCON_NEW(
+      "_id", BCON_OID(&oid), "n", BCON_INT64(i), "name", BCON_UTF8(name),
+      "group", BCON_INT32((int32_t)(i % 10)), "active", BCON_BOOL(i % 3 == 0),
+      "created", BCON_DATE_TIME(1700000000000LL + i * 60000), "tags", "[",
+      BCON_UTF8(tag_a), BCON_UTF8(tag_b), "]", "nested", "{", "x",
+      BCON_DOUBLE(i * 0.5), "y", BCON_UTF8(text), "}");
+
+  // "payload": string (1 + 8 + 4 + largo + 1 bytes)
+  size_t overhead = 14;
+  if (doc_size > doc->len + overhead) {
+    size_t length = doc_size - doc->len - overhead;
+    fill_text(text, length, &rng);
+    BSON_APPEND_UTF8(doc, "payload", text);
+  }
+  return doc;
+}
+
+bool mock_server_generate(mock_server_t *server, const char *db,
+                          const char *coll, long long count, size_t doc_size,
+                          uint64_t seed) {
+  if (doc_size > MAX_BSON_SIZE) {
+    doc_size = MAX_BSON_SIZE;
+  }
+  char *text = malloc(doc_size + 64);
+  if (!text) {
+    return false;
+  }
+
+  pthread_mutex_lock(&server->lock);
+  mock_coll_t *target = coll_get(server, db, coll);
+  bool ok = target != NULL;
+  for (long long i = 0; ok && i < count; i++) {
+    mock_doc_t *doc = doc_new(generate_doc(i, doc_size, seed, text));
+    ok = doc && coll_append(target, doc);
+  }
+  pthread_mutex_unlock(&server->lock);
+
+  free(text);
+  return ok;
+}
+
+bool mock_server_load(mock_server_t *server, const char *db,
+                      const char *coll, const char *path,
+                      bson_error_t *error) {
+  bson_json_reader_t *reader = bson_json_reader_new_from_file(path, error);
+  if (!reader) {
+    return false;
+  }
+
+  pthread_mutex_lock(&server->lock);
+  mock_coll_t *target = coll_get(server, db, coll);
+  bool ok = target != NULL;
+  bson_t doc = BSON_INITIALIZER;
+  int read;
+  while (ok && (read = bson_json_reader_read(reader, &doc, error)) > 0) {
+    mock_doc_t *entry = doc_new(with_id(server, &doc));
+    ok = entry && coll_append(target, entry);
+    bson_reinit(&doc);
+  }
+  if (ok && read < 0) {
+    ok = false;
+  } else if (!ok) {
+    bson_set_error(error, 0, 0, "out of memory");
+  }
+  pthread_mutex_unlock(&server->lock);
+
+  bson_destroy(&doc);
+  bson_json_reader_destroy(reader);
+  return ok;
+}
+
+bool mock_server_start(mock_server_t *server) {
+  server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (server->listen_fd < 0) {
+    perror("socket");
+    return false;
+  }
+  int one = 1;
+  setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons((uint16_t)server->config.port);
+  socklen_t addr_len = sizeof(addr);
+  if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(server->listen_fd, 64) != 0 ||
+      getsockname(server->listen_fd, (struct sockaddr *)&addr, &addr_len) !=
+          0) {
+    fprintf(stderr, "Cannot listen on port %d: %s\n", server->config.port,
+            strerror(errno));
+    close(server->listen_fd);
+    server->listen_fd = -1;
+    return false;
+  }
+  server->port = ntohs(addr.sin_port);
+
+  if (pthread_create(&server->accept_thread, NULL, accept_thread, server) !=
+      0) {
+    fprintf(stderr, "Cannot start the server thread\n");
+    close(server->listen_fd);
+    server->listen_fd = -1;
+    return false;
+  }
+  server->started = true;
+  return true;
+}
+
+int mock_server_port(const mock_server_t *server) { return server->port; }
+
+void mock_server_free(mock_server_t *server) {
+  if (!server) {
+    return;
+  }
+
+  if (server->started) {
+    pthread_mutex_lock(&server->lock);
+    server->stopping = true;
+    pthread_mutex_unlock(&server->lock);
+    pthread_join(server->accept_thread, NULL);
+    reap_connections(server, true);
+  }
+  if (server->listen_fd >= 0) {
+    close(server->listen_fd);
+  }
+
+  while (server->cursor_count > 0) {
+    cursor_close(server, server->cursors[0]);
+  }
+  free(server->cursors);
+  for (int i = 0; i < server->coll_count; i++) {
+    coll_free(server->colls[i]);
+  }
+  free(server->colls);
+  pthread_mutex_destroy(&server->lock);
+  free(server);
+}
@@ -0,0 +1,55 @@
+#ifndef MOCK_SERVER_H
+#define MOCK_SERVER_H
+
+#include <mongoc/mongoc.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// servidor de prueba que habla el protocolo de MongoDB (OP_MSG, y
+// OP_QUERY para el primer hello) sobre datos en memoria: para medir
+// mongo_ops.c sin un mongod, siempre con los mismos datos. escucha en
+// 127.0.0.1 desde un hilo propio, así que sirve dentro del mismo proceso
+// (bench) o solo (mongodb-tui-mock)
+//
+// entiende hello/isMaster, ping, buildInfo, listDatabases,
+// listCollections, listIndexes, createIndexes, create, drop,
+// dropDatabase, collStats, count, find/getMore/killCursors, aggregate
+// ($match, $sort, $skip, $limit, $project, $count y $group con _id
+// constante y $sum), insert, update ($set/$unset o reemplazo) y delete.
+// los filtros aceptan igualdad, $eq $ne $gt $gte $lt $lte $in $nin
+// $exists $regex $not $size, $and $or $nor; la proyección, sólo campos
+// de primer nivel. no se controla que _id sea único
+
+typedef struct {
+  int port;            // 0: uno libre (ver mock_server_port)
+  int latency_ms;      // espera antes de cada respuesta
+  long long bandwidth; // bytes por segundo hacia el cliente (0: sin límite)
+  int batch_docs;      // máximo de documentos por batch (0: como mongod)
+} mock_config_t;
+
+typedef struct mock_server mock_server_t;
+
+// NULL si no hay memoria
+mock_server_t *mock_server_new(const mock_config_t *config);
+
+// count documentos generados de unos doc_size bytes en db.coll; siempre
+// los mismos para la misma semilla
+bool mock_server_generate(mock_server_t *server, const char *db,
+                          const char *coll, long long count, size_t doc_size,
+                          uint64_t seed);
+
+// documentos JSON de un archivo (uno tras otro, como mongoexport)
+bool mock_server_load(mock_server_t *server, const char *db,
+                      const char *coll, const char *path,
+                      bson_error_t *error);
+
+// empezar a escuchar; false (con el motivo en stderr) si no se pudo
+bool mock_server_start(mock_server_t *server);
+
+int mock_server_port(const mock_server_t *server);
+
+// cortar las conexiones, esperar los hilos y liberar todo
+void mock_server_free(mock_server_t *server);
+
+#endif // MOCK_SERVER_H
@@ -0,0 +1,804 @@
+// repetición de un guion de teclas contra la interfaz real, en una
+// pseudo-terminal: mide cuánto tarda cada acción en dibujarse (hasta el
+// primer byte y hasta que la salida se calla), cuántos bytes manda a la
+// terminal y los percentiles por acción. sirve contra un mongod local o
+// un servidor de prueba, da igual: el comando va después de "--"
+
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#if defined(__APPLE__) && !defined(_DARWIN_C_SOURCE)
+#define _DARWIN_C_SOURCE
+#endif
+
+#include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <util.h>
+#elif defined(__FreeBSD__)
+#include <libutil.h>
+#else
+#include <pty.h>
+#endif
+
+// una acción terminó cuando la salida se calla esto
+#define DEFAULT_QUIET_MS 30
+// y si no dibuja nada, se espera esto antes de darla por vacía
+#define DEFAULT_WAIT_MS 250
+// máximo para una acción, para expect y para que el programa termine
+#define DEFAULT_TIMEOUT_MS 10000
+
+#define DEFAULT_ROWS 50
+#define DEFAULT_COLS 160
+
+// lo que se recuerda de la pantalla (sin secuencias) para expect
+#define TAIL_SIZE (64 * 1024)
+
+#define MAX_LABELS 64
+#define LABEL_SIZE 32
+#define MAX_REPEAT_DEPTH 8
+
+// una acción medida
+typedef struct {
+  int label;
+  int64_t first_us;  // tecla -> primer byte
+  int64_t total_us;  // tecla -> último byte
+  long long bytes;
+} sample_t;
+
+// secuencias de xterm con el teclado en modo aplicación (keypad())
+static const struct {
+  const char *name;
+  const char *seq;
+} KEYS[] = {
+    {"up", "\033OA"},        {"down", "\033OB"},     {"right", "\033OC"},
+    {"left", "\033OD"},      {"home", "\033OH"},     {"end", "\033OF"},
+    {"pgup", "\033[5~"},     {"pgdn", "\033[6~"},    {"insert", "\033[2~"},
+    {"delete", "\033[3~"},   {"enter", "\r"},        {"esc", "\033"},
+    {"tab", "\t"},           {"backspace", "\177"},  {"space", " "},
+    {"f1", "\033OP"},        {"f2", "\033OQ"},       {"f3", "\033OR"},
+    {"f4", "\033OS"},        {"f5", "\033[15~"},     {"f6", "\033[17~"},
+    {"f7", "\033[18~"},      {"f8", "\033[19~"},     {"f9", "\033[20~"},
+    {"f10", "\033[21~"},     {"f11", "\033[23~"},    {"f12", "\033[24~"},
+};
+
+typedef struct {
+  // opciones
+  int quiet_ms;
+  int wait_ms;
+  int timeout_ms;
+  FILE *log; // salida cruda de la aplicación (--log)
+
+  // la aplicación
+  int fd;
+  pid_t pid;
+  bool ended;
+  int status;
+
+  // texto dibujado desde el último expect, sin secuencias de escape
+  char tail[TAIL_SIZE];
+  size_t tail_len;
+  int escape; // 0 texto, 1 después de ESC, 2 CSI, 3 OSC
+
+  // resultados
+  char labels[MAX_LABELS][LABEL_SIZE];
+  int label_count;
+  sample_t *samples;
+  int sample_count;
+  int sample_capacity;
+  long long total_bytes;
+} replay_t;
+
+static int64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// texto visible de la salida: se sacan las secuencias de escape y los
+// caracteres de control (los movimientos de cursor pueden partir una
+// palabra, así que expect busca textos que se escriben de una vez)
+static void keep_text(replay_t *r, const char *data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    unsigned char c = (unsigned char)data[i];
+    switch (r->escape) {
+    case 1:
+      if (c == '[') {
+        r->escape = 2;
+      } else if (c == ']') {
+        r->escape = 3;
+      } else if (c < 0x20 || c > 0x2f) {
+        r->escape = 0; // ESC x, o ESC ( B después de los intermedios
+      }
+      continue;
+    case 2:
+      if (c >= 0x40 && c <= 0x7e) {
+        r->escape = 0;
+      }
+      continue;
+    case 3:
+      if (c == '\a' || c == 0x1b) {
+        r->escape = c == 0x1b ? 1 : 0;
+      }
+      continue;
+    default:
+      break;
+    }
+    if (c == 0x1b) {
+      r->escape = 1;
+      continue;
+    }
+    if (c < 0x20 || c == 0x7f) {
+      continue;
+    }
+
+    if (r->tail_len == sizeof(r->tail) - 1) {
+      // se descarta la primera mitad
+      size_t half = r->tail_len / 2;
+      memmove(r->tail, r->tail + half, r->tail_len - half);
+      r->tail_len -= half;
+    }
+    r->tail[r->tail_len++] = (char)c;
+  }
+  r->tail[r->tail_len] = '\0';
+}
+
+// leer lo que haya, esperando hasta timeout_ms; bytes leídos, 0 si no
+// llegó nada y -1 si la aplicación terminó
+static long pump(replay_t *r, int timeout_ms) {
+  if (r->ended) {
+    return -1;
+  }
+
+  struct pollfd pfd = {.fd = r->fd, .events = POLLIN};
+  int ready = poll(&pfd, 1, timeout_ms > 0 ? timeout_ms : 0);
+  if (ready < 0) {
+    return errno == EINTR ? 0 : -1;
+  }
+  if (ready == 0) {
+    return 0;
+  }
+
+  char buffer[16384];
+  ssize_t n = read(r->fd, buffer, sizeof(buffer));
+  if (n <= 0) {
+    // EIO en Linux cuando se cierra el lado de la aplicación
+    if (n < 0 && errno == EINTR) {
+      return 0;
+    }
+    r->ended = true;
+    return -1;
+  }
+
+  if (r->log) {
+    fwrite(buffer, 1, (size_t)n, r->log);
+  }
+  keep_text(r, buffer, (size_t)n);
+  r->total_bytes += n;
+  return n;
+}
+
+static bool send_all(replay_t *r, const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t n = write(r->fd, data, length);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    length -= (size_t)n;
+  }
+  return true;
+}
+
+// lo que quedó pendiente de la acción anterior no se cuenta en la próxima
+static void settle(replay_t *r) {
+  while (pump(r, 0) > 0) {
+  }
+}
+
+static int label_index(replay_t *r, const char *name) {
+  for (int i = 0; i < r->label_count; i++) {
+    if (strcmp(r->labels[i], name) == 0) {
+      return i;
+    }
+  }
+  if (r->label_count == MAX_LABELS) {
+    return MAX_LABELS - 1; // las que sobran van juntas en la última
+  }
+  snprintf(r->labels[r->label_count], LABEL_SIZE, "%s", name);
+  return r->label_count++;
+}
+
+// mandar una tecla (o un texto) y medir hasta que la salida se calla;
+// false si no se pudo mandar
+static bool act(replay_t *r, const char *label, const char *data,
+                size_t length) {
+  settle(r);
+
+  sample_t sample = {.label = label_index(r, label)};
+  long long before = r->total_bytes;
+  int64_t start = now_us();
+  int64_t first = 0, last = 0;
+  if (!send_all(r, data, length)) {
+    r->ended = true;
+    return false;
+  }
+
+  for (;;) {
+    int64_t now = now_us();
+    int64_t deadline = first ? last + r->quiet_ms * 1000LL
+                             : start + r->wait_ms * 1000LL;
+    if (deadline > start + r->timeout_ms * 1000LL) {
+      deadline = start + r->timeout_ms * 1000LL; // nunca se calla
+    }
+    if (now >= deadline) {
+      break;
+    }
+    long n = pump(r, (int)((deadline - now + 999) / 1000));
+    if (n < 0) {
+      break;
+    }
+    if (n > 0) {
+      last = now_us();
+      if (!first) {
+        first = last;
+      }
+    }
+  }
+
+  sample.bytes = r->total_bytes - before;
+  if (first) {
+    sample.first_us = first - start;
+    sample.total_us = last - start;
+  }
+
+  if (r->sample_count == r->sample_capacity) {
+    int capacity = r->sample_capacity ? r->sample_capacity * 2 : 1024;
+    sample_t *grown = realloc(r->samples, capacity * sizeof(sample_t));
+    if (!grown) {
+      return false;
+    }
+    r->samples = grown;
+    r->sample_capacity = capacity;
+  }
+  r->samples[r->sample_count++] = sample;
+  return true;
+}
+
+static bool expect(replay_t *r, const char *text) {
+  int64_t deadline = now_us() + r->timeout_ms * 1000LL;
+  for (;;) {
+    char *found = strstr(r->tail, text);
+    if (found) {
+      // lo de antes ya no cuenta para el próximo expect
+      size_t rest = r->tail_len - (size_t)(found - r->tail) - strlen(text);
+      memmove(r->tail, r->tail + r->tail_len - rest, rest + 1);
+      r->tail_len = rest;
+      return true;
+    }
+    int64_t now = now_us();
+    if (now >= deadline ||
+        pump(r, (int)((deadline - now + 999) / 1000)) < 0) {
+      return false;
+    }
+  }
+}
+
+// secuencia de una tecla por nombre: las de KEYS, ctrl-a..ctrl-z o un
+// carácter suelto
+static bool key_sequence(const char *name, char *out, size_t size) {
+  for (size_t i = 0; i < sizeof(KEYS) / sizeof(KEYS[0]); i++) {
+    if (strcmp(name, KEYS[i].name) == 0) {
+      snprintf(out, size, "%s", KEYS[i].seq);
+      return true;
+    }
+  }
+  if (strncmp(name, "ctrl-", 5) == 0 && isalpha((unsigned char)name[5]) &&
+      name[6] == '\0') {
+    snprintf(out, size, "%c", tolower((unsigned char)name[5]) - 'a' + 1);
+    return true;
+  }
+  if (name[0] != '\0' && name[1] == '\0') {
+    snprintf(out, size, "%s", name);
+    return true;
+  }
+  return false;
+}
+
+typedef struct {
+  char **lines;
+  int count;
+} script_t;
+
+static bool load_script(script_t *script, const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+
+  int capacity = 0;
+  char line[1024];
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (script->count == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      char **grown = realloc(script->lines, capacity * sizeof(char *));
+      if (!grown) {
+        ok = false;
+        break;
+      }
+      script->lines = grown;
+    }
+    size_t length = strlen(line);
+    char *copy = malloc(length + 1);
+    if (!copy) {
+      ok = false;
+      break;
+    }
+    memcpy(copy, line, length + 1);
+    script->lines[script->count++] = copy;
+  }
+  fclose(f);
+  return ok;
+}
+
+static void free_script(script_t *script) {
+  for (int i = 0; i < script->count; i++) {
+    free(script->lines[i]);
+  }
+  free(script->lines);
+}
+
+// una línea del guion: comando y argumento (el resto de la línea, sin
+// los espacios de adelante); false si es vacía o comentario
+static bool split_line(char *line, char **command, char **arg) {
+  while (isspace((unsigned char)*line)) {
+    line++;
+  }
+  if (*line == '\0' || *line == '#') {
+    return false;
+  }
+  *command = line;
+  while (*line && !isspace((unsigned char)*line)) {
+    line++;
+  }
+  if (*line) {
+    *line++ = '\0';
+    while (isspace((unsigned char)*line)) {
+      line++;
+    }
+  }
+  *arg = line;
+  return true;
+}
+
+// correr el guion; false (con el mensaje en stderr) si algo falló
+static bool run_script(replay_t *r, const script_t *script) {
+  struct {
+    int line;
+    int remaining;
+  } stack[MAX_REPEAT_DEPTH];
+  int depth = 0;
+  char label[LABEL_SIZE] = "";
+
+  for (int i = 0; i < script->count; i++) {
+    char line[1024];
+    snprintf(line, sizeof(line), "%s", script->lines[i]);
+    char *command, *arg;
+    if (!split_line(line, &command, &arg)) {
+      continue;
+    }
+
+    if (strcmp(command, "key") == 0) {
+      // key NAME [COUNT]
+      char name[64];
+      int count = 1;
+      if (sscanf(arg, "%63s %d", name, &count) < 1 || count < 1) {
+        fprintf(stderr, "line %d: key NAME [COUNT]\n", i + 1);
+        return false;
+      }
+      char seq[64];
+      if (!key_sequence(name, seq, sizeof(seq))) {
+        fprintf(stderr, "line %d: unknown key '%s'\n", i + 1, name);
+        return false;
+      }
+      for (int k = 0; k < count; k++) {
+        if (r->ended || !act(r, label[0] ? label : name, seq, strlen(seq))) {
+          fprintf(stderr, "line %d: the program ended\n", i + 1);
+          return false;
+        }
+      }
+    } else if (strcmp(command, "type") == 0) {
+      if (r->ended || !act(r, label[0] ? label : "type", arg, strlen(arg))) {
+        fprintf(stderr, "line %d: the program ended\n", i + 1);
+        return false;
+      }
+    } else if (strcmp(command, "expect") == 0) {
+      if (!expect(r, arg)) {
+        fprintf(stderr, "line %d: \"%s\" did not appear\n", i + 1, arg);
+        return false;
+      }
+    } else if (strcmp(command, "sleep") == 0) {
+      int64_t until = now_us() + atoll(arg) * 1000LL;
+      for (int64_t now = now_us(); now < until; now = now_us()) {
+        if (pump(r, (int)((until - now + 999) / 1000)) < 0) {
+          break;
+        }
+      }
+    } else if (strcmp(command, "label") == 0) {
+      snprintf(label, sizeof(label), "%s", arg);
+    } else if (strcmp(command, "repeat") == 0) {
+      if (depth == MAX_REPEAT_DEPTH || atoi(arg) < 1) {
+        fprintf(stderr, "line %d: bad repeat\n", i + 1);
+        return false;
+      }
+      stack[depth].line = i;
+      stack[depth].remaining = atoi(arg);
+      depth++;
+    } else if (strcmp(command, "end") == 0) {
+      if (depth == 0) {
+        fprintf(stderr, "line %d: end without repeat\n", i + 1);
+        return false;
+      }
+      if (--stack[depth - 1].remaining > 0) {
+        i = stack[depth - 1].line;
+      } else {
+        depth--;
+      }
+    } else {
+      fprintf(stderr, "line %d: unknown command '%s'\n", i + 1, command);
+      return false;
+    }
+  }
+  return true;
+}
+
+static int compare_us(const void *a, const void *b) {
+  int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// percentil por rango más cercano, en milisegundos
+static double percentile(const int64_t *sorted, int count, double p) {
+  if (count == 0) {
+    return 0;
+  }
+  int index = (int)(p / 100.0 * count + 0.999999) - 1;
+  if (index < 0) {
+    index = 0;
+  }
+  return sorted[index < count ? index : count - 1] / 1000.0;
+}
+
+typedef struct {
+  const char *label;
+  int count;
+  int idle; // sin nada que dibujar
+  double p50, p90, p99, max;
+  double render_p50, render_p99; // primer a último byte
+  double first_p50;
+  double bytes;
+} summary_t;
+
+static void summarize(const replay_t *r, int label, summary_t *s,
+                      int64_t *total, int64_t *render, int64_t *first) {
+  memset(s, 0, sizeof(*s));
+  s->label = r->labels[label];
+
+  int drawn = 0;
+  long long bytes = 0;
+  for (int i = 0; i < r->sample_count; i++) {
+    const sample_t *sample = &r->samples[i];
+    if (sample->label != label) {
+      continue;
+    }
+    s->count++;
+    bytes += sample->bytes;
+    if (sample->bytes == 0) {
+      s->idle++;
+      continue;
+    }
+    total[drawn] = sample->total_us;
+    render[drawn] = sample->total_us - sample->first_us;
+    first[drawn] = sample->first_us;
+    drawn++;
+  }
+
+  qsort(total, drawn, sizeof(int64_t), compare_us);
+  qsort(render, drawn, sizeof(int64_t), compare_us);
+  qsort(first, drawn, sizeof(int64_t), compare_us);
+  s->p50 = percentile(total, drawn, 50);
+  s->p90 = percentile(total, drawn, 90);
+  s->p99 = percentile(total, drawn, 99);
+  s->max = percentile(total, drawn, 100);
+  s->render_p50 = percentile(render, drawn, 50);
+  s->render_p99 = percentile(render, drawn, 99);
+  s->first_p50 = percentile(first, drawn, 50);
+  s->bytes = s->count ? (double)bytes / s->count : 0;
+}
+
+static void write_json_string(FILE *f, const char *text) {
+  fputc('"', f);
+  for (; *text; text++) {
+    unsigned char c = (unsigned char)*text;
+    if (c == '"' || c == '\\') {
+      fprintf(f, "\\%c", c);
+    } else if (c < 0x20) {
+      fprintf(f, "\\u%04x", c);
+    } else {
+      fputc(c, f);
+    }
+  }
+  fputc('"', f);
+}
+
+static bool report(const replay_t *r, const char *json_path,
+                   double elapsed_s) {
+  size_t n = (size_t)(r->sample_count > 0 ? r->sample_count : 1);
+  int64_t *total = malloc(n * sizeof(int64_t));
+  int64_t *render = malloc(n * sizeof(int64_t));
+  int64_t *first = malloc(n * sizeof(int64_t));
+  summary_t *summaries = calloc(MAX_LABELS, sizeof(summary_t));
+  FILE *json = NULL;
+  bool ok = total && render && first && summaries;
+  if (ok && json_path) {
+    json = fopen(json_path, "w");
+    if (!json) {
+      fprintf(stderr, "Cannot write %s\n", json_path);
+      ok = false;
+    }
+  }
+  if (!ok) {
+    free(total);
+    free(render);
+    free(first);
+    free(summaries);
+    return false;
+  }
+
+  printf("\n%-20s %6s %5s %8s %8s %8s %8s %9s %9s %9s\n", "action", "count",
+         "idle", "p50 ms", "p90 ms", "p99 ms", "max ms", "first ms",
+         "render ms", "B/action");
+  for (int i = 0; i < r->label_count; i++) {
+    summary_t *s = &summaries[i];
+    summarize(r, i, s, total, render, first);
+    printf("%-20s %6d %5d %8.1f %8.1f %8.1f %8.1f %9.1f %9.1f %9.0f\n",
+           s->label, s->count, s->idle, s->p50, s->p90, s->p99, s->max,
+           s->first_p50, s->render_p50, s->bytes);
+  }
+  printf("\n%d actions, %lld bytes to the terminal, %.1f s\n",
+         r->sample_count, r->total_bytes, elapsed_s);
+
+  if (json) {
+    fprintf(json, "{\n  \"version\": 1,\n");
+    fprintf(json, "  \"actions\": %d,\n  \"terminal_bytes\": %lld,\n",
+            r->sample_count, r->total_bytes);
+    fprintf(json, "  \"elapsed_s\": %.3f,\n  \"results\": [\n", elapsed_s);
+    for (int i = 0; i < r->label_count; i++) {
+      const summary_t *s = &summaries[i];
+      fprintf(json, "    {\"action\": ");
+      write_json_string(json, s->label);
+      fprintf(json,
+              ", \"count\": %d, \"idle\": %d, "
+              "\"p50_ms\": %.2f, \"p90_ms\": %.2f, \"p99_ms\": %.2f, "
+              "\"max_ms\": %.2f, \"first_byte_p50_ms\": %.2f, "
+              "\"render_p50_ms\": %.2f, \"render_p99_ms\": %.2f, "
+              "\"bytes_per_action\": %.1f}%s\n",
+              s->count, s->idle, s->p50, s->p90, s->p99, s->max,
+              s->first_p50, s->render_p50, s->render_p99, s->bytes,
+              i + 1 < r->label_count ? "," : "");
+    }
+    fprintf(json, "  ]\n}\n");
+    ok = fclose(json) == 0;
+  }
+
+  free(total);
+  free(render);
+  free(first);
+  free(summaries);
+  return ok;
+}
+
+// cada acción en una línea (TSV) para graficar o comparar a mano
+static bool write_trace(const replay_t *r, const char *path) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    fprintf(stderr, "Cannot write %s\n", path);
+    return false;
+  }
+  fprintf(f, "index\taction\tfirst_us\ttotal_us\tbytes\n");
+  for (int i = 0; i < r->sample_count; i++) {
+    const sample_t *s = &r->samples[i];
+    fprintf(f, "%d\t%s\t%lld\t%lld\t%lld\n", i, r->labels[s->label],
+            (long long)s->first_us, (long long)s->total_us, s->bytes);
+  }
+  return fclose(f) == 0;
+}
+
+// la aplicación en una pseudo-terminal de rows x cols, con una sesión
+// propia para no tocar la del usuario
+static bool spawn(replay_t *r, char **command, int rows, int cols,
+                  const char *session) {
+  struct winsize size = {.ws_row = (unsigned short)rows,
+                         .ws_col = (unsigned short)cols};
+  r->pid = forkpty(&r->fd, NULL, NULL, &size);
+  if (r->pid < 0) {
+    perror("forkpty");
+    return false;
+  }
+  if (r->pid == 0) {
+    // las secuencias de KEYS son las de xterm; ESC solo sin esperar 1 s
+    setenv("TERM", "xterm", 1);
+    setenv("ESCDELAY", "25", 1);
+    if (session) {
+      setenv("MONGODB_TUI_SESSION", session, 1);
+    }
+    execvp(command[0], command);
+    fprintf(stderr, "Cannot run %s: %s\n", command[0], strerror(errno));
+    _exit(127);
+  }
+  return true;
+}
+
+// esperar a que la aplicación termine sola; si no, se la termina
+static void finish(replay_t *r) {
+  int64_t deadline = now_us() + r->timeout_ms * 1000LL;
+  while (!r->ended && now_us() < deadline) {
+    pump(r, 100);
+  }
+  // cerrada la terminal puede tardar un poco en salir
+  pid_t done = 0;
+  while ((done = waitpid(r->pid, &r->status, WNOHANG)) == 0 &&
+         now_us() < deadline) {
+    pump(r, 10);
+  }
+
+  if (done == 0) {
+    fprintf(stderr, "The program did not exit; terminating it\n");
+    kill(r->pid, SIGTERM);
+    waitpid(r->pid, &r->status, 0);
+  }
+  close(r->fd);
+}
+
+static void usage(const char *program) {
+  printf("Usage: %s [options] SCRIPT -- COMMAND [ARGS...]\n"
+         "\n"
+         "Runs COMMAND in a pseudo-terminal and replays the keys in SCRIPT,\n"
+         "timing each one until the screen stops changing.\n"
+         "\n"
+         "  --json FILE       Also write the summary to FILE as JSON\n"
+         "  --trace FILE      Write every action (TSV) to FILE\n"
+         "  --log FILE        Write the raw terminal output to FILE\n"
+         "  --size ROWSxCOLS  Terminal size (default %dx%d)\n"
+         "  --quiet MS        Silence that ends an action (default %d)\n"
+         "  --wait MS         Wait for a first byte (default %d)\n"
+         "  --timeout MS      Limit for an action, expect and exiting "
+         "(default %d)\n"
+         "\n"
+         "Script lines ('#' starts a comment):\n"
+         "  key NAME [COUNT]  up down left right home end pgup pgdn enter\n"
+         "                    esc tab backspace delete space f1-f12 ctrl-X\n"
+         "                    or one character\n"
+         "  type TEXT         send TEXT as one action\n"
+         "  expect TEXT       wait until TEXT is drawn\n"
+         "  sleep MS          wait, reading the output\n"
+         "  label NAME        report the next actions as NAME (empty: key)\n"
+         "  repeat N ... end  repeat the lines in between\n",
+         program, DEFAULT_ROWS, DEFAULT_COLS, DEFAULT_QUIET_MS,
+         DEFAULT_WAIT_MS, DEFAULT_TIMEOUT_MS);
+}
+
+int main(int argc, char *argv[]) {
+  static replay_t replay;
+  replay_t *r = &replay;
+  r->quiet_ms = DEFAULT_QUIET_MS;
+  r->wait_ms = DEFAULT_WAIT_MS;
+  r->timeout_ms = DEFAULT_TIMEOUT_MS;
+  int rows = DEFAULT_ROWS, cols = DEFAULT_COLS;
+  const char *json_path = NULL;
+  const char *trace_path = NULL;
+  const char *log_path = NULL;
+  const char *script_path = NULL;
+  char **command = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--") == 0 && has_value) {
+      command = &argv[i + 1];
+      break;
+    } else if (strcmp(argv[i], "--json") == 0 && has_value) {
+      json_path = argv[++i];
+    } else if (strcmp(argv[i], "--trace") == 0 && has_value) {
+      trace_path = argv[++i];
+    } else if (strcmp(argv[i], "--log") == 0 && has_value) {
+      log_path = argv[++i];
+    } else if (strcmp(argv[i], "--size") == 0 && has_value &&
+               sscanf(argv[i + 1], "%dx%d", &rows, &cols) == 2) {
+      i++;
+    } else if (strcmp(argv[i], "--quiet") == 0 && has_value) {
+      r->quiet_ms = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--wait") == 0 && has_value) {
+      r->wait_ms = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--timeout") == 0 && has_value) {
+      r->timeout_ms = atoi(argv[++i]);
+    } else if (argv[i][0] != '-' && !script_path) {
+      script_path = argv[i];
+    } else {
+      usage(argv[0]);
+      return strcmp(argv[i], "--help") == 0 ? 0 : 2;
+    }
+  }
+  if (!script_path || !command || rows < 2 || cols < 2) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  script_t script = {0};
+  if (!load_script(&script, script_path)) {
+    fprintf(stderr, "Cannot read %s\n", script_path);
+    free_script(&script);
+    return 2;
+  }
+  if (log_path && !(r->log = fopen(log_path, "wb"))) {
+    fprintf(stderr, "Cannot write %s\n", log_path);
+    free_script(&script);
+    return 2;
+  }
+
+  // sesión vacía: la del usuario no cambia ni influye en lo que se mide
+  char session[] = "/tmp/mongodb-tui-replay-XXXXXX";
+  int session_fd = getenv("MONGODB_TUI_SESSION") ? -1 : mkstemp(session);
+  if (session_fd >= 0) {
+    close(session_fd);
+  }
+
+  bool ok = spawn(r, command, rows, cols, session_fd >= 0 ? session : NULL);
+  if (ok) {
+    int64_t start = now_us();
+    ok = run_script(r, &script);
+    double elapsed_s = (now_us() - start) / 1e6;
+    finish(r);
+
+    if (WIFEXITED(r->status) && WEXITSTATUS(r->status) != 0) {
+      fprintf(stderr, "The program exited with status %d\n",
+              WEXITSTATUS(r->status));
+      ok = false;
+    } else if (WIFSIGNALED(r->status)) {
+      fprintf(stderr, "The program was killed by signal %d\n",
+              WTERMSIG(r->status));
+      ok = false;
+    }
+    ok = report(r, json_path, elapsed_s) && ok;
+    if (trace_path) {
+      ok = write_trace(r, trace_path) && ok;
+    }
+  }
+
+  if (session_fd >= 0) {
+    unlink(session);
+  }
+  if (r->log) {
+    fclose(r->log);
+  }
+  free(r->samples);
+  free_script(&script);
+  return ok ? 0 : 1;
+}
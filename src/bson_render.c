@@ -0,0 +1,948 @@
+#include "bson_render.h"
+#include "json_display.h"
+#include "search.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// paso del recorrido
+enum {
+  RENDER_OPEN,      // "{ " del documento raíz
+  RENDER_NEXT,      // ", " y próximo elemento, o cierre del nivel
+  RENDER_KEY_OPEN,  // comilla de apertura de la clave
+  RENDER_KEY_TEXT,  // clave (sigue como string)
+  RENDER_COLON,     // " : "
+  RENDER_VALUE,     // valor (abre un nivel si es documento o array)
+  RENDER_STRING,    // cuerpo de un string o clave, en tramos sin escapes
+  RENDER_CLOSE,     // cierre del nivel tras el salto de línea (pretty)
+  RENDER_DONE
+};
+
+// ",\n" y la sangría más profunda; los saltos del modo pretty son
+// prefijos de este buffer
+static char pretty_break[2 + 2 * BSON_RENDER_MAX_DEPTH];
+
+static void render_start(bson_render_t *render, const bson_t *doc) {
+  render->depth = 0;
+  render->step = RENDER_DONE;
+  render->string = NULL;
+  render->string_left = 0;
+  render->owned = NULL;
+
+  if (doc && bson_iter_init(&render->stack[0].iter, doc)) {
+    render->stack[0].is_array = false;
+    render->stack[0].first = true;
+    render->stack[0].compact = !render->pretty;
+    render->depth = 1;
+    render->step = RENDER_OPEN;
+  }
+}
+
+void bson_render_init(bson_render_t *render, const bson_t *doc) {
+  render->pretty = false;
+  render->json = false;
+  render->width = 0;
+  render_start(render, doc);
+}
+
+static bool emit(bson_span_t *span, const char *text, size_t length,
+                 int color) {
+  span->text = text;
+  span->length = length;
+  span->color = color;
+  return true;
+}
+
+void bson_render_init_pretty(bson_render_t *render, const bson_t *doc,
+                             int width) {
+  render->pretty = true;
+  render->json = false;
+  render->width = width;
+  render_start(render, doc);
+  if (pretty_break[0] == '\0') {
+    memset(pretty_break, ' ', sizeof(pretty_break));
+    pretty_break[0] = ',';
+    pretty_break[1] = '\n';
+  }
+}
+
+void bson_render_init_json(bson_render_t *render, const bson_t *doc,
+                           int width) {
+  bson_render_init_pretty(render, doc, width);
+  render->json = true;
+}
+
+void bson_render_init_json_line(bson_render_t *render, const bson_t *doc) {
+  bson_render_init(render, doc);
+  render->json = true;
+}
+
+void bson_render_init_json_line_array(bson_render_t *render,
+                                      const bson_t *array) {
+  bson_render_init_json_line(render, array);
+  render->stack[0].is_array = true;
+}
+
+void bson_render_clear(bson_render_t *render) {
+  free(render->owned);
+  render->owned = NULL;
+  render->step = RENDER_DONE;
+}
+
+// salto de línea con la sangría de level niveles (con coma si comma)
+static bool emit_break(bson_span_t *span, int level, bool comma) {
+  return emit(span, pretty_break + (comma ? 0 : 1), (comma ? 2 : 1) + 2 * level,
+              JSON_COLOR_BRACKET);
+}
+
+// el nivel va en una línea con espacio junto a las llaves ("{ a : 1 }",
+// notación del shell); JSON compacto va pegado ("{"a": 1}")
+static bool spaced(const bson_render_t *render,
+                   const bson_render_frame_t *frame) {
+  return !render->json && frame->compact;
+}
+
+// cierre del nivel de arriba
+static bool emit_close(bson_render_t *render, bson_span_t *span) {
+  bson_render_frame_t *top = &render->stack[render->depth - 1];
+  bool empty = top->first;
+  bool is_array = top->is_array;
+  bool space = spaced(render, top);
+  render->depth--;
+  render->step = render->depth > 0 ? RENDER_NEXT : RENDER_DONE;
+  if (!space || empty) {
+    return emit(span, is_array ? "]" : "}", 1, JSON_COLOR_BRACKET);
+  }
+  return emit(span, is_array ? " ]" : " }", 2, JSON_COLOR_BRACKET);
+}
+
+static bool emit_open(bson_render_t *render, bson_span_t *span,
+                      const bson_render_frame_t *frame) {
+  size_t length = spaced(render, frame) ? 2 : 1;
+  return emit(span, frame->is_array ? "[ " : "{ ", length, JSON_COLOR_BRACKET);
+}
+
+static bool emit_scratch(bson_render_t *render, bson_span_t *span, int color) {
+  return emit(span, render->scratch, strlen(render->scratch), color);
+}
+
+// valores que no son string ni contenedor, en notación del shell
+static int format_value(bson_render_t *render, const bson_iter_t *iter) {
+  char value[128];
+  int color = json_format_scalar(iter, value, sizeof(value));
+  const char *wrapper = NULL;
+
+  switch (bson_iter_type(iter)) {
+  case BSON_TYPE_OID:
+    wrapper = "ObjectId";
+    break;
+  case BSON_TYPE_DATE_TIME:
+    wrapper = "ISODate";
+    break;
+  case BSON_TYPE_DECIMAL128:
+    wrapper = "NumberDecimal";
+    break;
+  default:
+    break;
+  }
+
+  if (wrapper) {
+    snprintf(render->scratch, sizeof(render->scratch), "%s(\"%s\")", wrapper,
+             value);
+  } else {
+    snprintf(render->scratch, sizeof(render->scratch), "%s", value);
+  }
+  return color;
+}
+
+// "$binary" en base64; el texto queda en render->owned
+static bool format_binary(bson_render_t *render, const bson_iter_t *iter) {
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  bson_subtype_t subtype;
+  uint32_t length;
+  const uint8_t *data;
+  bson_iter_binary(iter, &subtype, &length, &data);
+
+  size_t size = 64 + (length + 2) / 3 * 4;
+  char *out = malloc(size);
+  if (!out) {
+    return false;
+  }
+
+  size_t pos = (size_t)snprintf(out, size, "{\"$binary\": {\"base64\": \"");
+  for (uint32_t i = 0; i < length; i += 3) {
+    uint32_t n = (uint32_t)data[i] << 16;
+    if (i + 1 < length) {
+      n |= (uint32_t)data[i + 1] << 8;
+    }
+    if (i + 2 < length) {
+      n |= data[i + 2];
+    }
+    out[pos++] = alphabet[(n >> 18) & 63];
+    out[pos++] = alphabet[(n >> 12) & 63];
+    out[pos++] = i + 1 < length ? alphabet[(n >> 6) & 63] : '=';
+    out[pos++] = i + 2 < length ? alphabet[n & 63] : '=';
+  }
+  snprintf(out + pos, size - pos, "\", \"subType\": \"%02x\"}}",
+           (unsigned)subtype);
+  render->owned = out;
+  return true;
+}
+
+// tipos raros (regex, code, dbpointer...): los escribe libbson como
+// { "" : valor } y se queda el valor
+static bool format_by_libbson(bson_render_t *render, const bson_iter_t *iter) {
+  bson_t tmp;
+  bson_init(&tmp);
+  bson_append_iter(&tmp, "", 0, iter);
+  size_t length;
+  char *json = bson_as_relaxed_extended_json(&tmp, &length);
+  bson_destroy(&tmp);
+  if (!json) {
+    return false;
+  }
+
+  const char *prefix = "{ \"\" : ";
+  size_t skip = strncmp(json, prefix, strlen(prefix)) == 0 ? strlen(prefix)
+                                                            : 0;
+  size_t trim = skip && length >= skip + 2 ? 2 : 0; // " }"
+  size_t n = length - skip - trim;
+  render->owned = malloc(n + 1);
+  if (render->owned) {
+    memcpy(render->owned, json + skip, n);
+    render->owned[n] = '\0';
+  }
+  bson_free(json);
+  return render->owned != NULL;
+}
+
+// valores que no son string ni contenedor, en JSON extendido relajado
+// (lo que vuelve a leer bson_new_from_json)
+static bool emit_json_value(bson_render_t *render, bson_span_t *span,
+                            const bson_iter_t *iter) {
+  char value[128];
+  int color = json_format_scalar(iter, value, sizeof(value));
+  char *out = render->scratch;
+  size_t size = sizeof(render->scratch);
+
+  switch (bson_iter_type(iter)) {
+  case BSON_TYPE_INT32:
+  case BSON_TYPE_INT64:
+  case BSON_TYPE_BOOL:
+  case BSON_TYPE_NULL:
+    snprintf(out, size, "%s", value);
+    break;
+  case BSON_TYPE_DOUBLE:
+    if (isfinite(bson_iter_double(iter))) {
+      snprintf(out, size, "%s", value);
+    } else {
+      snprintf(out, size, "{\"$numberDouble\": \"%s\"}", value);
+    }
+    break;
+  case BSON_TYPE_OID:
+    snprintf(out, size, "{\"$oid\": \"%s\"}", value);
+    break;
+  case BSON_TYPE_DATE_TIME: {
+    // la forma ISO sólo cubre los años 1970 a 9999
+    int64_t ms = bson_iter_date_time(iter);
+    if (ms >= 0 && ms < 253402300800000LL) {
+      snprintf(out, size, "{\"$date\": \"%s\"}", value);
+    } else {
+      snprintf(out, size, "{\"$date\": {\"$numberLong\": \"%lld\"}}",
+               (long long)ms);
+    }
+    break;
+  }
+  case BSON_TYPE_DECIMAL128:
+    snprintf(out, size, "{\"$numberDecimal\": \"%s\"}", value);
+    break;
+  case BSON_TYPE_TIMESTAMP: {
+    uint32_t t, i;
+    bson_iter_timestamp(iter, &t, &i);
+    snprintf(out, size, "{\"$timestamp\": {\"t\": %u, \"i\": %u}}", t, i);
+    break;
+  }
+  case BSON_TYPE_MINKEY:
+    snprintf(out, size, "{\"$minKey\": 1}");
+    break;
+  case BSON_TYPE_MAXKEY:
+    snprintf(out, size, "{\"$maxKey\": 1}");
+    break;
+  case BSON_TYPE_UNDEFINED:
+    snprintf(out, size, "{\"$undefined\": true}");
+    break;
+  case BSON_TYPE_BINARY:
+    if (!format_binary(render, iter)) {
+      return emit(span, "null", 4, JSON_COLOR_NULL);
+    }
+    return emit(span, render->owned, strlen(render->owned), JSON_COLOR_STRING);
+  default:
+    if (!format_by_libbson(render, iter)) {
+      return emit(span, "null", 4, JSON_COLOR_NULL);
+    }
+    return emit(span, render->owned, strlen(render->owned), JSON_COLOR_STRING);
+  }
+  return emit_scratch(render, span, color);
+}
+
+// largo del tramo inicial que no necesita escape
+static uint32_t plain_run(const char *s, uint32_t length) {
+  uint32_t i = 0;
+  while (i < length) {
+    unsigned char c = (unsigned char)s[i];
+    if (c < 0x20 || c == '"' || c == '\\') {
+      break;
+    }
+    i++;
+  }
+  return i;
+}
+
+static void escape_char(char *buffer, size_t size, unsigned char c) {
+  switch (c) {
+  case '"':
+    snprintf(buffer, size, "\\\"");
+    break;
+  case '\\':
+    snprintf(buffer, size, "\\\\");
+    break;
+  case '\n':
+    snprintf(buffer, size, "\\n");
+    break;
+  case '\r':
+    snprintf(buffer, size, "\\r");
+    break;
+  case '\t':
+    snprintf(buffer, size, "\\t");
+    break;
+  default:
+    snprintf(buffer, size, "\\u%04x", c);
+    break;
+  }
+}
+
+// largo de frame en una línea, cortando apenas pasa de limit
+static size_t measure_compact(const bson_render_t *render,
+                              const bson_render_frame_t *frame, size_t limit) {
+  bson_render_t m;
+  m.pretty = false;
+  m.json = render->json;
+  m.width = 0;
+  m.string = NULL;
+  m.string_left = 0;
+  m.owned = NULL;
+  m.stack[0] = *frame;
+  m.depth = 1;
+  m.step = RENDER_NEXT;
+
+  size_t total = spaced(&m, frame) ? 2 : 1;
+  bson_span_t span;
+  while (total <= limit && bson_render_next(&m, &span)) {
+    total += span.length;
+  }
+  bson_render_clear(&m);
+  return total;
+}
+
+// abrir el contenedor de top como nivel nuevo; false si no se puede
+static bool open_child(bson_render_t *render, bson_span_t *span,
+                       bson_type_t type) {
+  bson_render_frame_t *top = &render->stack[render->depth - 1];
+  bson_render_frame_t *child = &render->stack[render->depth];
+  if (!bson_iter_recurse(&top->iter, &child->iter)) {
+    return false;
+  }
+  child->is_array = type == BSON_TYPE_ARRAY;
+  child->first = true;
+  child->compact = top->compact;
+
+  // en pretty, un nivel corto va entero en una línea si entra en el ancho
+  // (con la sangría, la clave y la coma)
+  if (!top->compact && render->width > 0) {
+    size_t prefix = 2 * (size_t)render->depth + 1;
+    if (!top->is_array) {
+      prefix += strlen(bson_iter_key(&top->iter)) + (render->json ? 4 : 5);
+    }
+    if (prefix < (size_t)render->width) {
+      size_t room = (size_t)render->width - prefix;
+      bson_render_frame_t probe = *child;
+      probe.compact = true;
+      child->compact = measure_compact(render, &probe, room) <= room;
+    }
+  }
+
+  render->depth++;
+  render->step = RENDER_NEXT;
+  return emit_open(render, span, child);
+}
+
+bool bson_render_next(bson_render_t *render, bson_span_t *span) {
+  // lo que se reservó para el fragmento anterior ya no se usa
+  if (render->owned) {
+    free(render->owned);
+    render->owned = NULL;
+  }
+
+  while (render->step != RENDER_DONE) {
+    bson_render_frame_t *top = &render->stack[render->depth - 1];
+
+    switch (render->step) {
+    case RENDER_OPEN:
+      render->step = RENDER_NEXT;
+      return emit_open(render, span, top);
+
+    case RENDER_NEXT:
+      if (!bson_iter_next(&top->iter)) {
+        if (!top->compact && !top->first) {
+          render->step = RENDER_CLOSE;
+          return emit_break(span, render->depth - 1, false);
+        }
+        return emit_close(render, span);
+      }
+
+      render->step = top->is_array ? RENDER_VALUE : RENDER_KEY_OPEN;
+      if (!top->compact) {
+        bool first = top->first;
+        top->first = false;
+        return emit_break(span, render->depth, !first);
+      }
+      if (!top->first) {
+        return emit(span, ", ", 2, JSON_COLOR_BRACKET);
+      }
+      top->first = false;
+      break;
+
+    case RENDER_CLOSE:
+      return emit_close(render, span);
+
+    case RENDER_KEY_OPEN:
+      render->step = RENDER_KEY_TEXT;
+      return emit(span, "\"", 1, JSON_COLOR_KEY);
+
+    case RENDER_KEY_TEXT: {
+      const char *key = bson_iter_key(&top->iter);
+      render->string = key;
+      render->string_left = (uint32_t)strlen(key);
+      render->string_color = JSON_COLOR_KEY;
+      render->after_string = RENDER_COLON;
+      render->step = RENDER_STRING;
+      break;
+    }
+
+    case RENDER_COLON:
+      render->step = RENDER_VALUE;
+      if (render->json) {
+        return emit(span, ": ", 2, JSON_COLOR_BRACKET);
+      }
+      return emit(span, " : ", 3, JSON_COLOR_BRACKET);
+
+    case RENDER_VALUE: {
+      bson_type_t type = bson_iter_type(&top->iter);
+      if (type == BSON_TYPE_UTF8 ||
+          (type == BSON_TYPE_SYMBOL && !render->json)) {
+        render->string = type == BSON_TYPE_UTF8
+                             ? bson_iter_utf8(&top->iter, &render->string_left)
+                             : bson_iter_symbol(&top->iter,
+                                                &render->string_left);
+        render->string_color = JSON_COLOR_STRING;
+        render->after_string = RENDER_NEXT;
+        render->step = RENDER_STRING;
+        return emit(span, "\"", 1, JSON_COLOR_STRING);
+      }
+
+      bool container =
+          type == BSON_TYPE_DOCUMENT || type == BSON_TYPE_ARRAY;
+      if (container && render->depth < BSON_RENDER_MAX_DEPTH &&
+          open_child(render, span, type)) {
+        return true;
+      }
+
+      render->step = RENDER_NEXT;
+      if (render->json) {
+        return emit_json_value(render, span, &top->iter);
+      }
+
+      // escalares y niveles demasiado profundos (resumen {n} / [n])
+      int color = format_value(render, &top->iter);
+      return emit_scratch(render, span, color);
+    }
+
+    case RENDER_STRING: {
+      if (render->string_left == 0) {
+        render->step = render->after_string;
+        return emit(span, "\"", 1, render->string_color);
+      }
+
+      // tramo sin escapes: directo desde el documento, sin copiar
+      const char *s = render->string;
+      uint32_t run = plain_run(s, render->string_left);
+      if (run == 0) {
+        escape_char(render->scratch, sizeof(render->scratch),
+                    (unsigned char)*s);
+        run = 1;
+        render->string += run;
+        render->string_left -= run;
+        return emit_scratch(render, span, render->string_color);
+      }
+
+      render->string += run;
+      render->string_left -= run;
+      return emit(span, s, run, render->string_color);
+    }
+
+    default:
+      render->step = RENDER_DONE;
+      break;
+    }
+  }
+
+  return false;
+}
+
+bool bson_render_to_buffer(bson_render_t *render, text_buffer_t *out) {
+  bson_span_t span;
+  while (bson_render_next(render, &span)) {
+    if (!text_buffer_append(out, span.text, span.length)) {
+      bson_render_clear(render);
+      return false;
+    }
+  }
+  return true;
+}
+
+// byte que continúa un caracter UTF-8 (no ocupa columna)
+static bool is_continuation(unsigned char c) { return (c & 0xC0) == 0x80; }
+
+// texto de las líneas visibles: byte, color y línea de cada uno. se
+// reutiliza entre llamadas para no reservar memoria en cada frame
+typedef struct {
+  char *text;
+  unsigned char *color;
+  int *line;
+  size_t length;
+  size_t capacity;
+} render_buffer_t;
+
+static render_buffer_t g_buffer;
+
+#define RENDER_REVERSE 0x80 // marca de resaltado en el byte de color
+
+static bool buffer_push(render_buffer_t *b, char c, int color, int line) {
+  if (b->length == b->capacity) {
+    size_t capacity = b->capacity ? b->capacity * 2 : 4096;
+    char *text = realloc(b->text, capacity);
+    if (text) {
+      b->text = text;
+    }
+    unsigned char *colors = realloc(b->color, capacity);
+    if (colors) {
+      b->color = colors;
+    }
+    int *lines = realloc(b->line, capacity * sizeof(int));
+    if (lines) {
+      b->line = lines;
+    }
+    if (!text || !colors || !lines) {
+      return false;
+    }
+    b->capacity = capacity;
+  }
+
+  b->text[b->length] = c;
+  b->color[b->length] = (unsigned char)color;
+  b->line[b->length] = line;
+  b->length++;
+  return true;
+}
+
+// dejar sólo los últimos keep bytes (contexto para coincidencias que
+// empiezan antes de la primera línea visible)
+static void buffer_keep_tail(render_buffer_t *b, size_t keep) {
+  if (b->length <= keep) {
+    return;
+  }
+  size_t from = b->length - keep;
+  memmove(b->text, b->text + from, keep);
+  memmove(b->color, b->color + from, keep);
+  memmove(b->line, b->line + from, keep * sizeof(int));
+  b->length = keep;
+}
+
+static void mark_matches(render_buffer_t *b) {
+  const search_pattern_t *pattern = json_highlight_pattern();
+  if (!pattern || b->length == 0) {
+    return;
+  }
+
+  const char *p = b->text;
+  const char *end = b->text + b->length;
+  const char *match;
+  while ((match = search_find(pattern, p, end - p)) != NULL) {
+    for (size_t i = 0; i < pattern->length; i++) {
+      b->color[match - b->text + i] |= RENDER_REVERSE;
+    }
+    p = match + pattern->length;
+  }
+}
+
+int bson_render_draw(WINDOW *win, const bson_t *doc, int start_y, int start_x,
+                     int max_height, int max_width, int scroll_offset) {
+  if (!win || !doc || max_width <= 0 || max_height <= 0) {
+    return 0;
+  }
+
+  if (scroll_offset < 0) {
+    scroll_offset = 0;
+  }
+
+  const search_pattern_t *pattern = json_highlight_pattern();
+  size_t context = pattern ? pattern->length - 1 : 0;
+  int last_line = scroll_offset + max_height; // primera línea que no entra
+
+  render_buffer_t *b = &g_buffer;
+  b->length = 0;
+
+  bson_render_t render;
+  bson_render_init(&render, doc);
+
+  // juntar los bytes visibles (más un poco de contexto antes y después)
+  int line = 0;
+  int col = 0;
+  size_t after = 0; // bytes de contexto tomados después de la última línea
+  bool done = false;
+  bson_span_t span;
+
+  while (!done && bson_render_next(&render, &span)) {
+    for (size_t i = 0; i < span.length; i++) {
+      unsigned char c = (unsigned char)span.text[i];
+      if (!is_continuation(c)) {
+        if (col >= max_width) {
+          line++;
+          col = 0;
+        }
+        col++;
+      }
+
+      if (line >= last_line) {
+        if (after++ >= context) {
+          done = true;
+          break;
+        }
+      } else if (line < scroll_offset && b->length >= 4096 + context) {
+        buffer_keep_tail(b, context);
+      }
+
+      if (!buffer_push(b, (char)c, span.color, line)) {
+        done = true;
+        break;
+      }
+    }
+  }
+
+  mark_matches(b);
+
+  // dibujar tramos de igual línea y color con una sola llamada
+  int drawn_lines = 0;
+  size_t i = 0;
+  int draw_line = -1;
+  col = 0;
+  while (i < b->length) {
+    int l = b->line[i];
+    if (l < scroll_offset) {
+      i++;
+      continue;
+    }
+    if (l >= last_line) {
+      break;
+    }
+
+    if (l != draw_line) {
+      draw_line = l;
+      col = 0;
+      drawn_lines = l - scroll_offset + 1;
+    }
+
+    size_t start = i;
+    int start_col = col;
+    unsigned char color = b->color[i];
+    while (i < b->length && b->line[i] == l && b->color[i] == color) {
+      if (!is_continuation((unsigned char)b->text[i])) {
+        col++;
+      }
+      i++;
+    }
+
+    attr_t attr = A_NORMAL;
+    if ((color & ~RENDER_REVERSE) != 0) {
+      attr |= COLOR_PAIR(color & ~RENDER_REVERSE);
+    }
+    if (color & RENDER_REVERSE) {
+      attr |= A_REVERSE;
+    }
+    wattron(win, attr);
+    mvwaddnstr(win, start_y + l - scroll_offset, start_x + start_col,
+               b->text + start, (int)(i - start));
+    wattroff(win, attr);
+  }
+
+  return drawn_lines;
+}
+
+bool bson_render_cache_valid(const bson_render_cache_t *cache,
+                             const bson_t *doc, int width) {
+  return cache && cache->text && cache->doc == doc && cache->width == width;
+}
+
+void bson_render_cache_free(bson_render_cache_t *cache) {
+  if (!cache) {
+    return;
+  }
+  free(cache->text);
+  free(cache->runs);
+  free(cache->lines);
+  memset(cache, 0, sizeof(*cache));
+}
+
+// crecer un array dinámico al doble; devuelve el array (NULL si falla,
+// dejando el original intacto)
+static void *grow_array(void *array, uint32_t *capacity, size_t item_size,
+                        uint32_t needed) {
+  if (needed <= *capacity) {
+    return array;
+  }
+  uint32_t new_capacity = *capacity ? *capacity * 2 : 64;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+  void *grown = realloc(array, (size_t)new_capacity * item_size);
+  if (grown) {
+    *capacity = new_capacity;
+  }
+  return grown;
+}
+
+bool bson_render_cache_build(bson_render_cache_t *cache, const bson_t *doc,
+                             int width) {
+  if (!cache) {
+    return false;
+  }
+
+  bson_render_cache_free(cache);
+  if (!doc || width <= 0) {
+    return false;
+  }
+
+  size_t text_capacity = (size_t)doc->len * 2 + 16;
+  cache->text = malloc(text_capacity);
+  if (!cache->text) {
+    return false;
+  }
+
+  uint32_t run_capacity = 0, line_capacity = 0;
+  bool ok = true;
+  int col = width; // fuerza abrir la primera línea
+  bson_render_run_t *run = NULL;
+
+  bson_render_t render;
+  bson_render_init(&render, doc);
+
+  bson_span_t span;
+  while (ok && bson_render_next(&render, &span)) {
+    if (cache->text_length + span.length + 1 > text_capacity) {
+      text_capacity = (cache->text_length + span.length + 1) * 2;
+      char *grown = realloc(cache->text, text_capacity);
+      if (!grown) {
+        ok = false;
+        break;
+      }
+      cache->text = grown;
+    }
+
+    for (size_t i = 0; i < span.length; i++) {
+      unsigned char c = (unsigned char)span.text[i];
+      bool new_line = false;
+      if (!is_continuation(c)) {
+        if (col >= width) {
+          new_line = true;
+          col = 0;
+        }
+        col++;
+      }
+
+      if (new_line) {
+        bson_render_line_t *lines =
+            grow_array(cache->lines, &line_capacity,
+                       sizeof(bson_render_line_t), cache->line_count + 1);
+        if (!lines) {
+          ok = false;
+          break;
+        }
+        cache->lines = lines;
+        bson_render_line_t *line = &cache->lines[cache->line_count++];
+        line->first_run = cache->run_count;
+        line->run_count = 0;
+        run = NULL;
+      }
+
+      // seguir el tramo si es del mismo color, si no abrir otro
+      if (!run || run->color != span.color) {
+        bson_render_run_t *runs =
+            grow_array(cache->runs, &run_capacity, sizeof(bson_render_run_t),
+                       cache->run_count + 1);
+        if (!runs) {
+          ok = false;
+          break;
+        }
+        cache->runs = runs;
+        run = &cache->runs[cache->run_count++];
+        run->offset = (uint32_t)cache->text_length;
+        run->length = 0;
+        run->color = span.color;
+        cache->lines[cache->line_count - 1].run_count++;
+      }
+
+      cache->text[cache->text_length++] = (char)c;
+      run->length++;
+    }
+  }
+
+  if (!ok) {
+    bson_render_cache_free(cache);
+    return false;
+  }
+
+  cache->text[cache->text_length] = '\0';
+  cache->doc = doc;
+  cache->width = width;
+  return true;
+}
+
+// coincidencias [start, end) del texto visible
+typedef struct {
+  size_t start;
+  size_t end;
+} match_range_t;
+
+static match_range_t *g_matches;
+static uint32_t g_match_capacity;
+
+static uint32_t find_visible_matches(const bson_render_cache_t *cache,
+                                     size_t from, size_t to) {
+  const search_pattern_t *pattern = json_highlight_pattern();
+  if (!pattern) {
+    return 0;
+  }
+
+  // contexto para coincidencias que cruzan el borde de lo visible
+  size_t context = pattern->length - 1;
+  from = from > context ? from - context : 0;
+  to = to + context < cache->text_length ? to + context : cache->text_length;
+
+  uint32_t count = 0;
+  const char *p = cache->text + from;
+  const char *end = cache->text + to;
+  const char *match;
+  while ((match = search_find(pattern, p, end - p)) != NULL) {
+    match_range_t *matches = grow_array(g_matches, &g_match_capacity,
+                                        sizeof(match_range_t), count + 1);
+    if (!matches) {
+      break;
+    }
+    g_matches = matches;
+    g_matches[count].start = match - cache->text;
+    g_matches[count].end = g_matches[count].start + pattern->length;
+    count++;
+    p = match + pattern->length;
+  }
+  return count;
+}
+
+int bson_render_cache_draw(WINDOW *win, const bson_render_cache_t *cache,
+                           int start_y, int start_x, int max_height,
+                           int scroll_offset) {
+  if (!win || !cache || !cache->text || max_height <= 0) {
+    return 0;
+  }
+
+  if (scroll_offset < 0) {
+    scroll_offset = 0;
+  }
+
+  uint32_t first = (uint32_t)scroll_offset;
+  uint32_t last = first + (uint32_t)max_height;
+  if (last > cache->line_count) {
+    last = cache->line_count;
+  }
+  if (first >= last) {
+    return 0;
+  }
+
+  // rango de texto visible
+  const bson_render_line_t *first_line = &cache->lines[first];
+  const bson_render_line_t *last_line = &cache->lines[last - 1];
+  const bson_render_run_t *end_run =
+      &cache->runs[last_line->first_run + last_line->run_count - 1];
+  uint32_t match_count =
+      find_visible_matches(cache, cache->runs[first_line->first_run].offset,
+                           end_run->offset + end_run->length);
+  uint32_t m = 0;
+
+  for (uint32_t l = first; l < last; l++) {
+    const bson_render_line_t *line = &cache->lines[l];
+    wmove(win, start_y + (int)(l - first), start_x);
+
+    for (uint32_t r = 0; r < line->run_count; r++) {
+      const bson_render_run_t *run = &cache->runs[line->first_run + r];
+      size_t pos = run->offset;
+      size_t run_end = run->offset + run->length;
+
+      // partir el tramo donde empiezan o terminan coincidencias
+      while (pos < run_end) {
+        while (m < match_count && g_matches[m].end <= pos) {
+          m++;
+        }
+
+        bool reverse = m < match_count && g_matches[m].start <= pos;
+        size_t seg_end = run_end;
+        if (reverse && g_matches[m].end < seg_end) {
+          seg_end = g_matches[m].end;
+        } else if (!reverse && m < match_count &&
+                   g_matches[m].start < seg_end) {
+          seg_end = g_matches[m].start;
+        }
+
+        attr_t attr = run->color ? COLOR_PAIR(run->color) : A_NORMAL;
+        if (reverse) {
+          attr |= A_REVERSE;
+        }
+        wattron(win, attr);
+        waddnstr(win, cache->text + pos, (int)(seg_end - pos));
+        wattroff(win, attr);
+        pos = seg_end;
+      }
+    }
+  }
+
+  return (int)(last - first);
+}
+
+int bson_render_cache_offset_line(const bson_render_cache_t *cache,
+                                  size_t offset) {
+  if (!cache || cache->line_count == 0) {
+    return 0;
+  }
+
+  // última línea que empieza en o antes del offset
+  uint32_t lo = 0, hi = cache->line_count - 1;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo + 1) / 2;
+    if (cache->runs[cache->lines[mid].first_run].offset <= offset) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return (int)lo;
+}
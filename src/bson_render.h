@@ -0,0 +1,133 @@
+#ifndef BSON_RENDER_H
+#define BSON_RENDER_H
+
+#include "text_buffer.h"
+#include <mongoc/mongoc.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// header de curses multiplataforma
+#ifdef _WIN32
+#include <curses.h> // PDCurses en Windows
+#else
+#include <ncurses.h> // ncurses en Unix
+#endif
+
+// niveles anidados que se abren; más adentro se muestra un resumen
+#define BSON_RENDER_MAX_DEPTH 100
+
+// fragmento de texto con su color JSON_COLOR_*. el texto apunta al
+// documento o al buffer del renderer y vale hasta el próximo next
+typedef struct {
+  const char *text;
+  size_t length;
+  int color;
+} bson_span_t;
+
+// nivel abierto (documento o array)
+typedef struct {
+  bson_iter_t iter;
+  bool is_array;
+  bool first;
+  bool compact; // en una sola línea
+} bson_render_frame_t;
+
+// recorrido del documento con pila explícita: se puede cortar y seguir
+typedef struct {
+  bson_render_frame_t stack[BSON_RENDER_MAX_DEPTH];
+  int depth;
+  int step;
+  const char *string; // resto del string (o clave) que se está emitiendo
+  uint32_t string_left;
+  int string_color;
+  int after_string; // paso que sigue a la comilla de cierre
+  bool pretty;      // un elemento por línea, con sangría
+  bool json;        // JSON extendido relajado en vez de notación del shell
+  int width;        // en pretty, niveles que entran en el ancho van en 1 línea
+  char *owned;      // texto largo del fragmento actual (binarios, etc.)
+  char scratch[160];
+} bson_render_t;
+
+// empezar a recorrer un documento
+void bson_render_init(bson_render_t *render, const bson_t *doc);
+
+// igual, pero con salto de línea y sangría de 2 espacios por nivel (los
+// saltos llegan como fragmentos que empiezan con '\n'). un subdocumento o
+// array que entra entero en width columnas, contando sangría y clave, va en
+// una línea; width 0 abre todos
+void bson_render_init_pretty(bson_render_t *render, const bson_t *doc,
+                             int width);
+
+// pretty en JSON extendido relajado ({"$oid": ...}, {"$date": ...}), que
+// bson_new_from_json vuelve a leer; para el editor y las exportaciones
+void bson_render_init_json(bson_render_t *render, const bson_t *doc,
+                           int width);
+
+// JSON extendido relajado en una sola línea (NDJSON, celdas de CSV)
+void bson_render_init_json_line(bson_render_t *render, const bson_t *doc);
+
+// igual, para el documento de un array (claves "0", "1"...): sale entre
+// corchetes y sin las claves
+void bson_render_init_json_line_array(bson_render_t *render,
+                                      const bson_t *array);
+
+// siguiente fragmento; false al terminar
+bool bson_render_next(bson_render_t *render, bson_span_t *span);
+
+// soltar lo reservado si se deja un recorrido sin terminar
+void bson_render_clear(bson_render_t *render);
+
+// recorrer hasta el final agregando el texto a out
+bool bson_render_to_buffer(bson_render_t *render, text_buffer_t *out);
+
+// dibujar con colores y wrap (mismo contrato que json_display_string);
+// resalta el patrón de json_set_highlight
+int bson_render_draw(WINDOW *win, const bson_t *doc, int start_y, int start_x,
+                     int max_height, int max_width, int scroll_offset);
+
+// tramo de texto del mismo color dentro de una línea
+typedef struct {
+  uint32_t offset; // en text
+  uint32_t length;
+  int color;
+} bson_render_run_t;
+
+typedef struct {
+  uint32_t first_run;
+  uint32_t run_count;
+} bson_render_line_t;
+
+// documento renderizado una vez y partido en líneas de un ancho dado.
+// sirve mientras no cambien el documento ni el ancho
+typedef struct {
+  const bson_t *doc;
+  int width;
+  char *text;
+  size_t text_length;
+  bson_render_run_t *runs;
+  uint32_t run_count;
+  bson_render_line_t *lines;
+  uint32_t line_count;
+} bson_render_cache_t;
+
+// ver si el cache corresponde a doc y width
+bool bson_render_cache_valid(const bson_render_cache_t *cache,
+                             const bson_t *doc, int width);
+
+// renderizar doc en líneas de width columnas (libera lo anterior)
+bool bson_render_cache_build(bson_render_cache_t *cache, const bson_t *doc,
+                             int width);
+
+// liberar el cache
+void bson_render_cache_free(bson_render_cache_t *cache);
+
+// dibujar desde el cache: un waddnstr por tramo, resaltado al dibujar
+int bson_render_cache_draw(WINDOW *win, const bson_render_cache_t *cache,
+                           int start_y, int start_x, int max_height,
+                           int scroll_offset);
+
+// línea en la que cae un offset de cache->text
+int bson_render_cache_offset_line(const bson_render_cache_t *cache,
+                                  size_t offset);
+
+#endif // BSON_RENDER_H
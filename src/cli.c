@@ -0,0 +1,502 @@
+#include "cli.h"
+#include "bson_render.h"
+#include "json_display.h"
+#include "mongo_ops.h"
+#include "utils.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// salida juntada antes de cada fwrite
+#define CLI_OUT_BUFFER (256 * 1024)
+
+// ancho del pretty de --format json
+#define CLI_JSON_WIDTH 80
+
+typedef struct {
+  char data[CLI_OUT_BUFFER];
+  size_t length;
+  bool failed; // falló la escritura (pipe cerrado, disco lleno)
+  cli_format_t format;
+  char **columns; // columnas del CSV
+  int column_count;
+  unsigned long long count;
+} cli_writer_t;
+
+static void usage(FILE *out) {
+  fprintf(out,
+          "Usage: mongodb-tui [URI] [--ns DB.COLLECTION] [options]\n"
+          "\n"
+          "Opens the interface connected to URI (or $MONGODB_URI, or the\n"
+          "last session), straight into the namespace if one is given.\n"
+          "With --format, or when stdout is not a terminal, runs one query\n"
+          "and writes the documents to stdout instead.\n"
+          "\n"
+          "  --uri URI          connection string (same as the argument)\n"
+          "  --ns DB.COLL       namespace to open or query\n"
+          "  --filter JSON      query filter (default {})\n"
+          "  --sort SPEC        \"field:1, other:-1\", \"-field\" or JSON\n"
+          "  --limit N          stop after N documents (default all)\n"
+          "  --format FORMAT    ndjson (default), json or csv\n"
+          "  --fields A,B.C     CSV columns (default: keys of the first "
+          "document)\n"
+          "  --help             show this help\n");
+}
+
+static void flush_out(cli_writer_t *w) {
+  if (w->length > 0 && !w->failed &&
+      fwrite(w->data, 1, w->length, stdout) != w->length) {
+    w->failed = true;
+  }
+  w->length = 0;
+}
+
+static void write_out(cli_writer_t *w, const char *text, size_t length) {
+  if (w->length + length > sizeof(w->data)) {
+    flush_out(w);
+    if (length > sizeof(w->data)) {
+      if (!w->failed && fwrite(text, 1, length, stdout) != length) {
+        w->failed = true;
+      }
+      return;
+    }
+  }
+  memcpy(w->data + w->length, text, length);
+  w->length += length;
+}
+
+static void write_render(cli_writer_t *w, bson_render_t *render) {
+  bson_span_t span;
+  while (bson_render_next(render, &span)) {
+    write_out(w, span.text, span.length);
+  }
+}
+
+// texto entre comillas con las comillas dobladas (RFC 4180)
+static void write_csv_quoted(cli_writer_t *w, const char *text,
+                             size_t length) {
+  const char *end = text + length;
+  while (text < end) {
+    const char *quote = memchr(text, '"', (size_t)(end - text));
+    if (!quote) {
+      write_out(w, text, (size_t)(end - text));
+      break;
+    }
+    write_out(w, text, (size_t)(quote - text) + 1);
+    write_out(w, "\"", 1);
+    text = quote + 1;
+  }
+}
+
+static void write_csv_text(cli_writer_t *w, const char *text, size_t length) {
+  bool quote = false;
+  for (size_t i = 0; i < length && !quote; i++) {
+    char c = text[i];
+    quote = c == ',' || c == '"' || c == '\n' || c == '\r';
+  }
+
+  if (!quote) {
+    write_out(w, text, length);
+    return;
+  }
+  write_out(w, "\"", 1);
+  write_csv_quoted(w, text, length);
+  write_out(w, "\"", 1);
+}
+
+static void write_csv_value(cli_writer_t *w, const bson_iter_t *iter) {
+  switch (bson_iter_type(iter)) {
+  case BSON_TYPE_NULL:
+  case BSON_TYPE_UNDEFINED:
+    break;
+  case BSON_TYPE_UTF8: {
+    uint32_t length;
+    const char *text = bson_iter_utf8(iter, &length);
+    write_csv_text(w, text, length);
+    break;
+  }
+  case BSON_TYPE_DOCUMENT:
+  case BSON_TYPE_ARRAY: {
+    // subdocumentos como JSON en una celda
+    uint32_t length;
+    const uint8_t *data;
+    bson_t sub;
+    if (BSON_ITER_HOLDS_DOCUMENT(iter)) {
+      bson_iter_document(iter, &length, &data);
+    } else {
+      bson_iter_array(iter, &length, &data);
+    }
+    if (!bson_init_static(&sub, data, length)) {
+      break;
+    }
+
+    bson_render_t render;
+    bson_span_t span;
+    if (BSON_ITER_HOLDS_ARRAY(iter)) {
+      bson_render_init_json_line_array(&render, &sub);
+    } else {
+      bson_render_init_json_line(&render, &sub);
+    }
+    write_out(w, "\"", 1);
+    while (bson_render_next(&render, &span)) {
+      write_csv_quoted(w, span.text, span.length);
+    }
+    write_out(w, "\"", 1);
+    break;
+  }
+  default: {
+    char value[128];
+    json_format_scalar(iter, value, sizeof(value));
+    write_csv_text(w, value, strlen(value));
+    break;
+  }
+  }
+}
+
+// columnas de --fields, o las claves del primer documento
+static bool csv_columns(cli_writer_t *w, const char *fields,
+                        const bson_t *first) {
+  bson_iter_t iter;
+  int count = 0;
+  if (fields) {
+    count = 1;
+    for (const char *p = fields; *p; p++) {
+      count += *p == ',';
+    }
+  } else if (bson_iter_init(&iter, first)) {
+    while (bson_iter_next(&iter)) {
+      count++;
+    }
+  }
+
+  w->columns = calloc((size_t)(count > 0 ? count : 1), sizeof(char *));
+  if (!w->columns) {
+    return false;
+  }
+
+  if (fields) {
+    const char *start = fields;
+    for (int i = 0; i < count; i++) {
+      const char *comma = strchr(start, ',');
+      size_t length = comma ? (size_t)(comma - start) : strlen(start);
+      char name[256];
+      if (length >= sizeof(name)) {
+        length = sizeof(name) - 1;
+      }
+      memcpy(name, start, length);
+      name[length] = '\0';
+      w->columns[i] = str_dup(trim_whitespace(name));
+      if (!w->columns[i]) {
+        return false;
+      }
+      w->column_count++;
+      start = comma ? comma + 1 : start + strlen(start);
+    }
+    return true;
+  }
+
+  if (bson_iter_init(&iter, first)) {
+    while (bson_iter_next(&iter) && w->column_count < count) {
+      w->columns[w->column_count] = str_dup(bson_iter_key(&iter));
+      if (!w->columns[w->column_count]) {
+        return false;
+      }
+      w->column_count++;
+    }
+  }
+  return true;
+}
+
+static void write_csv_header(cli_writer_t *w) {
+  for (int i = 0; i < w->column_count; i++) {
+    if (i > 0) {
+      write_out(w, ",", 1);
+    }
+    write_csv_text(w, w->columns[i], strlen(w->columns[i]));
+  }
+  write_out(w, "\r\n", 2);
+}
+
+static void write_csv_row(cli_writer_t *w, const bson_t *doc) {
+  for (int i = 0; i < w->column_count; i++) {
+    if (i > 0) {
+      write_out(w, ",", 1);
+    }
+    // "a.b" busca dentro de subdocumentos
+    bson_iter_t iter, found;
+    if (bson_iter_init(&iter, doc) &&
+        bson_iter_find_descendant(&iter, w->columns[i], &found)) {
+      write_csv_value(w, &found);
+    }
+  }
+  write_out(w, "\r\n", 2);
+}
+
+typedef struct {
+  cli_writer_t *writer;
+  const char *fields;
+} cli_each_t;
+
+static bool write_document(const bson_t *doc, void *user_data) {
+  cli_each_t *each = user_data;
+  cli_writer_t *w = each->writer;
+  bson_render_t render;
+
+  switch (w->format) {
+  case CLI_FORMAT_NDJSON:
+    bson_render_init_json_line(&render, doc);
+    write_render(w, &render);
+    write_out(w, "\n", 1);
+    break;
+  case CLI_FORMAT_JSON:
+    write_out(w, w->count == 0 ? "[\n" : ",\n", 2);
+    bson_render_init_json(&render, doc, CLI_JSON_WIDTH);
+    write_render(w, &render);
+    break;
+  case CLI_FORMAT_CSV:
+    if (w->count == 0) {
+      if (!csv_columns(w, each->fields, doc)) {
+        fprintf(stderr, "mongodb-tui: out of memory\n");
+        w->failed = true;
+        return false;
+      }
+      write_csv_header(w);
+    }
+    write_csv_row(w, doc);
+    break;
+  }
+
+  w->count++;
+  return !w->failed;
+}
+
+// "--name valor" o "--name=valor"; 1 si es esta opción, -1 si le falta
+// el valor, 0 si es otra
+static int take_option(int argc, char *argv[], int *i, const char *name,
+                       const char **value) {
+  const char *arg = argv[*i];
+  size_t length = strlen(name);
+  if (strncmp(arg, name, length) != 0) {
+    return 0;
+  }
+  if (arg[length] == '=') {
+    *value = arg + length + 1;
+    return 1;
+  }
+  if (arg[length] != '\0') {
+    return 0;
+  }
+  if (*i + 1 >= argc) {
+    return -1;
+  }
+  *value = argv[++*i];
+  return 1;
+}
+
+int cli_parse(int argc, char *argv[], cli_options_t *opts) {
+  static const char *names[] = {"--uri",    "--ns",     "--filter", "--sort",
+                                "--fields", "--limit",  "--format"};
+  const char *limit = NULL;
+  const char *format = NULL;
+  const char **slots[] = {&opts->uri,    &opts->ns, &opts->filter, &opts->sort,
+                          &opts->fields, &limit,    &format};
+
+  memset(opts, 0, sizeof(*opts));
+  opts->format = CLI_FORMAT_NDJSON;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+      usage(stdout);
+      return -1;
+    }
+    if (argv[i][0] != '-' && !opts->uri) {
+      opts->uri = argv[i];
+      continue;
+    }
+
+    int matched = 0;
+    for (size_t n = 0; n < sizeof(names) / sizeof(names[0]) && !matched; n++) {
+      matched = take_option(argc, argv, &i, names[n], slots[n]);
+      if (matched < 0) {
+        fprintf(stderr, "mongodb-tui: %s needs a value\n", names[n]);
+        return 2;
+      }
+    }
+    if (!matched) {
+      fprintf(stderr, "mongodb-tui: unknown option '%s'\n", argv[i]);
+      usage(stderr);
+      return 2;
+    }
+  }
+
+  if (limit) {
+    char *end;
+    long n = strtol(limit, &end, 10);
+    if (end == limit || *end != '\0' || n < 0 || n > INT_MAX) {
+      fprintf(stderr, "mongodb-tui: invalid --limit '%s'\n", limit);
+      return 2;
+    }
+    opts->limit = (int)n;
+  }
+
+  if (format) {
+    if (strcmp(format, "ndjson") == 0) {
+      opts->format = CLI_FORMAT_NDJSON;
+    } else if (strcmp(format, "json") == 0) {
+      opts->format = CLI_FORMAT_JSON;
+    } else if (strcmp(format, "csv") == 0) {
+      opts->format = CLI_FORMAT_CSV;
+    } else {
+      fprintf(stderr, "mongodb-tui: unknown --format '%s'\n", format);
+      return 2;
+    }
+  }
+
+  if (opts->fields && opts->format != CLI_FORMAT_CSV) {
+    fprintf(stderr, "mongodb-tui: --fields only applies to --format csv\n");
+    return 2;
+  }
+
+  // en un pipe o en cron no hay terminal para la interfaz
+  opts->batch = format || limit || opts->fields ||
+                (opts->ns && !isatty(STDOUT_FILENO));
+  if (opts->batch && !opts->ns) {
+    fprintf(stderr, "mongodb-tui: --ns is required to write documents\n");
+    return 2;
+  }
+  return 0;
+}
+
+// separar "db.coll"; coll apunta dentro de ns
+static int run_query(const cli_options_t *opts, mongo_context_t *ctx) {
+  const char *uri = opts->uri ? opts->uri : getenv("MONGODB_URI");
+  if (!uri || !*uri) {
+    uri = "mongodb://localhost:27017";
+  }
+
+  char db[256], coll[256];
+  if (!split_namespace(opts->ns, db, sizeof(db), coll, sizeof(coll))) {
+    fprintf(stderr, "mongodb-tui: --ns must be DB.COLLECTION\n");
+    return 2;
+  }
+
+  bson_error_t error;
+  bson_t *filter = NULL;
+  bson_t *sort = NULL;
+  if (opts->filter) {
+    filter = mongo_json_to_bson(opts->filter, &error);
+    if (!filter) {
+      fprintf(stderr, "mongodb-tui: invalid --filter: %s\n", error.message);
+      return 2;
+    }
+  }
+  if (opts->sort) {
+    sort = mongo_parse_sort(opts->sort, &error);
+    if (!sort) {
+      fprintf(stderr, "mongodb-tui: invalid --sort: %s\n", error.message);
+      if (filter) {
+        bson_destroy(filter);
+      }
+      return 2;
+    }
+  }
+
+  int status = 1;
+  cli_writer_t *w = calloc(1, sizeof(cli_writer_t));
+  if (!w) {
+    fprintf(stderr, "mongodb-tui: out of memory\n");
+  } else if (!mongo_connect(ctx, uri)) {
+    fprintf(stderr, "mongodb-tui: %s\n", mongo_get_error(ctx));
+  } else {
+    mongo_find_opts_t find_opts = {.sort = sort};
+    cli_each_t each = {.writer = w, .fields = opts->fields};
+    w->format = opts->format;
+
+    bool ok = mongo_find_each(ctx, db, coll, filter, &find_opts, 0,
+                              opts->limit, write_document, &each);
+    if (opts->format == CLI_FORMAT_JSON) {
+      write_out(w, w->count == 0 ? "[]\n" : "\n]\n", 3);
+    } else if (opts->format == CLI_FORMAT_CSV && w->count == 0 &&
+               opts->fields && csv_columns(w, opts->fields, NULL)) {
+      // sin resultados, el encabezado igual sale si se pidieron columnas
+      write_csv_header(w);
+    }
+    flush_out(w);
+
+    if (!ok) {
+      fprintf(stderr, "mongodb-tui: %s\n", mongo_get_error(ctx));
+    } else if (w->failed || fflush(stdout) != 0) {
+      fprintf(stderr, "mongodb-tui: error writing output\n");
+    } else {
+      status = 0;
+    }
+  }
+
+  if (w) {
+    free_string_array(&w->columns, w->column_count);
+    free(w);
+  }
+  if (sort) {
+    bson_destroy(sort);
+  }
+  if (filter) {
+    bson_destroy(filter);
+  }
+  return status;
+}
+
+int cli_run(const cli_options_t *opts) {
+  mongo_init();
+  mongo_context_t *ctx = mongo_context_new();
+  if (!ctx) {
+    fprintf(stderr, "mongodb-tui: out of memory\n");
+    mongo_cleanup();
+    return 1;
+  }
+
+  int status = run_query(opts, ctx);
+
+  mongo_context_free(ctx);
+  mongo_cleanup();
+  return status;
+}
+
+void cli_startup(const cli_options_t *opts, session_t *start) {
+  session_t saved;
+  bool have_saved = session_load(&saved);
+  memset(start, 0, sizeof(*start));
+
+  const char *uri = opts->uri ? opts->uri : getenv("MONGODB_URI");
+  if (uri && *uri) {
+    safe_strncpy(start->uri, uri, sizeof(start->uri));
+  } else if (have_saved) {
+    safe_strncpy(start->uri, saved.uri, sizeof(start->uri));
+  }
+
+  // lo guardado vale para el mismo servidor (la sesión no tiene contraseña)
+  char server[sizeof(start->uri)];
+  session_strip_password(start->uri, server, sizeof(server));
+  bool same_server = have_saved && strcmp(server, saved.uri) == 0;
+
+  bool have_ns =
+      opts->ns && split_namespace(opts->ns, start->db, sizeof(start->db),
+                                  start->collection, sizeof(start->collection));
+  if (!have_ns && same_server) {
+    *start = saved;
+    safe_strncpy(start->uri, uri && *uri ? uri : saved.uri,
+                 sizeof(start->uri));
+  }
+
+  if (opts->filter) {
+    safe_strncpy(start->filter, opts->filter, sizeof(start->filter));
+    start->position = 0;
+  }
+  if (opts->sort) {
+    safe_strncpy(start->sort, opts->sort, sizeof(start->sort));
+    start->hint[0] = '\0';
+    start->allow_disk = false;
+    start->position = 0;
+  }
+}
@@ -0,0 +1,47 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include "session.h"
+#include <stdbool.h>
+
+// formato de salida del modo batch
+typedef enum {
+  CLI_FORMAT_NDJSON,
+  CLI_FORMAT_JSON,
+  CLI_FORMAT_CSV
+} cli_format_t;
+
+// opciones de la línea de comandos:
+//
+//   mongodb-tui [URI] [--uri URI] [--ns db.coll] [--filter JSON]
+//               [--sort ORDEN] [--limit N] [--format ndjson|json|csv]
+//               [--fields a,b.c]
+//
+// sin --format (ni --limit o --fields) y con la salida en una terminal
+// abre la interfaz en el namespace; si no, corre un find y vuelca el
+// resultado a stdout, para cron y pipes
+typedef struct {
+  const char *uri;
+  const char *ns;
+  const char *filter;
+  const char *sort;
+  const char *fields;
+  int limit;
+  cli_format_t format;
+  bool batch;
+} cli_options_t;
+
+// leer argv; devuelve 0 para seguir, -1 si ya no hay nada que hacer
+// (--help) o el código de salida de un error
+int cli_parse(int argc, char *argv[], cli_options_t *opts);
+
+// modo batch; devuelve el código de salida (0 bien, 1 error, 2 uso
+// incorrecto)
+int cli_run(const cli_options_t *opts);
+
+// dónde arrancar la interfaz: URI de las opciones, de MONGODB_URI o de la
+// última sesión (con el mismo servidor, también su namespace, filtro,
+// orden y posición). start->uri queda vacío si no hay a qué conectar
+void cli_startup(const cli_options_t *opts, session_t *start);
+
+#endif // CLI_H
@@ -0,0 +1,533 @@
+#include "doc_view.h"
+#include "bson_render.h"
+#include "input.h"
+#include "search.h"
+#include "tui.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// texto pretty de un documento, formateado de a tramos
+typedef struct {
+  bson_render_t render;
+  bool done;
+
+  char *text; // con los '\n'
+  size_t length;
+  size_t capacity;
+
+  // inicio de cada línea en text (uint32: 4 bytes por línea)
+  uint32_t *lines;
+  uint32_t line_count;
+  uint32_t line_capacity;
+
+  // tramos de color: offset donde empiezan y su JSON_COLOR_*
+  uint32_t *run_offsets;
+  unsigned char *run_colors;
+  uint32_t run_count;
+  uint32_t run_capacity;
+} doc_text_t;
+
+// búsqueda: las coincidencias se buscan una sola vez, en orden, y se
+// guardan; scanned marca hasta dónde se buscó
+typedef struct {
+  search_pattern_t pattern;
+  bool active;
+  uint32_t *matches;
+  uint32_t count;
+  uint32_t capacity;
+  size_t scanned;
+  int current; // -1 = ninguna
+} doc_search_t;
+
+static bool grow(void **array, uint32_t *capacity, uint32_t needed,
+                 size_t item_size) {
+  if (needed <= *capacity) {
+    return true;
+  }
+  uint32_t new_capacity = *capacity ? *capacity * 2 : 1024;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+  void *grown = realloc(*array, new_capacity * item_size);
+  if (!grown) {
+    return false;
+  }
+  *array = grown;
+  *capacity = new_capacity;
+  return true;
+}
+
+static bool text_append(doc_text_t *t, const char *s, size_t n, int color) {
+  if (t->length + n > t->capacity) {
+    size_t capacity = t->capacity ? t->capacity * 2 : 64 * 1024;
+    while (capacity < t->length + n) {
+      capacity *= 2;
+    }
+    char *grown = realloc(t->text, capacity);
+    if (!grown) {
+      return false;
+    }
+    t->text = grown;
+    t->capacity = capacity;
+  }
+
+  if (t->run_count == 0 || t->run_colors[t->run_count - 1] != color) {
+    if (t->run_count == t->run_capacity) {
+      uint32_t capacity = t->run_capacity ? t->run_capacity * 2 : 1024;
+      uint32_t *offsets = realloc(t->run_offsets, capacity * sizeof(uint32_t));
+      if (!offsets) {
+        return false;
+      }
+      t->run_offsets = offsets;
+      unsigned char *colors = realloc(t->run_colors, capacity);
+      if (!colors) {
+        return false;
+      }
+      t->run_colors = colors;
+      t->run_capacity = capacity;
+    }
+    t->run_offsets[t->run_count] = (uint32_t)t->length;
+    t->run_colors[t->run_count] = (unsigned char)color;
+    t->run_count++;
+  }
+
+  memcpy(t->text + t->length, s, n);
+
+  // indexar los saltos de línea del fragmento
+  const char *p = s;
+  const char *end = s + n;
+  while ((p = memchr(p, '\n', end - p)) != NULL) {
+    p++;
+    if (!grow((void **)&t->lines, &t->line_capacity, t->line_count + 1,
+              sizeof(uint32_t))) {
+      return false;
+    }
+    t->lines[t->line_count++] = (uint32_t)(t->length + (p - s));
+  }
+
+  t->length += n;
+  return true;
+}
+
+static bool text_init(doc_text_t *t, const bson_t *doc, int width) {
+  memset(t, 0, sizeof(*t));
+  bson_render_init_pretty(&t->render, doc, width);
+  if (!grow((void **)&t->lines, &t->line_capacity, 1, sizeof(uint32_t))) {
+    return false;
+  }
+  t->lines[0] = 0;
+  t->line_count = 1;
+  return true;
+}
+
+static void text_free(doc_text_t *t) {
+  free(t->text);
+  free(t->lines);
+  free(t->run_offsets);
+  free(t->run_colors);
+  memset(t, 0, sizeof(*t));
+}
+
+// formatear hasta tener la línea until completa (o terminar)
+static void text_format(doc_text_t *t, uint32_t until) {
+  bson_span_t span;
+  while (!t->done && t->line_count <= until + 1) {
+    if (!bson_render_next(&t->render, &span)) {
+      t->done = true;
+      break;
+    }
+    if (!text_append(t, span.text, span.length, span.color)) {
+      t->done = true; // sin memoria: mostrar lo que hay
+    }
+  }
+}
+
+// un tramo más en segundo plano
+static void text_format_chunk(doc_text_t *t) {
+  text_format(t, t->line_count + DOC_VIEW_CHUNK_LINES);
+}
+
+static void line_range(const doc_text_t *t, uint32_t line, size_t *start,
+                       size_t *end) {
+  *start = t->lines[line];
+  *end = line + 1 < t->line_count ? t->lines[line + 1] - 1 : t->length;
+}
+
+static uint32_t line_of_offset(const doc_text_t *t, size_t offset) {
+  uint32_t lo = 0;
+  uint32_t hi = t->line_count;
+  while (hi - lo > 1) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (t->lines[mid] <= offset) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static uint32_t run_of_offset(const doc_text_t *t, size_t offset) {
+  uint32_t lo = 0;
+  uint32_t hi = t->run_count;
+  while (hi - lo > 1) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (t->run_offsets[mid] <= offset) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// byte que continúa un caracter UTF-8 (no ocupa columna)
+static bool is_continuation(unsigned char c) { return (c & 0xC0) == 0x80; }
+
+// avanzar columns columnas desde pos sin pasar de end
+static size_t skip_columns(const char *text, size_t pos, size_t end,
+                           int columns) {
+  while (pos < end && columns > 0) {
+    pos++;
+    while (pos < end && is_continuation((unsigned char)text[pos])) {
+      pos++;
+    }
+    columns--;
+  }
+  return pos;
+}
+
+static void draw_line(WINDOW *win, const doc_text_t *t,
+                      const doc_search_t *search, uint32_t line, int y, int x,
+                      int width, int hscroll) {
+  size_t start;
+  size_t end;
+  line_range(t, line, &start, &end);
+
+  size_t pos = skip_columns(t->text, start, end, hscroll);
+  size_t stop = skip_columns(t->text, pos, end, width);
+
+  // coincidencias que tocan el tramo visible (se buscan sobre la línea
+  // entera para no cortar una que empieza antes de hscroll)
+  size_t match_start[16];
+  size_t match_end[16];
+  int match_count = 0;
+  if (search->active) {
+    const char *p = t->text + start;
+    const char *m;
+    while (match_count < 16 &&
+           (m = search_find(&search->pattern, p, t->text + stop - p)) !=
+               NULL) {
+      size_t ms = m - t->text;
+      if (ms + search->pattern.length > pos) {
+        match_start[match_count] = ms;
+        match_end[match_count] = ms + search->pattern.length;
+        match_count++;
+      }
+      p = m + search->pattern.length;
+    }
+  }
+
+  wmove(win, y, x);
+  uint32_t r = run_of_offset(t, pos);
+  int m = 0;
+  while (pos < stop) {
+    size_t run_end = r + 1 < t->run_count ? t->run_offsets[r + 1] : t->length;
+    while (m < match_count && match_end[m] <= pos) {
+      m++;
+    }
+
+    bool reverse = m < match_count && match_start[m] <= pos;
+    size_t seg_end = run_end < stop ? run_end : stop;
+    if (reverse && match_end[m] < seg_end) {
+      seg_end = match_end[m];
+    } else if (!reverse && m < match_count && match_start[m] < seg_end) {
+      seg_end = match_start[m];
+    }
+
+    int color = t->run_colors[r];
+    attr_t attr = color ? COLOR_PAIR(color) : A_NORMAL;
+    if (reverse) {
+      attr |= A_REVERSE;
+    }
+    wattron(win, attr);
+    waddnstr(win, t->text + pos, (int)(seg_end - pos));
+    wattroff(win, attr);
+
+    pos = seg_end;
+    if (pos >= run_end) {
+      r++;
+    }
+  }
+}
+
+static void search_reset(doc_search_t *search) {
+  if (search->active) {
+    search_free(&search->pattern);
+  }
+  free(search->matches);
+  memset(search, 0, sizeof(*search));
+  search->current = -1;
+}
+
+// seguir buscando desde donde quedó, formateando más si hace falta,
+// hasta encontrar una coincidencia en from o después; índice o -1
+static int search_forward(doc_text_t *t, doc_search_t *search, size_t from) {
+  // ya encontrada antes (las anteriores a scanned están todas)
+  uint32_t lo = 0;
+  uint32_t hi = search->count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (search->matches[mid] < from) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo < search->count) {
+    return (int)lo;
+  }
+
+  size_t overlap = search->pattern.length - 1;
+  while (true) {
+    const char *p = t->text + search->scanned;
+    const char *m;
+    int found = -1;
+    while ((m = search_find(&search->pattern, p, t->text + t->length - p)) !=
+           NULL) {
+      if (!grow((void **)&search->matches, &search->capacity,
+                search->count + 1, sizeof(uint32_t))) {
+        return found;
+      }
+      search->matches[search->count] = (uint32_t)(m - t->text);
+      if (found < 0 && (size_t)(m - t->text) >= from) {
+        found = (int)search->count;
+      }
+      search->count++;
+      p = m + search->pattern.length;
+      if (found >= 0) {
+        break;
+      }
+    }
+
+    if (found >= 0) {
+      search->scanned = p - t->text;
+      return found;
+    }
+
+    // lo que queda sin buscar puede ser el principio de una coincidencia
+    // que sigue en el próximo tramo
+    size_t scanned = t->length > overlap ? t->length - overlap : 0;
+    search->scanned = scanned > (size_t)(p - t->text) ? scanned
+                                                      : (size_t)(p - t->text);
+    if (t->done) {
+      return -1;
+    }
+    text_format_chunk(t);
+  }
+}
+
+void doc_view_show(const bson_t *doc, const char *title) {
+  if (!doc) {
+    return;
+  }
+
+  doc_text_t text;
+  if (!text_init(&text, doc, COLS - 4)) {
+    text_free(&text);
+    return;
+  }
+  doc_search_t search;
+  memset(&search, 0, sizeof(search));
+  search.current = -1;
+
+  WINDOW *win = newwin(LINES, COLS, 0, 0);
+  keypad(win, TRUE);
+
+  int visible = LINES - 5;
+  if (visible < 1) {
+    visible = 1;
+  }
+  int width = COLS - 4;
+  uint32_t top = 0;
+  int hscroll = 0;
+  char message[128] = "";
+  bool running = true;
+
+  while (running) {
+    // lo que hace falta para esta pantalla; el resto, de a tramos
+    text_format(&text, top + (uint32_t)visible);
+
+    werase(win);
+    tui_draw_box(win, title);
+    tui_draw_status(win, "UP/DOWN/PgUp/PgDn: Scroll | LEFT/RIGHT: Pan | L: "
+                         "Go to line | /: Search, n/N | B/ESC: Back");
+    if (text.done) {
+      mvwprintw(win, 1, 2, "Line %u/%u | %u bytes", top + 1, text.line_count,
+                (unsigned)doc->len);
+    } else {
+      mvwprintw(win, 1, 2, "Line %u/%u+ | %u bytes | formatting %zu KB...",
+                top + 1, text.line_count, (unsigned)doc->len,
+                text.length / 1024);
+    }
+    if (search.active) {
+      wprintw(win, " | Match %d/%u%s", search.current + 1, search.count,
+              search.scanned < text.length || !text.done ? "+" : "");
+    }
+    if (message[0]) {
+      wprintw(win, " | %s", message);
+    }
+    tui_draw_hline(win, 2, 1, COLS - 2);
+
+    for (int i = 0; i < visible && top + (uint32_t)i < text.line_count; i++) {
+      draw_line(win, &text, &search, top + (uint32_t)i, 3 + i, 2, width,
+                hscroll);
+    }
+    wrefresh(win);
+
+    // mientras quede por formatear, no bloquear: un tramo por vuelta
+    wtimeout(win, text.done ? -1 : 0);
+    int ch = wgetch(win);
+    if (ch == ERR) {
+      text_format_chunk(&text);
+      continue;
+    }
+    message[0] = '\0';
+
+    bool jumped = false;
+    uint32_t last = text.line_count - 1;
+    switch (ch) {
+    case KEY_UP:
+    case 450:
+      if (top > 0) {
+        top--;
+      }
+      break;
+    case KEY_DOWN:
+    case 456:
+      if (top < last) {
+        top++;
+      }
+      break;
+    case KEY_PPAGE:
+    case 451:
+      top = top > (uint32_t)visible ? top - (uint32_t)visible : 0;
+      break;
+    case KEY_NPAGE:
+    case 457:
+      top += (uint32_t)visible;
+      text_format(&text, top);
+      if (top > text.line_count - 1) {
+        top = text.line_count - 1;
+      }
+      break;
+    case KEY_HOME:
+    case 'g':
+      top = 0;
+      hscroll = 0;
+      break;
+    case KEY_END:
+    case 'G':
+      text_format(&text, UINT32_MAX - 1);
+      top = text.line_count > (uint32_t)visible
+                ? text.line_count - (uint32_t)visible
+                : 0;
+      break;
+    case KEY_LEFT:
+    case 452:
+      hscroll = hscroll > width / 2 ? hscroll - width / 2 : 0;
+      break;
+    case KEY_RIGHT:
+    case 454:
+      hscroll += width / 2;
+      break;
+    case 'l':
+    case 'L':
+    case ':': {
+      char number[32] = "";
+      if (input_text_single("Go to line", "Line:", number, sizeof(number),
+                            "Line number of the formatted document")) {
+        long target = strtol(number, NULL, 10);
+        if (target > 0) {
+          text_format(&text, (uint32_t)(target - 1));
+          top = (uint32_t)target - 1 < text.line_count
+                    ? (uint32_t)target - 1
+                    : text.line_count - 1;
+          if ((uint32_t)target > text.line_count) {
+            snprintf(message, sizeof(message), "Only %u lines",
+                     text.line_count);
+          }
+        }
+      }
+      break;
+    }
+    case '/': {
+      char needle[256] = "";
+      if (!input_text_single("Search", "Text:", needle, sizeof(needle),
+                             "Search the document (lowercase = ignore "
+                             "case)")) {
+        break;
+      }
+      search_reset(&search);
+      if (needle[0] == '\0' ||
+          !search_compile(&search.pattern, needle, true)) {
+        break;
+      }
+      search.active = true;
+      search.current = search_forward(&text, &search, text.lines[top]);
+      if (search.current < 0 && search.count > 0) {
+        search.current = 0; // sólo antes: volver al principio
+      }
+      if (search.current < 0) {
+        snprintf(message, sizeof(message), "Not found");
+      }
+      jumped = search.current >= 0;
+      break;
+    }
+    case 'n':
+    case 'N':
+      if (!search.active || (search.count == 0 && search.current < 0)) {
+        break;
+      }
+      if (ch == 'n') {
+        size_t from = search.current >= 0
+                          ? search.matches[search.current] + 1
+                          : text.lines[top];
+        int next = search_forward(&text, &search, from);
+        search.current = next >= 0 ? next : 0; // al final, la primera
+      } else if (search.current > 0) {
+        // las anteriores ya se encontraron al pasar por ellas
+        search.current--;
+      } else {
+        // dar la vuelta: hace falta la última, buscar hasta el final
+        search_forward(&text, &search, (size_t)-1);
+        search.current = (int)search.count - 1;
+      }
+      jumped = search.count > 0;
+      break;
+    case 27:
+    case 'b':
+    case 'B':
+    case 'q':
+    case 'Q':
+      running = false;
+      break;
+    default:
+      break;
+    }
+
+    // dejar la coincidencia actual un poco abajo del borde
+    if (jumped) {
+      top = line_of_offset(&text, search.matches[search.current]);
+      top = top > 2 ? top - 2 : 0;
+      hscroll = 0;
+    }
+  }
+
+  search_reset(&search);
+  text_free(&text);
+  delwin(win);
+  touchwin(stdscr);
+  refresh();
+}
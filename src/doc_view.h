@@ -0,0 +1,15 @@
+#ifndef DOC_VIEW_H
+#define DOC_VIEW_H
+
+#include <mongoc/mongoc.h>
+
+// líneas que se formatean por tramo antes de volver a mirar el teclado
+#define DOC_VIEW_CHUNK_LINES 4096
+
+// mostrar un documento a pantalla completa con formato pretty (modal).
+// el texto se arma de a tramos y se indexa por línea a medida que avanza:
+// la primera pantalla aparece enseguida aunque el documento pese 16MB, e
+// ir a una línea o buscar sigue desde lo ya formateado
+void doc_view_show(const bson_t *doc, const char *title);
+
+#endif // DOC_VIEW_H
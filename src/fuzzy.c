@@ -0,0 +1,276 @@
+#include "fuzzy.h"
+#include "utils.h"
+#include <ctype.h>
+#include <mongoc/mongoc.h>
+#include <stdlib.h>
+#include <string.h>
+
+// cada cuántos candidatos se mira el reloj
+#define FUZZY_CLOCK_EVERY 256
+
+// puntaje de cada letra encontrada y extras
+#define SCORE_MATCH 16
+#define SCORE_CONSECUTIVE 12
+#define SCORE_BOUNDARY 8
+#define SCORE_PREFIX 8
+#define SCORE_EXACT 20
+#define GAP_OPEN 3
+#define GAP_PENALTY_MAX 10
+
+// para ordenar por largo, los nombres más largos que esto van juntos
+#define LENGTH_BUCKETS 256
+
+bool fuzzy_index_build(fuzzy_index_t *index, char *const *names, int count) {
+  memset(index, 0, sizeof(*index));
+
+  index->lower = pack_string_array((const char *const *)names, count);
+  index->length = malloc((count > 0 ? count : 1) * sizeof(int));
+  if (!index->lower || !index->length) {
+    fuzzy_index_free(index);
+    return false;
+  }
+
+  for (int i = 0; i < count; i++) {
+    char *p = index->lower[i];
+    for (; *p; p++) {
+      *p = (char)tolower((unsigned char)*p);
+    }
+    index->length[i] = (int)(p - index->lower[i]);
+  }
+  index->count = count;
+  return true;
+}
+
+void fuzzy_index_free(fuzzy_index_t *index) {
+  free(index->lower);
+  free(index->length);
+  memset(index, 0, sizeof(*index));
+}
+
+void fuzzy_lower(const char *text, char *out, int size) {
+  int i = 0;
+  for (; text[i] && i < size - 1; i++) {
+    out[i] = (char)tolower((unsigned char)text[i]);
+  }
+  out[i] = '\0';
+}
+
+static bool is_boundary(const char *text, int i) {
+  if (i == 0) {
+    return true;
+  }
+  switch (text[i - 1]) {
+  case '_':
+  case '-':
+  case '.':
+  case '/':
+  case ':':
+  case ' ':
+    return true;
+  default:
+    return isdigit((unsigned char)text[i - 1]) &&
+           !isdigit((unsigned char)text[i]);
+  }
+}
+
+int fuzzy_match(const char *pattern, const char *text, int *positions) {
+  int plen = (int)strlen(pattern);
+  if (plen == 0) {
+    return 0;
+  }
+
+  // dónde termina la primera aparición como subsecuencia
+  int p = 0;
+  int end = -1;
+  for (int t = 0; text[t]; t++) {
+    if (text[t] == pattern[p] && ++p == plen) {
+      end = t;
+      break;
+    }
+  }
+  if (end < 0) {
+    return -1;
+  }
+
+  // y de ahí para atrás la ventana más corta que la contiene
+  int start = end;
+  for (p = plen - 1; start >= 0; start--) {
+    if (text[start] == pattern[p] && --p < 0) {
+      break;
+    }
+  }
+
+  int score = 0;
+  int prev = -1;
+  p = 0;
+  for (int t = start; p < plen; t++) {
+    if (text[t] != pattern[p]) {
+      continue;
+    }
+    score += SCORE_MATCH;
+    if (prev >= 0 && t == prev + 1) {
+      score += SCORE_CONSECUTIVE;
+    } else if (prev >= 0) {
+      int gap = GAP_OPEN + t - prev - 1;
+      score -= gap < GAP_PENALTY_MAX ? gap : GAP_PENALTY_MAX;
+    }
+    if (is_boundary(text, t)) {
+      score += t == 0 ? SCORE_BOUNDARY + SCORE_PREFIX : SCORE_BOUNDARY;
+    }
+    if (positions) {
+      positions[p] = t;
+    }
+    prev = t;
+    p++;
+  }
+  if (start == 0 && end == plen - 1 && text[end + 1] == '\0') {
+    score += SCORE_EXACT;
+  }
+  return score;
+}
+
+bool fuzzy_filter_init(fuzzy_filter_t *filter, const fuzzy_index_t *index) {
+  memset(filter, 0, sizeof(*filter));
+  filter->index = index;
+
+  int n = index->count > 0 ? index->count : 1;
+  filter->candidates = malloc(n * sizeof(int));
+  filter->found = malloc(n * sizeof(fuzzy_hit_t));
+  filter->sorted = malloc(n * sizeof(fuzzy_hit_t));
+  filter->scratch = malloc(n * sizeof(fuzzy_hit_t));
+  filter->order = malloc(n * sizeof(int));
+  if (!filter->candidates || !filter->found || !filter->sorted ||
+      !filter->scratch || !filter->order) {
+    fuzzy_filter_free(filter);
+    return false;
+  }
+
+  for (int i = 0; i < index->count; i++) {
+    filter->order[i] = i;
+  }
+  filter->order_count = index->count;
+  filter->done = true;
+  return true;
+}
+
+void fuzzy_filter_free(fuzzy_filter_t *filter) {
+  free(filter->candidates);
+  free(filter->found);
+  free(filter->sorted);
+  free(filter->scratch);
+  free(filter->order);
+  memset(filter, 0, sizeof(*filter));
+}
+
+void fuzzy_filter_set(fuzzy_filter_t *filter, const char *pattern) {
+  char lower[FUZZY_PATTERN_MAX];
+  fuzzy_lower(pattern, lower, sizeof(lower));
+  if (strcmp(lower, filter->pattern) == 0) {
+    return;
+  }
+
+  // lo que no coincidía con "ab" tampoco coincide con "abc"
+  size_t old_len = strlen(filter->pattern);
+  bool narrower =
+      old_len > 0 && strncmp(lower, filter->pattern, old_len) == 0;
+  if (narrower && filter->done) {
+    for (int i = 0; i < filter->found_count; i++) {
+      filter->candidates[i] = filter->found[i].index;
+    }
+    filter->candidate_count = filter->found_count;
+  } else if (!narrower) {
+    for (int i = 0; i < filter->index->count; i++) {
+      filter->candidates[i] = i;
+    }
+    filter->candidate_count = filter->index->count;
+  }
+  // (más estrecho que una pasada a medias: sus candidatos siguen sirviendo)
+
+  safe_strncpy(filter->pattern, lower, sizeof(filter->pattern));
+  filter->next = 0;
+  filter->found_count = 0;
+  filter->done = false;
+}
+
+// ordenar de a buckets (estable, lineal): con decenas de miles de
+// resultados un qsort no entra en un cuadro
+static bool sort_by(const fuzzy_hit_t *in, fuzzy_hit_t *out, int count,
+                    bool by_score, int buckets) {
+  int *start = calloc(buckets + 1, sizeof(int));
+  if (!start) {
+    return false;
+  }
+
+  // mayor puntaje primero; a igual puntaje, el nombre más corto
+  for (int i = 0; i < count; i++) {
+    int key = by_score ? buckets - 1 - in[i].score
+                       : (in[i].length < buckets ? in[i].length : buckets - 1);
+    start[key + 1]++;
+  }
+  for (int k = 0; k < buckets; k++) {
+    start[k + 1] += start[k];
+  }
+  for (int i = 0; i < count; i++) {
+    int key = by_score ? buckets - 1 - in[i].score
+                       : (in[i].length < buckets ? in[i].length : buckets - 1);
+    out[start[key]++] = in[i];
+  }
+
+  free(start);
+  return true;
+}
+
+// resultado en el orden del índice -> sorted, del mejor al peor
+static void rank_hits(fuzzy_filter_t *filter) {
+  int count = filter->found_count;
+  int max_score = 0;
+  for (int i = 0; i < count; i++) {
+    if (filter->found[i].score > max_score) {
+      max_score = filter->found[i].score;
+    }
+  }
+
+  if (!sort_by(filter->found, filter->scratch, count, false, LENGTH_BUCKETS) ||
+      !sort_by(filter->scratch, filter->sorted, count, true, max_score + 1)) {
+    // sin memoria para los buckets: en el orden de la lista
+    memcpy(filter->sorted, filter->found, count * sizeof(fuzzy_hit_t));
+  }
+}
+
+bool fuzzy_filter_step(fuzzy_filter_t *filter, int64_t budget_us) {
+  if (filter->done) {
+    return true;
+  }
+
+  const fuzzy_index_t *index = filter->index;
+  int64_t deadline = bson_get_monotonic_time() + budget_us;
+  while (filter->next < filter->candidate_count) {
+    int i = filter->candidates[filter->next++];
+    int score = fuzzy_match(filter->pattern, index->lower[i], NULL);
+    if (score >= 0) {
+      fuzzy_hit_t *hit = &filter->found[filter->found_count++];
+      hit->index = i;
+      hit->score = score;
+      hit->length = index->length[i];
+    }
+    if (filter->next % FUZZY_CLOCK_EVERY == 0 &&
+        bson_get_monotonic_time() >= deadline) {
+      return false;
+    }
+  }
+
+  // sin patrón se deja el orden de la lista
+  if (filter->pattern[0] != '\0') {
+    rank_hits(filter);
+    for (int i = 0; i < filter->found_count; i++) {
+      filter->order[i] = filter->sorted[i].index;
+    }
+  } else {
+    for (int i = 0; i < filter->found_count; i++) {
+      filter->order[i] = filter->found[i].index;
+    }
+  }
+  filter->order_count = filter->found_count;
+  filter->done = true;
+  return true;
+}
@@ -0,0 +1,70 @@
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// largo máximo del texto a filtrar
+#define FUZZY_PATTERN_MAX 128
+
+// nombres en minúsculas, hechos una vez por lista (no en cada tecla)
+typedef struct {
+  char **lower; // un solo bloque (pack_string_array)
+  int *length;
+  int count;
+} fuzzy_index_t;
+
+bool fuzzy_index_build(fuzzy_index_t *index, char *const *names, int count);
+void fuzzy_index_free(fuzzy_index_t *index);
+
+// puntaje de pattern como subsecuencia de text (los dos en minúsculas):
+// más por letras seguidas y por empezar palabras (inicio, después de
+// '_', '-', '.', ...). -1 si no aparece. positions (si no es NULL) recibe
+// dónde quedó cada letra del patrón
+int fuzzy_match(const char *pattern, const char *text, int *positions);
+
+// copia de text en minúsculas (cortada a size)
+void fuzzy_lower(const char *text, char *out, int size);
+
+typedef struct {
+  int index;
+  int score;
+  int length;
+} fuzzy_hit_t;
+
+// filtro incremental sobre un índice: cada tecla cambia el patrón y el
+// trabajo se hace de a pedazos (fuzzy_filter_step) para no trabar la
+// pantalla. si el patrón nuevo extiende al anterior sólo se revisa lo
+// que ya coincidía
+typedef struct {
+  const fuzzy_index_t *index;
+  char pattern[FUZZY_PATTERN_MAX];
+  bool done;
+
+  // pasada en curso
+  int *candidates;
+  int candidate_count;
+  int next;
+  fuzzy_hit_t *found; // en el orden del índice
+  int found_count;
+
+  // último resultado terminado, del mejor al peor
+  fuzzy_hit_t *sorted;
+  fuzzy_hit_t *scratch;
+  int *order;
+  int order_count;
+} fuzzy_filter_t;
+
+// false si no hay memoria; con patrón vacío order es toda la lista
+bool fuzzy_filter_init(fuzzy_filter_t *filter, const fuzzy_index_t *index);
+void fuzzy_filter_free(fuzzy_filter_t *filter);
+
+// cambiar el patrón (se guarda en minúsculas); order no cambia hasta que
+// termine la pasada
+void fuzzy_filter_set(fuzzy_filter_t *filter, const char *pattern);
+
+// avanzar la pasada hasta budget_us microsegundos; true si terminó (order
+// tiene el resultado nuevo)
+bool fuzzy_filter_step(fuzzy_filter_t *filter, int64_t budget_us);
+
+#endif // FUZZY_H
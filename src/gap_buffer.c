@@ -0,0 +1,241 @@
+#include "gap_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define GAP_MIN 4096
+#define LINE_GAP_MIN 256
+
+static size_t gap_size(const gap_buffer_t *gb) {
+  return gb->gap_end - gb->gap_start;
+}
+
+static size_t line_gap_size(const gap_buffer_t *gb) {
+  return gb->line_gap_end - gb->line_gap_start;
+}
+
+bool gap_buffer_init(gap_buffer_t *gb, const char *text) {
+  memset(gb, 0, sizeof(*gb));
+  size_t length = text ? strlen(text) : 0;
+
+  gb->capacity = length + GAP_MIN;
+  gb->data = malloc(gb->capacity);
+
+  // un inicio por línea; todas quedan detrás del cursor (al principio)
+  size_t line_count = 1;
+  for (size_t i = 0; i < length; i++) {
+    if (text[i] == '\n') {
+      line_count++;
+    }
+  }
+  gb->line_capacity = line_count + LINE_GAP_MIN;
+  gb->lines = malloc(gb->line_capacity * sizeof(size_t));
+
+  if (!gb->data || !gb->lines) {
+    gap_buffer_free(gb);
+    return false;
+  }
+
+  // texto al final, hueco al principio
+  gb->gap_start = 0;
+  gb->gap_end = gb->capacity - length;
+  if (length > 0) {
+    memcpy(gb->data + gb->gap_end, text, length);
+  }
+
+  gb->lines[0] = 0;
+  gb->line_gap_start = 1;
+  gb->line_gap_end = gb->line_capacity;
+  for (size_t i = length; i > 0; i--) {
+    if (text[i - 1] == '\n') {
+      gb->lines[--gb->line_gap_end] = length - i;
+    }
+  }
+  return true;
+}
+
+void gap_buffer_free(gap_buffer_t *gb) {
+  free(gb->data);
+  free(gb->lines);
+  memset(gb, 0, sizeof(*gb));
+}
+
+size_t gap_buffer_length(const gap_buffer_t *gb) {
+  return gb->capacity - gap_size(gb);
+}
+
+size_t gap_buffer_cursor(const gap_buffer_t *gb) { return gb->gap_start; }
+
+char gap_buffer_char_at(const gap_buffer_t *gb, size_t pos) {
+  return pos < gb->gap_start ? gb->data[pos] : gb->data[pos + gap_size(gb)];
+}
+
+size_t gap_buffer_line_count(const gap_buffer_t *gb) {
+  return gb->line_capacity - line_gap_size(gb);
+}
+
+size_t gap_buffer_line_start(const gap_buffer_t *gb, size_t line) {
+  if (line < gb->line_gap_start) {
+    return gb->lines[line];
+  }
+  return gap_buffer_length(gb) - gb->lines[line + line_gap_size(gb)];
+}
+
+size_t gap_buffer_line_length(const gap_buffer_t *gb, size_t line) {
+  size_t start = gap_buffer_line_start(gb, line);
+  size_t end = line + 1 < gap_buffer_line_count(gb)
+                   ? gap_buffer_line_start(gb, line + 1) - 1
+                   : gap_buffer_length(gb);
+  return end - start;
+}
+
+size_t gap_buffer_cursor_line(const gap_buffer_t *gb) {
+  return gb->line_gap_start - 1;
+}
+
+void gap_buffer_move(gap_buffer_t *gb, size_t pos) {
+  size_t length = gap_buffer_length(gb);
+  if (pos > length) {
+    pos = length;
+  }
+
+  if (pos < gb->gap_start) {
+    // el texto entre pos y el cursor pasa al otro lado del hueco
+    size_t n = gb->gap_start - pos;
+    memmove(gb->data + gb->gap_end - n, gb->data + pos, n);
+    gb->gap_start = pos;
+    gb->gap_end -= n;
+    // líneas que empiezan después del cursor nuevo: a relativas al final
+    while (gb->line_gap_start > 1 &&
+           gb->lines[gb->line_gap_start - 1] > pos) {
+      gb->lines[--gb->line_gap_end] =
+          length - gb->lines[--gb->line_gap_start];
+    }
+  } else if (pos > gb->gap_start) {
+    size_t n = pos - gb->gap_start;
+    memmove(gb->data + gb->gap_start, gb->data + gb->gap_end, n);
+    gb->gap_start = pos;
+    gb->gap_end += n;
+    while (gb->line_gap_end < gb->line_capacity &&
+           length - gb->lines[gb->line_gap_end] <= pos) {
+      gb->lines[gb->line_gap_start++] =
+          length - gb->lines[gb->line_gap_end++];
+    }
+  }
+}
+
+static bool ensure_gap(gap_buffer_t *gb, size_t needed) {
+  if (gap_size(gb) >= needed) {
+    return true;
+  }
+
+  size_t after = gb->capacity - gb->gap_end;
+  size_t capacity = gb->capacity * 2 + needed;
+  char *data = realloc(gb->data, capacity);
+  if (!data) {
+    return false;
+  }
+  memmove(data + capacity - after, data + gb->gap_end, after);
+  gb->data = data;
+  gb->gap_end = capacity - after;
+  gb->capacity = capacity;
+  return true;
+}
+
+static bool ensure_line_gap(gap_buffer_t *gb) {
+  if (line_gap_size(gb) > 0) {
+    return true;
+  }
+
+  size_t after = gb->line_capacity - gb->line_gap_end;
+  size_t capacity = gb->line_capacity * 2 + LINE_GAP_MIN;
+  size_t *lines = realloc(gb->lines, capacity * sizeof(size_t));
+  if (!lines) {
+    return false;
+  }
+  memmove(lines + capacity - after, lines + gb->line_gap_end,
+          after * sizeof(size_t));
+  gb->lines = lines;
+  gb->line_gap_end = capacity - after;
+  gb->line_capacity = capacity;
+  return true;
+}
+
+bool gap_buffer_insert(gap_buffer_t *gb, const char *text, size_t length) {
+  if (!ensure_gap(gb, length)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    gb->data[gb->gap_start++] = text[i];
+    if (text[i] == '\n') {
+      if (!ensure_line_gap(gb)) {
+        gb->gap_start--;
+        return false;
+      }
+      gb->lines[gb->line_gap_start++] = gb->gap_start;
+    }
+  }
+  return true;
+}
+
+bool gap_buffer_delete_before(gap_buffer_t *gb) {
+  if (gb->gap_start == 0) {
+    return false;
+  }
+
+  gb->gap_start--;
+  if (gb->data[gb->gap_start] == '\n') {
+    gb->line_gap_start--; // la línea del cursor se une a la anterior
+  }
+  return true;
+}
+
+bool gap_buffer_delete_after(gap_buffer_t *gb) {
+  if (gb->gap_end == gb->capacity) {
+    return false;
+  }
+
+  if (gb->data[gb->gap_end] == '\n') {
+    gb->line_gap_end++; // la línea siguiente se une a la del cursor
+  }
+  gb->gap_end++;
+  return true;
+}
+
+size_t gap_buffer_copy(const gap_buffer_t *gb, size_t pos, size_t length,
+                       char *out) {
+  size_t total = gap_buffer_length(gb);
+  if (pos >= total) {
+    return 0;
+  }
+  if (length > total - pos) {
+    length = total - pos;
+  }
+
+  size_t copied = 0;
+  if (pos < gb->gap_start) {
+    size_t n = gb->gap_start - pos;
+    if (n > length) {
+      n = length;
+    }
+    memcpy(out, gb->data + pos, n);
+    copied = n;
+    pos += n;
+  }
+  if (copied < length) {
+    memcpy(out + copied, gb->data + pos + gap_size(gb), length - copied);
+    copied = length;
+  }
+  return copied;
+}
+
+char *gap_buffer_text(const gap_buffer_t *gb) {
+  size_t length = gap_buffer_length(gb);
+  char *text = malloc(length + 1);
+  if (!text) {
+    return NULL;
+  }
+  gap_buffer_copy(gb, 0, length, text);
+  text[length] = '\0';
+  return text;
+}
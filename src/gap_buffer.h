@@ -0,0 +1,62 @@
+#ifndef GAP_BUFFER_H
+#define GAP_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// texto editable con el hueco en el cursor: insertar y borrar ahí es O(1)
+// y mover el cursor cuesta lo que se mueve. los inicios de línea se
+// mantienen con la misma idea: las líneas hasta la del cursor guardan su
+// posición y las siguientes su distancia al final del texto, así que
+// editar no obliga a corregir las de abajo
+typedef struct {
+  char *data;
+  size_t capacity;
+  size_t gap_start; // = posición del cursor
+  size_t gap_end;
+
+  size_t *lines; // [0, line_gap_start) absolutas; [line_gap_end, ...) al final
+  size_t line_capacity;
+  size_t line_gap_start; // = línea del cursor + 1
+  size_t line_gap_end;
+} gap_buffer_t;
+
+// inicializar con texto (puede ser NULL)
+bool gap_buffer_init(gap_buffer_t *gb, const char *text);
+
+// liberar
+void gap_buffer_free(gap_buffer_t *gb);
+
+// largo del texto
+size_t gap_buffer_length(const gap_buffer_t *gb);
+
+// posición del cursor
+size_t gap_buffer_cursor(const gap_buffer_t *gb);
+
+// mover el cursor (se limita al largo)
+void gap_buffer_move(gap_buffer_t *gb, size_t pos);
+
+// insertar en el cursor; el cursor queda después de lo insertado
+bool gap_buffer_insert(gap_buffer_t *gb, const char *text, size_t length);
+
+// borrar el caracter antes / después del cursor; false si no hay
+bool gap_buffer_delete_before(gap_buffer_t *gb);
+bool gap_buffer_delete_after(gap_buffer_t *gb);
+
+// caracter en pos (pos < largo)
+char gap_buffer_char_at(const gap_buffer_t *gb, size_t pos);
+
+// copiar hasta length bytes desde pos; devuelve cuántos copió
+size_t gap_buffer_copy(const gap_buffer_t *gb, size_t pos, size_t length,
+                       char *out);
+
+// líneas: cantidad, inicio, largo (sin el '\n') y la del cursor
+size_t gap_buffer_line_count(const gap_buffer_t *gb);
+size_t gap_buffer_line_start(const gap_buffer_t *gb, size_t line);
+size_t gap_buffer_line_length(const gap_buffer_t *gb, size_t line);
+size_t gap_buffer_cursor_line(const gap_buffer_t *gb);
+
+// texto completo terminado en '\0' (liberar con free)
+char *gap_buffer_text(const gap_buffer_t *gb);
+
+#endif // GAP_BUFFER_H
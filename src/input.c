@@ -1,7 +1,11 @@
 #include "input.h"
+#include "gap_buffer.h"
+#include "json_display.h"
+#include "json_lex.h"
 #include "tui.h"
 #include "utils.h"
 #include <ctype.h>
+#include <stdio.h>
 #include <string.h>
 
 
@@ -71,77 +75,177 @@ bool input_get_string(WINDOW *win, int y, int x, char *buffer, int max_length,
   return true;
 }
 
-// redibujar buffer y posicionar cursor
-static void redraw_buffer(WINDOW *win, int start_y, int start_x, int height,
-                          int width, const char *buffer, int pos) {
-  // limpiar área de input
-  for (int i = 0; i < height; i++) {
-    mvwhline(win, start_y + i, start_x, ' ', width);
-  }
+// estado del editor multilínea: el texto vive en un gap buffer y la
+// pantalla muestra [top, top + height) líneas desde la columna left
+typedef struct {
+  WINDOW *win;
+  int y, x, height, width;
+  gap_buffer_t gb;
+  size_t top;
+  size_t left;
+  size_t goal; // columna a la que vuelven UP/DOWN
+  json_lex_t *lex; // validación y colores (NULL: texto plano)
+} editor_t;
+
+static size_t editor_column(const editor_t *ed) {
+  size_t line = gap_buffer_cursor_line(&ed->gb);
+  return gap_buffer_cursor(&ed->gb) - gap_buffer_line_start(&ed->gb, line);
+}
 
-  // redibujar contenido
-  int l = 0, c = 0;
-  int buffer_len = strlen(buffer);
-  for (int i = 0; i < buffer_len && l < height; i++) {
-    if (buffer[i] == '\n') {
-      l++;
-      c = 0;
-    } else {
-      mvwaddch(win, start_y + l, start_x + c, buffer[i]);
-      c++;
-      if (c >= width) {
-        l++;
-        c = 0;
-      }
+// dibujar una línea con los colores del lexer; los errores van en rojo
+// invertido
+static void editor_draw_json_row(editor_t *ed, int row, size_t line) {
+  json_lex_run(ed->lex, &ed->gb, line, 0);
+
+  const char *text;
+  const uint8_t *colors;
+  size_t length = json_lex_colorize(ed->lex, &ed->gb, line, &text, &colors);
+
+  wmove(ed->win, ed->y + row, ed->x);
+  for (size_t i = ed->left; i < length && i < ed->left + ed->width; i++) {
+    chtype attr = COLOR_PAIR(colors[i] & ~JSON_LEX_ERROR);
+    if (colors[i] & JSON_LEX_ERROR) {
+      attr = COLOR_PAIR(JSON_COLOR_NULL) | A_REVERSE;
     }
+    waddch(ed->win, (unsigned char)text[i] | attr);
   }
+}
 
-  // calcular posición del cursor
-  int line = 0, col = 0;
-  for (int i = 0; i < pos; i++) {
-    if (buffer[i] == '\n') {
-      line++;
-      col = 0;
-    } else {
-      col++;
-      if (col >= width) {
-        line++;
-        col = 0;
-      }
+// dibujar una fila del área (vacía si no hay línea)
+static void editor_draw_row(editor_t *ed, int row) {
+  char text[512];
+  size_t line = ed->top + row;
+
+  mvwhline(ed->win, ed->y + row, ed->x, ' ', ed->width);
+  if (line >= gap_buffer_line_count(&ed->gb)) {
+    return;
+  }
+
+  if (ed->lex) {
+    editor_draw_json_row(ed, row, line);
+    return;
+  }
+
+  size_t length = gap_buffer_line_length(&ed->gb, line);
+  if (length <= ed->left) {
+    return;
+  }
+  size_t n = length - ed->left;
+  if (n > (size_t)ed->width) {
+    n = ed->width;
+  }
+  if (n > sizeof(text)) {
+    n = sizeof(text);
+  }
+  gap_buffer_copy(&ed->gb, gap_buffer_line_start(&ed->gb, line) + ed->left,
+                  n, text);
+  mvwaddnstr(ed->win, ed->y + row, ed->x, text, (int)n);
+}
+
+// redibujar desde la fila from hasta el final del área
+static void editor_draw_rows(editor_t *ed, int from) {
+  for (int row = from < 0 ? 0 : from; row < ed->height; row++) {
+    editor_draw_row(ed, row);
+  }
+}
+
+// mover la vista para que el cursor quede adentro; true si se movió
+static bool editor_follow_cursor(editor_t *ed) {
+  size_t line = gap_buffer_cursor_line(&ed->gb);
+  size_t col = editor_column(ed);
+  bool moved = false;
+
+  if (line < ed->top) {
+    ed->top = line;
+    moved = true;
+  } else if (line >= ed->top + ed->height) {
+    ed->top = line - ed->height + 1;
+    moved = true;
+  }
+  if (col < ed->left) {
+    ed->left = col;
+    moved = true;
+  } else if (col >= ed->left + ed->width) {
+    ed->left = col - ed->width + 1;
+    moved = true;
+  }
+  return moved;
+}
+
+// poner el cursor en line, lo más cerca posible de la columna col
+static void editor_goto(editor_t *ed, size_t line, size_t col) {
+  size_t count = gap_buffer_line_count(&ed->gb);
+  if (line >= count) {
+    line = count - 1;
+  }
+  size_t length = gap_buffer_line_length(&ed->gb, line);
+  gap_buffer_move(&ed->gb,
+                  gap_buffer_line_start(&ed->gb, line) +
+                      (col < length ? col : length));
+}
+
+// posición del cursor (y el primer error de JSON, si hay) a la derecha de
+// la fila debajo del área, en los dos tercios derechos del ancho
+static void editor_draw_status(editor_t *ed) {
+  char position[48];
+  snprintf(position, sizeof(position), "  Ln %zu, Col %zu",
+           gap_buffer_cursor_line(&ed->gb) + 1, editor_column(ed) + 1);
+  int field = ed->width * 2 / 3;
+  int len = (int)strlen(position);
+  int y = ed->y + ed->height;
+  int x = ed->x + ed->width - field;
+
+  mvwhline(ed->win, y, x, ' ', field);
+  mvwaddstr(ed->win, y, ed->x + ed->width - len, position);
+
+  size_t line, col;
+  const char *message;
+  if (ed->lex && json_lex_error(ed->lex, &ed->gb, &line, &col, &message)) {
+    char error[128];
+    snprintf(error, sizeof(error), "%zu:%zu %s", line + 1, col + 1, message);
+    int room = field - len;
+    int error_len = (int)strlen(error);
+    if (error_len > room) {
+      error_len = room;
     }
+    wattron(ed->win, COLOR_PAIR(JSON_COLOR_NULL) | A_BOLD);
+    mvwaddnstr(ed->win, y, x + room - error_len, error, error_len);
+    wattroff(ed->win, COLOR_PAIR(JSON_COLOR_NULL) | A_BOLD);
   }
+}
 
-  // posicionar cursor y refrescar
-  wmove(win, start_y + line, start_x + col);
-  wrefresh(win);
+static void editor_place_cursor(editor_t *ed) {
+  editor_draw_status(ed);
+  size_t row = gap_buffer_cursor_line(&ed->gb) - ed->top;
+  size_t col = editor_column(ed) - ed->left;
+  curs_set(2);
+  wmove(ed->win, ed->y + (int)row, ed->x + (int)col);
+  wrefresh(ed->win);
   doupdate(); // forzar actualización para PDCurses
 }
 
-bool input_get_multiline(WINDOW *win, int start_y, int start_x, int height,
-                         int width, char *buffer, int max_length) {
-  if (!win || !buffer || max_length <= 0) {
-    return false;
+char *input_get_multiline(WINDOW *win, int start_y, int start_x, int height,
+                          int width, const char *initial, bool json) {
+  if (!win || height <= 0 || width <= 0) {
+    return NULL;
   }
 
-  // calcular posición inicial del buffer
-  int pos = strlen(buffer);
-  int line = 0;
-  int col = 0;
+  editor_t ed = {
+      .win = win, .y = start_y, .x = start_x, .height = height, .width = width};
+  if (!gap_buffer_init(&ed.gb, initial)) {
+    return NULL;
+  }
 
-  // calcular línea y columna inicial
-  for (int i = 0; i < pos; i++) {
-    if (buffer[i] == '\n') {
-      line++;
-      col = 0;
-    } else {
-      col++;
-      if (col >= width) {
-        line++;
-        col = 0;
-      }
-    }
+  json_lex_t lex;
+  if (json && json_lex_init(&lex, &ed.gb)) {
+    ed.lex = &lex;
   }
 
+  // cursor al final, como antes
+  gap_buffer_move(&ed.gb, gap_buffer_length(&ed.gb));
+  editor_follow_cursor(&ed);
+  ed.goal = editor_column(&ed);
+
   // activar cursor visible
   curs_set(2);
 
@@ -149,12 +253,8 @@ bool input_get_multiline(WINDOW *win, int start_y, int start_x, int height,
   leaveok(win, FALSE);
 
   // dibujo inicial
-  redraw_buffer(win, start_y, start_x, height, width, buffer, pos);
-
-  // actualización extra para que el cursor se vea en Windows
-  wmove(win, start_y + line, start_x + col);
-  wrefresh(win);
-  doupdate();
+  editor_draw_rows(&ed, 0);
+  editor_place_cursor(&ed);
 
 // macros para códigos de teclas multiplataforma
 #define IS_KEY_UP(ch) ((ch) == KEY_UP || (ch) == 450)
@@ -162,196 +262,100 @@ bool input_get_multiline(WINDOW *win, int start_y, int start_x, int height,
 #define IS_KEY_LEFT(ch) ((ch) == KEY_LEFT || (ch) == 452)
 #define IS_KEY_RIGHT(ch) ((ch) == KEY_RIGHT || (ch) == 454)
 
+  bool saved = false;
   int ch;
-  while ((ch = wgetch(win)) != ERR) {
+  while (true) {
+    // con el lexer atrasado la tecla se espera sin bloquear y, si no llega,
+    // se avanza un tramo
+    bool lexing = ed.lex && ed.lex->next < gap_buffer_line_count(&ed.gb);
+    wtimeout(win, lexing ? 0 : -1);
+    ch = wgetch(win);
+    if (ch == ERR) {
+      if (!lexing) {
+        break;
+      }
+      json_lex_run(ed.lex, &ed.gb, 0, JSON_LEX_CHUNK_LINES);
+      editor_place_cursor(&ed);
+      continue;
+    }
+
+    size_t line = gap_buffer_cursor_line(&ed.gb);
+    size_t cursor = gap_buffer_cursor(&ed.gb);
+    size_t line_count = gap_buffer_line_count(&ed.gb);
+    bool keep_goal = false;
+    bool edited = false;
+
     if (ch == 27) { // ESC
-      curs_set(0);
-      return false;
+      break;
     } else if (ch == KEY_F(2)) { // F2 para guardar
+      saved = true;
       break;
     } else if (IS_KEY_LEFT(ch)) {
-      // mover cursor izq
-      if (pos > 0) {
-        pos--;
-        // recalcular línea y col
-        line = 0;
-        col = 0;
-        for (int i = 0; i < pos; i++) {
-          if (buffer[i] == '\n') {
-            line++;
-            col = 0;
-          } else {
-            col++;
-            if (col >= width) {
-              line++;
-              col = 0;
-            }
-          }
-        }
-        curs_set(2);
-        wmove(win, start_y + line, start_x + col);
-        wrefresh(win);
-        doupdate(); // forzar actualización para PDCurses
+      if (cursor > 0) {
+        gap_buffer_move(&ed.gb, cursor - 1);
       }
     } else if (IS_KEY_RIGHT(ch)) {
-      // mover cursor der
-      if (pos < strlen(buffer)) {
-        pos++;
-        // recalcular línea y col
-        line = 0;
-        col = 0;
-        for (int i = 0; i < pos; i++) {
-          if (buffer[i] == '\n') {
-            line++;
-            col = 0;
-          } else {
-            col++;
-            if (col >= width) {
-              line++;
-              col = 0;
-            }
-          }
-        }
-        curs_set(2);
-        wmove(win, start_y + line, start_x + col);
-        wrefresh(win);
-        doupdate(); // forzar actualización para PDCurses
-      }
-    } else if (IS_KEY_UP(ch)) {
-      // mover cursor arriba
-      if (line > 0) {
-        // buscar inicio de línea actual
-        int line_start = pos;
-        while (line_start > 0 && buffer[line_start - 1] != '\n') {
-          line_start--;
-        }
-
-        if (line_start > 0) {
-          // buscar inicio de línea anterior
-          int prev_line_start = line_start - 2;
-          while (prev_line_start > 0 && buffer[prev_line_start - 1] != '\n') {
-            prev_line_start--;
-          }
-
-          // ir a la misma columna en línea anterior
-          int target_col = col;
-          pos = prev_line_start;
-          int curr_col = 0;
-          while (pos < line_start - 1 && buffer[pos] != '\n' &&
-                 curr_col < target_col) {
-            pos++;
-            curr_col++;
-          }
-
-          // recalcular línea y col
-          line = 0;
-          col = 0;
-          for (int i = 0; i < pos; i++) {
-            if (buffer[i] == '\n') {
-              line++;
-              col = 0;
-            } else {
-              col++;
-            }
-          }
-          curs_set(2);
-          wmove(win, start_y + line, start_x + col);
-          wrefresh(win);
-          doupdate(); // forzar actualización para PDCurses
-        }
-      }
-    } else if (IS_KEY_DOWN(ch)) {
-      // mover cursor abajo
-      int buffer_len = strlen(buffer);
-      // buscar fin de línea actual
-      int line_end = pos;
-      while (line_end < buffer_len && buffer[line_end] != '\n') {
-        line_end++;
-      }
-
-      if (line_end < buffer_len) {
-        // ir a línea siguiente
-        int next_line_start = line_end + 1;
-        int target_col = col;
-        pos = next_line_start;
-        int curr_col = 0;
-        while (pos < buffer_len && buffer[pos] != '\n' &&
-               curr_col < target_col) {
-          pos++;
-          curr_col++;
-        }
-
-        // recalcular línea y col
-        line = 0;
-        col = 0;
-        for (int i = 0; i < pos; i++) {
-          if (buffer[i] == '\n') {
-            line++;
-            col = 0;
-          } else {
-            col++;
-          }
-        }
-        curs_set(2);
-        wmove(win, start_y + line, start_x + col);
-        wrefresh(win);
-        doupdate(); // forzar actualización para PDCurses
-      }
+      gap_buffer_move(&ed.gb, cursor + 1);
+    } else if (IS_KEY_UP(ch) || ch == KEY_PPAGE) {
+      size_t step = ch == KEY_PPAGE ? (size_t)ed.height : 1;
+      editor_goto(&ed, line > step ? line - step : 0, ed.goal);
+      keep_goal = true;
+    } else if (IS_KEY_DOWN(ch) || ch == KEY_NPAGE) {
+      size_t step = ch == KEY_NPAGE ? (size_t)ed.height : 1;
+      editor_goto(&ed, line + step, ed.goal);
+      keep_goal = true;
+    } else if (ch == KEY_HOME) {
+      gap_buffer_move(&ed.gb, gap_buffer_line_start(&ed.gb, line));
+    } else if (ch == KEY_END) {
+      gap_buffer_move(&ed.gb, gap_buffer_line_start(&ed.gb, line) +
+                                  gap_buffer_line_length(&ed.gb, line));
     } else if (ch == KEY_BACKSPACE || ch == 127 || ch == '\b') {
-      if (pos > 0) {
-        // borrar caracter y mover todo a la izq
-        memmove(&buffer[pos - 1], &buffer[pos], strlen(buffer) - pos + 1);
-        pos--;
-
-        // recalcular línea y col
-        line = 0;
-        col = 0;
-        for (int i = 0; i < pos; i++) {
-          if (buffer[i] == '\n') {
-            line++;
-            col = 0;
-          } else {
-            col++;
-            if (col >= width) {
-              line++;
-              col = 0;
-            }
-          }
-        }
-
-        // redibujar con cursor visible
-        redraw_buffer(win, start_y, start_x, height, width, buffer, pos);
-        curs_set(2);
-      }
+      edited = gap_buffer_delete_before(&ed.gb);
+    } else if (ch == KEY_DC) {
+      edited = gap_buffer_delete_after(&ed.gb);
     } else if (ch == '\n' || ch == KEY_ENTER) {
-      if (strlen(buffer) < max_length - 1) {
-        // insertar salto de línea
-        memmove(&buffer[pos + 1], &buffer[pos], strlen(buffer) - pos + 1);
-        buffer[pos] = '\n';
-        pos++;
-        line++;
-        col = 0;
-
-        // redibujar con cursor visible
-        redraw_buffer(win, start_y, start_x, height, width, buffer, pos);
-        curs_set(2);
-      }
-    } else if (isprint(ch) && strlen(buffer) < max_length - 1) {
-      // insertar caracter en posición actual
-      memmove(&buffer[pos + 1], &buffer[pos], strlen(buffer) - pos + 1);
-      buffer[pos] = ch;
-      pos++;
-      col++;
-
-      if (col >= width) {
-        line++;
-        col = 0;
+      edited = gap_buffer_insert(&ed.gb, "\n", 1);
+    } else if (isprint(ch)) {
+      char c = (char)ch;
+      edited = gap_buffer_insert(&ed.gb, &c, 1);
+    } else {
+      continue;
+    }
+
+    if (!keep_goal) {
+      ed.goal = editor_column(&ed);
+    }
+
+    // primera línea tocada y líneas que se unieron o agregaron
+    size_t first = gap_buffer_cursor_line(&ed.gb);
+    if (first > line) {
+      first = line;
+    }
+    size_t new_count = gap_buffer_line_count(&ed.gb);
+    bool spread = new_count != line_count;
+    if (edited && ed.lex) {
+      json_lex_edit(ed.lex, first, line_count > new_count ? 1 : 0,
+                    new_count > line_count ? 1 : 0);
+      // si el estado al final de la línea cambió, cambian los colores de
+      // las de abajo
+      if (!json_lex_run(ed.lex, &ed.gb, first, 0)) {
+        spread = true;
       }
+    }
 
-      // redibujar con cursor visible
-      redraw_buffer(win, start_y, start_x, height, width, buffer, pos);
-      curs_set(2);
+    // si la vista se movió se redibuja todo; si no, sólo la línea tocada,
+    // o desde ella hacia abajo
+    if (editor_follow_cursor(&ed)) {
+      editor_draw_rows(&ed, 0);
+    } else if (edited) {
+      int row = (int)(first - ed.top);
+      if (spread) {
+        editor_draw_rows(&ed, row);
+      } else {
+        editor_draw_row(&ed, row);
+      }
     }
+    editor_place_cursor(&ed);
   }
 
 #undef IS_KEY_UP
@@ -359,8 +363,14 @@ bool input_get_multiline(WINDOW *win, int start_y, int start_x, int height,
 #undef IS_KEY_LEFT
 #undef IS_KEY_RIGHT
 
+  wtimeout(win, -1);
   curs_set(0);
-  return true;
+  char *text = saved ? gap_buffer_text(&ed.gb) : NULL;
+  if (ed.lex) {
+    json_lex_free(ed.lex);
+  }
+  gap_buffer_free(&ed.gb);
+  return text;
 }
 
 bool input_text_single(const char *title, const char *prompt, char *buffer,
@@ -404,10 +414,10 @@ bool input_text_single(const char *title, const char *prompt, char *buffer,
   return result;
 }
 
-bool input_text_editor(const char *title, char *buffer, int max_length,
-                       const char *instructions) {
+char *input_text_editor(const char *title, const char *initial,
+                        const char *instructions, bool json) {
   int height = 20;
-  int width = 70;
+  int width = INPUT_EDITOR_COLUMNS + 4;
   int start_y, start_x;
 
   tui_get_size(&start_y, &start_x);
@@ -416,7 +426,7 @@ bool input_text_editor(const char *title, char *buffer, int max_length,
 
   WINDOW *win = newwin(height, width, start_y, start_x);
   if (!win) {
-    return false;
+    return NULL;
   }
 
   keypad(win, TRUE);
@@ -427,15 +437,15 @@ bool input_text_editor(const char *title, char *buffer, int max_length,
     tui_draw_hline(win, 2, 1, width - 2);
   }
 
-  int input_height = height - 5;
-  int input_width = width - 4;
   int input_y = instructions ? 3 : 2;
+  int input_height = height - 2 - input_y;
+  int input_width = width - 4;
 
   mvwprintw(win, height - 2, 2, "F2: Save | ESC: Cancel");
   wrefresh(win);
 
-  bool result = input_get_multiline(win, input_y, 2, input_height, input_width,
-                                    buffer, max_length);
+  char *result = input_get_multiline(win, input_y, 2, input_height,
+                                     input_width, initial, json);
 
   delwin(win);
   touchwin(stdscr);
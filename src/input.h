@@ -20,13 +20,20 @@ bool input_get_string(WINDOW *win, int y, int x, char *buffer, int max_length,
 bool input_text_single(const char *title, const char *prompt, char *buffer,
                        int max_length, const char *instructions);
 
-// obtener input multilínea
-bool input_get_multiline(WINDOW *win, int start_y, int start_x, int height,
-                         int width, char *buffer, int max_length);
-
-// mostrar editor de texto
-bool input_text_editor(const char *title, char *buffer, int max_length,
-                       const char *instructions);
+// obtener input multilínea. el texto no tiene tope de largo: la vista
+// se desplaza en ambos ejes y la posición del cursor se muestra en la fila
+// debajo del área. con json se colorea y se valida mientras se escribe, y
+// el primer error aparece junto a la posición. devuelve el texto (liberar
+// con free) o NULL si se canceló
+char *input_get_multiline(WINDOW *win, int start_y, int start_x, int height,
+                          int width, const char *initial, bool json);
+
+// mostrar editor de texto; igual que input_get_multiline
+char *input_text_editor(const char *title, const char *initial,
+                        const char *instructions, bool json);
+
+// columnas de texto visibles en input_text_editor
+#define INPUT_EDITOR_COLUMNS 66
 
 // obtener selección de menú
 int input_get_menu_selection(WINDOW *win, int y, int x, const char **items,
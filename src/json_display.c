@@ -1,7 +1,17 @@
 #include "json_display.h"
+#include "bson_render.h"
+#include "search.h"
 #include <ctype.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+// patrón resaltado en json_display_string (búsqueda del visor)
+static search_pattern_t g_highlight;
+static bool g_highlight_active = false;
+
 
 void json_init_colors(void) {
   if (!has_colors()) {
@@ -28,68 +38,22 @@ char *json_format_bson(const bson_t *doc) {
   return json;
 }
 
-bool json_format_bson_editable(const bson_t *doc, char *buffer,
-                               size_t buffer_size) {
-  if (!doc || !buffer || buffer_size == 0) {
-    return false;
-  }
-
-  size_t length;
-  char *json = bson_as_relaxed_extended_json(doc, &length);
-  if (!json) {
-    return false;
+char *json_format_bson_editable(const bson_t *doc, int width) {
+  if (!doc) {
+    return NULL;
   }
 
-  // pretty-print simple: agregar saltos de línea
-  size_t out_pos = 0;
-  bool in_string = false;
-  bool escape_next = false;
-
-  buffer[0] = '\0';
-
-  for (size_t i = 0; i < length && out_pos < buffer_size - 10; i++) {
-    char c = json[i];
+  bson_render_t render;
+  text_buffer_t out;
+  bson_render_init_json(&render, doc, width);
+  text_buffer_init(&out);
 
-    // rastrear si estamos en string
-    if (c == '\\' && in_string) {
-      escape_next = true;
-      buffer[out_pos++] = c;
-      continue;
-    }
-
-    if (c == '"' && !escape_next) {
-      in_string = !in_string;
-    }
-
-    escape_next = false;
-
-    // agregar caracter
-    buffer[out_pos++] = c;
-
-    // agregar saltos de línea (solo fuera de strings)
-    if (!in_string) {
-      if (c == '{' || c == '[') {
-        buffer[out_pos++] = '\n';
-        buffer[out_pos++] = ' ';
-        buffer[out_pos++] = ' ';
-      } else if (c == ',') {
-        buffer[out_pos++] = '\n';
-        buffer[out_pos++] = ' ';
-        buffer[out_pos++] = ' ';
-      } else if (c == '}' || c == ']') {
-        // insertar salto antes del cierre
-        if (out_pos > 1 && buffer[out_pos - 2] != '\n') {
-          buffer[out_pos - 1] = '\n';
-          buffer[out_pos++] = c;
-        }
-      }
-    }
+  char *text = NULL;
+  if (bson_render_to_buffer(&render, &out)) {
+    text = text_buffer_join(&out);
   }
-
-  buffer[out_pos] = '\0';
-  bson_free(json);
-
-  return true;
+  text_buffer_free(&out);
+  return text;
 }
 
 int json_count_lines(const char *json, int max_width) {
@@ -169,140 +133,403 @@ static void print_colored_char(WINDOW *win, char ch, int *color,
   }
 }
 
+// color de un caracter según el estado del tokenizador (0 = sin color)
+static int classify_char(const char *p, bool *in_string, bool *in_escape,
+                         bool *is_key, int *keyword_left, int *keyword_color) {
+  if (*keyword_left > 0) {
+    (*keyword_left)--;
+    return *keyword_color;
+  }
+
+  if (*in_escape) {
+    *in_escape = false;
+    return *is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING;
+  }
+
+  if (*p == '\\' && *in_string) {
+    *in_escape = true;
+    return *is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING;
+  }
+
+  if (*p == '"') {
+    int color;
+    if (*in_string) {
+      // comilla de cierre
+      color = *is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING;
+      *in_string = false;
+      // ver si hay dos puntos adelante
+      const char *next = p + 1;
+      while (*next && isspace((unsigned char)*next))
+        next++;
+      if (*next != ':') {
+        *is_key = false;
+      }
+    } else {
+      // comilla de apertura - ver si es key
+      const char *temp = p + 1;
+      // buscar comilla de cierre
+      while (*temp && *temp != '\n') {
+        if (*temp == '"' && *(temp - 1) != '\\') {
+          temp++;
+          break;
+        }
+        temp++;
+      }
+      // ver si sigue con dos puntos
+      while (*temp && isspace((unsigned char)*temp))
+        temp++;
+      *is_key = (*temp == ':');
+      color = *is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING;
+      *in_string = true;
+    }
+    return color;
+  }
+
+  if (*in_string) {
+    return *is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING;
+  }
+
+  if (*p == '{' || *p == '}' || *p == '[' || *p == ']' || *p == ',' ||
+      *p == ':') {
+    return JSON_COLOR_BRACKET;
+  }
+
+  if (isdigit((unsigned char)*p) || *p == '-' || *p == '+' || *p == '.') {
+    return JSON_COLOR_NUMBER;
+  }
+
+  if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0) {
+    *keyword_left = (*p == 't') ? 3 : 4;
+    *keyword_color = JSON_COLOR_BOOLEAN;
+    return JSON_COLOR_BOOLEAN;
+  }
+
+  if (strncmp(p, "null", 4) == 0) {
+    *keyword_left = 3;
+    *keyword_color = JSON_COLOR_NULL;
+    return JSON_COLOR_NULL;
+  }
+
+  return 0;
+}
+
+void json_set_highlight(const char *needle) {
+  if (g_highlight_active) {
+    search_free(&g_highlight);
+    g_highlight_active = false;
+  }
+
+  if (needle && needle[0] != '\0') {
+    g_highlight_active = search_compile(&g_highlight, needle, true);
+  }
+}
+
+const search_pattern_t *json_highlight_pattern(void) {
+  return g_highlight_active ? &g_highlight : NULL;
+}
+
+static void flush_run(WINDOW *win, const char *text, int length, attr_t attr,
+                      int y, int x) {
+  wattron(win, attr);
+  mvwaddnstr(win, y, x, text, length);
+  wattroff(win, attr);
+}
+
 int json_display_string(WINDOW *win, const char *json, int start_y, int start_x,
                         int max_height, int max_width, int scroll_offset) {
-  if (!win || !json) {
+  if (!win || !json || max_width <= 0) {
     return 0;
   }
 
-  int y = start_y;
+  if (scroll_offset < 0) {
+    scroll_offset = 0;
+  }
+
+  int line = 0;
   int col = 0;
   const char *p = json;
   bool in_string = false;
   bool in_escape = false;
   bool is_key = false;
+  int keyword_left = 0;
+  int keyword_color = 0;
+
+  // coincidencias de la búsqueda activa
+  size_t json_len = strlen(json);
+  const char *match = NULL;
+  if (g_highlight_active) {
+    match = search_find(&g_highlight, json, json_len);
+  }
 
-  while (*p && (y - start_y) < max_height) {
+  // tramo pendiente de dibujar
+  const char *run_start = NULL;
+  int run_length = 0;
+  attr_t run_attr = A_NORMAL;
+  int run_line = 0;
+  int run_col = 0;
+
+  while (*p && (line - scroll_offset) < max_height) {
     if (*p == '\n') {
-      y++;
+      line++;
       col = 0;
       p++;
       continue;
     }
 
     if (col >= max_width) {
-      y++;
+      line++;
       col = 0;
+      if (line - scroll_offset >= max_height) {
+        break;
+      }
     }
 
-    wmove(win, y, start_x + col);
-
     // determinar contexto y aplicar colores
-    if (in_escape) {
-      wattron(win, COLOR_PAIR(is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING));
-      waddch(win, *p);
-      wattroff(win, COLOR_PAIR(is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING));
-      in_escape = false;
-    } else if (*p == '\\' && in_string) {
-      wattron(win, COLOR_PAIR(is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING));
-      waddch(win, *p);
-      wattroff(win, COLOR_PAIR(is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING));
-      in_escape = true;
-    } else if (*p == '"') {
-      if (in_string) {
-        // comilla de cierre
-        wattron(win, COLOR_PAIR(is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING));
-        waddch(win, *p);
-        wattroff(win, COLOR_PAIR(is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING));
-        in_string = false;
-        // ver si hay dos puntos adelante
-        const char *next = p + 1;
-        while (*next && isspace(*next))
-          next++;
-        if (*next != ':') {
-          is_key = false;
-        }
-      } else {
-        // comilla de apertura - ver si es key
-        const char *next = p + 1;
-        const char *temp = next;
-        bool found_quote = false;
-        // buscar comilla de cierre
-        while (*temp && *temp != '\n') {
-          if (*temp == '"' && *(temp - 1) != '\\') {
-            found_quote = true;
-            temp++;
-            break;
-          }
-          temp++;
-        }
-        // ver si sigue con dos puntos
-        while (*temp && isspace(*temp))
-          temp++;
-        is_key = (*temp == ':');
+    int color = classify_char(p, &in_string, &in_escape, &is_key,
+                              &keyword_left, &keyword_color);
+
+    while (match && p >= match + g_highlight.length) {
+      const char *from = match + g_highlight.length;
+      match = search_find(&g_highlight, from, json + json_len - from);
+    }
 
-        wattron(win, COLOR_PAIR(is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING));
-        waddch(win, *p);
-        wattroff(win, COLOR_PAIR(is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING));
-        in_string = true;
+    if (line >= scroll_offset) {
+      attr_t attr = color ? COLOR_PAIR(color) : A_NORMAL;
+      if (match && p >= match) {
+        attr |= A_REVERSE;
       }
-    } else if (in_string) {
-      wattron(win, COLOR_PAIR(is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING));
-      waddch(win, *p);
-      wattroff(win, COLOR_PAIR(is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING));
-    } else if (*p == '{' || *p == '}' || *p == '[' || *p == ']' || *p == ',' ||
-               *p == ':') {
-      wattron(win, COLOR_PAIR(JSON_COLOR_BRACKET));
-      waddch(win, *p);
-      wattroff(win, COLOR_PAIR(JSON_COLOR_BRACKET));
-    } else if (isdigit(*p) || *p == '-' || *p == '+' || *p == '.') {
-      wattron(win, COLOR_PAIR(JSON_COLOR_NUMBER));
-      waddch(win, *p);
-      wattroff(win, COLOR_PAIR(JSON_COLOR_NUMBER));
-    } else if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0) {
-      int len = (*p == 't') ? 4 : 5;
-      wattron(win, COLOR_PAIR(JSON_COLOR_BOOLEAN));
-      for (int i = 0; i < len && *p; i++, p++, col++) {
-        waddch(win, *p);
+
+      // juntar caracteres seguidos de igual atributo en un solo tramo
+      if (run_length > 0 && (attr != run_attr || line != run_line)) {
+        flush_run(win, run_start, run_length, run_attr,
+                  start_y + run_line - scroll_offset, start_x + run_col);
+        run_length = 0;
       }
-      wattroff(win, COLOR_PAIR(JSON_COLOR_BOOLEAN));
-      p--;
-      col--;
-    } else if (strncmp(p, "null", 4) == 0) {
-      wattron(win, COLOR_PAIR(JSON_COLOR_NULL));
-      for (int i = 0; i < 4 && *p; i++, p++, col++) {
-        waddch(win, *p);
+      if (run_length == 0) {
+        run_start = p;
+        run_attr = attr;
+        run_line = line;
+        run_col = col;
       }
-      wattroff(win, COLOR_PAIR(JSON_COLOR_NULL));
-      p--;
-      col--;
-    } else {
-      waddch(win, *p);
+      run_length++;
     }
 
     col++;
     p++;
   }
 
-  return (y - start_y) + 1;
+  if (run_length > 0) {
+    flush_run(win, run_start, run_length, run_attr,
+              start_y + run_line - scroll_offset, start_x + run_col);
+  }
+
+  int drawn = (line - scroll_offset) + 1;
+  return drawn > max_height ? max_height : drawn;
 }
 
-int json_display_document(WINDOW *win, const bson_t *doc, int start_y,
-                          int start_x, int max_height, int max_width) {
-  if (!win || !doc) {
-    return 0;
+// copiar un string en una línea: caracteres de control como espacio
+static void copy_single_line(char *buffer, size_t buffer_size, const char *str,
+                             uint32_t length) {
+  size_t n = length < buffer_size - 1 ? length : buffer_size - 1;
+  for (size_t i = 0; i < n; i++) {
+    unsigned char c = (unsigned char)str[i];
+    buffer[i] = c < 0x20 ? ' ' : (char)c;
   }
+  buffer[n] = '\0';
+}
 
-  char *json = json_format_bson(doc);
-  if (!json) {
-    mvwprintw(win, start_y, start_x, "Error: Could not format document");
-    return 1;
+// días desde 1970-01-01 a fecha civil (gregoriano proléptico, sin
+// depender de gmtime_r, que no está en C11 puro)
+static void civil_from_days(int64_t days, int *year, int *month, int *day) {
+  days += 719468;
+  int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  int64_t doe = days - era * 146097;
+  int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int64_t mp = (5 * doy + 2) / 153;
+  *day = (int)(doy - (153 * mp + 2) / 5 + 1);
+  *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+  *year = (int)(yoe + era * 400 + (*month <= 2));
+}
+
+// double con la menor precisión que lo reproduce, con ".0" si es entero
+static void format_double(double value, char *buffer, size_t size) {
+  if (isnan(value)) {
+    snprintf(buffer, size, "NaN");
+    return;
+  }
+  if (isinf(value)) {
+    snprintf(buffer, size, value > 0 ? "Infinity" : "-Infinity");
+    return;
   }
 
-  int lines = json_display_string(win, json, start_y, start_x, max_height,
-                                  max_width, 0);
+  snprintf(buffer, size, "%.15g", value);
+  if (strtod(buffer, NULL) != value) {
+    snprintf(buffer, size, "%.17g", value);
+  }
+  if (!strpbrk(buffer, ".eE")) {
+    size_t len = strlen(buffer);
+    if (len + 2 < size) {
+      memcpy(buffer + len, ".0", 3);
+    }
+  }
+}
 
-  bson_free(json);
+int json_format_scalar(const bson_iter_t *iter, char *buffer,
+                       size_t buffer_size) {
+  if (!iter || !buffer || buffer_size == 0) {
+    return JSON_COLOR_NULL;
+  }
 
-  return lines;
+  buffer[0] = '\0';
+
+  switch (bson_iter_type(iter)) {
+  case BSON_TYPE_UTF8: {
+    uint32_t length;
+    const char *str = bson_iter_utf8(iter, &length);
+    copy_single_line(buffer, buffer_size, str, length);
+    return JSON_COLOR_STRING;
+  }
+  case BSON_TYPE_SYMBOL: {
+    uint32_t length;
+    const char *str = bson_iter_symbol(iter, &length);
+    copy_single_line(buffer, buffer_size, str, length);
+    return JSON_COLOR_STRING;
+  }
+  case BSON_TYPE_INT32:
+    snprintf(buffer, buffer_size, "%" PRId32, bson_iter_int32(iter));
+    return JSON_COLOR_NUMBER;
+  case BSON_TYPE_INT64:
+    snprintf(buffer, buffer_size, "%" PRId64, bson_iter_int64(iter));
+    return JSON_COLOR_NUMBER;
+  case BSON_TYPE_DOUBLE:
+    format_double(bson_iter_double(iter), buffer, buffer_size);
+    return JSON_COLOR_NUMBER;
+  case BSON_TYPE_DECIMAL128: {
+    bson_decimal128_t dec;
+    char str[BSON_DECIMAL128_STRING];
+    bson_iter_decimal128(iter, &dec);
+    bson_decimal128_to_string(&dec, str);
+    snprintf(buffer, buffer_size, "%s", str);
+    return JSON_COLOR_NUMBER;
+  }
+  case BSON_TYPE_BOOL:
+    snprintf(buffer, buffer_size, "%s",
+             bson_iter_bool(iter) ? "true" : "false");
+    return JSON_COLOR_BOOLEAN;
+  case BSON_TYPE_NULL:
+    snprintf(buffer, buffer_size, "null");
+    return JSON_COLOR_NULL;
+  case BSON_TYPE_UNDEFINED:
+    snprintf(buffer, buffer_size, "undefined");
+    return JSON_COLOR_NULL;
+  case BSON_TYPE_OID: {
+    char oid[25];
+    bson_oid_to_string(bson_iter_oid(iter), oid);
+    snprintf(buffer, buffer_size, "%s", oid);
+    return JSON_COLOR_STRING;
+  }
+  case BSON_TYPE_DATE_TIME: {
+    // fecha ISO en UTC, con milisegundos sólo si hay
+    int64_t ms = bson_iter_date_time(iter);
+    int64_t secs = ms / 1000;
+    int millis = (int)(ms % 1000);
+    if (millis < 0) {
+      millis += 1000;
+      secs--;
+    }
+    int year, month, day;
+    int64_t days = secs / 86400;
+    int64_t rem = secs % 86400;
+    if (rem < 0) {
+      rem += 86400;
+      days--;
+    }
+    civil_from_days(days, &year, &month, &day);
+    int hour = (int)(rem / 3600), min = (int)(rem % 3600 / 60),
+        sec = (int)(rem % 60);
+    if (millis) {
+      snprintf(buffer, buffer_size, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+               year, month, day, hour, min, sec, millis);
+    } else {
+      snprintf(buffer, buffer_size, "%04d-%02d-%02dT%02d:%02d:%02dZ", year,
+               month, day, hour, min, sec);
+    }
+    return JSON_COLOR_NUMBER;
+  }
+  case BSON_TYPE_TIMESTAMP: {
+    uint32_t timestamp, increment;
+    bson_iter_timestamp(iter, &timestamp, &increment);
+    snprintf(buffer, buffer_size, "Timestamp(%" PRIu32 ", %" PRIu32 ")",
+             timestamp, increment);
+    return JSON_COLOR_NUMBER;
+  }
+  case BSON_TYPE_REGEX: {
+    const char *options;
+    const char *regex = bson_iter_regex(iter, &options);
+    snprintf(buffer, buffer_size, "/%s/%s", regex, options ? options : "");
+    return JSON_COLOR_STRING;
+  }
+  case BSON_TYPE_BINARY: {
+    bson_subtype_t subtype;
+    uint32_t length;
+    const uint8_t *data;
+    bson_iter_binary(iter, &subtype, &length, &data);
+    if (subtype == BSON_SUBTYPE_UUID && length == 16) {
+      snprintf(buffer, buffer_size,
+               "UUID(\"%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-"
+               "%02x%02x%02x%02x%02x%02x\")",
+               data[0], data[1], data[2], data[3], data[4], data[5], data[6],
+               data[7], data[8], data[9], data[10], data[11], data[12],
+               data[13], data[14], data[15]);
+    } else {
+      snprintf(buffer, buffer_size, "Binary(%d, %" PRIu32 " bytes)",
+               (int)subtype, length);
+    }
+    return JSON_COLOR_STRING;
+  }
+  case BSON_TYPE_CODE:
+  case BSON_TYPE_CODEWSCOPE: {
+    uint32_t length;
+    const char *code = bson_iter_type(iter) == BSON_TYPE_CODE
+                           ? bson_iter_code(iter, &length)
+                           : bson_iter_codewscope(iter, &length, NULL, NULL);
+    copy_single_line(buffer, buffer_size, code, length);
+    return JSON_COLOR_STRING;
+  }
+  case BSON_TYPE_DOCUMENT:
+  case BSON_TYPE_ARRAY: {
+    // resumen: {n} o [n] con la cantidad de elementos
+    bson_iter_t child;
+    int n = 0;
+    if (bson_iter_recurse(iter, &child)) {
+      while (bson_iter_next(&child)) {
+        n++;
+      }
+    }
+    bool is_array = bson_iter_type(iter) == BSON_TYPE_ARRAY;
+    snprintf(buffer, buffer_size, is_array ? "[%d]" : "{%d}", n);
+    return JSON_COLOR_BRACKET;
+  }
+  case BSON_TYPE_MINKEY:
+    snprintf(buffer, buffer_size, "MinKey");
+    return JSON_COLOR_NULL;
+  case BSON_TYPE_MAXKEY:
+    snprintf(buffer, buffer_size, "MaxKey");
+    return JSON_COLOR_NULL;
+  default:
+    snprintf(buffer, buffer_size, "<type 0x%02x>", (int)bson_iter_type(iter));
+    return JSON_COLOR_NULL;
+  }
+}
+
+int json_display_document(WINDOW *win, const bson_t *doc, int start_y,
+                          int start_x, int max_height, int max_width) {
+  if (!win || !doc) {
+    return 0;
+  }
+
+  // directo desde el BSON, sin pasar por texto JSON
+  return bson_render_draw(win, doc, start_y, start_x, max_height, max_width,
+                          0);
 }
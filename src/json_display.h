@@ -1,6 +1,7 @@
 #ifndef JSON_DISPLAY_H
 #define JSON_DISPLAY_H
 
+#include "search.h"
 #include <mongoc/mongoc.h>
 
 // header de curses multiplataforma
@@ -13,9 +14,9 @@
 // formatear BSON a JSON
 char *json_format_bson(const bson_t *doc);
 
-// formatear BSON a JSON editable
-bool json_format_bson_editable(const bson_t *doc, char *buffer,
-                               size_t buffer_size);
+// formatear BSON a JSON editable con sangría, sin tope de largo; los
+// niveles que entran en width columnas van en una línea (liberar con free)
+char *json_format_bson_editable(const bson_t *doc, int width);
 
 // mostrar documento BSON con colores
 int json_display_document(WINDOW *win, const bson_t *doc, int start_y,
@@ -28,6 +29,19 @@ int json_display_string(WINDOW *win, const char *json, int start_y, int start_x,
 // calcular líneas totales del JSON
 int json_count_lines(const char *json, int max_width);
 
+// formatear un valor escalar directo desde el iterador (sin pasar por
+// JSON) en una línea; subdocumentos y arrays se resumen. devuelve el
+// color JSON_COLOR_* que le corresponde
+int json_format_scalar(const bson_iter_t *iter, char *buffer,
+                       size_t buffer_size);
+
+// resaltar un texto en json_display_string y bson_render_draw (NULL o ""
+// para apagar)
+void json_set_highlight(const char *needle);
+
+// patrón resaltado actual (NULL si no hay)
+const search_pattern_t *json_highlight_pattern(void);
+
 // inicializar colores para JSON
 void json_init_colors(void);
 
@@ -0,0 +1,622 @@
+#include "json_lex.h"
+#include "json_display.h"
+#include <stdlib.h>
+#include <string.h>
+
+// qué puede venir a continuación
+enum {
+  EXPECT_DOCUMENT,        // inicio: sólo '{'
+  EXPECT_KEY_OR_CLOSE,    // después de '{'
+  EXPECT_KEY,             // después de ',' en un objeto
+  EXPECT_COLON,           // después de una clave
+  EXPECT_VALUE,           // después de ':' o de ',' en un array
+  EXPECT_VALUE_OR_CLOSE,  // después de '['
+  EXPECT_COMMA_OR_CLOSE,  // después de un valor dentro de un contenedor
+  EXPECT_END,             // el documento ya cerró
+};
+
+enum {
+  LEX_OK,
+  LEX_UNEXPECTED_CHAR,
+  LEX_UNTERMINATED_STRING,
+  LEX_BAD_ESCAPE,
+  LEX_CONTROL_CHAR,
+  LEX_BAD_NUMBER,
+  LEX_BAD_LITERAL,
+  LEX_EXPECTED_KEY,
+  LEX_EXPECTED_COLON,
+  LEX_EXPECTED_VALUE,
+  LEX_EXPECTED_COMMA_OBJECT,
+  LEX_EXPECTED_COMMA_ARRAY,
+  LEX_MISMATCH,
+  LEX_NOT_OBJECT,
+  LEX_TRAILING,
+  LEX_TOO_DEEP,
+  LEX_UNCLOSED,
+  LEX_EMPTY,
+};
+
+static const char *const lex_messages[] = {
+    "",
+    "unexpected character",
+    "unterminated string",
+    "invalid escape",
+    "control character in string",
+    "invalid number",
+    "invalid literal",
+    "expected a key",
+    "expected ':'",
+    "expected a value",
+    "expected ',' or '}'",
+    "expected ',' or ']'",
+    "mismatched bracket",
+    "document must be an object",
+    "text after document",
+    "nesting too deep",
+    "missing '}' or ']'",
+    "empty document",
+};
+
+static bool state_equal(const json_lex_state_t *a, const json_lex_state_t *b) {
+  return a->depth == b->depth && a->expect == b->expect &&
+         memcmp(a->arrays, b->arrays, sizeof(a->arrays)) == 0;
+}
+
+static bool top_is_array(const json_lex_state_t *s) {
+  unsigned level = s->depth - 1;
+  return (s->arrays[level / 64] >> (level % 64)) & 1;
+}
+
+static bool expects_value(const json_lex_state_t *s) {
+  return s->expect == EXPECT_VALUE || s->expect == EXPECT_VALUE_OR_CLOSE;
+}
+
+static void after_value(json_lex_state_t *s) {
+  s->expect = s->depth == 0 ? EXPECT_END : EXPECT_COMMA_OR_CLOSE;
+}
+
+// error para un token que no va en este lugar
+static uint8_t misplaced(const json_lex_state_t *s, char c) {
+  switch (s->expect) {
+  case EXPECT_DOCUMENT:
+    return LEX_NOT_OBJECT;
+  case EXPECT_KEY_OR_CLOSE:
+  case EXPECT_KEY:
+    return LEX_EXPECTED_KEY;
+  case EXPECT_COLON:
+    return LEX_EXPECTED_COLON;
+  case EXPECT_VALUE:
+  case EXPECT_VALUE_OR_CLOSE:
+    return LEX_EXPECTED_VALUE;
+  case EXPECT_COMMA_OR_CLOSE:
+    if (c == '}' || c == ']') {
+      return LEX_MISMATCH;
+    }
+    return top_is_array(s) ? LEX_EXPECTED_COMMA_ARRAY
+                           : LEX_EXPECTED_COMMA_OBJECT;
+  default:
+    return LEX_TRAILING;
+  }
+}
+
+// largo de un string que empieza en text[0] == '"'; 0 si no cierra en la
+// línea. *error queda con el primer problema de adentro y *error_at con
+// su posición
+static size_t scan_string(const char *text, size_t length, uint8_t *error,
+                          size_t *error_at) {
+  *error = LEX_OK;
+  for (size_t i = 1; i < length; i++) {
+    unsigned char c = (unsigned char)text[i];
+    if (c == '"') {
+      return i + 1;
+    }
+    if (c < 0x20 && *error == LEX_OK) {
+      *error = LEX_CONTROL_CHAR;
+      *error_at = i;
+    } else if (c == '\\') {
+      if (i + 1 >= length) {
+        break;
+      }
+      char e = text[++i];
+      bool ok = strchr("\"\\/bfnrt", e) != NULL;
+      if (e == 'u') {
+        ok = i + 4 < length;
+        for (int k = 1; ok && k <= 4; k++) {
+          ok = strchr("0123456789abcdefABCDEF", text[i + k]) != NULL &&
+               text[i + k] != '\0';
+        }
+        if (ok) {
+          i += 4;
+        }
+      }
+      if (!ok && *error == LEX_OK) {
+        *error = LEX_BAD_ESCAPE;
+        *error_at = i - 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// largo del token numérico y si respeta la gramática de JSON
+static size_t scan_number(const char *text, size_t length, bool *valid) {
+  size_t end = 0;
+  while (end < length && text[end] != '\0' &&
+         (is_digit(text[end]) || strchr("+-.eE", text[end]))) {
+    end++;
+  }
+
+  size_t i = 0;
+  if (i < end && text[i] == '-') {
+    i++;
+  }
+  if (i < end && text[i] == '0') {
+    i++;
+  } else if (i < end && is_digit(text[i])) {
+    while (i < end && is_digit(text[i])) {
+      i++;
+    }
+  } else {
+    *valid = false;
+    return end;
+  }
+  if (i < end && text[i] == '.') {
+    size_t digits = ++i;
+    while (i < end && is_digit(text[i])) {
+      i++;
+    }
+    if (i == digits) {
+      *valid = false;
+      return end;
+    }
+  }
+  if (i < end && (text[i] == 'e' || text[i] == 'E')) {
+    i++;
+    if (i < end && (text[i] == '+' || text[i] == '-')) {
+      i++;
+    }
+    size_t digits = i;
+    while (i < end && is_digit(text[i])) {
+      i++;
+    }
+    if (i == digits) {
+      *valid = false;
+      return end;
+    }
+  }
+  *valid = i == end;
+  return end;
+}
+
+static void paint(uint8_t *colors, size_t from, size_t to, uint8_t color) {
+  if (colors) {
+    memset(colors + from, color, to - from);
+  }
+}
+
+// lexear una línea desde s; deja en s el estado al final. el primer error
+// queda en error/error_col y colors (si no es NULL) recibe un color por
+// caracter
+static void lex_line(json_lex_state_t *s, const char *text, size_t length,
+                     uint8_t *colors, uint8_t *error, int32_t *error_col) {
+  *error = LEX_OK;
+  *error_col = -1;
+
+#define FAIL(code, from, to)                                                   \
+  do {                                                                         \
+    if (*error == LEX_OK) {                                                    \
+      *error = (code);                                                         \
+      *error_col = (int32_t)(from);                                            \
+    }                                                                          \
+    if (colors) {                                                              \
+      for (size_t k_ = (from); k_ < (to); k_++) {                              \
+        colors[k_] |= JSON_LEX_ERROR;                                          \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+  size_t i = 0;
+  while (i < length) {
+    char c = text[i];
+    size_t start = i;
+
+    if (c == ' ' || c == '\t' || c == '\r') {
+      paint(colors, i, i + 1, JSON_COLOR_BRACKET);
+      i++;
+      continue;
+    }
+
+    if (s->expect == EXPECT_END) {
+      paint(colors, i, length, JSON_COLOR_BRACKET);
+      FAIL(LEX_TRAILING, i, length);
+      break;
+    }
+
+    if (c == '{' || c == '[') {
+      i++;
+      paint(colors, start, i, JSON_COLOR_BRACKET);
+      bool allowed = expects_value(s) ||
+                     (s->expect == EXPECT_DOCUMENT && c == '{');
+      if (!allowed) {
+        FAIL(misplaced(s, c), start, i);
+      } else if (s->depth >= JSON_LEX_MAX_DEPTH) {
+        FAIL(LEX_TOO_DEEP, start, i);
+      } else {
+        unsigned level = s->depth++;
+        uint64_t bit = (uint64_t)1 << (level % 64);
+        if (c == '[') {
+          s->arrays[level / 64] |= bit;
+        } else {
+          s->arrays[level / 64] &= ~bit;
+        }
+        s->expect = c == '{' ? EXPECT_KEY_OR_CLOSE : EXPECT_VALUE_OR_CLOSE;
+      }
+    } else if (c == '}' || c == ']') {
+      i++;
+      paint(colors, start, i, JSON_COLOR_BRACKET);
+      bool closes = s->depth > 0 && top_is_array(s) == (c == ']') &&
+                    (s->expect == EXPECT_COMMA_OR_CLOSE ||
+                     s->expect == (c == '}' ? EXPECT_KEY_OR_CLOSE
+                                            : EXPECT_VALUE_OR_CLOSE));
+      if (closes) {
+        s->depth--;
+        after_value(s);
+      } else {
+        FAIL(misplaced(s, c), start, i);
+      }
+    } else if (c == ':') {
+      i++;
+      paint(colors, start, i, JSON_COLOR_BRACKET);
+      if (s->expect == EXPECT_COLON) {
+        s->expect = EXPECT_VALUE;
+      } else {
+        FAIL(misplaced(s, c), start, i);
+      }
+    } else if (c == ',') {
+      i++;
+      paint(colors, start, i, JSON_COLOR_BRACKET);
+      if (s->expect == EXPECT_COMMA_OR_CLOSE) {
+        s->expect = top_is_array(s) ? EXPECT_VALUE : EXPECT_KEY;
+      } else {
+        FAIL(misplaced(s, c), start, i);
+      }
+    } else if (c == '"') {
+      uint8_t inner = LEX_OK;
+      size_t inner_at = 0;
+      size_t n = scan_string(text + i, length - i, &inner, &inner_at);
+      bool is_key =
+          s->expect == EXPECT_KEY || s->expect == EXPECT_KEY_OR_CLOSE;
+      if (n == 0) {
+        paint(colors, start, length, JSON_COLOR_STRING);
+        FAIL(LEX_UNTERMINATED_STRING, start, length);
+        break;
+      }
+      i += n;
+      paint(colors, start, i, is_key ? JSON_COLOR_KEY : JSON_COLOR_STRING);
+      if (inner != LEX_OK) {
+        FAIL(inner, start + inner_at, start + inner_at + 1);
+      }
+      if (is_key) {
+        s->expect = EXPECT_COLON;
+      } else if (expects_value(s)) {
+        after_value(s);
+      } else {
+        FAIL(misplaced(s, c), start, i);
+      }
+    } else if (c == '-' || is_digit(c)) {
+      bool valid;
+      i += scan_number(text + i, length - i, &valid);
+      paint(colors, start, i, JSON_COLOR_NUMBER);
+      if (!valid) {
+        FAIL(LEX_BAD_NUMBER, start, i);
+      } else if (expects_value(s)) {
+        after_value(s);
+      } else {
+        FAIL(misplaced(s, c), start, i);
+      }
+    } else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+      while (i < length && ((text[i] >= 'a' && text[i] <= 'z') ||
+                            (text[i] >= 'A' && text[i] <= 'Z'))) {
+        i++;
+      }
+      size_t n = i - start;
+      bool is_null = n == 4 && memcmp(text + start, "null", 4) == 0;
+      bool is_bool = (n == 4 && memcmp(text + start, "true", 4) == 0) ||
+                     (n == 5 && memcmp(text + start, "false", 5) == 0);
+      paint(colors, start, i,
+            is_null ? JSON_COLOR_NULL : JSON_COLOR_BOOLEAN);
+      if (!is_null && !is_bool) {
+        FAIL(LEX_BAD_LITERAL, start, i);
+      } else if (expects_value(s)) {
+        after_value(s);
+      } else {
+        FAIL(misplaced(s, c), start, i);
+      }
+    } else {
+      i++;
+      paint(colors, start, i, JSON_COLOR_BRACKET);
+      FAIL(LEX_UNEXPECTED_CHAR, start, i);
+    }
+  }
+
+#undef FAIL
+}
+
+static size_t gap_count(const json_lex_t *lex) {
+  return lex->gap_end - lex->gap_start;
+}
+
+static size_t line_count(const json_lex_t *lex) {
+  return lex->capacity - gap_count(lex);
+}
+
+static json_lex_line_t *record(json_lex_t *lex, size_t line) {
+  return line < lex->gap_start ? &lex->lines[line]
+                               : &lex->lines[line + gap_count(lex)];
+}
+
+// llevar el hueco a la posición pos (en líneas)
+static void move_gap(json_lex_t *lex, size_t pos) {
+  if (pos < lex->gap_start) {
+    size_t n = lex->gap_start - pos;
+    memmove(lex->lines + lex->gap_end - n, lex->lines + pos,
+            n * sizeof(json_lex_line_t));
+    lex->gap_start -= n;
+    lex->gap_end -= n;
+  } else if (pos > lex->gap_start) {
+    size_t n = pos - lex->gap_start;
+    memmove(lex->lines + lex->gap_start, lex->lines + lex->gap_end,
+            n * sizeof(json_lex_line_t));
+    lex->gap_start += n;
+    lex->gap_end += n;
+  }
+}
+
+static bool ensure_gap(json_lex_t *lex, size_t needed) {
+  if (gap_count(lex) >= needed) {
+    return true;
+  }
+
+  size_t after = lex->capacity - lex->gap_end;
+  size_t capacity = lex->capacity * 2 + needed;
+  json_lex_line_t *lines =
+      realloc(lex->lines, capacity * sizeof(json_lex_line_t));
+  if (!lines) {
+    return false;
+  }
+  memmove(lines + capacity - after, lines + lex->gap_end,
+          after * sizeof(json_lex_line_t));
+  lex->lines = lines;
+  lex->gap_end = capacity - after;
+  lex->capacity = capacity;
+  return true;
+}
+
+static bool ensure_scratch(json_lex_t *lex, size_t length) {
+  if (length <= lex->scratch_size) {
+    return true;
+  }
+
+  size_t size = length * 2;
+  char *text = realloc(lex->text, size);
+  if (!text) {
+    return false;
+  }
+  lex->text = text;
+  uint8_t *colors = realloc(lex->colors, size);
+  if (!colors) {
+    return false;
+  }
+  lex->colors = colors;
+  lex->scratch_size = size;
+  return true;
+}
+
+// copiar la línea al buffer de trabajo; devuelve su largo
+static size_t load_line(json_lex_t *lex, const gap_buffer_t *gb, size_t line,
+                        bool *ok) {
+  size_t length = gap_buffer_line_length(gb, line);
+  *ok = ensure_scratch(lex, length + 1);
+  if (!*ok) {
+    return 0;
+  }
+  gap_buffer_copy(gb, gap_buffer_line_start(gb, line), length, lex->text);
+  return length;
+}
+
+bool json_lex_init(json_lex_t *lex, const gap_buffer_t *gb) {
+  memset(lex, 0, sizeof(*lex));
+
+  size_t count = gap_buffer_line_count(gb);
+  lex->capacity = count + 64;
+  lex->lines = calloc(lex->capacity, sizeof(json_lex_line_t));
+  if (!lex->lines) {
+    return false;
+  }
+
+  // líneas en [0, count), hueco al final
+  lex->gap_start = count;
+  lex->gap_end = lex->capacity;
+  for (size_t i = 0; i < count; i++) {
+    lex->lines[i].error_col = -1;
+  }
+  lex->next = 0;
+  lex->stale_end = count;
+  return true;
+}
+
+void json_lex_free(json_lex_t *lex) {
+  free(lex->lines);
+  free(lex->text);
+  free(lex->colors);
+  memset(lex, 0, sizeof(*lex));
+}
+
+// dónde queda la línea pos después de la edición de json_lex_edit
+static size_t shift_line(size_t pos, size_t line, size_t removed,
+                         size_t added) {
+  if (pos <= line) {
+    return pos;
+  }
+  if (pos > line + removed) {
+    return pos - removed + added;
+  }
+  return line + 1 + added;
+}
+
+void json_lex_edit(json_lex_t *lex, size_t line, size_t removed,
+                   size_t added) {
+  bool pending = lex->next < line_count(lex);
+
+  // las líneas que se van dejan de contar sus errores
+  move_gap(lex, line + 1);
+  for (size_t i = 0; i < removed && lex->gap_end < lex->capacity; i++) {
+    if (lex->lines[lex->gap_end].error_col >= 0) {
+      lex->error_lines--;
+    }
+    lex->gap_end++;
+  }
+
+  if (added > 0 && ensure_gap(lex, added)) {
+    for (size_t i = 0; i < added; i++) {
+      json_lex_line_t *rec = &lex->lines[lex->gap_start++];
+      memset(rec, 0, sizeof(*rec));
+      rec->error_col = -1;
+    }
+  }
+
+  // si quedaba trabajo pendiente, la cadena de estados está cortada en
+  // next y lo marcado como cambiado también cuenta: no se puede cortar por
+  // coincidencia antes de ninguno de los dos
+  size_t stale_end = line + 1 + added;
+  if (pending) {
+    size_t old_next = shift_line(lex->next, line, removed, added) + 1;
+    size_t old_stale = shift_line(lex->stale_end, line, removed, added);
+    if (old_next > stale_end) {
+      stale_end = old_next;
+    }
+    if (old_stale > stale_end) {
+      stale_end = old_stale;
+    }
+  }
+  lex->stale_end = stale_end;
+
+  if (!pending || line < lex->next) {
+    lex->next = line;
+  }
+  if (line < lex->clean_until) {
+    lex->clean_until = line;
+  }
+}
+
+// lexear la línea lex->next y avanzar
+static bool lex_next(json_lex_t *lex, const gap_buffer_t *gb) {
+  size_t line = lex->next;
+  size_t count = line_count(lex);
+
+  bool ok;
+  size_t length = load_line(lex, gb, line, &ok);
+  if (!ok) {
+    return false;
+  }
+
+  json_lex_line_t *rec = record(lex, line);
+  json_lex_state_t state = rec->start;
+  bool had_error = rec->error_col >= 0;
+  lex_line(&state, lex->text, length, NULL, &rec->error, &rec->error_col);
+  if (had_error != (rec->error_col >= 0)) {
+    if (had_error) {
+      lex->error_lines--;
+    } else {
+      lex->error_lines++;
+    }
+  }
+
+  if (line + 1 >= count) {
+    lex->end = state;
+    lex->next = count;
+    return true;
+  }
+
+  json_lex_line_t *following = record(lex, line + 1);
+  if (line + 1 >= lex->stale_end && state_equal(&state, &following->start)) {
+    // de acá en adelante nada cambió
+    lex->next = count;
+  } else {
+    following->start = state;
+    lex->next = line + 1;
+  }
+  return true;
+}
+
+bool json_lex_run(json_lex_t *lex, const gap_buffer_t *gb, size_t min_line,
+                  size_t budget) {
+  size_t count = line_count(lex);
+  while (lex->next < count && lex->next <= min_line) {
+    if (!lex_next(lex, gb)) {
+      return false;
+    }
+  }
+  while (lex->next < count && budget > 0) {
+    if (!lex_next(lex, gb)) {
+      return false;
+    }
+    budget--;
+  }
+  return lex->next >= count;
+}
+
+size_t json_lex_colorize(json_lex_t *lex, const gap_buffer_t *gb, size_t line,
+                         const char **text, const uint8_t **colors) {
+  bool ok;
+  size_t length = load_line(lex, gb, line, &ok);
+  if (!ok) {
+    return 0;
+  }
+
+  json_lex_state_t state = record(lex, line)->start;
+  uint8_t error;
+  int32_t error_col;
+  lex_line(&state, lex->text, length, lex->colors, &error, &error_col);
+
+  *text = lex->text;
+  *colors = lex->colors;
+  return length;
+}
+
+bool json_lex_error(json_lex_t *lex, const gap_buffer_t *gb, size_t *line,
+                    size_t *col, const char **message) {
+  size_t count = line_count(lex);
+  bool done = lex->next >= count;
+  size_t known = done ? count : lex->next;
+
+  // primera línea con error entre las ya lexeadas
+  if (lex->error_lines > 0) {
+    while (lex->clean_until < known &&
+           record(lex, lex->clean_until)->error_col < 0) {
+      lex->clean_until++;
+    }
+    if (lex->clean_until < known) {
+      json_lex_line_t *rec = record(lex, lex->clean_until);
+      *line = lex->clean_until;
+      *col = (size_t)rec->error_col;
+      *message = lex_messages[rec->error];
+      return true;
+    }
+  }
+  if (!done) {
+    return false;
+  }
+
+  // sin errores por línea: falta ver que el documento haya cerrado
+  if (lex->end.expect == EXPECT_END) {
+    return false;
+  }
+  *line = count - 1;
+  *col = gap_buffer_line_length(gb, count - 1);
+  *message = lex_messages[lex->end.expect == EXPECT_DOCUMENT ? LEX_EMPTY
+                                                             : LEX_UNCLOSED];
+  return true;
+}
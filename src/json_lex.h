@@ -0,0 +1,83 @@
+#ifndef JSON_LEX_H
+#define JSON_LEX_H
+
+#include "gap_buffer.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// niveles de anidamiento que se siguen (bson no pasa de 100)
+#define JSON_LEX_MAX_DEPTH 128
+
+// líneas que se lexean por tramo cuando hay tiempo libre
+#define JSON_LEX_CHUNK_LINES 4096
+
+// bit que json_lex_colorize suma al color de un caracter con error
+#define JSON_LEX_ERROR 0x80
+
+// estado del lexer al empezar una línea. un string no puede cruzar líneas,
+// así que alcanza con la pila de contenedores y qué se espera a continuación
+typedef struct {
+  uint64_t arrays[JSON_LEX_MAX_DEPTH / 64]; // bit i: el nivel i es un array
+  uint16_t depth;
+  uint8_t expect;
+} json_lex_state_t;
+
+// resultado guardado por línea
+typedef struct {
+  json_lex_state_t start;
+  int32_t error_col; // -1 si la línea no tiene error
+  uint8_t error;
+} json_lex_line_t;
+
+// validación incremental de un gap buffer. cada línea guarda el estado con
+// el que empieza; al editar se vuelve a lexear desde la línea tocada y se
+// corta apenas el estado al final coincide con el que ya tenía la siguiente,
+// así que una tecla cuesta lo que mide la línea y no el documento. los
+// registros están en un arreglo con hueco en la última línea editada, igual
+// que el texto
+typedef struct {
+  json_lex_line_t *lines;
+  size_t capacity;
+  size_t gap_start;
+  size_t gap_end;
+
+  size_t next;      // primera línea sin lexear (== cantidad: al día)
+  size_t stale_end; // antes de esta línea no se puede cortar por coincidencia
+  json_lex_state_t end; // estado al terminar la última línea
+  size_t error_lines;   // líneas con error
+  size_t clean_until;   // las líneas anteriores no tienen error
+
+  // línea actual para json_lex_colorize
+  char *text;
+  uint8_t *colors;
+  size_t scratch_size;
+} json_lex_t;
+
+// preparar para el texto de gb (todo queda por lexear)
+bool json_lex_init(json_lex_t *lex, const gap_buffer_t *gb);
+
+// liberar
+void json_lex_free(json_lex_t *lex);
+
+// avisar una edición: cambió la línea line, se le unieron las removed
+// siguientes y después de ella se agregaron added líneas nuevas
+void json_lex_edit(json_lex_t *lex, size_t line, size_t removed,
+                   size_t added);
+
+// lexear hasta dejar al día la línea min_line y después hasta budget líneas
+// más; devuelve true si ya no queda nada por lexear
+bool json_lex_run(json_lex_t *lex, const gap_buffer_t *gb, size_t min_line,
+                  size_t budget);
+
+// colores JSON_COLOR_* (con JSON_LEX_ERROR) de una línea ya alcanzada por
+// json_lex_run. text y colors apuntan a memoria de lex hasta la próxima
+// llamada
+size_t json_lex_colorize(json_lex_t *lex, const gap_buffer_t *gb, size_t line,
+                         const char **text, const uint8_t **colors);
+
+// primer error conocido; false si no hay (o todavía no se llegó a él)
+bool json_lex_error(json_lex_t *lex, const gap_buffer_t *gb, size_t *line,
+                    size_t *col, const char **message);
+
+#endif // JSON_LEX_H
@@ -0,0 +1,162 @@
+#include "list_view.h"
+#include "fuzzy.h"
+#include "tui.h"
+#include <string.h>
+
+void list_view_init(list_view_t *list, WINDOW *win, int y, int x, int height,
+                    int width) {
+  list->win = win;
+  list->y = y;
+  list->x = x;
+  list->height = height > 0 ? height : 1;
+  list->width = width > 0 ? width : 1;
+  list->items = NULL;
+  list->notes = NULL;
+  list->order = NULL;
+  list->highlight = NULL;
+  list->count = 0;
+  list->selected = 0;
+  list->scroll_offset = 0;
+  list->drawn_selected = -1;
+  list->drawn_scroll = -1;
+}
+
+void list_view_set_items(list_view_t *list, char **items, int count) {
+  list->items = items;
+  list->notes = NULL;
+  list->order = NULL;
+  list->highlight = NULL;
+  list->count = count;
+  list_view_select(list, list->selected);
+  list_view_invalidate(list);
+}
+
+void list_view_set_notes(list_view_t *list, char **notes) {
+  list->notes = notes;
+  list_view_invalidate(list);
+}
+
+void list_view_set_order(list_view_t *list, const int *order, int count,
+                         const char *highlight) {
+  list->order = order;
+  list->count = count;
+  list->highlight = highlight && *highlight ? highlight : NULL;
+  list_view_select(list, list->selected);
+  list_view_invalidate(list);
+}
+
+int list_view_item(const list_view_t *list, int row) {
+  if (row < 0 || row >= list->count) {
+    return -1;
+  }
+  return list->order ? list->order[row] : row;
+}
+
+void list_view_select(list_view_t *list, int index) {
+  if (index >= list->count) {
+    index = list->count - 1;
+  }
+  if (index < 0) {
+    index = 0;
+  }
+  list->selected = index;
+
+  if (list->selected < list->scroll_offset) {
+    list->scroll_offset = list->selected;
+  } else if (list->selected >= list->scroll_offset + list->height) {
+    list->scroll_offset = list->selected - list->height + 1;
+  }
+}
+
+void list_view_invalidate(list_view_t *list) { list->drawn_selected = -1; }
+
+// texto de una fila con las letras del patrón resaltadas (en tramos, para
+// no partir caracteres de varios bytes)
+static void draw_matches(list_view_t *list, const char *text, int width) {
+  char lower[512];
+  int positions[FUZZY_PATTERN_MAX];
+  fuzzy_lower(text, lower, sizeof(lower));
+  int count = fuzzy_match(list->highlight, lower, positions) >= 0
+                  ? (int)strlen(list->highlight)
+                  : 0;
+
+  int pos = 0;
+  for (int i = 0; i <= count; i++) {
+    int end = i < count ? positions[i] : width;
+    if (end > width) {
+      end = width;
+    }
+    if (end > pos) {
+      waddnstr(list->win, text + pos, end - pos);
+      pos = end;
+    }
+    if (i < count && pos < width && text[pos] != '\0') {
+      wattron(list->win, A_BOLD | A_UNDERLINE);
+      waddnstr(list->win, text + pos, 1);
+      wattroff(list->win, A_BOLD | A_UNDERLINE);
+      pos++;
+    }
+  }
+}
+
+static void draw_row(list_view_t *list, int index) {
+  int y = list->y + (index - list->scroll_offset);
+  mvwhline(list->win, y, list->x, ' ', list->width);
+
+  int item = list_view_item(list, index);
+  if (item < 0) {
+    return;
+  }
+
+  const char *text = list->items[item];
+  bool selected = index == list->selected;
+  if (selected) {
+    wattron(list->win, COLOR_PAIR(COLOR_PAIR_SELECTED));
+  }
+  mvwaddstr(list->win, y, list->x, selected ? " > " : "   ");
+
+  // el detalle va pegado a la derecha si deja lugar para el nombre
+  int width = list->width - 3;
+  const char *note = list->notes ? list->notes[item] : "";
+  int note_len = (int)strlen(note);
+  if (note_len > 0 && width - note_len - 1 >= 10) {
+    width -= note_len + 1;
+    if (!selected) {
+      wattron(list->win, A_DIM);
+    }
+    mvwaddstr(list->win, y, list->x + list->width - note_len, note);
+    if (!selected) {
+      wattroff(list->win, A_DIM);
+    }
+    wmove(list->win, y, list->x + 3);
+  }
+
+  if (list->highlight) {
+    draw_matches(list, text, width);
+  } else {
+    waddnstr(list->win, text, width);
+  }
+  if (selected) {
+    wattroff(list->win, COLOR_PAIR(COLOR_PAIR_SELECTED));
+  }
+}
+
+void list_view_draw(list_view_t *list) {
+  if (!list->win) {
+    return;
+  }
+
+  if (list->drawn_selected < 0 || list->drawn_scroll != list->scroll_offset) {
+    // todo: primera vez o cambió el scroll
+    for (int row = 0; row < list->height; row++) {
+      draw_row(list, list->scroll_offset + row);
+    }
+  } else if (list->drawn_selected != list->selected) {
+    // sólo la fila que pierde la selección y la que la gana
+    draw_row(list, list->drawn_selected);
+    draw_row(list, list->selected);
+  }
+
+  list->drawn_selected = list->selected;
+  list->drawn_scroll = list->scroll_offset;
+}
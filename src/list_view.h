@@ -0,0 +1,59 @@
+#ifndef LIST_VIEW_H
+#define LIST_VIEW_H
+
+#include <stdbool.h>
+
+// header de curses multiplataforma
+#ifdef _WIN32
+#include <curses.h> // PDCurses en Windows
+#else
+#include <ncurses.h> // ncurses en Unix
+#endif
+
+// lista seleccionable que recuerda lo que dibujó: mover la selección
+// repinta sólo la fila vieja y la nueva, y todo sólo si cambia el scroll
+typedef struct {
+  WINDOW *win;
+  int y, x;
+  int height, width;
+  char **items; // no se copian
+  char **notes; // detalle a la derecha de cada item o NULL; no se copian
+  const int *order;      // filas a mostrar como índices en items (NULL =
+                         // todos, en orden); tampoco se copia
+  const char *highlight; // patrón fuzzy en minúsculas a resaltar o NULL
+  int count;             // filas
+  int selected;
+  int scroll_offset;
+  int drawn_selected; // -1 = hay que repintar todo
+  int drawn_scroll;
+} list_view_t;
+
+// ubicar la lista dentro de una ventana
+void list_view_init(list_view_t *list, WINDOW *win, int y, int x, int height,
+                    int width);
+
+// cambiar los elementos (repinta todo)
+void list_view_set_items(list_view_t *list, char **items, int count);
+
+// detalle a mostrar a la derecha de cada elemento (tamaño, tipo), en el
+// mismo orden que items; NULL para no mostrar nada. set_items lo borra
+void list_view_set_notes(list_view_t *list, char **notes);
+
+// mostrar sólo algunos elementos, en ese orden (un filtro); order NULL
+// vuelve a mostrar todos (count = total)
+void list_view_set_order(list_view_t *list, const int *order, int count,
+                         const char *highlight);
+
+// índice en items de una fila (-1 si no hay)
+int list_view_item(const list_view_t *list, int row);
+
+// seleccionar un índice (se ajusta al rango)
+void list_view_select(list_view_t *list, int index);
+
+// forzar repintado completo (después de un diálogo, por ejemplo)
+void list_view_invalidate(list_view_t *list);
+
+// repintar sólo lo que cambió desde el último draw
+void list_view_draw(list_view_t *list);
+
+#endif // LIST_VIEW_H
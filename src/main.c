@@ -1,6 +1,8 @@
+#include "cli.h"
 #include "mongo_ops.h"
 #include "tui.h"
 #include "screens.h"
+#include "tabs.h"
 #include "json_display.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,8 +22,16 @@ void setup_signal_handlers(void) {
 }
 
 int main(int argc, char *argv[]) {
-    (void)argc;
-    (void)argv;
+    cli_options_t opts;
+    int status = cli_parse(argc, argv, &opts);
+    if (status != 0) {
+        return status < 0 ? 0 : status;
+    }
+
+    // volcar una consulta a stdout y salir, sin abrir la interfaz
+    if (opts.batch) {
+        return cli_run(&opts);
+    }
 
     // inicializar mongo
     mongo_init();
@@ -29,9 +39,30 @@ int main(int argc, char *argv[]) {
     // configurar handlers de señales
     setup_signal_handlers();
 
+    // crear estado de la app
+    app_state_t *state = app_state_new();
+    if (!state) {
+        mongo_cleanup();
+        fprintf(stderr, "Failed to create application state\n");
+        return 1;
+    }
+
+    // con un URI a mano, conectar mientras arranca la interfaz
+    session_t start;
+    cli_startup(&opts, &start);
+    if (start.uri[0] != '\0') {
+        app_restore_session(state, &start);
+        mongo_connect_start(state->mongo_ctx, start.uri);
+    }
+
+    // la primera pestaña; Ctrl-T abre otras
+    tabs_t tabs;
+    tabs_init(&tabs, state);
+
     // inicializar TUI
     if (!tui_init()) {
         fprintf(stderr, "Failed to initialize TUI\n");
+        tabs_free(&tabs);
         mongo_cleanup();
         return 1;
     }
@@ -39,19 +70,15 @@ int main(int argc, char *argv[]) {
     // inicializar colores JSON
     json_init_colors();
 
-    // crear estado de la app
-    app_state_t *state = app_state_new();
-    if (!state) {
-        tui_cleanup();
-        mongo_cleanup();
-        fprintf(stderr, "Failed to create application state\n");
-        return 1;
-    }
-
     // loop principal
     screen_id_t next_screen = SCREEN_CONNECTION;
 
-    while (g_running && !state->should_quit) {
+    while (g_running) {
+        state = tabs_current(&tabs);
+        if (state->should_quit) {
+            break;
+        }
+
         // guardar pantalla anterior para la ayuda
         state->previous_screen = state->current_screen;
         state->current_screen = next_screen;
@@ -87,6 +114,21 @@ int main(int argc, char *argv[]) {
                 break;
         }
 
+        // la pantalla ya no está retomando lo que había
+        state->resume = false;
+
+        // salir desde una de varias pestañas cierra sólo ésa
+        if (next_screen == SCREEN_QUIT && tabs.count > 1) {
+            state->should_quit = false;
+            state->tab_request = TAB_CLOSE;
+            next_screen = SCREEN_TABS;
+        }
+
+        // cambiar, abrir o cerrar pestañas
+        if (next_screen == SCREEN_TABS) {
+            next_screen = tabs_apply(&tabs, state->current_screen);
+        }
+
         // ver si hubo interrupción
         if (!g_running) {
             break;
@@ -94,7 +136,8 @@ int main(int argc, char *argv[]) {
     }
 
     // limpiar todo
-    app_state_free(state);
+    app_save_session(tabs_current(&tabs));
+    tabs_free(&tabs);
     tui_cleanup();
     mongo_cleanup();
 
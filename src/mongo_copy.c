@@ -0,0 +1,589 @@
+#include "mongo_copy.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// código de error del servidor cuando la colección no existe
+#define NAMESPACE_NOT_FOUND 26
+
+// hosts que se miran para saber si dos conexiones van al mismo servidor
+#define COPY_MAX_HOSTS 64
+#define COPY_HOST_LEN 272
+
+typedef struct {
+  char names[COPY_MAX_HOSTS][COPY_HOST_LEN];
+  int count;
+} host_set_t;
+
+// lote de documentos copiados del cursor
+typedef struct {
+  bson_t **docs;
+  int count;
+  size_t bytes;
+} copy_batch_t;
+
+// cola acotada entre el hilo lector y el escritor
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  copy_batch_t slots[COPY_QUEUE_DEPTH];
+  int head;
+  int count;
+  bool closed;  // el lector no va a mandar más lotes
+  bool aborted; // error del escritor o cancelación
+
+  // lado escritor (su propio cliente)
+  mongoc_client_t *client;
+  const char *db_name;
+  const char *coll_name;
+
+  long long docs_written;
+  long long bytes_written;
+  char error_message[512];
+} copy_queue_t;
+
+static void batch_free(copy_batch_t *batch) {
+  if (!batch->docs) {
+    return;
+  }
+
+  for (int i = 0; i < batch->count; i++) {
+    bson_destroy(batch->docs[i]);
+  }
+  free(batch->docs);
+  batch->docs = NULL;
+  batch->count = 0;
+  batch->bytes = 0;
+}
+
+static bool batch_init(copy_batch_t *batch) {
+  batch->docs = malloc(COPY_BATCH_DOCS * sizeof(bson_t *));
+  batch->count = 0;
+  batch->bytes = 0;
+  return batch->docs != NULL;
+}
+
+// encolar lote (bloquea si la cola está llena); el lote pasa a la cola
+static bool queue_push(copy_queue_t *q, copy_batch_t *batch) {
+  pthread_mutex_lock(&q->lock);
+  while (q->count == COPY_QUEUE_DEPTH && !q->aborted) {
+    pthread_cond_wait(&q->not_full, &q->lock);
+  }
+
+  if (q->aborted) {
+    pthread_mutex_unlock(&q->lock);
+    batch_free(batch);
+    return false;
+  }
+
+  q->slots[(q->head + q->count) % COPY_QUEUE_DEPTH] = *batch;
+  q->count++;
+  pthread_cond_signal(&q->not_empty);
+  pthread_mutex_unlock(&q->lock);
+
+  batch->docs = NULL;
+  batch->count = 0;
+  batch->bytes = 0;
+  return true;
+}
+
+// desencolar lote; false cuando no hay más trabajo
+static bool queue_pop(copy_queue_t *q, copy_batch_t *out) {
+  pthread_mutex_lock(&q->lock);
+  while (q->count == 0 && !q->closed && !q->aborted) {
+    pthread_cond_wait(&q->not_empty, &q->lock);
+  }
+
+  if (q->aborted || q->count == 0) {
+    pthread_mutex_unlock(&q->lock);
+    return false;
+  }
+
+  *out = q->slots[q->head];
+  q->head = (q->head + 1) % COPY_QUEUE_DEPTH;
+  q->count--;
+  pthread_cond_signal(&q->not_full);
+  pthread_mutex_unlock(&q->lock);
+  return true;
+}
+
+static void queue_abort(copy_queue_t *q, const char *message) {
+  pthread_mutex_lock(&q->lock);
+  if (!q->aborted && message) {
+    snprintf(q->error_message, sizeof(q->error_message), "%s", message);
+  }
+  q->aborted = true;
+  pthread_cond_broadcast(&q->not_empty);
+  pthread_cond_broadcast(&q->not_full);
+  pthread_mutex_unlock(&q->lock);
+}
+
+static void queue_close(copy_queue_t *q) {
+  pthread_mutex_lock(&q->lock);
+  q->closed = true;
+  pthread_cond_broadcast(&q->not_empty);
+  pthread_mutex_unlock(&q->lock);
+}
+
+// hilo escritor: bulk insert desordenado de cada lote
+static void *copy_writer(void *arg) {
+  copy_queue_t *q = arg;
+
+  mongoc_collection_t *collection =
+      mongoc_client_get_collection(q->client, q->db_name, q->coll_name);
+  bson_t *bulk_opts = BCON_NEW("ordered", BCON_BOOL(false));
+
+  copy_batch_t batch;
+  while (queue_pop(q, &batch)) {
+    bson_error_t error;
+    mongoc_bulk_operation_t *bulk =
+        mongoc_collection_create_bulk_operation_with_opts(collection,
+                                                          bulk_opts);
+
+    bool ok = true;
+    for (int i = 0; i < batch.count && ok; i++) {
+      ok = mongoc_bulk_operation_insert_with_opts(bulk, batch.docs[i], NULL,
+                                                  &error);
+    }
+
+    bson_t reply;
+    if (ok) {
+      ok = mongoc_bulk_operation_execute(bulk, &reply, &error) != 0;
+      bson_destroy(&reply);
+    }
+    mongoc_bulk_operation_destroy(bulk);
+
+    if (!ok) {
+      char message[512];
+      snprintf(message, sizeof(message), "Bulk insert failed: %s",
+               error.message);
+      queue_abort(q, message);
+      batch_free(&batch);
+      break;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    q->docs_written += batch.count;
+    q->bytes_written += (long long)batch.bytes;
+    pthread_mutex_unlock(&q->lock);
+
+    batch_free(&batch);
+  }
+
+  bson_destroy(bulk_opts);
+  mongoc_collection_destroy(collection);
+  return NULL;
+}
+
+static void fill_progress(copy_progress_t *p, copy_queue_t *q,
+                          int64_t start_usec) {
+  pthread_mutex_lock(&q->lock);
+  p->docs_written = q->docs_written;
+  p->bytes_written = q->bytes_written;
+  p->batches_queued = q->count;
+  pthread_mutex_unlock(&q->lock);
+
+  p->elapsed_sec = (bson_get_monotonic_time() - start_usec) / 1000000.0;
+  if (p->elapsed_sec > 0) {
+    p->docs_per_sec = p->docs_written / p->elapsed_sec;
+    p->mb_per_sec = p->bytes_written / (1024.0 * 1024.0) / p->elapsed_sec;
+  }
+}
+
+// recrear en el destino los índices de la fuente (menos _id_)
+static int copy_indexes(mongoc_collection_t *src_collection,
+                        mongoc_client_t *dst_client, const char *dst_db,
+                        const char *dst_coll, char *err, size_t err_size) {
+  mongoc_cursor_t *cursor =
+      mongoc_collection_find_indexes_with_opts(src_collection, NULL);
+
+  bson_t *command = BCON_NEW("createIndexes", BCON_UTF8(dst_coll));
+  bson_t indexes;
+  BSON_APPEND_ARRAY_BEGIN(command, "indexes", &indexes);
+
+  const bson_t *spec;
+  int count = 0;
+  while (mongoc_cursor_next(cursor, &spec)) {
+    bson_iter_t iter;
+    if (bson_iter_init_find(&iter, spec, "name") &&
+        strcmp(bson_iter_utf8(&iter, NULL), "_id_") == 0) {
+      continue;
+    }
+
+    char key[16];
+    snprintf(key, sizeof(key), "%d", count);
+
+    // copiar la especificación sin los campos que pone el servidor
+    bson_t index;
+    bson_append_document_begin(&indexes, key, -1, &index);
+    if (bson_iter_init(&iter, spec)) {
+      while (bson_iter_next(&iter)) {
+        const char *field = bson_iter_key(&iter);
+        if (strcmp(field, "v") == 0 || strcmp(field, "ns") == 0) {
+          continue;
+        }
+        bson_append_iter(&index, field, -1, &iter);
+      }
+    }
+    bson_append_document_end(&indexes, &index);
+    count++;
+  }
+  bson_append_array_end(command, &indexes);
+
+  bson_error_t error;
+  if (mongoc_cursor_error(cursor, &error)) {
+    snprintf(err, err_size, "Failed to list indexes: %s", error.message);
+    count = -1;
+  } else if (count > 0) {
+    bson_t reply;
+    if (!mongoc_client_command_simple(dst_client, dst_db, command, NULL,
+                                      &reply, &error)) {
+      snprintf(err, err_size, "Failed to create indexes: %s", error.message);
+      count = -1;
+    }
+    bson_destroy(&reply);
+  }
+
+  mongoc_cursor_destroy(cursor);
+  bson_destroy(command);
+  return count;
+}
+
+// uuid de db.coll según listCollections. false si no se pudo preguntar;
+// si se pudo, *found dice si la colección existe y trae uuid
+static bool collection_uuid(mongoc_client_t *client, const char *db_name,
+                            const char *coll_name, uint8_t uuid[16],
+                            bool *found) {
+  *found = false;
+  mongoc_database_t *database = mongoc_client_get_database(client, db_name);
+  bson_t *opts = BCON_NEW("filter", "{", "name", BCON_UTF8(coll_name), "}");
+  mongoc_cursor_t *cursor =
+      mongoc_database_find_collections_with_opts(database, opts);
+
+  const bson_t *info;
+  while (mongoc_cursor_next(cursor, &info)) {
+    bson_iter_t iter, field;
+    bson_subtype_t subtype;
+    uint32_t len;
+    const uint8_t *data;
+    if (bson_iter_init(&iter, info) &&
+        bson_iter_find_descendant(&iter, "info.uuid", &field) &&
+        BSON_ITER_HOLDS_BINARY(&field)) {
+      bson_iter_binary(&field, &subtype, &len, &data);
+      if (len == 16) {
+        memcpy(uuid, data, 16);
+        *found = true;
+      }
+    }
+  }
+
+  bson_error_t error;
+  bool ok = !mongoc_cursor_error(cursor, &error);
+  mongoc_cursor_destroy(cursor);
+  bson_destroy(opts);
+  mongoc_database_destroy(database);
+  return ok;
+}
+
+// host:port en minúsculas, con localhost como 127.0.0.1
+static void host_set_add(host_set_t *set, const char *host) {
+  if (set->count == COPY_MAX_HOSTS) {
+    return;
+  }
+  char *name = set->names[set->count++];
+  if (strncmp(host, "localhost:", 10) == 0) {
+    snprintf(name, COPY_HOST_LEN, "127.0.0.1%s", host + 9);
+  } else {
+    snprintf(name, COPY_HOST_LEN, "%s", host);
+  }
+  for (char *p = name; *p; p++) {
+    *p = (char)tolower((unsigned char)*p);
+  }
+}
+
+static void host_set_add_array(host_set_t *set, const bson_t *reply,
+                               const char *key) {
+  bson_iter_t iter, child;
+  if (bson_iter_init_find(&iter, reply, key) &&
+      BSON_ITER_HOLDS_ARRAY(&iter) && bson_iter_recurse(&iter, &child)) {
+    while (bson_iter_next(&child)) {
+      if (BSON_ITER_HOLDS_UTF8(&child)) {
+        host_set_add(set, bson_iter_utf8(&child, NULL));
+      }
+    }
+  }
+}
+
+// miembros del replica set según hello, o los hosts de la URI si es un
+// standalone o un mongos (que no los informan). false si hello falla
+static bool deployment_hosts(mongo_context_t *ctx, host_set_t *set,
+                             char *set_name, size_t set_name_size) {
+  set->count = 0;
+  set_name[0] = '\0';
+
+  bson_t *command = BCON_NEW("hello", BCON_INT32(1));
+  bson_t reply;
+  bson_error_t error;
+  bool ok = mongoc_client_command_simple(ctx->client, "admin", command, NULL,
+                                         &reply, &error);
+  if (ok) {
+    bson_iter_t iter;
+    if (bson_iter_init_find(&iter, &reply, "setName") &&
+        BSON_ITER_HOLDS_UTF8(&iter)) {
+      snprintf(set_name, set_name_size, "%s", bson_iter_utf8(&iter, NULL));
+    }
+    if (bson_iter_init_find(&iter, &reply, "me") &&
+        BSON_ITER_HOLDS_UTF8(&iter)) {
+      host_set_add(set, bson_iter_utf8(&iter, NULL));
+    }
+    host_set_add_array(set, &reply, "hosts");
+    host_set_add_array(set, &reply, "passives");
+    host_set_add_array(set, &reply, "arbiters");
+  }
+  bson_destroy(&reply);
+  bson_destroy(command);
+
+  if (ok && set->count == 0 && ctx->uri) {
+    for (const mongoc_host_list_t *host = mongoc_uri_get_hosts(ctx->uri);
+         host; host = host->next) {
+      host_set_add(set, host->host_and_port);
+    }
+  }
+  return ok;
+}
+
+// las dos conexiones llegan al mismo servidor: mismo replica set con algún
+// miembro en común, o algún host en común. si no se puede saber, se asume
+// que sí
+static bool same_deployment(mongo_context_t *a, mongo_context_t *b) {
+  host_set_t *hosts = calloc(2, sizeof(host_set_t));
+  char set_a[256], set_b[256];
+  if (!hosts || !deployment_hosts(a, &hosts[0], set_a, sizeof(set_a)) ||
+      !deployment_hosts(b, &hosts[1], set_b, sizeof(set_b))) {
+    free(hosts);
+    return true;
+  }
+
+  bool same = false;
+  if (strcmp(set_a, set_b) == 0) {
+    for (int i = 0; i < hosts[0].count && !same; i++) {
+      for (int j = 0; j < hosts[1].count && !same; j++) {
+        same = strcmp(hosts[0].names[i], hosts[1].names[j]) == 0;
+      }
+    }
+  }
+  free(hosts);
+  return same;
+}
+
+// el destino es la misma colección que la fuente (aunque se llegue por
+// otra conexión): con el mismo namespace, se comparan los uuid y, si el
+// servidor no los da, los hosts del deployment
+static bool same_collection(mongo_context_t *src, const char *src_db,
+                            const char *src_coll, mongo_context_t *dst,
+                            const char *dst_db, const char *dst_coll) {
+  if (strcmp(src_db, dst_db) != 0 || strcmp(src_coll, dst_coll) != 0) {
+    return false;
+  }
+  if (src == dst || src->client == dst->client) {
+    return true;
+  }
+
+  // si el destino no está (o tiene otro uuid) no puede ser la fuente
+  uint8_t uuid_src[16], uuid_dst[16];
+  bool found_src, found_dst;
+  if (collection_uuid(src->client, src_db, src_coll, uuid_src, &found_src) &&
+      found_src &&
+      collection_uuid(dst->client, dst_db, dst_coll, uuid_dst, &found_dst)) {
+    return found_dst && memcmp(uuid_src, uuid_dst, 16) == 0;
+  }
+  return same_deployment(src, dst);
+}
+
+bool mongo_copy_collection(mongo_context_t *src, const char *src_db,
+                           const char *src_coll, mongo_context_t *dst,
+                           const char *dst_db, const char *dst_coll,
+                           bool drop_target, copy_progress_fn progress,
+                           void *user_data) {
+  if (!src || !src->client || !dst || !dst->client || !src_db || !src_coll ||
+      !dst_db || !dst_coll) {
+    if (src) {
+      snprintf(src->error_message, sizeof(src->error_message),
+               "Invalid parameters");
+    }
+    return false;
+  }
+
+  // antes de tocar el destino: borrarlo o escribirlo sería perder la fuente
+  if (same_collection(src, src_db, src_coll, dst, dst_db, dst_coll)) {
+    snprintf(src->error_message, sizeof(src->error_message),
+             "Source and target are the same collection");
+    return false;
+  }
+
+  bson_error_t error;
+
+  if (drop_target) {
+    mongoc_collection_t *target =
+        mongoc_client_get_collection(dst->client, dst_db, dst_coll);
+    bool dropped = mongoc_collection_drop(target, &error);
+    mongoc_collection_destroy(target);
+    if (!dropped && error.code != NAMESPACE_NOT_FOUND) {
+      snprintf(src->error_message, sizeof(src->error_message),
+               "Failed to drop target: %s", error.message);
+      return false;
+    }
+  }
+
+  copy_queue_t q;
+  memset(&q, 0, sizeof(q));
+  q.client = mongo_client_spawn(dst);
+  if (!q.client) {
+    snprintf(src->error_message, sizeof(src->error_message), "%s",
+             mongo_get_error(dst));
+    return false;
+  }
+  q.db_name = dst_db;
+  q.coll_name = dst_coll;
+  pthread_mutex_init(&q.lock, NULL);
+  pthread_cond_init(&q.not_empty, NULL);
+  pthread_cond_init(&q.not_full, NULL);
+
+  pthread_t writer;
+  if (pthread_create(&writer, NULL, copy_writer, &q) != 0) {
+    snprintf(src->error_message, sizeof(src->error_message),
+             "Failed to start writer thread");
+    pthread_cond_destroy(&q.not_full);
+    pthread_cond_destroy(&q.not_empty);
+    pthread_mutex_destroy(&q.lock);
+    mongoc_client_destroy(q.client);
+    return false;
+  }
+
+  mongoc_collection_t *src_collection =
+      mongoc_client_get_collection(src->client, src_db, src_coll);
+  bson_t query;
+  bson_init(&query);
+  bson_t *opts = BCON_NEW("batchSize", BCON_INT32(COPY_BATCH_DOCS));
+  mongoc_cursor_t *cursor =
+      mongoc_collection_find_with_opts(src_collection, &query, opts, NULL);
+
+  copy_progress_t p;
+  memset(&p, 0, sizeof(p));
+  p.phase = COPY_PHASE_LOADING;
+  int64_t start = bson_get_monotonic_time();
+  bool cancelled = false;
+
+  // lector: llenar lotes acotados y pasarlos al escritor
+  copy_batch_t batch;
+  bool ok = batch_init(&batch);
+  if (!ok) {
+    queue_abort(&q, "Memory allocation failed");
+  }
+  const bson_t *doc;
+  while (ok && mongoc_cursor_next(cursor, &doc)) {
+    batch.docs[batch.count++] = bson_copy(doc);
+    batch.bytes += doc->len;
+    p.docs_read++;
+    p.bytes_read += doc->len;
+
+    if (batch.count == COPY_BATCH_DOCS || batch.bytes >= COPY_BATCH_BYTES) {
+      if (!queue_push(&q, &batch)) {
+        ok = false;
+        break;
+      }
+      if (!batch_init(&batch)) {
+        queue_abort(&q, "Memory allocation failed");
+        ok = false;
+        break;
+      }
+      fill_progress(&p, &q, start);
+      if (progress && !progress(&p, user_data)) {
+        cancelled = true;
+        ok = false;
+      }
+    }
+  }
+
+  if (ok && mongoc_cursor_error(cursor, &error)) {
+    char message[512];
+    snprintf(message, sizeof(message), "Cursor error: %s", error.message);
+    queue_abort(&q, message);
+    ok = false;
+  }
+
+  if (ok && batch.count > 0) {
+    ok = queue_push(&q, &batch);
+  }
+  batch_free(&batch);
+
+  if (cancelled) {
+    queue_abort(&q, "Copy cancelled");
+  } else {
+    queue_close(&q);
+  }
+
+  // esperar que el escritor vacíe la cola mostrando el lag
+  pthread_mutex_lock(&q.lock);
+  while (q.count > 0 && !q.aborted) {
+    pthread_cond_wait(&q.not_full, &q.lock);
+    pthread_mutex_unlock(&q.lock);
+    fill_progress(&p, &q, start);
+    if (progress && !progress(&p, user_data)) {
+      queue_abort(&q, "Copy cancelled");
+    }
+    pthread_mutex_lock(&q.lock);
+  }
+  pthread_mutex_unlock(&q.lock);
+
+  pthread_join(writer, NULL);
+
+  // liberar lotes que quedaron si se abortó
+  for (int i = 0; i < q.count; i++) {
+    batch_free(&q.slots[(q.head + i) % COPY_QUEUE_DEPTH]);
+  }
+
+  mongoc_cursor_destroy(cursor);
+  bson_destroy(opts);
+  bson_destroy(&query);
+  mongoc_client_destroy(q.client);
+
+  ok = !q.aborted;
+  if (!ok) {
+    snprintf(src->error_message, sizeof(src->error_message), "%s",
+             q.error_message[0] ? q.error_message : "Copy failed");
+  }
+
+  if (ok) {
+    fill_progress(&p, &q, start);
+    p.phase = COPY_PHASE_INDEXES;
+    if (progress) {
+      progress(&p, user_data);
+    }
+
+    int created = copy_indexes(src_collection, dst->client, dst_db, dst_coll,
+                               src->error_message,
+                               sizeof(src->error_message));
+    if (created < 0) {
+      ok = false;
+    } else {
+      p.indexes_created = created;
+      p.phase = COPY_PHASE_DONE;
+      fill_progress(&p, &q, start);
+      if (progress) {
+        progress(&p, user_data);
+      }
+      src->error_message[0] = '\0';
+    }
+  }
+
+  mongoc_collection_destroy(src_collection);
+  pthread_cond_destroy(&q.not_full);
+  pthread_cond_destroy(&q.not_empty);
+  pthread_mutex_destroy(&q.lock);
+
+  return ok;
+}
@@ -0,0 +1,49 @@
+#ifndef MONGO_COPY_H
+#define MONGO_COPY_H
+
+#include "mongo_ops.h"
+#include <stdbool.h>
+
+// documentos por lote y lotes en vuelo entre el lector y el escritor
+#define COPY_BATCH_DOCS 1000
+#define COPY_BATCH_BYTES (8 * 1024 * 1024)
+#define COPY_QUEUE_DEPTH 4
+
+// fase de la copia
+typedef enum {
+  COPY_PHASE_LOADING,
+  COPY_PHASE_INDEXES,
+  COPY_PHASE_DONE
+} copy_phase_t;
+
+// progreso de la copia (se pasa al callback)
+typedef struct {
+  copy_phase_t phase;
+  long long docs_read;
+  long long docs_written;
+  long long bytes_read;
+  long long bytes_written;
+  int batches_queued; // lotes leídos que el escritor todavía no insertó
+  int indexes_created;
+  double elapsed_sec;
+  double docs_per_sec; // throughput de escritura
+  double mb_per_sec;
+} copy_progress_t;
+
+// callback de progreso; devolver false cancela la copia
+typedef bool (*copy_progress_fn)(const copy_progress_t *progress,
+                                 void *user_data);
+
+// copiar una colección a otro namespace (misma conexión u otra).
+// un hilo lee con un cursor y llena lotes acotados mientras otro hilo
+// los inserta desordenados en el destino; al final recrea los índices.
+// se niega (antes de borrar nada) si el destino es la misma colección que
+// la fuente, aunque se llegue a ella por otra conexión.
+// los errores quedan en src->error_message
+bool mongo_copy_collection(mongo_context_t *src, const char *src_db,
+                           const char *src_coll, mongo_context_t *dst,
+                           const char *dst_db, const char *dst_coll,
+                           bool drop_target, copy_progress_fn progress,
+                           void *user_data);
+
+#endif // MONGO_COPY_H
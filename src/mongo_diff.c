@@ -0,0 +1,1142 @@
+#include "mongo_diff.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// los hashes por documento se reducen módulo esto antes de sumarlos para
+// que la suma de un rango entre en un int64 en el servidor
+#define DIFF_HASH_MOD 2147483647LL
+
+// largo máximo de una ruta con puntos en mongo_diff_document
+#define DIFF_MAX_PATH 1024
+
+// rango [lo, hi) de _id; NULL = sin límite (cada extremo es {_id: valor})
+typedef struct {
+  const bson_t *lo;
+  const bson_t *hi;
+} diff_range_t;
+
+// _id y hash de un documento
+typedef struct {
+  bson_t *id;
+  int64_t hash;
+} diff_item_t;
+
+// resumen de un rango
+typedef struct {
+  int64_t count;
+  int64_t hash; // suma de $toHashedIndexKey módulo DIFF_HASH_MOD
+  int64_t size; // suma de $bsonSize
+} diff_summary_t;
+
+typedef struct {
+  mongoc_collection_t *a;
+  mongoc_collection_t *b;
+  diff_result_t *result;
+  diff_progress_fn progress;
+  void *user_data;
+  bool cancelled;
+  char *err;
+  size_t err_size;
+} diff_job_t;
+
+// orden de tipos de BSON al comparar valores (el tipo canónico del
+// servidor: los números entre sí y string con symbol empatan)
+static int type_rank(bson_type_t type) {
+  switch (type) {
+  case BSON_TYPE_MINKEY:
+    return -1;
+  case BSON_TYPE_UNDEFINED:
+    return 0;
+  case BSON_TYPE_NULL:
+    return 5;
+  case BSON_TYPE_INT32:
+  case BSON_TYPE_INT64:
+  case BSON_TYPE_DOUBLE:
+  case BSON_TYPE_DECIMAL128:
+    return 10;
+  case BSON_TYPE_SYMBOL:
+  case BSON_TYPE_UTF8:
+    return 15;
+  case BSON_TYPE_DOCUMENT:
+    return 20;
+  case BSON_TYPE_ARRAY:
+    return 25;
+  case BSON_TYPE_BINARY:
+    return 30;
+  case BSON_TYPE_OID:
+    return 35;
+  case BSON_TYPE_BOOL:
+    return 40;
+  case BSON_TYPE_DATE_TIME:
+    return 45;
+  case BSON_TYPE_TIMESTAMP:
+    return 47;
+  case BSON_TYPE_REGEX:
+    return 50;
+  case BSON_TYPE_DBPOINTER:
+    return 55;
+  case BSON_TYPE_CODE:
+    return 60;
+  case BSON_TYPE_CODEWSCOPE:
+    return 65;
+  default:
+    return 127; // maxkey
+  }
+}
+
+static int compare_raw(const bson_t *x, const bson_t *y) {
+  size_t len = x->len < y->len ? x->len : y->len;
+  int c = memcmp(bson_get_data(x), bson_get_data(y), len);
+  if (c != 0) {
+    return c;
+  }
+  return (x->len > y->len) - (x->len < y->len);
+}
+
+// bytes y después largo, como compara el servidor strings y códigos
+static int compare_bytes(const char *x, uint32_t lx, const char *y,
+                         uint32_t ly) {
+  int c = memcmp(x, y, lx < ly ? lx : ly);
+  if (c != 0) {
+    return c < 0 ? -1 : 1;
+  }
+  return (lx > ly) - (lx < ly);
+}
+
+// un número cualquiera como long double: alcanza para int64 sin perder
+// precisión en x86; decimal128 pasa por su texto
+static long double number_value(const bson_iter_t *iter) {
+  switch (bson_iter_type(iter)) {
+  case BSON_TYPE_DOUBLE:
+    return bson_iter_double(iter);
+  case BSON_TYPE_DECIMAL128: {
+    bson_decimal128_t dec;
+    char text[BSON_DECIMAL128_STRING];
+    bson_iter_decimal128(iter, &dec);
+    bson_decimal128_to_string(&dec, text);
+    return strtold(text, NULL);
+  }
+  default:
+    return (long double)bson_iter_as_int64(iter);
+  }
+}
+
+// NaN va antes que todos los números (y es igual a sí mismo)
+static int compare_numbers(const bson_iter_t *x, const bson_iter_t *y) {
+  if (!BSON_ITER_HOLDS_DOUBLE(x) && !BSON_ITER_HOLDS_DECIMAL128(x) &&
+      !BSON_ITER_HOLDS_DOUBLE(y) && !BSON_ITER_HOLDS_DECIMAL128(y)) {
+    int64_t vx = bson_iter_as_int64(x);
+    int64_t vy = bson_iter_as_int64(y);
+    return (vx > vy) - (vx < vy);
+  }
+
+  long double vx = number_value(x);
+  long double vy = number_value(y);
+  if (isnan(vx) || isnan(vy)) {
+    return (int)!isnan(vx) - (int)!isnan(vy);
+  }
+  return (vx > vy) - (vx < vy);
+}
+
+static const char *iter_string(const bson_iter_t *iter, uint32_t *len) {
+  return BSON_ITER_HOLDS_SYMBOL(iter) ? bson_iter_symbol(iter, len)
+                                      : bson_iter_utf8(iter, len);
+}
+
+static int compare_docs(const bson_t *x, const bson_t *y);
+
+static int compare_values(const bson_iter_t *x, const bson_iter_t *y) {
+  int rx = type_rank(bson_iter_type(x));
+  int ry = type_rank(bson_iter_type(y));
+  if (rx != ry) {
+    return rx < ry ? -1 : 1;
+  }
+
+  switch (bson_iter_type(x)) {
+  case BSON_TYPE_INT32:
+  case BSON_TYPE_INT64:
+  case BSON_TYPE_DOUBLE:
+  case BSON_TYPE_DECIMAL128:
+    return compare_numbers(x, y);
+  case BSON_TYPE_UTF8:
+  case BSON_TYPE_SYMBOL: {
+    uint32_t lx, ly;
+    const char *sx = iter_string(x, &lx);
+    const char *sy = iter_string(y, &ly);
+    return compare_bytes(sx, lx, sy, ly);
+  }
+  case BSON_TYPE_DOCUMENT:
+  case BSON_TYPE_ARRAY: {
+    uint32_t lx, ly;
+    const uint8_t *dx, *dy;
+    bson_t cx, cy;
+    if (BSON_ITER_HOLDS_DOCUMENT(x)) {
+      bson_iter_document(x, &lx, &dx);
+      bson_iter_document(y, &ly, &dy);
+    } else {
+      bson_iter_array(x, &lx, &dx);
+      bson_iter_array(y, &ly, &dy);
+    }
+    if (!bson_init_static(&cx, dx, lx) || !bson_init_static(&cy, dy, ly)) {
+      return 0;
+    }
+    return compare_docs(&cx, &cy);
+  }
+  case BSON_TYPE_BINARY: {
+    // largo, después subtipo, después bytes
+    bson_subtype_t kx, ky;
+    uint32_t lx, ly;
+    const uint8_t *bx, *by;
+    bson_iter_binary(x, &kx, &lx, &bx);
+    bson_iter_binary(y, &ky, &ly, &by);
+    if (lx != ly) {
+      return lx < ly ? -1 : 1;
+    }
+    if (kx != ky) {
+      return kx < ky ? -1 : 1;
+    }
+    return compare_bytes((const char *)bx, lx, (const char *)by, ly);
+  }
+  case BSON_TYPE_OID:
+    return bson_oid_compare(bson_iter_oid(x), bson_iter_oid(y));
+  case BSON_TYPE_BOOL:
+    return (int)bson_iter_bool(x) - (int)bson_iter_bool(y);
+  case BSON_TYPE_DATE_TIME: {
+    int64_t vx = bson_iter_date_time(x);
+    int64_t vy = bson_iter_date_time(y);
+    return (vx > vy) - (vx < vy);
+  }
+  case BSON_TYPE_TIMESTAMP: {
+    // sin signo: primero los segundos, después el incremento
+    uint32_t tx, ix, ty, iy;
+    bson_iter_timestamp(x, &tx, &ix);
+    bson_iter_timestamp(y, &ty, &iy);
+    if (tx != ty) {
+      return tx < ty ? -1 : 1;
+    }
+    return (ix > iy) - (ix < iy);
+  }
+  case BSON_TYPE_REGEX: {
+    const char *ox, *oy;
+    const char *px = bson_iter_regex(x, &ox);
+    const char *py = bson_iter_regex(y, &oy);
+    int c = strcmp(px, py);
+    if (c == 0) {
+      c = strcmp(ox, oy);
+    }
+    return (c > 0) - (c < 0);
+  }
+  case BSON_TYPE_DBPOINTER: {
+    uint32_t lx, ly;
+    const char *nx, *ny;
+    const bson_oid_t *ox, *oy;
+    bson_iter_dbpointer(x, &lx, &nx, &ox);
+    bson_iter_dbpointer(y, &ly, &ny, &oy);
+    if (lx != ly) {
+      return lx < ly ? -1 : 1;
+    }
+    int c = compare_bytes(nx, lx, ny, ly);
+    return c != 0 ? c : bson_oid_compare(ox, oy);
+  }
+  case BSON_TYPE_CODE: {
+    uint32_t lx, ly;
+    const char *cx = bson_iter_code(x, &lx);
+    const char *cy = bson_iter_code(y, &ly);
+    return compare_bytes(cx, lx, cy, ly);
+  }
+  case BSON_TYPE_CODEWSCOPE: {
+    uint32_t lx, ly, sx, sy;
+    const uint8_t *dx, *dy;
+    const char *cx = bson_iter_codewscope(x, &lx, &sx, &dx);
+    const char *cy = bson_iter_codewscope(y, &ly, &sy, &dy);
+    int c = compare_bytes(cx, lx, cy, ly);
+    bson_t scope_x, scope_y;
+    if (c != 0 || !bson_init_static(&scope_x, dx, sx) ||
+        !bson_init_static(&scope_y, dy, sy)) {
+      return c;
+    }
+    return compare_docs(&scope_x, &scope_y);
+  }
+  default:
+    return 0; // minkey, maxkey, null, undefined: un solo valor
+  }
+}
+
+// campo por campo: tipo, nombre y valor; el más corto va primero
+static int compare_docs(const bson_t *x, const bson_t *y) {
+  bson_iter_t ix, iy;
+  if (!bson_iter_init(&ix, x) || !bson_iter_init(&iy, y)) {
+    return compare_raw(x, y);
+  }
+
+  while (true) {
+    bool more_x = bson_iter_next(&ix);
+    bool more_y = bson_iter_next(&iy);
+    if (!more_x || !more_y) {
+      return (int)more_x - (int)more_y;
+    }
+
+    int rx = type_rank(bson_iter_type(&ix));
+    int ry = type_rank(bson_iter_type(&iy));
+    if (rx != ry) {
+      return rx < ry ? -1 : 1;
+    }
+    int c = strcmp(bson_iter_key(&ix), bson_iter_key(&iy));
+    if (c != 0) {
+      return c < 0 ? -1 : 1;
+    }
+    c = compare_values(&ix, &iy);
+    if (c != 0) {
+      return c;
+    }
+  }
+}
+
+// comparar dos documentos {_id: valor} en el orden de sort del servidor
+static int compare_ids(const bson_t *x, const bson_t *y) {
+  bson_iter_t ix, iy;
+  if (!bson_iter_init_find(&ix, x, "_id") ||
+      !bson_iter_init_find(&iy, y, "_id")) {
+    return compare_docs(x, y);
+  }
+  return compare_values(&ix, &iy);
+}
+
+static bson_t *copy_id(const bson_t *doc) {
+  bson_iter_t iter;
+  if (!bson_iter_init_find(&iter, doc, "_id")) {
+    return NULL;
+  }
+
+  bson_t *id = bson_new();
+  bson_append_iter(id, "_id", 3, &iter);
+  return id;
+}
+
+static void add_entry(diff_result_t *result, diff_kind_t kind,
+                      const bson_t *id) {
+  result->stats.differences++;
+
+  if (result->count >= DIFF_MAX_ENTRIES) {
+    result->truncated = true;
+    return;
+  }
+
+  if (result->count == result->capacity) {
+    int capacity = result->capacity ? result->capacity * 2 : 64;
+    diff_entry_t *entries =
+        realloc(result->entries, capacity * sizeof(diff_entry_t));
+    if (!entries) {
+      result->truncated = true;
+      return;
+    }
+    result->entries = entries;
+    result->capacity = capacity;
+  }
+
+  result->entries[result->count].kind = kind;
+  result->entries[result->count].id = bson_copy(id);
+  result->count++;
+}
+
+static bool report(diff_job_t *job) {
+  if (job->progress && !job->progress(&job->result->stats, job->user_data)) {
+    job->cancelled = true;
+    snprintf(job->err, job->err_size, "Diff cancelled");
+    return false;
+  }
+  return true;
+}
+
+// tipos de BSON que puede tener un _id (los arrays no), para acotar por
+// clase de type_rank
+static const bson_type_t id_types[] = {
+    BSON_TYPE_MINKEY,     BSON_TYPE_UNDEFINED,  BSON_TYPE_NULL,
+    BSON_TYPE_INT32,      BSON_TYPE_INT64,      BSON_TYPE_DOUBLE,
+    BSON_TYPE_DECIMAL128, BSON_TYPE_SYMBOL,     BSON_TYPE_UTF8,
+    BSON_TYPE_DOCUMENT,   BSON_TYPE_BINARY,     BSON_TYPE_OID,
+    BSON_TYPE_BOOL,       BSON_TYPE_DATE_TIME,  BSON_TYPE_TIMESTAMP,
+    BSON_TYPE_REGEX,      BSON_TYPE_DBPOINTER,  BSON_TYPE_CODE,
+    BSON_TYPE_CODEWSCOPE, BSON_TYPE_MAXKEY};
+
+// {$type: [...]} con los tipos cuya clase está en [min_rank, max_rank];
+// false (sin agregar nada) si no hay ninguno
+static bool append_type_cond(bson_t *cond, int min_rank, int max_rank) {
+  bson_t types;
+  int count = 0;
+  for (size_t i = 0; i < sizeof(id_types) / sizeof(id_types[0]); i++) {
+    int rank = type_rank(id_types[i]);
+    if (rank < min_rank || rank > max_rank) {
+      continue;
+    }
+    if (count == 0) {
+      BSON_APPEND_ARRAY_BEGIN(cond, "$type", &types);
+    }
+    char key[16];
+    snprintf(key, sizeof(key), "%d", count++);
+    // el código de minKey en $type es -1
+    BSON_APPEND_INT32(&types, key,
+                      id_types[i] == BSON_TYPE_MINKEY ? -1 : (int)id_types[i]);
+  }
+  if (count > 0) {
+    bson_append_array_end(cond, &types);
+  }
+  return count > 0;
+}
+
+// {_id: {op: valor, $type: [tipos de su clase]}}
+static void append_bound_term(bson_t *terms, const char *key, const char *op,
+                              const bson_iter_t *bound) {
+  bson_t term, cond;
+  bson_append_document_begin(terms, key, -1, &term);
+  BSON_APPEND_DOCUMENT_BEGIN(&term, "_id", &cond);
+  bson_append_iter(&cond, op, -1, bound);
+  int rank = type_rank(bson_iter_type(bound));
+  append_type_cond(&cond, rank, rank);
+  bson_append_document_end(&term, &cond);
+  bson_append_document_end(terms, &term);
+}
+
+// {$match: {_id: {$gte: lo, $lt: hi}}}. una consulta sólo compara valores
+// de la misma clase de tipo que el límite, así que si lo y hi son de
+// clases distintas (o falta uno) el rango se arma como un $or por clase:
+// [lo, fin de su clase), las clases del medio enteras y [inicio de la
+// clase de hi, hi). si no, un rango de _id mixtos contaría 0 en los dos
+// lados y se daría por igual
+static void append_match_stage(bson_t *pipeline, const char *key,
+                               const diff_range_t *range) {
+  bson_iter_t lo, hi;
+  bool has_lo = range->lo && bson_iter_init_find(&lo, range->lo, "_id");
+  bool has_hi = range->hi && bson_iter_init_find(&hi, range->hi, "_id");
+  int lo_rank = has_lo ? type_rank(bson_iter_type(&lo)) : -2;
+  int hi_rank = has_hi ? type_rank(bson_iter_type(&hi)) : 128;
+
+  bson_t stage, match, cond;
+  bson_append_document_begin(pipeline, key, -1, &stage);
+  BSON_APPEND_DOCUMENT_BEGIN(&stage, "$match", &match);
+  if (has_lo && has_hi && lo_rank == hi_rank) {
+    BSON_APPEND_DOCUMENT_BEGIN(&match, "_id", &cond);
+    bson_append_iter(&cond, "$gte", 4, &lo);
+    bson_append_iter(&cond, "$lt", 3, &hi);
+    bson_append_document_end(&match, &cond);
+  } else if (has_lo || has_hi) {
+    bson_t terms, term;
+    int count = 0;
+    char term_key[16];
+    BSON_APPEND_ARRAY_BEGIN(&match, "$or", &terms);
+    if (has_lo) {
+      snprintf(term_key, sizeof(term_key), "%d", count++);
+      append_bound_term(&terms, term_key, "$gte", &lo);
+    }
+    // las clases entre las dos, enteras; se arma aparte por si no queda
+    // ninguna
+    bson_t middle;
+    bson_init(&middle);
+    if (append_type_cond(&middle, lo_rank + 1, hi_rank - 1)) {
+      snprintf(term_key, sizeof(term_key), "%d", count++);
+      bson_append_document_begin(&terms, term_key, -1, &term);
+      BSON_APPEND_DOCUMENT(&term, "_id", &middle);
+      bson_append_document_end(&terms, &term);
+    }
+    bson_destroy(&middle);
+    if (has_hi) {
+      snprintf(term_key, sizeof(term_key), "%d", count++);
+      append_bound_term(&terms, term_key, "$lt", &hi);
+    }
+    bson_append_array_end(&match, &terms);
+  }
+  bson_append_document_end(&stage, &match);
+  bson_append_document_end(pipeline, &stage);
+}
+
+// expresión {$toHashedIndexKey: "$$ROOT"}
+static void append_hash_expr(bson_t *parent, const char *key) {
+  bson_t expr;
+  bson_append_document_begin(parent, key, -1, &expr);
+  BSON_APPEND_UTF8(&expr, "$toHashedIndexKey", "$$ROOT");
+  bson_append_document_end(parent, &expr);
+}
+
+// expresión {$bsonSize: "$$ROOT"}: separa lo que el hash confunde cuando
+// cambia el tamaño (int32 por double, un campo que pasa a otro tipo...)
+static void append_size_expr(bson_t *parent, const char *key) {
+  bson_t expr;
+  bson_append_document_begin(parent, key, -1, &expr);
+  BSON_APPEND_UTF8(&expr, "$bsonSize", "$$ROOT");
+  bson_append_document_end(parent, &expr);
+}
+
+static mongoc_cursor_t *run_pipeline(mongoc_collection_t *collection,
+                                     bson_t *pipeline) {
+  bson_t *opts = BCON_NEW("allowDiskUse", BCON_BOOL(true));
+  mongoc_cursor_t *cursor = mongoc_collection_aggregate(
+      collection, MONGOC_QUERY_NONE, pipeline, opts, NULL);
+  bson_destroy(opts);
+  return cursor;
+}
+
+// cantidad, hash combinado y bytes totales de un rango, calculados en el
+// servidor. dos rangos con los tres iguales se dan por iguales sin bajar
+static bool range_summary(diff_job_t *job, mongoc_collection_t *collection,
+                          const diff_range_t *range, diff_summary_t *summary) {
+  bson_t pipeline;
+  bson_init(&pipeline);
+  append_match_stage(&pipeline, "0", range);
+
+  bson_t stage, group, sum, mod, mod_args;
+  BSON_APPEND_DOCUMENT_BEGIN(&pipeline, "1", &stage);
+  BSON_APPEND_DOCUMENT_BEGIN(&stage, "$group", &group);
+  BSON_APPEND_NULL(&group, "_id");
+  bson_t n;
+  BSON_APPEND_DOCUMENT_BEGIN(&group, "n", &n);
+  BSON_APPEND_INT32(&n, "$sum", 1);
+  bson_append_document_end(&group, &n);
+  BSON_APPEND_DOCUMENT_BEGIN(&group, "h", &sum);
+  BSON_APPEND_DOCUMENT_BEGIN(&sum, "$sum", &mod);
+  BSON_APPEND_ARRAY_BEGIN(&mod, "$mod", &mod_args);
+  append_hash_expr(&mod_args, "0");
+  bson_append_int64(&mod_args, "1", 1, DIFF_HASH_MOD);
+  bson_append_array_end(&mod, &mod_args);
+  bson_append_document_end(&sum, &mod);
+  bson_append_document_end(&group, &sum);
+  BSON_APPEND_DOCUMENT_BEGIN(&group, "s", &sum);
+  append_size_expr(&sum, "$sum");
+  bson_append_document_end(&group, &sum);
+  bson_append_document_end(&stage, &group);
+  bson_append_document_end(&pipeline, &stage);
+
+  mongoc_cursor_t *cursor = run_pipeline(collection, &pipeline);
+
+  memset(summary, 0, sizeof(*summary));
+  const bson_t *doc;
+  if (mongoc_cursor_next(cursor, &doc)) {
+    bson_iter_t iter;
+    if (bson_iter_init_find(&iter, doc, "n")) {
+      summary->count = bson_iter_as_int64(&iter);
+    }
+    if (bson_iter_init_find(&iter, doc, "h")) {
+      summary->hash = bson_iter_as_int64(&iter);
+    }
+    if (bson_iter_init_find(&iter, doc, "s")) {
+      summary->size = bson_iter_as_int64(&iter);
+    }
+  }
+
+  bson_error_t error;
+  bool ok = !mongoc_cursor_error(cursor, &error);
+  if (!ok) {
+    snprintf(job->err, job->err_size, "Range hash failed: %s",
+             error.message);
+  }
+
+  mongoc_cursor_destroy(cursor);
+  bson_destroy(&pipeline);
+  return ok;
+}
+
+// puntos de corte (_id) que parten el rango en DIFF_FANOUT partes parejas
+static bson_t **range_splits(diff_job_t *job, mongoc_collection_t *collection,
+                             const diff_range_t *range, int *count) {
+  bson_t pipeline;
+  bson_init(&pipeline);
+  append_match_stage(&pipeline, "0", range);
+
+  bson_t stage, bucket;
+  BSON_APPEND_DOCUMENT_BEGIN(&pipeline, "1", &stage);
+  BSON_APPEND_DOCUMENT_BEGIN(&stage, "$bucketAuto", &bucket);
+  BSON_APPEND_UTF8(&bucket, "groupBy", "$_id");
+  BSON_APPEND_INT32(&bucket, "buckets", DIFF_FANOUT);
+  bson_append_document_end(&stage, &bucket);
+  bson_append_document_end(&pipeline, &stage);
+
+  mongoc_cursor_t *cursor = run_pipeline(collection, &pipeline);
+
+  bson_t **splits = malloc(DIFF_FANOUT * sizeof(bson_t *));
+  *count = 0;
+
+  // el mínimo de cada bucket (salvo el primero) es un punto de corte
+  const bson_t *doc;
+  bool first = true;
+  while (splits && mongoc_cursor_next(cursor, &doc)) {
+    bson_iter_t iter, min;
+    if (first) {
+      first = false;
+      continue;
+    }
+    if (*count < DIFF_FANOUT && bson_iter_init(&iter, doc) &&
+        bson_iter_find_descendant(&iter, "_id.min", &min)) {
+      bson_t *split = bson_new();
+      bson_append_iter(split, "_id", 3, &min);
+      splits[(*count)++] = split;
+    }
+  }
+
+  bson_error_t error;
+  if (mongoc_cursor_error(cursor, &error)) {
+    snprintf(job->err, job->err_size, "Range split failed: %s",
+             error.message);
+    for (int i = 0; i < *count; i++) {
+      bson_destroy(splits[i]);
+    }
+    free(splits);
+    splits = NULL;
+    *count = 0;
+  }
+
+  mongoc_cursor_destroy(cursor);
+  bson_destroy(&pipeline);
+  return splits;
+}
+
+// FNV-1a de 64 bits sobre los bytes del documento
+static int64_t hash_bytes(const uint8_t *data, size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= data[i];
+    h *= 1099511628211ULL;
+  }
+  return (int64_t)h;
+}
+
+static void free_items(diff_item_t *items, int count) {
+  for (int i = 0; i < count; i++) {
+    bson_destroy(items[i].id);
+  }
+  free(items);
+}
+
+// _id y hash de cada documento del rango, ordenados por _id. el hash se
+// calcula acá sobre los bytes del documento entero: $toHashedIndexKey
+// trunca los doubles y no distingue tipos numéricos, así que no sirve para
+// decidir si un documento cambió
+static diff_item_t *fetch_leaf(diff_job_t *job,
+                               mongoc_collection_t *collection,
+                               const diff_range_t *range, int *count) {
+  bson_t pipeline;
+  bson_init(&pipeline);
+  append_match_stage(&pipeline, "0", range);
+
+  bson_t stage, sort;
+  BSON_APPEND_DOCUMENT_BEGIN(&pipeline, "1", &stage);
+  BSON_APPEND_DOCUMENT_BEGIN(&stage, "$sort", &sort);
+  BSON_APPEND_INT32(&sort, "_id", 1);
+  bson_append_document_end(&stage, &sort);
+  bson_append_document_end(&pipeline, &stage);
+
+  mongoc_cursor_t *cursor = run_pipeline(collection, &pipeline);
+
+  diff_item_t *items = NULL;
+  int capacity = 0;
+  bool failed = false;
+  *count = 0;
+
+  const bson_t *doc;
+  while (mongoc_cursor_next(cursor, &doc)) {
+    if (*count == capacity) {
+      capacity = capacity ? capacity * 2 : 128;
+      diff_item_t *grown = realloc(items, capacity * sizeof(diff_item_t));
+      if (!grown) {
+        failed = true;
+        break;
+      }
+      items = grown;
+    }
+
+    items[*count].id = copy_id(doc);
+    items[*count].hash = hash_bytes(bson_get_data(doc), doc->len);
+    if (items[*count].id) {
+      (*count)++;
+    }
+  }
+
+  bson_error_t error;
+  if (failed) {
+    snprintf(job->err, job->err_size, "Memory allocation failed");
+  } else if (mongoc_cursor_error(cursor, &error)) {
+    snprintf(job->err, job->err_size, "Leaf fetch failed: %s",
+             error.message);
+    failed = true;
+  } else if (!items) {
+    // rango vacío: devolver un array válido de cero elementos
+    items = malloc(sizeof(diff_item_t));
+    failed = (items == NULL);
+  }
+
+  if (failed) {
+    free_items(items, *count);
+    items = NULL;
+    *count = 0;
+  }
+
+  job->result->stats.docs_fetched += *count;
+
+  mongoc_cursor_destroy(cursor);
+  bson_destroy(&pipeline);
+  return items;
+}
+
+// merge de dos listas ordenadas por _id
+static void merge_items(diff_result_t *result, const diff_item_t *a, int na,
+                        const diff_item_t *b, int nb) {
+  int i = 0, j = 0;
+  while (i < na || j < nb) {
+    int c = (i >= na) ? 1 : (j >= nb) ? -1 : compare_ids(a[i].id, b[j].id);
+    if (c < 0) {
+      add_entry(result, DIFF_MISSING, a[i++].id);
+    } else if (c > 0) {
+      add_entry(result, DIFF_EXTRA, b[j++].id);
+    } else {
+      if (a[i].hash != b[j].hash) {
+        add_entry(result, DIFF_CHANGED, a[i].id);
+      }
+      i++;
+      j++;
+    }
+  }
+}
+
+static bool diff_leaf(diff_job_t *job, const diff_range_t *range) {
+  int na, nb;
+  diff_item_t *a = fetch_leaf(job, job->a, range, &na);
+  if (!a) {
+    return false;
+  }
+  diff_item_t *b = fetch_leaf(job, job->b, range, &nb);
+  if (!b) {
+    free_items(a, na);
+    return false;
+  }
+
+  merge_items(job->result, a, na, b, nb);
+
+  free_items(a, na);
+  free_items(b, nb);
+  return true;
+}
+
+static bool diff_range(diff_job_t *job, const diff_range_t *range) {
+  job->result->stats.ranges_compared++;
+  if (!report(job)) {
+    return false;
+  }
+
+  diff_summary_t sa, sb;
+  if (!range_summary(job, job->a, range, &sa) ||
+      !range_summary(job, job->b, range, &sb)) {
+    return false;
+  }
+
+  // punto ciego: un rango con cambios que no mueven ni el hash (sólo la
+  // parte fraccionaria de un double, un int64 por un double del mismo
+  // valor) ni el tamaño se da por igual. queda contado para avisarlo; las
+  // hojas sí comparan los bytes
+  if (sa.count == sb.count && sa.hash == sb.hash && sa.size == sb.size) {
+    if (sa.count > 0) {
+      job->result->stats.ranges_unverified++;
+      job->result->stats.docs_unverified += sa.count;
+    }
+    return true;
+  }
+
+  int64_t na = sa.count, nb = sb.count;
+  if (na + nb <= DIFF_LEAF_DOCS) {
+    return diff_leaf(job, range);
+  }
+
+  // partir según el lado con más documentos
+  int split_count;
+  bson_t **splits =
+      range_splits(job, na >= nb ? job->a : job->b, range, &split_count);
+  if (!splits) {
+    return false;
+  }
+
+  bool ok = true;
+  if (split_count == 0) {
+    ok = diff_leaf(job, range);
+  } else {
+    diff_range_t sub = {range->lo, NULL};
+    for (int i = 0; i <= split_count && ok; i++) {
+      sub.hi = (i < split_count) ? splits[i] : range->hi;
+      ok = diff_range(job, &sub);
+      sub.lo = sub.hi;
+    }
+  }
+
+  for (int i = 0; i < split_count; i++) {
+    bson_destroy(splits[i]);
+  }
+  free(splits);
+  return ok;
+}
+
+// ver si el servidor soporta $toHashedIndexKey y $bsonSize
+static bool server_can_hash(mongoc_collection_t *collection) {
+  bson_t pipeline;
+  bson_init(&pipeline);
+  bson_t stage, project;
+  BSON_APPEND_DOCUMENT_BEGIN(&pipeline, "0", &stage);
+  BSON_APPEND_INT32(&stage, "$limit", 1);
+  bson_append_document_end(&pipeline, &stage);
+  BSON_APPEND_DOCUMENT_BEGIN(&pipeline, "1", &stage);
+  BSON_APPEND_DOCUMENT_BEGIN(&stage, "$project", &project);
+  append_hash_expr(&project, "h");
+  append_size_expr(&project, "s");
+  bson_append_document_end(&stage, &project);
+  bson_append_document_end(&pipeline, &stage);
+
+  mongoc_cursor_t *cursor = run_pipeline(collection, &pipeline);
+  const bson_t *doc;
+  while (mongoc_cursor_next(cursor, &doc)) {
+  }
+
+  bson_error_t error;
+  bool ok = !mongoc_cursor_error(cursor, &error);
+
+  mongoc_cursor_destroy(cursor);
+  bson_destroy(&pipeline);
+  return ok;
+}
+
+static bool next_item(mongoc_cursor_t *cursor, diff_item_t *item) {
+  const bson_t *doc;
+  while (mongoc_cursor_next(cursor, &doc)) {
+    item->id = copy_id(doc);
+    if (item->id) {
+      item->hash = hash_bytes(bson_get_data(doc), doc->len);
+      return true;
+    }
+  }
+  item->id = NULL;
+  return false;
+}
+
+// modo cliente: una pasada ordenada por _id sobre las dos colecciones
+static bool diff_client_scan(diff_job_t *job) {
+  bson_t query;
+  bson_init(&query);
+  bson_t *opts = BCON_NEW("sort", "{", "_id", BCON_INT32(1), "}");
+
+  mongoc_cursor_t *ca =
+      mongoc_collection_find_with_opts(job->a, &query, opts, NULL);
+  mongoc_cursor_t *cb =
+      mongoc_collection_find_with_opts(job->b, &query, opts, NULL);
+
+  diff_item_t a, b;
+  bool have_a = next_item(ca, &a);
+  bool have_b = next_item(cb, &b);
+  bool ok = true;
+  long long steps = 0;
+
+  while (ok && (have_a || have_b)) {
+    int c = !have_a ? 1 : !have_b ? -1 : compare_ids(a.id, b.id);
+    if (c <= 0) {
+      job->result->stats.docs_fetched++;
+    }
+    if (c >= 0) {
+      job->result->stats.docs_fetched++;
+    }
+
+    if (c < 0) {
+      add_entry(job->result, DIFF_MISSING, a.id);
+    } else if (c > 0) {
+      add_entry(job->result, DIFF_EXTRA, b.id);
+    } else if (a.hash != b.hash) {
+      add_entry(job->result, DIFF_CHANGED, a.id);
+    }
+
+    if (c <= 0) {
+      bson_destroy(a.id);
+      have_a = next_item(ca, &a);
+    }
+    if (c >= 0) {
+      bson_destroy(b.id);
+      have_b = next_item(cb, &b);
+    }
+
+    if (++steps % 1000 == 0) {
+      ok = report(job);
+    }
+  }
+
+  if (have_a) {
+    bson_destroy(a.id);
+  }
+  if (have_b) {
+    bson_destroy(b.id);
+  }
+
+  bson_error_t error;
+  if (ok && (mongoc_cursor_error(ca, &error) ||
+             mongoc_cursor_error(cb, &error))) {
+    snprintf(job->err, job->err_size, "Cursor error: %s", error.message);
+    ok = false;
+  }
+
+  mongoc_cursor_destroy(ca);
+  mongoc_cursor_destroy(cb);
+  bson_destroy(opts);
+  bson_destroy(&query);
+  return ok;
+}
+
+bool mongo_diff_collections(mongo_context_t *a, const char *db_a,
+                            const char *coll_a, mongo_context_t *b,
+                            const char *db_b, const char *coll_b, bool quick,
+                            diff_result_t *result, diff_progress_fn progress,
+                            void *user_data) {
+  if (!a || !a->client || !b || !b->client || !db_a || !coll_a || !db_b ||
+      !coll_b || !result) {
+    if (a) {
+      snprintf(a->error_message, sizeof(a->error_message),
+               "Invalid parameters");
+    }
+    return false;
+  }
+
+  memset(result, 0, sizeof(*result));
+
+  diff_job_t job;
+  memset(&job, 0, sizeof(job));
+  job.a = mongoc_client_get_collection(a->client, db_a, coll_a);
+  job.b = mongoc_client_get_collection(b->client, db_b, coll_b);
+  job.result = result;
+  job.progress = progress;
+  job.user_data = user_data;
+  job.err = a->error_message;
+  job.err_size = sizeof(a->error_message);
+
+  result->stats.server_hash =
+      quick && server_can_hash(job.a) && server_can_hash(job.b);
+
+  bool ok;
+  if (result->stats.server_hash) {
+    diff_range_t all = {NULL, NULL};
+    ok = diff_range(&job, &all);
+  } else {
+    ok = diff_client_scan(&job);
+  }
+
+  if (ok) {
+    a->error_message[0] = '\0';
+    if (progress) {
+      progress(&result->stats, user_data);
+    }
+  }
+
+  mongoc_collection_destroy(job.a);
+  mongoc_collection_destroy(job.b);
+  return ok;
+}
+
+void diff_result_free(diff_result_t *result) {
+  if (!result) {
+    return;
+  }
+
+  for (int i = 0; i < result->count; i++) {
+    bson_destroy(result->entries[i].id);
+  }
+  free(result->entries);
+  memset(result, 0, sizeof(*result));
+}
+
+// campos con estos nombres no se pueden nombrar en una ruta con puntos
+static bool key_addressable(const char *key) {
+  return key[0] != '\0' && key[0] != '$' && strchr(key, '.') == NULL;
+}
+
+// todos los campos se pueden nombrar y entran en max_len bytes
+static bool keys_addressable(const bson_t *doc, size_t max_len) {
+  bson_iter_t iter;
+  if (!bson_iter_init(&iter, doc)) {
+    return false;
+  }
+  while (bson_iter_next(&iter)) {
+    const char *key = bson_iter_key(&iter);
+    if (!key_addressable(key) || strlen(key) > max_len) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// documento o array al que apunta iter (sin copiar)
+static bool iter_container(const bson_iter_t *iter, bson_t *out) {
+  uint32_t len;
+  const uint8_t *data;
+  if (BSON_ITER_HOLDS_DOCUMENT(iter)) {
+    bson_iter_document(iter, &len, &data);
+  } else if (BSON_ITER_HOLDS_ARRAY(iter)) {
+    bson_iter_array(iter, &len, &data);
+  } else {
+    return false;
+  }
+  return bson_init_static(out, data, len);
+}
+
+static bool holds_integer(const bson_iter_t *iter) {
+  return BSON_ITER_HOLDS_INT32(iter) || BSON_ITER_HOLDS_INT64(iter);
+}
+
+// mismo tipo y mismos bytes. un int64 chico vuelve del JSON relajado como
+// int32: enteros de igual valor cuentan como iguales y se conserva el tipo
+static bool same_value(const bson_iter_t *x, const bson_iter_t *y) {
+  if (holds_integer(x) && holds_integer(y)) {
+    return bson_iter_as_int64(x) == bson_iter_as_int64(y);
+  }
+  if (bson_iter_type(x) != bson_iter_type(y)) {
+    return false;
+  }
+
+  bson_t cx, cy;
+  if (iter_container(x, &cx) && iter_container(y, &cy)) {
+    return compare_raw(&cx, &cy) == 0;
+  }
+
+  bson_t vx, vy;
+  bson_init(&vx);
+  bson_init(&vy);
+  bson_append_iter(&vx, "", 0, x);
+  bson_append_iter(&vy, "", 0, y);
+  bool same = compare_raw(&vx, &vy) == 0;
+  bson_destroy(&vx);
+  bson_destroy(&vy);
+  return same;
+}
+
+// buscar key en doc empezando por donde quedó hint (los campos suelen
+// venir en el mismo orden); hint avanza si acierta
+static bool find_key(const bson_t *doc, bson_iter_t *hint, bool *hint_ok,
+                     const char *key, bson_iter_t *found) {
+  if (*hint_ok && strcmp(bson_iter_key(hint), key) == 0) {
+    *found = *hint;
+    *hint_ok = bson_iter_next(hint);
+    return true;
+  }
+  return bson_iter_init_find(found, doc, key);
+}
+
+// ruta de key debajo de path (len bytes); el llamador ya verificó que entra
+static void path_push(char *path, size_t len, const char *key) {
+  if (len > 0) {
+    path[len++] = '.';
+  }
+  strcpy(path + len, key);
+}
+
+// comparar un nivel; path tiene la ruta hasta acá (len bytes). en el nivel
+// de arriba cada campo tiene que poder nombrarse; más abajo, se baja a un
+// contenedor sólo si los suyos pueden (si no, va entero en $set)
+static bool diff_level(const bson_t *before, const bson_t *after, char *path,
+                       size_t len, bool top, bson_t *set, bson_t *unset) {
+  bson_iter_t hint, iter, found;
+  bool hint_ok = bson_iter_init(&hint, before) && bson_iter_next(&hint);
+
+  // campos nuevos o cambiados
+  if (bson_iter_init(&iter, after)) {
+    while (bson_iter_next(&iter)) {
+      const char *key = bson_iter_key(&iter);
+      if (top && strcmp(key, "_id") == 0) {
+        continue;
+      }
+      bool exists = find_key(before, &hint, &hint_ok, key, &found);
+      if (exists && same_value(&found, &iter)) {
+        continue;
+      }
+      if (top && (!key_addressable(key) || strlen(key) >= DIFF_MAX_PATH)) {
+        return false;
+      }
+      path_push(path, len, key);
+      size_t sub_len = strlen(path);
+      size_t room = DIFF_MAX_PATH - sub_len - 2;
+
+      // bajar si los dos son contenedores del mismo tipo (y, en arrays, del
+      // mismo largo) con campos que se pueden nombrar
+      bson_t sub_before, sub_after;
+      bool descend = exists &&
+                     bson_iter_type(&found) == bson_iter_type(&iter) &&
+                     iter_container(&found, &sub_before) &&
+                     iter_container(&iter, &sub_after) &&
+                     sub_len + 2 < DIFF_MAX_PATH &&
+                     keys_addressable(&sub_before, room) &&
+                     keys_addressable(&sub_after, room) &&
+                     (!BSON_ITER_HOLDS_ARRAY(&iter) ||
+                      bson_count_keys(&sub_before) ==
+                          bson_count_keys(&sub_after));
+      if (descend) {
+        diff_level(&sub_before, &sub_after, path, sub_len, false, set, unset);
+      } else {
+        bson_append_iter(set, path, -1, &iter);
+      }
+      path[len] = '\0';
+    }
+  }
+
+  // campos que ya no están
+  hint_ok = bson_iter_init(&hint, after) && bson_iter_next(&hint);
+  if (bson_iter_init(&iter, before)) {
+    while (bson_iter_next(&iter)) {
+      const char *key = bson_iter_key(&iter);
+      if (top && strcmp(key, "_id") == 0) {
+        continue;
+      }
+      if (find_key(after, &hint, &hint_ok, key, &found)) {
+        continue;
+      }
+      if (top && (!key_addressable(key) || strlen(key) >= DIFF_MAX_PATH)) {
+        return false;
+      }
+      path_push(path, len, key);
+      BSON_APPEND_UTF8(unset, path, "");
+      path[len] = '\0';
+    }
+  }
+  return true;
+}
+
+bson_t *mongo_diff_document(const bson_t *before, const bson_t *after,
+                            const char **error) {
+  if (!before || !after) {
+    return NULL;
+  }
+
+  // el _id no se puede cambiar con un update
+  bson_iter_t id_before, id_after;
+  if (bson_iter_init_find(&id_after, after, "_id") &&
+      (!bson_iter_init_find(&id_before, before, "_id") ||
+       !same_value(&id_before, &id_after))) {
+    if (error) {
+      *error = "The _id field cannot be changed";
+    }
+    return NULL;
+  }
+
+  bson_t set, unset;
+  bson_init(&set);
+  bson_init(&unset);
+
+  char path[DIFF_MAX_PATH];
+  path[0] = '\0';
+  if (!diff_level(before, after, path, 0, true, &set, &unset)) {
+    bson_destroy(&set);
+    bson_destroy(&unset);
+    if (error) {
+      *error = "A changed top-level field name cannot be used in an update";
+    }
+    return NULL;
+  }
+
+  bson_t *update = bson_new();
+  if (!bson_empty(&set)) {
+    BSON_APPEND_DOCUMENT(update, "$set", &set);
+  }
+  if (!bson_empty(&unset)) {
+    BSON_APPEND_DOCUMENT(update, "$unset", &unset);
+  }
+  bson_destroy(&set);
+  bson_destroy(&unset);
+  return update;
+}
@@ -0,0 +1,79 @@
+#ifndef MONGO_DIFF_H
+#define MONGO_DIFF_H
+
+#include "mongo_ops.h"
+#include <stdbool.h>
+
+// rangos con menos documentos que esto se comparan documento a documento
+#define DIFF_LEAF_DOCS 512
+// sub-rangos en que se parte un rango con hashes distintos
+#define DIFF_FANOUT 8
+// máximo de diferencias que se guardan
+#define DIFF_MAX_ENTRIES 10000
+
+// tipo de diferencia (fuente = A, destino = B)
+typedef enum {
+  DIFF_MISSING, // está en A y falta en B
+  DIFF_EXTRA,   // está en B y no en A
+  DIFF_CHANGED  // está en los dos con contenido distinto
+} diff_kind_t;
+
+typedef struct {
+  diff_kind_t kind;
+  bson_t *id; // documento {_id: valor}
+} diff_entry_t;
+
+// estadísticas de la comparación (también se pasan al callback)
+typedef struct {
+  long long ranges_compared;
+  long long docs_fetched; // documentos traídos en hojas (o en modo cliente)
+  long long differences;
+  bool server_hash; // se usaron resúmenes de rango (modo rápido)
+  // modo rápido: rangos (y sus documentos) dados por iguales sólo porque
+  // el resumen coincidía, sin comparar los bytes
+  long long ranges_unverified;
+  long long docs_unverified;
+} diff_stats_t;
+
+typedef struct {
+  diff_entry_t *entries;
+  int count;
+  int capacity;
+  bool truncated;
+  diff_stats_t stats;
+} diff_result_t;
+
+// callback de progreso; devolver false cancela
+typedef bool (*diff_progress_fn)(const diff_stats_t *stats, void *user_data);
+
+// comparar dos colecciones (posiblemente en conexiones distintas).
+// por defecto trae todos los documentos de los dos lados ordenados por _id
+// en una pasada y compara sus bytes: exacto.
+// con quick resume rangos en el servidor con $group (cantidad,
+// $toHashedIndexKey y $bsonSize) y baja recursivamente sólo en los rangos
+// cuyo resumen difiere (estilo Merkle); en las hojas compara los bytes.
+// un rango cuyo resumen coincide no se revisa, así que se pueden escapar
+// cambios que el hash no ve y no alteran el tamaño (la parte fraccionaria
+// de un double): quedan contados en stats.ranges_unverified y
+// docs_unverified. sin $toHashedIndexKey o $bsonSize en el servidor quick
+// no se usa.
+// los errores quedan en a->error_message
+bool mongo_diff_collections(mongo_context_t *a, const char *db_a,
+                            const char *coll_a, mongo_context_t *b,
+                            const char *db_b, const char *coll_b, bool quick,
+                            diff_result_t *result, diff_progress_fn progress,
+                            void *user_data);
+
+// liberar resultado de la comparación
+void diff_result_free(diff_result_t *result);
+
+// update mínimo que lleva before a after: $set sólo de las rutas que
+// cambiaron (bajando por subdocumentos y arrays del mismo largo) y $unset
+// de las que ya no están. sin cambios devuelve un documento vacío. el _id
+// no se toca; devuelve NULL (y el motivo en *error) si after lo cambia o si
+// un campo de arriba cambiado tiene un nombre que no se puede usar en una
+// ruta ('$' al principio o '.')
+bson_t *mongo_diff_document(const bson_t *before, const bson_t *after,
+                            const char **error);
+
+#endif // MONGO_DIFF_H
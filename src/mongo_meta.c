@@ -0,0 +1,470 @@
+#include "mongo_meta.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// prioridad de un pedido: lo que espera la interfaz va antes que los
+// refrescos, y éstos antes que la precarga
+enum { WANT_NONE, WANT_PREFETCH, WANT_REFRESH, WANT_NOW };
+
+typedef struct {
+  char db[256];            // "" = la lista de bases de datos
+  mongo_meta_list_t *list; // NULL si todavía no llegó
+  int64_t fetched_us;
+  unsigned edits; // cambios locales: un pedido que los cruzó se repite
+  int want;
+  bool failed;
+  char error[256];
+} meta_entry_t;
+
+struct mongo_meta {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  bool quit;
+
+  meta_entry_t *entries; // [0] = bases de datos; nunca se sacan
+  int count;
+  int capacity;
+  bool prefetched; // ya se pidieron las colecciones de las primeras BDs
+
+  // sólo los usa el hilo (cliente propio y copia del URI)
+  mongo_context_t worker;
+};
+
+// toma names y notes; NULL (y los dos liberados) si no hay memoria
+static mongo_meta_list_t *list_new(char **names, char **notes, int count) {
+  mongo_meta_list_t *list = names && notes ? malloc(sizeof(*list)) : NULL;
+  if (!list) {
+    free(names);
+    free(notes);
+    return NULL;
+  }
+  list->names = names;
+  list->notes = notes;
+  list->count = count;
+  list->refs = 1;
+  return list;
+}
+
+// con el lock tomado
+static void list_unref(mongo_meta_list_t *list) {
+  if (list && --list->refs == 0) {
+    free(list->names);
+    free(list->notes);
+    free(list);
+  }
+}
+
+// tamaño en disco legible ("" si no se sabe)
+static void format_size(long long bytes, char *out, size_t size) {
+  static const char *const units[] = {"B", "KB", "MB", "GB", "TB"};
+  if (bytes < 0) {
+    out[0] = '\0';
+    return;
+  }
+  double value = (double)bytes;
+  int unit = 0;
+  while (value >= 1024 && unit < 4) {
+    value /= 1024;
+    unit++;
+  }
+  snprintf(out, size, unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+}
+
+// detalle de cada nombre a partir de lo que trajo el listado (sizes o
+// types, uno de los dos); NULL si no hay memoria
+static char **make_notes(const long long *sizes,
+                         const mongo_coll_type_t *types, int count) {
+  enum { NOTE_SIZE = 16 };
+  char *text = malloc((count > 0 ? count : 1) * NOTE_SIZE);
+  const char **notes = malloc((count > 0 ? count : 1) * sizeof(char *));
+  char **packed = NULL;
+  if (text && notes) {
+    for (int i = 0; i < count; i++) {
+      char *note = text + i * NOTE_SIZE;
+      note[0] = '\0';
+      if (sizes) {
+        format_size(sizes[i], note, NOTE_SIZE);
+      } else if (types && types[i] == MONGO_COLL_VIEW) {
+        safe_strncpy(note, "view", NOTE_SIZE);
+      } else if (types && types[i] == MONGO_COLL_TIMESERIES) {
+        safe_strncpy(note, "timeseries", NOTE_SIZE);
+      } else if (types && types[i] == MONGO_COLL_CAPPED) {
+        safe_strncpy(note, "capped", NOTE_SIZE);
+      }
+      notes[i] = note;
+    }
+    packed = pack_string_array(notes, count);
+  }
+  free(text);
+  free(notes);
+  return packed;
+}
+
+static bool list_contains(const mongo_meta_list_t *list, const char *name) {
+  for (int i = 0; i < list->count; i++) {
+    if (strcmp(list->names[i], name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// reemplazar la lista de una entrada por una copia con name agregado o
+// quitado (con el lock tomado)
+static bool entry_edit(meta_entry_t *entry, const char *name, bool add) {
+  const mongo_meta_list_t *old = entry->list;
+  if (list_contains(old, name) == add) {
+    return false;
+  }
+
+  const char **names = malloc((old->count + 1) * sizeof(char *));
+  const char **notes = malloc((old->count + 1) * sizeof(char *));
+  if (!names || !notes) {
+    free(names);
+    free(notes);
+    return false;
+  }
+  int count = 0;
+  for (int i = 0; i < old->count; i++) {
+    if (add || strcmp(old->names[i], name) != 0) {
+      notes[count] = old->notes[i];
+      names[count++] = old->names[i];
+    }
+  }
+  if (add) {
+    // el detalle de una nueva llega con el próximo refresco
+    notes[count] = "";
+    names[count++] = name;
+  }
+
+  mongo_meta_list_t *list = list_new(pack_string_array(names, count),
+                                     pack_string_array(notes, count), count);
+  free(names);
+  free(notes);
+  if (!list) {
+    return false;
+  }
+  list_unref(entry->list);
+  entry->list = list;
+  entry->edits++;
+  return true;
+}
+
+// con el lock tomado
+static int find_entry(const mongo_meta_t *meta, const char *db) {
+  for (int i = 0; i < meta->count; i++) {
+    if (strcmp(meta->entries[i].db, db) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// con el lock tomado; el puntero vale hasta la próxima entrada nueva
+static meta_entry_t *get_entry(mongo_meta_t *meta, const char *db) {
+  int index = find_entry(meta, db);
+  if (index >= 0) {
+    return &meta->entries[index];
+  }
+
+  if (meta->count == meta->capacity) {
+    int capacity = meta->capacity ? meta->capacity * 2 : 32;
+    meta_entry_t *grown =
+        realloc(meta->entries, capacity * sizeof(meta_entry_t));
+    if (!grown) {
+      return NULL;
+    }
+    meta->entries = grown;
+    meta->capacity = capacity;
+  }
+
+  meta_entry_t *entry = &meta->entries[meta->count++];
+  memset(entry, 0, sizeof(*entry));
+  safe_strncpy(entry->db, db, sizeof(entry->db));
+  return entry;
+}
+
+static void want(mongo_meta_t *meta, meta_entry_t *entry, int level) {
+  if (entry->want < level) {
+    entry->want = level;
+    pthread_cond_signal(&meta->wake);
+  }
+}
+
+// el pedido más urgente (con el lock tomado); -1 si no hay
+static int next_wanted(const mongo_meta_t *meta) {
+  int best = -1;
+  for (int i = 0; i < meta->count; i++) {
+    if (meta->entries[i].want != WANT_NONE &&
+        (best < 0 || meta->entries[i].want > meta->entries[best].want)) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+static void *meta_thread(void *arg) {
+  mongo_meta_t *meta = arg;
+
+  pthread_mutex_lock(&meta->lock);
+  while (true) {
+    int index;
+    while (!meta->quit && (index = next_wanted(meta)) < 0) {
+      pthread_cond_wait(&meta->wake, &meta->lock);
+    }
+    if (meta->quit) {
+      break;
+    }
+
+    char db[256];
+    safe_strncpy(db, meta->entries[index].db, sizeof(db));
+    unsigned edits = meta->entries[index].edits;
+    meta->entries[index].want = WANT_NONE;
+    pthread_mutex_unlock(&meta->lock);
+
+    // tamaños y tipos vienen en la misma respuesta que los nombres
+    int count = 0;
+    long long *sizes = NULL;
+    mongo_coll_type_t *types = NULL;
+    char **names =
+        db[0] != '\0'
+            ? mongo_list_collections(&meta->worker, db, &types, &count)
+            : mongo_list_databases(&meta->worker, &sizes, &count);
+    mongo_meta_list_t *list =
+        names ? list_new(names, make_notes(sizes, types, count), count)
+              : NULL;
+    free(sizes);
+    free(types);
+
+    pthread_mutex_lock(&meta->lock);
+    meta_entry_t *entry = &meta->entries[index]; // el array pudo crecer
+    if (entry->edits != edits) {
+      // lo que trajimos puede no incluir un cambio nuestro: otra vez
+      list_unref(list);
+      want(meta, entry, WANT_REFRESH);
+      continue;
+    }
+
+    entry->fetched_us = bson_get_monotonic_time();
+    if (list) {
+      list_unref(entry->list);
+      entry->list = list;
+      entry->failed = false;
+    } else if (!entry->list) {
+      // con una lista vieja se sigue usando ésa hasta el próximo TTL
+      entry->failed = true;
+      safe_strncpy(entry->error, meta->worker.error_message,
+                   sizeof(entry->error));
+    }
+
+    if (index == 0 && list && !meta->prefetched) {
+      meta->prefetched = true;
+      // con miles de BDs (un cluster por cliente) serían miles de
+      // listCollections: sólo las que se ven primero
+      int prefetch = list->count < MONGO_META_PREFETCH_DBS
+                         ? list->count
+                         : MONGO_META_PREFETCH_DBS;
+      for (int i = 0; i < prefetch; i++) {
+        meta_entry_t *coll = get_entry(meta, list->names[i]);
+        if (coll && !coll->list) {
+          want(meta, coll, WANT_PREFETCH);
+        }
+      }
+    }
+  }
+  pthread_mutex_unlock(&meta->lock);
+  return NULL;
+}
+
+mongo_meta_t *mongo_meta_new(mongo_context_t *ctx) {
+  mongo_meta_t *meta = calloc(1, sizeof(mongo_meta_t));
+  if (!meta) {
+    if (ctx) {
+      snprintf(ctx->error_message, sizeof(ctx->error_message),
+               "Memory allocation failed");
+    }
+    return NULL;
+  }
+
+  meta->worker.client = mongo_client_spawn(ctx);
+  if (!meta->worker.client) {
+    free(meta);
+    return NULL;
+  }
+  meta->worker.uri = mongoc_uri_copy(ctx->uri);
+  meta->worker.connected = true;
+
+  pthread_mutex_init(&meta->lock, NULL);
+  pthread_cond_init(&meta->wake, NULL);
+
+  // las bases de datos primero; las colecciones después, al llegar
+  meta_entry_t *databases = get_entry(meta, "");
+  if (databases) {
+    databases->want = WANT_NOW;
+  }
+
+  if (!databases ||
+      pthread_create(&meta->thread, NULL, meta_thread, meta) != 0) {
+    snprintf(ctx->error_message, sizeof(ctx->error_message),
+             "Failed to start metadata thread");
+    pthread_cond_destroy(&meta->wake);
+    pthread_mutex_destroy(&meta->lock);
+    mongoc_client_destroy(meta->worker.client);
+    mongoc_uri_destroy(meta->worker.uri);
+    free(meta->entries);
+    free(meta);
+    return NULL;
+  }
+
+  return meta;
+}
+
+void mongo_meta_free(mongo_meta_t *meta) {
+  if (!meta) {
+    return;
+  }
+
+  pthread_mutex_lock(&meta->lock);
+  meta->quit = true;
+  pthread_cond_signal(&meta->wake);
+  pthread_mutex_unlock(&meta->lock);
+  pthread_join(meta->thread, NULL);
+
+  for (int i = 0; i < meta->count; i++) {
+    list_unref(meta->entries[i].list);
+  }
+  free(meta->entries);
+  mongoc_client_destroy(meta->worker.client);
+  mongoc_uri_destroy(meta->worker.uri);
+  pthread_cond_destroy(&meta->wake);
+  pthread_mutex_destroy(&meta->lock);
+  free(meta);
+}
+
+mongo_meta_status_t mongo_meta_get(mongo_meta_t *meta, const char *db,
+                                   mongo_meta_list_t **list, char *error,
+                                   size_t error_size) {
+  *list = NULL;
+  if (!meta) {
+    safe_strncpy(error, "Not connected", error_size);
+    return MONGO_META_FAILED;
+  }
+
+  mongo_meta_status_t status = MONGO_META_LOADING;
+  pthread_mutex_lock(&meta->lock);
+  meta_entry_t *entry = get_entry(meta, db ? db : "");
+  if (!entry) {
+    safe_strncpy(error, "Memory allocation failed", error_size);
+    status = MONGO_META_FAILED;
+  } else if (entry->list) {
+    *list = entry->list;
+    entry->list->refs++;
+    status = MONGO_META_READY;
+    if (bson_get_monotonic_time() - entry->fetched_us > MONGO_META_TTL_US) {
+      want(meta, entry, WANT_REFRESH);
+    }
+  } else if (entry->failed) {
+    safe_strncpy(error, entry->error, error_size);
+    entry->failed = false;
+    status = MONGO_META_FAILED;
+  } else {
+    want(meta, entry, WANT_NOW);
+  }
+  pthread_mutex_unlock(&meta->lock);
+  return status;
+}
+
+bool mongo_meta_changed(mongo_meta_t *meta, const char *db,
+                        const mongo_meta_list_t *list) {
+  if (!meta) {
+    return false;
+  }
+
+  pthread_mutex_lock(&meta->lock);
+  int index = find_entry(meta, db ? db : "");
+  bool changed = index >= 0 && meta->entries[index].list &&
+                 meta->entries[index].list != list;
+  pthread_mutex_unlock(&meta->lock);
+  return changed;
+}
+
+void mongo_meta_release(mongo_meta_t *meta, mongo_meta_list_t *list) {
+  if (!meta || !list) {
+    return;
+  }
+
+  pthread_mutex_lock(&meta->lock);
+  list_unref(list);
+  pthread_mutex_unlock(&meta->lock);
+}
+
+void mongo_meta_invalidate(mongo_meta_t *meta, const char *db) {
+  if (!meta) {
+    return;
+  }
+
+  pthread_mutex_lock(&meta->lock);
+  if (db) {
+    int index = find_entry(meta, db);
+    if (index >= 0) {
+      want(meta, &meta->entries[index], WANT_REFRESH);
+    }
+  } else {
+    // la lista de BDs enseguida; las colecciones ya vistas, de fondo
+    want(meta, &meta->entries[0], WANT_REFRESH);
+    for (int i = 1; i < meta->count; i++) {
+      if (meta->entries[i].list) {
+        want(meta, &meta->entries[i], WANT_PREFETCH);
+      }
+    }
+  }
+  pthread_mutex_unlock(&meta->lock);
+}
+
+void mongo_meta_add_collection(mongo_meta_t *meta, const char *db,
+                               const char *collection) {
+  if (!meta || !db || !collection) {
+    return;
+  }
+
+  pthread_mutex_lock(&meta->lock);
+  int index = find_entry(meta, db);
+  if (index >= 0) {
+    meta_entry_t *entry = &meta->entries[index];
+    entry->edits++;
+    if (entry->list) {
+      entry_edit(entry, collection, true);
+    }
+  }
+
+  // crear una colección puede crear la base de datos
+  if (meta->entries[0].list) {
+    entry_edit(&meta->entries[0], db, true);
+  }
+  pthread_mutex_unlock(&meta->lock);
+}
+
+void mongo_meta_remove_collection(mongo_meta_t *meta, const char *db,
+                                  const char *collection) {
+  if (!meta || !db || !collection) {
+    return;
+  }
+
+  pthread_mutex_lock(&meta->lock);
+  int index = find_entry(meta, db);
+  if (index >= 0) {
+    meta_entry_t *entry = &meta->entries[index];
+    entry->edits++;
+    if (entry->list && entry_edit(entry, collection, false) &&
+        entry->list->count == 0) {
+      // sin colecciones la base de datos deja de existir (salvo la del
+      // URI): que lo diga el servidor
+      want(meta, &meta->entries[0], WANT_REFRESH);
+    }
+  }
+  pthread_mutex_unlock(&meta->lock);
+}
@@ -0,0 +1,69 @@
+#ifndef MONGO_META_H
+#define MONGO_META_H
+
+#include "mongo_ops.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// cuánto se usa una lista sin volver a pedirla (después se sigue usando,
+// pero se refresca en segundo plano)
+#define MONGO_META_TTL_US (30 * 1000000LL)
+
+// de cuántas bases de datos se precargan las colecciones al conectar (las
+// primeras de la lista); las demás se piden al entrar
+#define MONGO_META_PREFETCH_DBS 32
+
+// caché de nombres de bases de datos y colecciones de una conexión: un hilo
+// con su propio cliente las trae (las de las primeras BDs al conectar) y
+// la interfaz nunca espera a la red para cambiar de nivel si ya las tiene
+typedef struct mongo_meta mongo_meta_t;
+
+// lista de nombres; no cambia mientras alguien la tenga (un refresco trae
+// otra). soltar con mongo_meta_release
+typedef struct {
+  char **names; // un solo bloque (pack_string_array)
+  char **notes; // detalle de cada nombre (tamaño, tipo), "" si no hay;
+                // otro bloque
+  int count;
+  int refs;     // uso interno
+} mongo_meta_list_t;
+
+// resultado de pedir una lista
+typedef enum {
+  MONGO_META_READY,   // *list tiene la lista (quizás vieja, ya se pidió otra)
+  MONGO_META_LOADING, // todavía no llegó; volver a preguntar
+  MONGO_META_FAILED   // no se pudo traer; la próxima vez se vuelve a intentar
+} mongo_meta_status_t;
+
+// crear la caché y lanzar el hilo, que empieza por las bases de datos y
+// sigue con las colecciones de cada una; NULL si falla (error en ctx)
+mongo_meta_t *mongo_meta_new(mongo_context_t *ctx);
+
+// parar el hilo y liberar todo; las listas que se hayan entregado tienen
+// que estar soltadas
+void mongo_meta_free(mongo_meta_t *meta);
+
+// lista de bases de datos (db NULL) o de colecciones de db, sin bloquear
+mongo_meta_status_t mongo_meta_get(mongo_meta_t *meta, const char *db,
+                                   mongo_meta_list_t **list, char *error,
+                                   size_t error_size);
+
+// true si hay una lista más nueva que list para lo mismo (llegó un refresco
+// o un cambio local)
+bool mongo_meta_changed(mongo_meta_t *meta, const char *db,
+                        const mongo_meta_list_t *list);
+
+// soltar una lista entregada por mongo_meta_get
+void mongo_meta_release(mongo_meta_t *meta, mongo_meta_list_t *list);
+
+// volver a pedir todo (db NULL) o las colecciones de db; mientras tanto se
+// sigue usando lo que hay
+void mongo_meta_invalidate(mongo_meta_t *meta, const char *db);
+
+// reflejar lo que hicimos nosotros sin ir al servidor
+void mongo_meta_add_collection(mongo_meta_t *meta, const char *db,
+                               const char *collection);
+void mongo_meta_remove_collection(mongo_meta_t *meta, const char *db,
+                                  const char *collection);
+
+#endif // MONGO_META_H
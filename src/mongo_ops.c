@@ -1,13 +1,40 @@
 #include "mongo_ops.h"
 #include "utils.h"
+#include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// hilos con cliente propio todavía vivos (ver mongo_cleanup)
+static pthread_mutex_t g_background_lock = PTHREAD_MUTEX_INITIALIZER;
+static int g_background_threads = 0;
+
 
 void mongo_init(void) { mongoc_init(); }
 
-void mongo_cleanup(void) { mongoc_cleanup(); }
+void mongo_cleanup(void) {
+  // mongoc_cleanup con un cliente vivo en otro hilo no es seguro; al salir
+  // con una conexión cancelada todavía en curso se deja al sistema
+  pthread_mutex_lock(&g_background_lock);
+  bool busy = g_background_threads > 0;
+  pthread_mutex_unlock(&g_background_lock);
+  if (!busy) {
+    mongoc_cleanup();
+  }
+}
+
+void mongo_background_begin(void) {
+  pthread_mutex_lock(&g_background_lock);
+  g_background_threads++;
+  pthread_mutex_unlock(&g_background_lock);
+}
+
+void mongo_background_end(void) {
+  pthread_mutex_lock(&g_background_lock);
+  g_background_threads--;
+  pthread_mutex_unlock(&g_background_lock);
+}
 
 mongo_context_t *mongo_context_new(void) {
   mongo_context_t *ctx = calloc(1, sizeof(mongo_context_t));
@@ -30,6 +57,7 @@ void mongo_context_free(mongo_context_t *ctx) {
     return;
   }
 
+  mongo_connect_cancel(ctx);
   mongo_disconnect(ctx);
 
   if (ctx->current_db) {
@@ -97,6 +125,121 @@ bool mongo_connect(mongo_context_t *ctx, const char *uri_string) {
   return true;
 }
 
+// conexión en segundo plano: el hilo y quien la lanzó comparten el job;
+// lo libera el último de los dos en soltarlo
+struct mongo_connect_job {
+  pthread_mutex_t lock;
+  mongo_context_t result; // contexto que conecta el hilo
+  char *uri;
+  bool done;
+  bool ok;
+  bool abandoned;
+};
+
+static void connect_job_free(struct mongo_connect_job *job) {
+  mongo_disconnect(&job->result);
+  pthread_mutex_destroy(&job->lock);
+  free(job->uri);
+  free(job);
+}
+
+static void *connect_thread(void *arg) {
+  struct mongo_connect_job *job = arg;
+  bool ok = mongo_connect(&job->result, job->uri);
+
+  pthread_mutex_lock(&job->lock);
+  job->ok = ok;
+  job->done = true;
+  bool abandoned = job->abandoned;
+  pthread_mutex_unlock(&job->lock);
+
+  if (abandoned) {
+    connect_job_free(job);
+  }
+
+  mongo_background_end();
+  return NULL;
+}
+
+bool mongo_connect_start(mongo_context_t *ctx, const char *uri_string) {
+  if (!ctx || !uri_string || ctx->connect_job) {
+    return false;
+  }
+
+  struct mongo_connect_job *job = calloc(1, sizeof(*job));
+  if (!job || !(job->uri = str_dup(uri_string))) {
+    free(job);
+    snprintf(ctx->error_message, sizeof(ctx->error_message),
+             "Memory allocation failed");
+    return false;
+  }
+  pthread_mutex_init(&job->lock, NULL);
+
+  mongo_background_begin();
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, connect_thread, job) != 0) {
+    mongo_background_end();
+    connect_job_free(job);
+    snprintf(ctx->error_message, sizeof(ctx->error_message),
+             "Failed to start connection thread");
+    return false;
+  }
+  pthread_detach(thread);
+
+  mongo_disconnect(ctx);
+  ctx->connect_job = job;
+  return true;
+}
+
+bool mongo_connect_pending(const mongo_context_t *ctx) {
+  return ctx && ctx->connect_job;
+}
+
+bool mongo_connect_poll(mongo_context_t *ctx, bool *ok) {
+  struct mongo_connect_job *job = ctx ? ctx->connect_job : NULL;
+  if (!job) {
+    return false;
+  }
+
+  pthread_mutex_lock(&job->lock);
+  bool done = job->done;
+  pthread_mutex_unlock(&job->lock);
+  if (!done) {
+    return false;
+  }
+
+  // el hilo ya no toca el job: pasar lo conectado a ctx
+  ctx->client = job->result.client;
+  ctx->uri = job->result.uri;
+  ctx->connected = job->result.connected;
+  memcpy(ctx->error_message, job->result.error_message,
+         sizeof(ctx->error_message));
+  job->result.client = NULL;
+  job->result.uri = NULL;
+  *ok = job->ok;
+
+  ctx->connect_job = NULL;
+  connect_job_free(job);
+  return true;
+}
+
+void mongo_connect_cancel(mongo_context_t *ctx) {
+  struct mongo_connect_job *job = ctx ? ctx->connect_job : NULL;
+  if (!job) {
+    return;
+  }
+  ctx->connect_job = NULL;
+
+  pthread_mutex_lock(&job->lock);
+  bool done = job->done;
+  job->abandoned = true;
+  pthread_mutex_unlock(&job->lock);
+
+  if (done) {
+    connect_job_free(job);
+  }
+}
+
 void mongo_disconnect(mongo_context_t *ctx) {
   if (!ctx) {
     return;
@@ -138,7 +281,120 @@ bool mongo_ping(mongo_context_t *ctx) {
   return success;
 }
 
-char **mongo_list_databases(mongo_context_t *ctx, int *count) {
+mongoc_client_t *mongo_client_spawn(mongo_context_t *ctx) {
+  if (!ctx || !ctx->uri) {
+    if (ctx) {
+      snprintf(ctx->error_message, sizeof(ctx->error_message),
+               "Invalid context or not connected");
+    }
+    return NULL;
+  }
+
+  mongoc_client_t *client = mongoc_client_new_from_uri(ctx->uri);
+  if (!client) {
+    snprintf(ctx->error_message, sizeof(ctx->error_message),
+             "Failed to create client");
+    return NULL;
+  }
+
+  mongoc_client_set_appname(client, "MongoDB-TUI");
+  mongoc_client_set_error_api(client, MONGOC_ERROR_API_VERSION_2);
+
+  return client;
+}
+
+// nombres de un listado que se va armando: el texto de todos en un buffer
+// (los documentos de un cursor cambian con cada next) y al final un bloque
+typedef struct {
+  char *text;
+  size_t text_used;
+  size_t text_capacity;
+  size_t *offsets;
+  long long *sizes;
+  mongo_coll_type_t *types;
+  int count;
+  int capacity;
+} name_list_t;
+
+static bool name_list_push(name_list_t *list, const char *name,
+                           long long size, mongo_coll_type_t type) {
+  if (list->count == list->capacity) {
+    int capacity = list->capacity ? list->capacity * 2 : 64;
+    size_t *offsets = realloc(list->offsets, capacity * sizeof(size_t));
+    if (offsets) {
+      list->offsets = offsets;
+    }
+    long long *sizes = realloc(list->sizes, capacity * sizeof(long long));
+    if (sizes) {
+      list->sizes = sizes;
+    }
+    mongo_coll_type_t *types =
+        realloc(list->types, capacity * sizeof(mongo_coll_type_t));
+    if (types) {
+      list->types = types;
+    }
+    if (!offsets || !sizes || !types) {
+      return false;
+    }
+    list->capacity = capacity;
+  }
+
+  size_t len = strlen(name) + 1;
+  if (list->text_used + len > list->text_capacity) {
+    size_t capacity = list->text_capacity ? list->text_capacity * 2 : 4096;
+    while (capacity < list->text_used + len) {
+      capacity *= 2;
+    }
+    char *text = realloc(list->text, capacity);
+    if (!text) {
+      return false;
+    }
+    list->text = text;
+    list->text_capacity = capacity;
+  }
+
+  memcpy(list->text + list->text_used, name, len);
+  list->offsets[list->count] = list->text_used;
+  list->sizes[list->count] = size;
+  list->types[list->count] = type;
+  list->text_used += len;
+  list->count++;
+  return true;
+}
+
+// empaquetar (pack_string_array); NULL si no hay memoria
+static char **name_list_pack(const name_list_t *list) {
+  const char **names = malloc((list->count > 0 ? list->count : 1) *
+                              sizeof(char *));
+  if (!names) {
+    return NULL;
+  }
+  for (int i = 0; i < list->count; i++) {
+    names[i] = list->text + list->offsets[i];
+  }
+  char **packed = pack_string_array(names, list->count);
+  free(names);
+  return packed;
+}
+
+// copia de un array paralelo del listado (liberar con free)
+static void *name_list_column(const void *column, int count, size_t size) {
+  void *copy = malloc((count > 0 ? count : 1) * size);
+  if (copy) {
+    memcpy(copy, column, count * size);
+  }
+  return copy;
+}
+
+static void name_list_free(name_list_t *list) {
+  free(list->text);
+  free(list->offsets);
+  free(list->sizes);
+  free(list->types);
+}
+
+char **mongo_list_databases(mongo_context_t *ctx, long long **sizes,
+                            int *count) {
   if (!ctx || !ctx->client || !count) {
     if (ctx) {
       snprintf(ctx->error_message, sizeof(ctx->error_message),
@@ -148,6 +404,9 @@ char **mongo_list_databases(mongo_context_t *ctx, int *count) {
   }
 
   *count = 0;
+  if (sizes) {
+    *sizes = NULL;
+  }
   bson_error_t error;
 
   // obtener nombre de BD del URI si está
@@ -156,87 +415,114 @@ char **mongo_list_databases(mongo_context_t *ctx, int *count) {
     uri_db = mongoc_uri_get_database(ctx->uri);
   }
 
-  // traer nombres de bases de datos
-  char **db_names =
-      mongoc_client_get_database_names_with_opts(ctx->client, NULL, &error);
-  if (!db_names) {
+  // nombres y tamaños en una sola ida y vuelta; authorizedDatabases deja
+  // listar a un usuario sin permiso sobre el cluster (ve sólo las suyas)
+  bson_t *command =
+      BCON_NEW("listDatabases", BCON_INT32(1), "nameOnly", BCON_BOOL(false),
+               "authorizedDatabases", BCON_BOOL(true));
+  bson_t reply;
+  bool ok = mongoc_client_command_simple(ctx->client, "admin", command, NULL,
+                                         &reply, &error);
+  bson_destroy(command);
+  if (!ok) {
+    bson_destroy(&reply);
     snprintf(ctx->error_message, sizeof(ctx->error_message),
              "Failed to list databases: %s", error.message);
     return NULL;
   }
 
-  // contar bases de datos
-  int db_count = 0;
-  while (db_names[db_count]) {
-    db_count++;
+  // la BD del URI va primero si no está en la lista (sin permiso para
+  // listar, suele ser la única a la que se puede entrar)
+  name_list_t list = {0};
+  bool listed = false;
+  bool failed = false;
+  bson_iter_t iter, databases;
+  if (bson_iter_init_find(&iter, &reply, "databases") &&
+      BSON_ITER_HOLDS_ARRAY(&iter) && bson_iter_recurse(&iter, &databases)) {
+    while (bson_iter_next(&databases)) {
+      bson_iter_t field;
+      if (BSON_ITER_HOLDS_DOCUMENT(&databases) &&
+          bson_iter_recurse(&databases, &field) &&
+          bson_iter_find(&field, "name") && BSON_ITER_HOLDS_UTF8(&field)) {
+        listed = listed || (uri_db && strcmp(bson_iter_utf8(&field, NULL),
+                                             uri_db) == 0);
+      }
+    }
+  }
+  if (uri_db && uri_db[0] != '\0' && !listed) {
+    failed = !name_list_push(&list, uri_db, -1, MONGO_COLL_COLLECTION);
   }
 
-  // ver si la BD del URI ya está en la lista
-  bool uri_db_in_list = false;
-  if (uri_db && uri_db[0] != '\0') {
-    for (int i = 0; i < db_count; i++) {
-      if (strcmp(db_names[i], uri_db) == 0) {
-        uri_db_in_list = true;
-        break;
+  if (bson_iter_init_find(&iter, &reply, "databases") &&
+      BSON_ITER_HOLDS_ARRAY(&iter) && bson_iter_recurse(&iter, &databases)) {
+    while (!failed && bson_iter_next(&databases)) {
+      bson_iter_t field;
+      const char *name = NULL;
+      long long size = -1;
+      if (!BSON_ITER_HOLDS_DOCUMENT(&databases) ||
+          !bson_iter_recurse(&databases, &field)) {
+        continue;
+      }
+      while (bson_iter_next(&field)) {
+        const char *key = bson_iter_key(&field);
+        if (strcmp(key, "name") == 0 && BSON_ITER_HOLDS_UTF8(&field)) {
+          name = bson_iter_utf8(&field, NULL);
+        } else if (strcmp(key, "sizeOnDisk") == 0 &&
+                   BSON_ITER_HOLDS_NUMBER(&field)) {
+          size = (long long)bson_iter_as_int64(&field);
+        }
+      }
+      if (name) {
+        failed = !name_list_push(&list, name, size, MONGO_COLL_COLLECTION);
       }
     }
   }
+  bson_destroy(&reply);
 
-  // calcular conteo final (agregar 1 si la BD del URI no está)
-  int final_count = db_count;
-  if (uri_db && uri_db[0] != '\0' && !uri_db_in_list) {
-    final_count++;
+  char **result = failed ? NULL : name_list_pack(&list);
+  if (result && sizes &&
+      !(*sizes = name_list_column(list.sizes, list.count,
+                                  sizeof(long long)))) {
+    free(result);
+    result = NULL;
   }
-
-  // crear nuestro propio array
-  char **result = malloc(final_count * sizeof(char *));
-  if (!result) {
-    bson_strfreev(db_names);
+  if (result) {
+    *count = list.count;
+  } else {
     snprintf(ctx->error_message, sizeof(ctx->error_message),
              "Memory allocation failed");
-    return NULL;
   }
 
-  int result_idx = 0;
+  name_list_free(&list);
+  return result;
+}
 
-  // agregar BD del URI primero si no está en lista
-  if (uri_db && uri_db[0] != '\0' && !uri_db_in_list) {
-    result[result_idx] = str_dup(uri_db);
-    if (!result[result_idx]) {
-      free(result);
-      bson_strfreev(db_names);
-      snprintf(ctx->error_message, sizeof(ctx->error_message),
-               "Memory allocation failed");
-      return NULL;
+// tipo según una entrada de listCollections
+static mongo_coll_type_t collection_type(const bson_t *info) {
+  bson_iter_t iter;
+  if (bson_iter_init_find(&iter, info, "type") &&
+      BSON_ITER_HOLDS_UTF8(&iter)) {
+    const char *type = bson_iter_utf8(&iter, NULL);
+    if (strcmp(type, "view") == 0) {
+      return MONGO_COLL_VIEW;
     }
-    result_idx++;
-  }
-
-  // copiar el resto de nombres de BD
-  for (int i = 0; i < db_count; i++) {
-    result[result_idx] = str_dup(db_names[i]);
-    if (!result[result_idx]) {
-      // liberar lo que ya creamos
-      for (int j = 0; j < result_idx; j++) {
-        free(result[j]);
-      }
-      free(result);
-      bson_strfreev(db_names);
-      snprintf(ctx->error_message, sizeof(ctx->error_message),
-               "Memory allocation failed");
-      return NULL;
+    if (strcmp(type, "timeseries") == 0) {
+      return MONGO_COLL_TIMESERIES;
     }
-    result_idx++;
   }
 
-  bson_strfreev(db_names);
-  *count = final_count;
-
-  return result;
+  // con nameOnly el servidor suele omitir options: capped sólo si vino
+  bson_iter_t capped;
+  if (bson_iter_init(&iter, info) &&
+      bson_iter_find_descendant(&iter, "options.capped", &capped) &&
+      bson_iter_as_bool(&capped)) {
+    return MONGO_COLL_CAPPED;
+  }
+  return MONGO_COLL_COLLECTION;
 }
 
 char **mongo_list_collections(mongo_context_t *ctx, const char *db_name,
-                              int *count) {
+                              mongo_coll_type_t **types, int *count) {
   if (!ctx || !ctx->client || !db_name || !count) {
     if (ctx) {
       snprintf(ctx->error_message, sizeof(ctx->error_message),
@@ -246,6 +532,9 @@ char **mongo_list_collections(mongo_context_t *ctx, const char *db_name,
   }
 
   *count = 0;
+  if (types) {
+    *types = NULL;
+  }
   bson_error_t error;
 
   mongoc_database_t *database =
@@ -256,52 +545,52 @@ char **mongo_list_collections(mongo_context_t *ctx, const char *db_name,
     return NULL;
   }
 
-  // traer nombres de colecciones
-  char **coll_names =
-      mongoc_database_get_collection_names_with_opts(database, NULL, &error);
-  if (!coll_names) {
+  // nameOnly no toma locks de colección; authorizedCollections (que pide
+  // nameOnly) lista lo que el usuario puede usar aunque no tenga
+  // listCollections sobre la BD. el tipo viene en la misma respuesta
+  bson_t *opts = BCON_NEW("nameOnly", BCON_BOOL(true), "authorizedCollections",
+                          BCON_BOOL(true));
+  mongoc_cursor_t *cursor =
+      mongoc_database_find_collections_with_opts(database, opts);
+  bson_destroy(opts);
+
+  name_list_t list = {0};
+  bool failed = false;
+  const bson_t *info;
+  while (!failed && mongoc_cursor_next(cursor, &info)) {
+    bson_iter_t iter;
+    if (bson_iter_init_find(&iter, info, "name") &&
+        BSON_ITER_HOLDS_UTF8(&iter)) {
+      failed = !name_list_push(&list, bson_iter_utf8(&iter, NULL), -1,
+                               collection_type(info));
+    }
+  }
+
+  bool cursor_failed = mongoc_cursor_error(cursor, &error);
+  mongoc_cursor_destroy(cursor);
+  mongoc_database_destroy(database);
+  if (cursor_failed) {
     snprintf(ctx->error_message, sizeof(ctx->error_message),
              "Failed to list collections: %s", error.message);
-    mongoc_database_destroy(database);
+    name_list_free(&list);
     return NULL;
   }
 
-  // contar colecciones
-  int coll_count = 0;
-  while (coll_names[coll_count]) {
-    coll_count++;
+  char **result = failed ? NULL : name_list_pack(&list);
+  if (result && types &&
+      !(*types = name_list_column(list.types, list.count,
+                                  sizeof(mongo_coll_type_t)))) {
+    free(result);
+    result = NULL;
   }
-
-  // crear nuestro propio array
-  char **result = malloc(coll_count * sizeof(char *));
-  if (!result) {
-    bson_strfreev(coll_names);
-    mongoc_database_destroy(database);
+  if (result) {
+    *count = list.count;
+  } else {
     snprintf(ctx->error_message, sizeof(ctx->error_message),
              "Memory allocation failed");
-    return NULL;
   }
 
-  // copiar nombres de colecciones
-  for (int i = 0; i < coll_count; i++) {
-    result[i] = str_dup(coll_names[i]);
-    if (!result[i]) {
-      for (int j = 0; j < i; j++) {
-        free(result[j]);
-      }
-      free(result);
-      bson_strfreev(coll_names);
-      mongoc_database_destroy(database);
-      snprintf(ctx->error_message, sizeof(ctx->error_message),
-               "Memory allocation failed");
-      return NULL;
-    }
-  }
-
-  bson_strfreev(coll_names);
-  mongoc_database_destroy(database);
-  *count = coll_count;
-
+  name_list_free(&list);
   return result;
 }
 
@@ -415,9 +704,29 @@ long long mongo_count_documents(mongo_context_t *ctx, const char *db_name,
   return count;
 }
 
+void mongo_find_opts_append(bson_t *opts, const mongo_find_opts_t *find_opts,
+                            long long skip, int limit) {
+  if (skip > 0) {
+    BSON_APPEND_INT64(opts, "skip", skip);
+  }
+  if (limit > 0) {
+    BSON_APPEND_INT32(opts, "limit", limit);
+  }
+  if (find_opts && find_opts->sort && !bson_empty(find_opts->sort)) {
+    BSON_APPEND_DOCUMENT(opts, "sort", find_opts->sort);
+  }
+  if (find_opts && find_opts->hint && find_opts->hint[0] != '\0') {
+    BSON_APPEND_UTF8(opts, "hint", find_opts->hint);
+  }
+  if (find_opts && find_opts->allow_disk_use) {
+    BSON_APPEND_BOOL(opts, "allowDiskUse", true);
+  }
+}
+
 bson_t **mongo_find_documents(mongo_context_t *ctx, const char *db_name,
                               const char *collection_name, const bson_t *filter,
-                              int skip, int limit, int *count) {
+                              const mongo_find_opts_t *find_opts,
+                              long long skip, int limit, int *count) {
   if (!ctx || !ctx->client || !db_name || !collection_name || !count) {
     if (ctx) {
       snprintf(ctx->error_message, sizeof(ctx->error_message),
@@ -440,113 +749,546 @@ bson_t **mongo_find_documents(mongo_context_t *ctx, const char *db_name,
   // armar opciones de query
   bson_t opts;
   bson_init(&opts);
-  if (skip > 0) {
-    BSON_APPEND_INT32(&opts, "skip", skip);
-  }
-  if (limit > 0) {
-    BSON_APPEND_INT32(&opts, "limit", limit);
-  }
+  mongo_find_opts_append(&opts, find_opts, skip, limit);
 
-  const bson_t *query = filter ? filter : bson_new();
+  bson_t empty;
+  bson_init(&empty);
+  const bson_t *query = filter ? filter : &empty;
 
-  // ejecutar find
+  // ejecutar find (una sola vez; el array crece a medida que llegan docs)
   mongoc_cursor_t *cursor =
       mongoc_collection_find_with_opts(collection, query, &opts, NULL);
 
-  if (!cursor) {
-    if (!filter) {
-      bson_destroy((bson_t *)query);
+  bson_t **documents = NULL;
+  int capacity = 0;
+  int doc_count = 0;
+  bool failed = false;
+
+  const bson_t *doc;
+  while (mongoc_cursor_next(cursor, &doc)) {
+    if (doc_count == capacity) {
+      capacity = capacity ? capacity * 2 : (limit > 0 ? limit : 16);
+      bson_t **grown = realloc(documents, capacity * sizeof(bson_t *));
+      if (!grown) {
+        snprintf(ctx->error_message, sizeof(ctx->error_message),
+                 "Memory allocation failed");
+        failed = true;
+        break;
+      }
+      documents = grown;
+    }
+
+    documents[doc_count] = bson_copy(doc);
+    if (!documents[doc_count]) {
+      snprintf(ctx->error_message, sizeof(ctx->error_message),
+               "Failed to copy document");
+      failed = true;
+      break;
     }
-    bson_destroy(&opts);
-    mongoc_collection_destroy(collection);
-    snprintf(ctx->error_message, sizeof(ctx->error_message),
-             "Failed to create cursor");
+    doc_count++;
+  }
+
+  // ver si hay errores del cursor
+  bson_error_t error;
+  if (!failed && mongoc_cursor_error(cursor, &error)) {
+    snprintf(ctx->error_message, sizeof(ctx->error_message), "Cursor error: %s",
+             error.message);
+    failed = true;
+  }
+
+  mongoc_cursor_destroy(cursor);
+  bson_destroy(&empty);
+  bson_destroy(&opts);
+  mongoc_collection_destroy(collection);
+
+  if (failed || doc_count == 0) {
+    mongo_free_documents(documents, doc_count);
     return NULL;
   }
 
-  // contar resultados primero
+  *count = doc_count;
+  return documents;
+}
+
+bool mongo_find_each(mongo_context_t *ctx, const char *db_name,
+                     const char *collection_name, const bson_t *filter,
+                     const mongo_find_opts_t *find_opts, long long skip,
+                     int limit, mongo_doc_fn each, void *user_data) {
+  if (!ctx || !ctx->client || !db_name || !collection_name || !each) {
+    if (ctx) {
+      snprintf(ctx->error_message, sizeof(ctx->error_message),
+               "Invalid parameters");
+    }
+    return false;
+  }
+
+  mongoc_collection_t *collection =
+      mongoc_client_get_collection(ctx->client, db_name, collection_name);
+  if (!collection) {
+    snprintf(ctx->error_message, sizeof(ctx->error_message),
+             "Failed to access collection: %s.%s", db_name, collection_name);
+    return false;
+  }
+
+  bson_t opts;
+  bson_init(&opts);
+  mongo_find_opts_append(&opts, find_opts, skip, limit);
+
+  bson_t empty;
+  bson_init(&empty);
+  const bson_t *query = filter ? filter : &empty;
+
+  mongoc_cursor_t *cursor =
+      mongoc_collection_find_with_opts(collection, query, &opts, NULL);
+
+  // el documento apunta al batch del cursor: vale hasta el próximo next
   const bson_t *doc;
-  int doc_count = 0;
   while (mongoc_cursor_next(cursor, &doc)) {
-    doc_count++;
+    if (!each(doc, user_data)) {
+      break;
+    }
   }
 
-  // ver si hay errores del cursor
   bson_error_t error;
-  if (mongoc_cursor_error(cursor, &error)) {
+  bool ok = !mongoc_cursor_error(cursor, &error);
+  if (!ok) {
     snprintf(ctx->error_message, sizeof(ctx->error_message), "Cursor error: %s",
              error.message);
-    mongoc_cursor_destroy(cursor);
-    if (!filter) {
-      bson_destroy((bson_t *)query);
+  }
+
+  mongoc_cursor_destroy(cursor);
+  bson_destroy(&empty);
+  bson_destroy(&opts);
+  mongoc_collection_destroy(collection);
+  return ok;
+}
+
+bson_t **mongo_list_indexes(mongo_context_t *ctx, const char *db_name,
+                            const char *collection_name, int *count) {
+  if (!ctx || !ctx->client || !db_name || !collection_name || !count) {
+    if (ctx) {
+      snprintf(ctx->error_message, sizeof(ctx->error_message),
+               "Invalid parameters");
     }
-    bson_destroy(&opts);
-    mongoc_collection_destroy(collection);
     return NULL;
   }
 
-  if (doc_count == 0) {
-    mongoc_cursor_destroy(cursor);
-    if (!filter) {
-      bson_destroy((bson_t *)query);
+  *count = 0;
+
+  mongoc_collection_t *collection =
+      mongoc_client_get_collection(ctx->client, db_name, collection_name);
+  mongoc_cursor_t *cursor =
+      mongoc_collection_find_indexes_with_opts(collection, NULL);
+
+  bson_t **indexes = NULL;
+  int capacity = 0;
+  const bson_t *spec;
+  while (mongoc_cursor_next(cursor, &spec)) {
+    if (*count == capacity) {
+      capacity = capacity ? capacity * 2 : 8;
+      bson_t **grown = realloc(indexes, capacity * sizeof(bson_t *));
+      if (!grown) {
+        break;
+      }
+      indexes = grown;
     }
-    bson_destroy(&opts);
-    mongoc_collection_destroy(collection);
+    indexes[(*count)++] = bson_copy(spec);
+  }
+
+  bson_error_t error;
+  if (mongoc_cursor_error(cursor, &error)) {
+    snprintf(ctx->error_message, sizeof(ctx->error_message),
+             "Failed to list indexes: %s", error.message);
+    mongo_free_documents(indexes, *count);
+    indexes = NULL;
+    *count = 0;
+  }
+
+  mongoc_cursor_destroy(cursor);
+  mongoc_collection_destroy(collection);
+  return indexes;
+}
+
+// ver si el filtro fija un campo por igualdad ({campo: valor} o {$eq})
+static bool filter_has_equality(const bson_t *filter, const char *field) {
+  bson_iter_t iter;
+  if (!filter || !bson_iter_init_find(&iter, filter, field)) {
+    return false;
+  }
+
+  if (!BSON_ITER_HOLDS_DOCUMENT(&iter)) {
+    return true;
+  }
+
+  bson_iter_t child;
+  if (bson_iter_recurse(&iter, &child) && bson_iter_next(&child)) {
+    const char *op = bson_iter_key(&child);
+    if (op[0] != '$') {
+      return true; // igualdad contra un subdocumento
+    }
+    return strcmp(op, "$eq") == 0 && !bson_iter_next(&child);
+  }
+
+  return true;
+}
+
+static int key_direction(const bson_iter_t *iter) {
+  switch (bson_iter_type(iter)) {
+  case BSON_TYPE_INT32:
+  case BSON_TYPE_INT64:
+  case BSON_TYPE_DOUBLE: {
+    double d = bson_iter_as_double(iter);
+    return d > 0 ? 1 : (d < 0 ? -1 : 0);
+  }
+  default:
+    return 0; // "hashed", "text", "2dsphere"... no sirven para ordenar
+  }
+}
+
+const char *mongo_index_for_sort(bson_t **indexes, int count,
+                                 const bson_t *sort, const bson_t *filter) {
+  if (!indexes || !sort || bson_empty(sort)) {
     return NULL;
   }
 
-  // crear array para documentos
-  bson_t **documents = malloc(doc_count * sizeof(bson_t *));
-  if (!documents) {
-    mongoc_cursor_destroy(cursor);
-    if (!filter) {
-      bson_destroy((bson_t *)query);
+  for (int i = 0; i < count; i++) {
+    bson_iter_t iter, key;
+    if (!bson_iter_init_find(&iter, indexes[i], "key") ||
+        !BSON_ITER_HOLDS_DOCUMENT(&iter) || !bson_iter_recurse(&iter, &key)) {
+      continue;
     }
-    bson_destroy(&opts);
-    mongoc_collection_destroy(collection);
-    snprintf(ctx->error_message, sizeof(ctx->error_message),
-             "Memory allocation failed");
+
+    bson_iter_t sort_iter;
+    bson_iter_init(&sort_iter, sort);
+    bool have_sort = bson_iter_next(&sort_iter);
+    bool matched = true;
+    int flip = 0; // 1 = mismo sentido, -1 = índice recorrido al revés
+
+    while (have_sort && bson_iter_next(&key)) {
+      const char *field = bson_iter_key(&key);
+      int index_dir = key_direction(&key);
+
+      if (strcmp(field, bson_iter_key(&sort_iter)) == 0) {
+        int wanted = key_direction(&sort_iter) * index_dir;
+        if (index_dir == 0 || wanted == 0 || (flip != 0 && wanted != flip)) {
+          matched = false;
+          break;
+        }
+        flip = wanted;
+        have_sort = bson_iter_next(&sort_iter);
+      } else if (flip == 0 && filter_has_equality(filter, field)) {
+        // prefijo fijado por igualdad: el resto del índice sigue ordenado
+        continue;
+      } else {
+        matched = false;
+        break;
+      }
+    }
+
+    if (matched && !have_sort && bson_iter_init_find(&iter, indexes[i], "name")) {
+      return bson_iter_utf8(&iter, NULL);
+    }
+  }
+
+  return NULL;
+}
+
+bson_t *mongo_parse_sort(const char *spec, bson_error_t *error) {
+  if (!spec) {
     return NULL;
   }
 
-  // re-ejecutar query porque el cursor ya se consumió
-  mongoc_cursor_destroy(cursor);
-  cursor = mongoc_collection_find_with_opts(collection, query, &opts, NULL);
-
-  // copiar documentos
-  int idx = 0;
-  while (mongoc_cursor_next(cursor, &doc) && idx < doc_count) {
-    documents[idx] = bson_copy(doc);
-    if (!documents[idx]) {
-      // liberar lo que ya creamos
-      for (int i = 0; i < idx; i++) {
-        bson_destroy(documents[i]);
+  while (isspace((unsigned char)*spec)) {
+    spec++;
+  }
+
+  // también se acepta JSON tal cual
+  if (*spec == '{') {
+    return mongo_json_to_bson(spec, error);
+  }
+
+  bson_t *sort = bson_new();
+  const char *p = spec;
+  while (*p) {
+    while (*p == ',' || isspace((unsigned char)*p)) {
+      p++;
+    }
+    if (!*p) {
+      break;
+    }
+
+    // "-campo", "campo:-1", "campo:1" o "campo"
+    int direction = 1;
+    if (*p == '-' || *p == '+') {
+      direction = (*p == '-') ? -1 : 1;
+      p++;
+    }
+
+    const char *start = p;
+    while (*p && *p != ',' && *p != ':' && !isspace((unsigned char)*p)) {
+      p++;
+    }
+    int len = (int)(p - start);
+
+    while (isspace((unsigned char)*p)) {
+      p++;
+    }
+    if (*p == ':') {
+      p++;
+      char *end;
+      long value = strtol(p, &end, 10);
+      if (end == p || (value != 1 && value != -1)) {
+        if (error) {
+          snprintf(error->message, sizeof(error->message),
+                   "Direction must be 1 or -1");
+        }
+        bson_destroy(sort);
+        return NULL;
       }
-      free(documents);
-      mongoc_cursor_destroy(cursor);
-      if (!filter) {
-        bson_destroy((bson_t *)query);
+      direction = (int)value;
+      p = end;
+    }
+
+    if (len == 0) {
+      if (error) {
+        snprintf(error->message, sizeof(error->message),
+                 "Empty field name in sort");
       }
-      bson_destroy(&opts);
-      mongoc_collection_destroy(collection);
-      snprintf(ctx->error_message, sizeof(ctx->error_message),
-               "Failed to copy document");
+      bson_destroy(sort);
       return NULL;
     }
-    idx++;
+
+    bson_append_int32(sort, start, len, direction);
   }
 
-  mongoc_cursor_destroy(cursor);
-  if (!filter) {
-    bson_destroy((bson_t *)query);
+  return sort;
+}
+
+bson_t *mongo_sort_reverse(const bson_t *sort) {
+  bson_t *reversed = bson_new();
+  if (!sort || bson_empty(sort)) {
+    BSON_APPEND_INT32(reversed, "$natural", -1);
+    return reversed;
   }
-  bson_destroy(&opts);
-  mongoc_collection_destroy(collection);
 
-  *count = doc_count;
+  bson_iter_t iter;
+  if (bson_iter_init(&iter, sort)) {
+    while (bson_iter_next(&iter)) {
+      int direction = key_direction(&iter);
+      if (direction == 0) {
+        bson_destroy(reversed);
+        return NULL;
+      }
+      bson_append_int32(reversed, bson_iter_key(&iter), -1, -direction);
+    }
+  }
+  return reversed;
+}
+
+bson_t *mongo_sort_with_id(const bson_t *sort) {
+  bson_t *keyed = bson_copy(sort);
+  int direction = 1;
+  bson_iter_t iter;
+  if (bson_iter_init(&iter, sort)) {
+    while (bson_iter_next(&iter)) {
+      direction = key_direction(&iter) < 0 ? -1 : 1;
+    }
+  }
+  BSON_APPEND_INT32(keyed, "_id", direction);
+  return keyed;
+}
+
+bool mongo_sort_is_total(const bson_t *sort) {
+  bson_iter_t iter;
+  if (!sort || !bson_iter_init(&iter, sort)) {
+    return false;
+  }
+
+  const char *last = NULL;
+  while (bson_iter_next(&iter)) {
+    if (key_direction(&iter) == 0) {
+      return false;
+    }
+    last = bson_iter_key(&iter);
+  }
+  return last && strcmp(last, "_id") == 0;
+}
+
+// valor de una clave del orden: el campo con ese nombre tal cual (en una
+// clave ya extraída) o la ruta con puntos dentro del documento
+static bool sort_key_value(const bson_t *doc, const char *key,
+                           bson_iter_t *value) {
+  bson_iter_t iter;
+  return bson_iter_init_find(value, doc, key) ||
+         (bson_iter_init(&iter, doc) &&
+          bson_iter_find_descendant(&iter, key, value));
+}
+
+// el valor o null si falta (el servidor ordena los faltantes como null)
+static void append_sort_value(bson_t *parent, const char *name,
+                              const bson_t *doc, const char *key) {
+  bson_iter_t value;
+  if (sort_key_value(doc, key, &value)) {
+    bson_append_iter(parent, name, -1, &value);
+  } else {
+    bson_append_null(parent, name, -1);
+  }
+}
+
+bson_t *mongo_sort_key(const bson_t *doc, const bson_t *sort) {
+  bson_t *key = bson_new();
+  bson_iter_t iter;
+  if (doc && sort && bson_iter_init(&iter, sort)) {
+    while (bson_iter_next(&iter)) {
+      append_sort_value(key, bson_iter_key(&iter), doc, bson_iter_key(&iter));
+    }
+  }
+  return key;
+}
+
+bson_t *mongo_keyset_filter(const bson_t *filter, const bson_t *sort,
+                            const bson_t *anchor, bool before) {
+  bson_t *result = bson_new();
+  bson_t *target = result;
+  bson_t all, range;
+  bool has_filter = filter && !bson_empty(filter);
+  if (has_filter) {
+    BSON_APPEND_ARRAY_BEGIN(result, "$and", &all);
+    BSON_APPEND_DOCUMENT(&all, "0", filter);
+    BSON_APPEND_DOCUMENT_BEGIN(&all, "1", &range);
+    target = &range;
+  }
+
+  // (k1 < v1) o (k1 = v1 y k2 < v2) o ... con < o > según el sentido
+  bson_t terms;
+  BSON_APPEND_ARRAY_BEGIN(target, "$or", &terms);
+  int keys = (int)bson_count_keys(sort);
+  for (int i = 0; i < keys; i++) {
+    char index[16];
+    snprintf(index, sizeof(index), "%d", i);
+    bson_t term;
+    bson_append_document_begin(&terms, index, -1, &term);
+
+    bson_iter_t iter;
+    bson_iter_init(&iter, sort);
+    for (int j = 0; j <= i && bson_iter_next(&iter); j++) {
+      const char *key = bson_iter_key(&iter);
+      if (j < i) {
+        append_sort_value(&term, key, anchor, key);
+        continue;
+      }
+
+      bool ascending = key_direction(&iter) > 0;
+      bool last = i == keys - 1;
+      const char *op = before      ? (ascending ? "$lt" : "$gt")
+                       : ascending ? (last ? "$gte" : "$gt")
+                                   : (last ? "$lte" : "$lt");
+      bson_t cond;
+      bson_append_document_begin(&term, key, -1, &cond);
+      append_sort_value(&cond, op, anchor, key);
+      bson_append_document_end(&term, &cond);
+    }
+    bson_append_document_end(&terms, &term);
+  }
+  bson_append_array_end(target, &terms);
+
+  if (has_filter) {
+    bson_append_document_end(&all, &range);
+    bson_append_array_end(result, &all);
+  }
+  return result;
+}
+
+void mongo_reverse_documents(bson_t **documents, int count) {
+  for (int i = 0, j = count - 1; i < j; i++, j--) {
+    bson_t *doc = documents[i];
+    documents[i] = documents[j];
+    documents[j] = doc;
+  }
+}
+
+bson_t **mongo_find_before(mongo_context_t *ctx, const char *db_name,
+                           const char *collection_name, const bson_t *filter,
+                           const mongo_find_opts_t *find_opts,
+                           const bson_t *anchor, long long end,
+                           long long total, int limit, int *count) {
+  if (count) {
+    *count = 0;
+  }
+  if (limit > end) {
+    limit = (int)end;
+  }
+  if (limit <= 0) {
+    return NULL;
+  }
+
+  const bson_t *sort = find_opts ? find_opts->sort : NULL;
+  bson_t *reversed = mongo_sort_reverse(sort);
+  if (!reversed) {
+    // un orden por $meta no se puede invertir: skip hacia adelante
+    return mongo_find_documents(ctx, db_name, collection_name, filter,
+                                find_opts, end - limit, limit, count);
+  }
+
+  mongo_find_opts_t back = {
+      .sort = reversed,
+      .hint = find_opts ? find_opts->hint : NULL,
+      .allow_disk_use = find_opts && find_opts->allow_disk_use,
+  };
+
+  bson_t **documents = NULL;
+  if (anchor && mongo_sort_is_total(sort)) {
+    bson_t *range = mongo_keyset_filter(filter, sort, anchor, true);
+    documents = mongo_find_documents(ctx, db_name, collection_name, range,
+                                     &back, 0, limit, count);
+    bson_destroy(range);
+
+    // con tipos mezclados en una clave el rango deja afuera documentos que
+    // el orden sí pone antes: si faltan, se vuelve a leer con skip
+    if (documents && *count < limit) {
+      mongo_free_documents(documents, *count);
+      documents = NULL;
+      *count = 0;
+    }
+  }
+
+  if (!documents) {
+    long long skip = total > end ? total - end : 0;
+    documents = mongo_find_documents(ctx, db_name, collection_name, filter,
+                                     &back, skip, limit, count);
+  }
+  bson_destroy(reversed);
+
+  if (documents) {
+    mongo_reverse_documents(documents, *count);
+  }
   return documents;
 }
 
+long long mongo_avg_document_size(mongo_context_t *ctx, const char *db_name,
+                                  const char *collection_name) {
+  if (!ctx || !ctx->client || !db_name || !collection_name) {
+    return -1;
+  }
+
+  bson_t *command = BCON_NEW("collStats", BCON_UTF8(collection_name));
+  bson_t reply;
+  bson_error_t error;
+  long long avg = -1;
+
+  if (mongoc_client_command_simple(ctx->client, db_name, command, NULL, &reply,
+                                   &error)) {
+    bson_iter_t iter;
+    if (bson_iter_init_find(&iter, &reply, "avgObjSize")) {
+      avg = (long long)bson_iter_as_int64(&iter);
+    }
+  }
+
+  bson_destroy(&reply);
+  bson_destroy(command);
+  return avg;
+}
+
 bool mongo_insert_document(mongo_context_t *ctx, const char *db_name,
                            const char *collection_name,
                            const bson_t *document) {
@@ -725,6 +1467,58 @@ bson_t *mongo_json_to_bson(const char *json_string, bson_error_t *error) {
   return bson;
 }
 
+bson_t *mongo_build_regex_filter(const char *text, const char *const *fields,
+                                 int field_count) {
+  if (!text || !fields || field_count <= 0) {
+    return NULL;
+  }
+
+  // escapar metacaracteres para que el texto se busque literal; smart
+  // case como la búsqueda en la página: sin mayúsculas ignora mayúsculas
+  size_t len = strlen(text);
+  char *pattern = malloc(len * 2 + 1);
+  if (!pattern) {
+    return NULL;
+  }
+
+  size_t out = 0;
+  bool ignore_case = true;
+  for (size_t i = 0; i < len; i++) {
+    if (isupper((unsigned char)text[i])) {
+      ignore_case = false;
+    }
+    if (strchr("\\^$.|?*+()[]{}", text[i])) {
+      pattern[out++] = '\\';
+    }
+    pattern[out++] = text[i];
+  }
+  pattern[out] = '\0';
+
+  bson_t *filter = bson_new();
+  bson_t or_array;
+  BSON_APPEND_ARRAY_BEGIN(filter, "$or", &or_array);
+
+  for (int i = 0; i < field_count; i++) {
+    char key[16];
+    snprintf(key, sizeof(key), "%d", i);
+
+    bson_t clause, cond;
+    bson_append_document_begin(&or_array, key, -1, &clause);
+    bson_append_document_begin(&clause, fields[i], -1, &cond);
+    BSON_APPEND_UTF8(&cond, "$regex", pattern);
+    if (ignore_case) {
+      BSON_APPEND_UTF8(&cond, "$options", "i");
+    }
+    bson_append_document_end(&clause, &cond);
+    bson_append_document_end(&or_array, &clause);
+  }
+
+  bson_append_array_end(filter, &or_array);
+  free(pattern);
+
+  return filter;
+}
+
 const char *mongo_get_error(mongo_context_t *ctx) {
   if (!ctx) {
     return "Invalid context";
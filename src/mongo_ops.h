@@ -12,6 +12,9 @@ typedef struct {
   char *current_collection;
   bool connected;
   char error_message[512];
+
+  // conexión en segundo plano (mongo_connect_start)
+  struct mongo_connect_job *connect_job;
 } mongo_context_t;
 
 // inicializar librería de mongo
@@ -20,6 +23,11 @@ void mongo_init(void);
 // limpiar librería de mongo
 void mongo_cleanup(void);
 
+// hilos sueltos con cliente propio (conexión, sondeos) que pueden seguir
+// vivos al salir: mongo_cleanup no libera libmongoc mientras haya alguno
+void mongo_background_begin(void);
+void mongo_background_end(void);
+
 // crear contexto de mongo
 mongo_context_t *mongo_context_new(void);
 
@@ -29,18 +37,53 @@ void mongo_context_free(mongo_context_t *ctx);
 // conectar a mongo con URI
 bool mongo_connect(mongo_context_t *ctx, const char *uri_string);
 
+// empezar mongo_connect en otro hilo, para que la interfaz siga viva
+// (y arranque) mientras tanto. el hilo conecta un contexto propio que pasa
+// a ctx en mongo_connect_poll
+bool mongo_connect_start(mongo_context_t *ctx, const char *uri_string);
+
+// true si hay una conexión lanzada que todavía no se retiró
+bool mongo_connect_pending(const mongo_context_t *ctx);
+
+// sin bloquear: false si la conexión sigue en curso; si terminó, la deja
+// en ctx (o el error en ctx->error_message) y pone el resultado en *ok
+bool mongo_connect_poll(mongo_context_t *ctx, bool *ok);
+
+// abandonar la conexión en curso; el hilo termina solo (a lo sumo lo que
+// tarde la selección de servidor) y libera lo que haya conectado
+void mongo_connect_cancel(mongo_context_t *ctx);
+
 // desconectar de mongo
 void mongo_disconnect(mongo_context_t *ctx);
 
 // probar si la conexión anda
 bool mongo_ping(mongo_context_t *ctx);
 
-// listar bases de datos
-char **mongo_list_databases(mongo_context_t *ctx, int *count);
-
-// listar colecciones
+// crear un cliente nuevo con el mismo URI (mongoc_client_t no es thread-safe,
+// cada hilo de trabajo necesita el suyo); liberar con mongoc_client_destroy
+mongoc_client_t *mongo_client_spawn(mongo_context_t *ctx);
+
+// listar bases de datos con un solo listDatabases (las que el usuario
+// puede ver). nombres en un solo bloque (liberar con free); sizes (si no
+// es NULL) recibe el tamaño en disco de cada una, -1 si no se sabe
+// (liberar con free)
+char **mongo_list_databases(mongo_context_t *ctx, long long **sizes,
+                            int *count);
+
+// tipo de colección según listCollections
+typedef enum {
+  MONGO_COLL_COLLECTION,
+  MONGO_COLL_VIEW,
+  MONGO_COLL_TIMESERIES,
+  MONGO_COLL_CAPPED
+} mongo_coll_type_t;
+
+// listar colecciones con listCollections nameOnly + authorizedCollections
+// (sin locks de colección, sirve con permisos mínimos). nombres en un solo
+// bloque (liberar con free); types (si no es NULL) recibe el tipo de cada
+// una (liberar con free)
 char **mongo_list_collections(mongo_context_t *ctx, const char *db_name,
-                              int *count);
+                              mongo_coll_type_t **types, int *count);
 
 // crear colección
 bool mongo_create_collection(mongo_context_t *ctx, const char *db_name,
@@ -55,10 +98,85 @@ long long mongo_count_documents(mongo_context_t *ctx, const char *db_name,
                                 const char *collection_name,
                                 const bson_t *filter);
 
-// buscar documentos
+// opciones de find
+typedef struct {
+  const bson_t *sort;  // orden o NULL (orden natural)
+  const char *hint;    // nombre de índice a forzar o NULL
+  bool allow_disk_use; // permitir sort en disco si supera 100MB
+} mongo_find_opts_t;
+
+// agregar skip/limit/sort/hint/allowDiskUse a las opciones de un find
+void mongo_find_opts_append(bson_t *opts, const mongo_find_opts_t *find_opts,
+                            long long skip, int limit);
+
+// buscar documentos (find_opts puede ser NULL)
 bson_t **mongo_find_documents(mongo_context_t *ctx, const char *db_name,
                               const char *collection_name, const bson_t *filter,
-                              int skip, int limit, int *count);
+                              const mongo_find_opts_t *find_opts,
+                              long long skip, int limit, int *count);
+
+// documento de un recorrido; devolver false lo corta
+typedef bool (*mongo_doc_fn)(const bson_t *doc, void *user_data);
+
+// recorrer un find sin copiar los documentos, a medida que llegan los
+// batches (volcados largos); false si hubo error del cursor. que each
+// corte el recorrido no es error
+bool mongo_find_each(mongo_context_t *ctx, const char *db_name,
+                     const char *collection_name, const bson_t *filter,
+                     const mongo_find_opts_t *find_opts, long long skip,
+                     int limit, mongo_doc_fn each, void *user_data);
+
+// listar especificaciones de índices (liberar con mongo_free_documents)
+bson_t **mongo_list_indexes(mongo_context_t *ctx, const char *db_name,
+                            const char *collection_name, int *count);
+
+// nombre del índice que puede dar el orden pedido (teniendo en cuenta
+// prefijos fijados por igualdad en el filtro); NULL si ninguno sirve
+const char *mongo_index_for_sort(bson_t **indexes, int count,
+                                 const bson_t *sort, const bson_t *filter);
+
+// parsear orden "campo:1, otro:-1", "-campo" o JSON
+bson_t *mongo_parse_sort(const char *spec, bson_error_t *error);
+
+// orden invertido ({$natural: -1} sin orden); NULL si tiene claves que no
+// se pueden invertir ({$meta: ...})
+bson_t *mongo_sort_reverse(const bson_t *sort);
+
+// el orden termina en _id: no hay empates y se puede paginar por rangos
+// de claves (keyset) en vez de con skip
+bool mongo_sort_is_total(const bson_t *sort);
+
+// el orden con _id al final, en el sentido de la última clave (un índice
+// {a: 1, _id: 1} lo sirve en los dos sentidos)
+bson_t *mongo_sort_with_id(const bson_t *sort);
+
+// valores de las claves del orden en doc, {"a.b": v, _id: id} (null si
+// falta); sirve de ancla para mongo_keyset_filter
+bson_t *mongo_sort_key(const bson_t *doc, const bson_t *sort);
+
+// filtro más el rango de claves de los documentos anteriores a anchor en
+// el orden (before) o desde anchor inclusive; anchor es un documento o su
+// mongo_sort_key. con tipos mezclados en una clave el rango puede dejar
+// documentos afuera
+bson_t *mongo_keyset_filter(const bson_t *filter, const bson_t *sort,
+                            const bson_t *anchor, bool before);
+
+// dar vuelta un array de documentos (leídos con el orden invertido)
+void mongo_reverse_documents(bson_t **documents, int count);
+
+// los limit documentos anteriores a la posición end (total = tamaño del
+// resultado), en orden. lee con el orden invertido: desde anchor (el
+// documento en end) con un rango si el orden es total, si no con skip
+// desde el final; anchor NULL y end = total es la última página sin skip
+bson_t **mongo_find_before(mongo_context_t *ctx, const char *db_name,
+                           const char *collection_name, const bson_t *filter,
+                           const mongo_find_opts_t *find_opts,
+                           const bson_t *anchor, long long end,
+                           long long total, int limit, int *count);
+
+// tamaño promedio de documento según collStats (-1 si no se sabe)
+long long mongo_avg_document_size(mongo_context_t *ctx, const char *db_name,
+                                  const char *collection_name);
 
 // insertar documento
 bool mongo_insert_document(mongo_context_t *ctx, const char *db_name,
@@ -81,6 +199,12 @@ void mongo_free_documents(bson_t **documents, int count);
 // parsear JSON a BSON
 bson_t *mongo_json_to_bson(const char *json_string, bson_error_t *error);
 
+// armar filtro {$or: [{campo: {$regex: texto, $options: "i"}}, ...]}
+// escapando el texto; "i" sólo si el texto no tiene mayúsculas (smart
+// case, como la búsqueda en la página); liberar con bson_destroy
+bson_t *mongo_build_regex_filter(const char *text, const char *const *fields,
+                                 int field_count);
+
 // obtener último error
 const char *mongo_get_error(mongo_context_t *ctx);
 
@@ -0,0 +1,456 @@
+#include "mongo_prefetch.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct mongo_prefetch {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  bool quit;
+
+  // consulta actual; generation cambia con cada set_query
+  unsigned generation;
+  char db_name[256];
+  char coll_name[256];
+  bson_t *filter;
+  bson_t *sort;
+  char hint[128];
+  bool allow_disk_use;
+
+  // pedido: [req_skip, req_skip + req_limit) o, hacia atrás, los
+  // req_limit anteriores a req_end
+  bool requested;
+  bool busy; // el hilo está atendiendo un pedido
+  long long req_skip;
+  int req_limit;
+  bool req_before;
+  long long req_end;
+  long long req_total;
+  bson_t *req_anchor; // documento en req_end (o NULL)
+
+  // lote terminado esperando que lo retiren
+  bool ready;
+  prefetch_batch_t result;
+
+  // sólo los usa el hilo
+  mongoc_client_t *client;
+};
+
+// copia de la consulta con la que trabaja el hilo fuera del lock
+typedef struct {
+  unsigned generation;
+  char db_name[256];
+  char coll_name[256];
+  bson_t *filter;
+  bson_t *sort;
+  char hint[128];
+  bool allow_disk_use;
+
+  // cursor abierto y la posición del próximo documento que entrega
+  mongoc_cursor_t *cursor;
+  long long cursor_next;
+
+  // cursor con el orden invertido; entrega el documento anterior a
+  // back_next
+  mongoc_cursor_t *back_cursor;
+  long long back_next;
+} prefetch_worker_t;
+
+static void batch_clear(prefetch_batch_t *batch) {
+  if (batch->docs) {
+    mongo_free_documents(batch->docs, batch->count);
+  }
+  memset(batch, 0, sizeof(*batch));
+}
+
+static void close_cursor(mongoc_cursor_t **cursor) {
+  if (*cursor) {
+    mongoc_cursor_destroy(*cursor);
+    *cursor = NULL;
+  }
+}
+
+static void worker_clear_query(prefetch_worker_t *w) {
+  close_cursor(&w->cursor);
+  close_cursor(&w->back_cursor);
+  if (w->filter) {
+    bson_destroy(w->filter);
+    w->filter = NULL;
+  }
+  if (w->sort) {
+    bson_destroy(w->sort);
+    w->sort = NULL;
+  }
+}
+
+// tomar la consulta nueva (con el lock tomado)
+static void worker_sync_query(prefetch_worker_t *w, mongo_prefetch_t *pf) {
+  worker_clear_query(w);
+  w->generation = pf->generation;
+  safe_strncpy(w->db_name, pf->db_name, sizeof(w->db_name));
+  safe_strncpy(w->coll_name, pf->coll_name, sizeof(w->coll_name));
+  w->filter = pf->filter ? bson_copy(pf->filter) : NULL;
+  w->sort = pf->sort ? bson_copy(pf->sort) : NULL;
+  safe_strncpy(w->hint, pf->hint, sizeof(w->hint));
+  w->allow_disk_use = pf->allow_disk_use;
+}
+
+// abrir un cursor con el orden dado que empieza en skip (sin limit: se
+// sigue leyendo)
+static mongoc_cursor_t *worker_open_cursor(prefetch_worker_t *w,
+                                           mongoc_client_t *client,
+                                           const bson_t *filter,
+                                           const bson_t *sort, long long skip,
+                                           int batch_size) {
+  mongoc_collection_t *collection =
+      mongoc_client_get_collection(client, w->db_name, w->coll_name);
+
+  mongo_find_opts_t find_opts = {
+      .sort = sort,
+      .hint = w->hint,
+      .allow_disk_use = w->allow_disk_use,
+  };
+  bson_t opts;
+  bson_init(&opts);
+  mongo_find_opts_append(&opts, &find_opts, skip, 0);
+  BSON_APPEND_INT32(&opts, "batchSize", batch_size);
+
+  bson_t empty;
+  bson_init(&empty);
+  mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(
+      collection, filter ? filter : &empty, &opts, NULL);
+
+  bson_destroy(&empty);
+  bson_destroy(&opts);
+  mongoc_collection_destroy(collection);
+  return cursor;
+}
+
+// leer hasta limit documentos del cursor al lote; si termina (o falla) lo
+// cierra para que el próximo pedido abra otro
+static void worker_read(mongoc_cursor_t **cursor, int limit,
+                        prefetch_batch_t *batch) {
+  batch->docs = malloc(limit * sizeof(bson_t *));
+  if (!batch->docs) {
+    batch->failed = true;
+    snprintf(batch->error_message, sizeof(batch->error_message),
+             "Memory allocation failed");
+    return;
+  }
+
+  const bson_t *doc;
+  while (batch->count < limit && mongoc_cursor_next(*cursor, &doc)) {
+    batch->docs[batch->count++] = bson_copy(doc);
+  }
+
+  bson_error_t error;
+  if (mongoc_cursor_error(*cursor, &error)) {
+    batch->failed = true;
+    snprintf(batch->error_message, sizeof(batch->error_message),
+             "Query failed: %s", error.message);
+    mongo_free_documents(batch->docs, batch->count);
+    batch->docs = NULL;
+    batch->count = 0;
+  }
+
+  if (batch->failed || batch->count < limit) {
+    close_cursor(cursor);
+  }
+}
+
+// leer [skip, skip + limit), reusando el cursor si ya está ahí
+static void worker_fetch(prefetch_worker_t *w, mongoc_client_t *client,
+                         long long skip, int limit, prefetch_batch_t *batch) {
+  memset(batch, 0, sizeof(*batch));
+  batch->skip = skip;
+
+  if (!w->cursor || w->cursor_next != skip) {
+    close_cursor(&w->cursor);
+    w->cursor = worker_open_cursor(w, client, w->filter, w->sort, skip, limit);
+    w->cursor_next = skip;
+  } else {
+    mongoc_cursor_set_batch_size(w->cursor, (uint32_t)limit);
+  }
+
+  worker_read(&w->cursor, limit, batch);
+  w->cursor_next += batch->count;
+}
+
+// leer los limit documentos anteriores a end con el orden invertido,
+// siguiendo el cursor hacia atrás si ya está ahí. al abrirlo, desde anchor
+// con un rango de claves si el orden es total y si no con skip desde el
+// final (end = total es la última página, sin skip)
+static void worker_fetch_before(prefetch_worker_t *w, mongoc_client_t *client,
+                                long long end, long long total, int limit,
+                                const bson_t *anchor,
+                                prefetch_batch_t *batch) {
+  if (limit > end) {
+    limit = (int)end;
+  }
+  bson_t *reversed = mongo_sort_reverse(w->sort);
+  if (!reversed) {
+    // un orden por $meta no se puede invertir
+    worker_fetch(w, client, end - limit, limit, batch);
+    return;
+  }
+
+  memset(batch, 0, sizeof(*batch));
+  bool keyset = false;
+  if (!w->back_cursor || w->back_next != end) {
+    close_cursor(&w->back_cursor);
+    keyset = anchor && mongo_sort_is_total(w->sort);
+    if (keyset) {
+      bson_t *range = mongo_keyset_filter(w->filter, w->sort, anchor, true);
+      w->back_cursor = worker_open_cursor(w, client, range, reversed, 0, limit);
+      bson_destroy(range);
+    } else {
+      w->back_cursor = worker_open_cursor(w, client, w->filter, reversed,
+                                          total > end ? total - end : 0,
+                                          limit);
+    }
+    w->back_next = end;
+  } else {
+    mongoc_cursor_set_batch_size(w->back_cursor, (uint32_t)limit);
+  }
+
+  worker_read(&w->back_cursor, limit, batch);
+
+  // con tipos mezclados en una clave el rango deja afuera documentos que
+  // el orden sí pone antes: si faltan, se vuelve a leer con skip
+  if (keyset && !batch->failed && batch->count < limit) {
+    batch_clear(batch);
+    close_cursor(&w->back_cursor);
+    w->back_cursor = worker_open_cursor(w, client, w->filter, reversed,
+                                        total > end ? total - end : 0, limit);
+    worker_read(&w->back_cursor, limit, batch);
+  }
+  bson_destroy(reversed);
+
+  mongo_reverse_documents(batch->docs, batch->count);
+  w->back_next -= batch->count;
+  batch->skip = end - batch->count;
+}
+
+static void *prefetch_thread(void *arg) {
+  mongo_prefetch_t *pf = arg;
+  prefetch_worker_t w;
+  memset(&w, 0, sizeof(w));
+
+  pthread_mutex_lock(&pf->lock);
+  while (true) {
+    while (!pf->quit && !pf->requested) {
+      pthread_cond_wait(&pf->wake, &pf->lock);
+    }
+    if (pf->quit) {
+      break;
+    }
+
+    if (w.generation != pf->generation) {
+      worker_sync_query(&w, pf);
+    }
+    long long skip = pf->req_skip;
+    int limit = pf->req_limit;
+    bool before = pf->req_before;
+    long long end = pf->req_end;
+    long long total = pf->req_total;
+    bson_t *anchor = pf->req_anchor;
+    pf->req_anchor = NULL;
+    unsigned generation = pf->generation;
+    pf->requested = false;
+    pf->busy = true;
+    pthread_mutex_unlock(&pf->lock);
+
+    prefetch_batch_t batch;
+    if (before) {
+      worker_fetch_before(&w, pf->client, end, total, limit, anchor, &batch);
+    } else {
+      worker_fetch(&w, pf->client, skip, limit, &batch);
+    }
+    if (anchor) {
+      bson_destroy(anchor);
+    }
+
+    pthread_mutex_lock(&pf->lock);
+    pf->busy = false;
+    if (generation == pf->generation) {
+      pf->result = batch;
+      pf->ready = true;
+    } else {
+      // la consulta cambió mientras leíamos
+      batch_clear(&batch);
+    }
+  }
+  pthread_mutex_unlock(&pf->lock);
+
+  worker_clear_query(&w);
+  return NULL;
+}
+
+mongo_prefetch_t *mongo_prefetch_new(mongo_context_t *ctx) {
+  mongo_prefetch_t *pf = calloc(1, sizeof(mongo_prefetch_t));
+  if (!pf) {
+    if (ctx) {
+      snprintf(ctx->error_message, sizeof(ctx->error_message),
+               "Memory allocation failed");
+    }
+    return NULL;
+  }
+
+  pf->client = mongo_client_spawn(ctx);
+  if (!pf->client) {
+    free(pf);
+    return NULL;
+  }
+
+  pthread_mutex_init(&pf->lock, NULL);
+  pthread_cond_init(&pf->wake, NULL);
+
+  if (pthread_create(&pf->thread, NULL, prefetch_thread, pf) != 0) {
+    snprintf(ctx->error_message, sizeof(ctx->error_message),
+             "Failed to start prefetch thread");
+    pthread_cond_destroy(&pf->wake);
+    pthread_mutex_destroy(&pf->lock);
+    mongoc_client_destroy(pf->client);
+    free(pf);
+    return NULL;
+  }
+
+  return pf;
+}
+
+void mongo_prefetch_free(mongo_prefetch_t *pf) {
+  if (!pf) {
+    return;
+  }
+
+  pthread_mutex_lock(&pf->lock);
+  pf->quit = true;
+  pthread_cond_signal(&pf->wake);
+  pthread_mutex_unlock(&pf->lock);
+  pthread_join(pf->thread, NULL);
+
+  batch_clear(&pf->result);
+  if (pf->req_anchor) {
+    bson_destroy(pf->req_anchor);
+  }
+  if (pf->filter) {
+    bson_destroy(pf->filter);
+  }
+  if (pf->sort) {
+    bson_destroy(pf->sort);
+  }
+  mongoc_client_destroy(pf->client);
+  pthread_cond_destroy(&pf->wake);
+  pthread_mutex_destroy(&pf->lock);
+  free(pf);
+}
+
+void mongo_prefetch_set_query(mongo_prefetch_t *pf, const char *db_name,
+                              const char *collection_name,
+                              const bson_t *filter,
+                              const mongo_find_opts_t *find_opts) {
+  if (!pf || !db_name || !collection_name) {
+    return;
+  }
+
+  pthread_mutex_lock(&pf->lock);
+  pf->generation++;
+  safe_strncpy(pf->db_name, db_name, sizeof(pf->db_name));
+  safe_strncpy(pf->coll_name, collection_name, sizeof(pf->coll_name));
+
+  if (pf->filter) {
+    bson_destroy(pf->filter);
+  }
+  pf->filter = filter ? bson_copy(filter) : NULL;
+
+  if (pf->sort) {
+    bson_destroy(pf->sort);
+  }
+  pf->sort = find_opts && find_opts->sort ? bson_copy(find_opts->sort) : NULL;
+  safe_strncpy(pf->hint, find_opts && find_opts->hint ? find_opts->hint : "",
+               sizeof(pf->hint));
+  pf->allow_disk_use = find_opts && find_opts->allow_disk_use;
+
+  pf->requested = false;
+  if (pf->req_anchor) {
+    bson_destroy(pf->req_anchor);
+    pf->req_anchor = NULL;
+  }
+  if (pf->ready) {
+    batch_clear(&pf->result);
+    pf->ready = false;
+  }
+  pthread_mutex_unlock(&pf->lock);
+}
+
+bool mongo_prefetch_request(mongo_prefetch_t *pf, long long skip, int limit) {
+  if (!pf || skip < 0 || limit <= 0) {
+    return false;
+  }
+
+  pthread_mutex_lock(&pf->lock);
+  bool accepted = !pf->requested && !pf->busy && !pf->ready &&
+                  pf->db_name[0] != '\0';
+  if (accepted) {
+    pf->req_skip = skip;
+    pf->req_limit = limit;
+    pf->req_before = false;
+    pf->requested = true;
+    pthread_cond_signal(&pf->wake);
+  }
+  pthread_mutex_unlock(&pf->lock);
+  return accepted;
+}
+
+bool mongo_prefetch_request_before(mongo_prefetch_t *pf, long long end,
+                                   long long total, int limit,
+                                   const bson_t *anchor) {
+  if (!pf || end <= 0 || limit <= 0) {
+    return false;
+  }
+
+  pthread_mutex_lock(&pf->lock);
+  bool accepted = !pf->requested && !pf->busy && !pf->ready &&
+                  pf->db_name[0] != '\0';
+  if (accepted) {
+    pf->req_end = end;
+    pf->req_total = total;
+    pf->req_limit = limit;
+    pf->req_anchor = anchor ? bson_copy(anchor) : NULL;
+    pf->req_before = true;
+    pf->requested = true;
+    pthread_cond_signal(&pf->wake);
+  }
+  pthread_mutex_unlock(&pf->lock);
+  return accepted;
+}
+
+bool mongo_prefetch_pending(mongo_prefetch_t *pf) {
+  if (!pf) {
+    return false;
+  }
+
+  pthread_mutex_lock(&pf->lock);
+  bool pending = pf->requested || pf->busy || pf->ready;
+  pthread_mutex_unlock(&pf->lock);
+  return pending;
+}
+
+bool mongo_prefetch_take(mongo_prefetch_t *pf, prefetch_batch_t *batch) {
+  if (!pf || !batch) {
+    return false;
+  }
+
+  pthread_mutex_lock(&pf->lock);
+  bool ready = pf->ready;
+  if (ready) {
+    *batch = pf->result;
+    memset(&pf->result, 0, sizeof(pf->result));
+    pf->ready = false;
+  }
+  pthread_mutex_unlock(&pf->lock);
+  return ready;
+}
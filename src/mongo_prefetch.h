@@ -0,0 +1,54 @@
+#ifndef MONGO_PREFETCH_H
+#define MONGO_PREFETCH_H
+
+#include "mongo_ops.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// lector en segundo plano del visor: un hilo con su propio cliente trae
+// lotes de la consulta actual sin bloquear la UI. mientras los pedidos
+// sean contiguos hacia adelante sigue leyendo el mismo cursor; hacia atrás
+// lee con el orden invertido, desde el primer documento de la ventana con
+// un rango de claves si el orden termina en _id (sin skip), y sigue ese
+// cursor mientras los pedidos sigan siendo contiguos
+typedef struct mongo_prefetch mongo_prefetch_t;
+
+// lote terminado
+typedef struct {
+  bson_t **docs;  // liberar con mongo_free_documents (NULL si falló)
+  int count;
+  long long skip; // posición del primero en el resultado
+  bool failed;
+  char error_message[512];
+} prefetch_batch_t;
+
+// crear lector y lanzar el hilo; NULL si falla (error en ctx)
+mongo_prefetch_t *mongo_prefetch_new(mongo_context_t *ctx);
+
+// parar el hilo y liberar todo, incluido un lote sin retirar
+void mongo_prefetch_free(mongo_prefetch_t *pf);
+
+// fijar la consulta (copia filtro y opciones); descarta el cursor, el
+// pedido en curso y los lotes de la consulta anterior
+void mongo_prefetch_set_query(mongo_prefetch_t *pf, const char *db_name,
+                              const char *collection_name,
+                              const bson_t *filter,
+                              const mongo_find_opts_t *find_opts);
+
+// pedir los documentos [skip, skip + limit); false si ya hay uno pendiente
+bool mongo_prefetch_request(mongo_prefetch_t *pf, long long skip, int limit);
+
+// pedir los limit documentos anteriores a la posición end; anchor es el
+// documento en end (se copia) y total el tamaño del resultado (ver
+// mongo_find_before). el lote llega en orden, con skip = end - count
+bool mongo_prefetch_request_before(mongo_prefetch_t *pf, long long end,
+                                   long long total, int limit,
+                                   const bson_t *anchor);
+
+// true si hay un pedido en curso o un lote sin retirar
+bool mongo_prefetch_pending(mongo_prefetch_t *pf);
+
+// retirar el lote terminado; false si todavía no hay ninguno
+bool mongo_prefetch_take(mongo_prefetch_t *pf, prefetch_batch_t *batch);
+
+#endif // MONGO_PREFETCH_H
@@ -0,0 +1,271 @@
+#include "profiles.h"
+#include "mongo_ops.h"
+#include "session.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+struct profile_probe {
+  pthread_mutex_t lock;
+  int refs; // quien lo lanzó y cada hilo que sigue corriendo
+  profile_t *profiles;
+  bool *changed;
+  int count;
+};
+
+typedef struct {
+  profile_probe_t *probe;
+  int index;
+} probe_task_t;
+
+static bool profiles_path(char *path, size_t size) {
+  const char *env = getenv("MONGODB_TUI_PROFILES");
+  if (env && *env) {
+    return snprintf(path, size, "%s", env) < (int)size;
+  }
+
+  const char *home = getenv("HOME");
+#ifdef _WIN32
+  if (!home || !*home) {
+    home = getenv("USERPROFILE");
+  }
+#endif
+  if (!home || !*home) {
+    return false;
+  }
+  return snprintf(path, size, "%s/.mongodb-tui-profiles", home) < (int)size;
+}
+
+int profiles_load(profile_t **profiles) {
+  *profiles = NULL;
+
+  char path[1024];
+  if (!profiles_path(path, sizeof(path))) {
+    return 0;
+  }
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    return 0;
+  }
+
+  int count = 0;
+  int capacity = 0;
+  char line[1024];
+  while (fgets(line, sizeof(line), file)) {
+    char *text = trim_whitespace(line);
+    char *equals = strchr(text, '=');
+    if (*text == '#' || !equals) {
+      continue;
+    }
+    *equals = '\0';
+    char *name = trim_whitespace(text);
+    char *uri = trim_whitespace(equals + 1);
+    if (*name == '\0' || *uri == '\0') {
+      continue;
+    }
+
+    if (count == capacity) {
+      capacity = capacity ? capacity * 2 : 16;
+      profile_t *grown = realloc(*profiles, capacity * sizeof(profile_t));
+      if (!grown) {
+        break;
+      }
+      *profiles = grown;
+    }
+    profile_t *p = &(*profiles)[count++];
+    memset(p, 0, sizeof(*p));
+    safe_strncpy(p->name, name, sizeof(p->name));
+    safe_strncpy(p->uri, uri, sizeof(p->uri));
+    p->state = PROFILE_PROBING;
+  }
+
+  fclose(file);
+  return count;
+}
+
+bool profiles_add(const char *name, const char *uri) {
+  char path[1024];
+  if (!profiles_path(path, sizeof(path)) || strchr(name, '=') ||
+      strchr(name, '\n') || strchr(uri, '\n')) {
+    return false;
+  }
+
+  FILE *file = fopen(path, "a");
+  if (!file) {
+    return false;
+  }
+#ifndef _WIN32
+  chmod(path, 0600);
+#endif
+
+  char stripped[512];
+  session_strip_password(uri, stripped, sizeof(stripped));
+  fprintf(file, "%s = %s\n", name, stripped);
+  bool ok = !ferror(file);
+  return fclose(file) == 0 && ok;
+}
+
+static void probe_unref(profile_probe_t *probe) {
+  pthread_mutex_lock(&probe->lock);
+  bool last = --probe->refs == 0;
+  pthread_mutex_unlock(&probe->lock);
+
+  if (last) {
+    pthread_mutex_destroy(&probe->lock);
+    free(probe->profiles);
+    free(probe->changed);
+    free(probe);
+  }
+}
+
+// un ping para conectar (handshake, TLS, auth) y otro para medir
+static bool probe_ping(const char *uri_string, int64_t *rtt_us, char *error_out,
+                       size_t error_size) {
+  bson_error_t error;
+  mongoc_uri_t *uri = mongoc_uri_new_with_error(uri_string, &error);
+  if (!uri) {
+    snprintf(error_out, error_size, "%s", error.message);
+    return false;
+  }
+  mongoc_uri_set_option_as_int32(uri, MONGOC_URI_SERVERSELECTIONTIMEOUTMS,
+                                 PROFILE_PROBE_TIMEOUT_MS);
+  mongoc_uri_set_option_as_int32(uri, MONGOC_URI_CONNECTTIMEOUTMS,
+                                 PROFILE_PROBE_TIMEOUT_MS);
+
+  mongoc_client_t *client = mongoc_client_new_from_uri(uri);
+  mongoc_uri_destroy(uri);
+  if (!client) {
+    snprintf(error_out, error_size, "Failed to create client");
+    return false;
+  }
+  mongoc_client_set_appname(client, "MongoDB-TUI");
+  mongoc_client_set_error_api(client, MONGOC_ERROR_API_VERSION_2);
+
+  bson_t *ping = BCON_NEW("ping", BCON_INT32(1));
+  bool ok = mongoc_client_command_simple(client, "admin", ping, NULL, NULL,
+                                         &error);
+  if (ok) {
+    int64_t start = bson_get_monotonic_time();
+    ok = mongoc_client_command_simple(client, "admin", ping, NULL, NULL,
+                                      &error);
+    *rtt_us = bson_get_monotonic_time() - start;
+  }
+  if (!ok) {
+    snprintf(error_out, error_size, "%s", error.message);
+  }
+
+  bson_destroy(ping);
+  mongoc_client_destroy(client);
+  return ok;
+}
+
+static void *probe_thread(void *arg) {
+  probe_task_t *task = arg;
+  profile_probe_t *probe = task->probe;
+  int index = task->index;
+  free(task);
+
+  // la copia del URI no cambia mientras corre el sondeo
+  int64_t rtt = 0;
+  char error[128] = "";
+  bool up = probe_ping(probe->profiles[index].uri, &rtt, error, sizeof(error));
+
+  pthread_mutex_lock(&probe->lock);
+  profile_t *p = &probe->profiles[index];
+  p->state = up ? PROFILE_UP : PROFILE_DOWN;
+  p->rtt_us = rtt;
+  safe_strncpy(p->error, error, sizeof(p->error));
+  probe->changed[index] = true;
+  pthread_mutex_unlock(&probe->lock);
+
+  probe_unref(probe);
+  mongo_background_end();
+  return NULL;
+}
+
+profile_probe_t *profiles_probe_start(const profile_t *profiles, int count) {
+  if (count <= 0) {
+    return NULL;
+  }
+
+  profile_probe_t *probe = calloc(1, sizeof(*probe));
+  if (!probe) {
+    return NULL;
+  }
+  probe->profiles = malloc(count * sizeof(profile_t));
+  probe->changed = calloc(count, sizeof(bool));
+  if (!probe->profiles || !probe->changed) {
+    free(probe->profiles);
+    free(probe->changed);
+    free(probe);
+    return NULL;
+  }
+  memcpy(probe->profiles, profiles, count * sizeof(profile_t));
+  probe->count = count;
+  probe->refs = 1;
+  pthread_mutex_init(&probe->lock, NULL);
+
+  for (int i = 0; i < count; i++) {
+    probe->profiles[i].state = PROFILE_PROBING;
+    probe_task_t *task = malloc(sizeof(*task));
+    pthread_t thread;
+    if (task) {
+      task->probe = probe;
+      task->index = i;
+      pthread_mutex_lock(&probe->lock);
+      probe->refs++;
+      pthread_mutex_unlock(&probe->lock);
+      mongo_background_begin();
+
+      if (pthread_create(&thread, NULL, probe_thread, task) == 0) {
+        pthread_detach(thread);
+        continue;
+      }
+      mongo_background_end();
+      free(task);
+      probe_unref(probe);
+    }
+
+    // sin hilo no hay sondeo: que no quede esperando para siempre
+    pthread_mutex_lock(&probe->lock);
+    probe->profiles[i].state = PROFILE_DOWN;
+    safe_strncpy(probe->profiles[i].error, "Failed to start probe",
+                 sizeof(probe->profiles[i].error));
+    probe->changed[i] = true;
+    pthread_mutex_unlock(&probe->lock);
+  }
+  return probe;
+}
+
+bool profiles_probe_update(profile_probe_t *probe, profile_t *profiles,
+                           int count) {
+  if (!probe) {
+    return false;
+  }
+
+  bool any = false;
+  pthread_mutex_lock(&probe->lock);
+  for (int i = 0; i < count && i < probe->count; i++) {
+    if (probe->changed[i]) {
+      profiles[i].state = probe->profiles[i].state;
+      profiles[i].rtt_us = probe->profiles[i].rtt_us;
+      safe_strncpy(profiles[i].error, probe->profiles[i].error,
+                   sizeof(profiles[i].error));
+      probe->changed[i] = false;
+      any = true;
+    }
+  }
+  pthread_mutex_unlock(&probe->lock);
+  return any;
+}
+
+void profiles_probe_release(profile_probe_t *probe) {
+  if (probe) {
+    probe_unref(probe);
+  }
+}
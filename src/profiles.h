@@ -0,0 +1,48 @@
+#ifndef PROFILES_H
+#define PROFILES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// tiempo máximo de un sondeo (selección de servidor y conexión)
+#define PROFILE_PROBE_TIMEOUT_MS 3000
+
+// estado de un perfil según el último sondeo
+typedef enum {
+  PROFILE_PROBING,
+  PROFILE_UP,
+  PROFILE_DOWN
+} profile_state_t;
+
+// conexión guardada
+typedef struct {
+  char name[64];
+  char uri[512];
+  profile_state_t state;
+  int64_t rtt_us;  // ida y vuelta de un ping (PROFILE_UP)
+  char error[128]; // por qué no responde (PROFILE_DOWN)
+} profile_t;
+
+// leer los perfiles de $MONGODB_TUI_PROFILES o ~/.mongodb-tui-profiles,
+// una línea "nombre = uri" por perfil ('#' para comentarios). devuelve
+// la cantidad; *profiles se libera con free
+int profiles_load(profile_t **profiles);
+
+// agregar un perfil al archivo; el URI se guarda sin contraseña
+bool profiles_add(const char *name, const char *uri);
+
+// sondeo de todos los perfiles a la vez, un hilo con su cliente por perfil
+typedef struct profile_probe profile_probe_t;
+
+// lanzar el sondeo (copia los perfiles); NULL si no se pudo
+profile_probe_t *profiles_probe_start(const profile_t *profiles, int count);
+
+// copiar a profiles lo que cambió desde la última llamada; true si algo
+// cambió
+bool profiles_probe_update(profile_probe_t *probe, profile_t *profiles,
+                           int count);
+
+// soltar el sondeo; los hilos que siguen terminan solos
+void profiles_probe_release(profile_probe_t *probe);
+
+#endif // PROFILES_H
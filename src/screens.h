@@ -2,45 +2,84 @@
 #define SCREENS_H
 
 #include "input.h"
+#include "bson_render.h"
+#include "mongo_meta.h"
 #include "mongo_ops.h"
+#include "mongo_prefetch.h"
+#include "session.h"
+#include "table_view.h"
 #include "tui.h"
 #include <stdbool.h>
+#include <stddef.h>
 
+// coincidencia de búsqueda en los documentos cargados
+typedef struct {
+  int doc;       // índice del documento en la ventana
+  size_t offset; // posición en el JSON renderizado
+} search_match_t;
+
+// pedido de una pantalla sobre las pestañas (vuelve con SCREEN_TABS)
+typedef enum { TAB_NONE, TAB_NEW, TAB_CLOSE, TAB_NEXT, TAB_PREV } tab_request_t;
+
+// conexión compartida por las pestañas con el mismo URI (privada)
+struct app_conn;
 
-// estado de la aplicación
+// estado de la aplicación (uno por pestaña)
 typedef struct {
   mongo_context_t *mongo_ctx;
+  struct app_conn *conn; // NULL si no está conectada (o no se comparte)
   screen_id_t current_screen;
   screen_id_t previous_screen;
 
+  // pestañas
+  tab_request_t tab_request;
+  bool resume;       // volver a la pantalla tal como quedó, sin recargar
+  char tab_bar[64];  // " 1 [2] 3 " arriba a la izquierda; "" con una sola
+
   // pantalla de conexión
   char uri_buffer[512];
 
-  // navegación de BD/colecciones
-  char **databases;
-  int db_count;
+  // navegación de BD/colecciones; los nombres salen de la caché de la
+  // conexión
+  mongo_meta_t *meta;
+  mongo_meta_list_t *databases;
   int db_selected;
 
-  char **collections;
-  int coll_count;
+  mongo_meta_list_t *collections;
   int coll_selected;
 
   char current_db[256];
   char current_collection[256];
 
-  // visor de documentos
+  // visor de documentos: ventana deslizante sobre el resultado
   bson_t **documents;
   int doc_count;
-  int doc_page;
-  int doc_per_page;
-  int doc_selected; // documento seleccionado en página actual
-  int doc_scroll_offset;
+  long long doc_base; // posición en el resultado de documents[0]
+  int doc_selected;   // documento seleccionado (arriba de todo en modo JSON)
+  int doc_scroll_offset; // línea dentro del bloque del seleccionado
   long long total_documents;
+  bson_t *doc_anchor; // claves del orden del documento donde reabrir (o NULL)
+  bson_render_cache_t *doc_render; // líneas renderizadas, una por documento
+  mongo_prefetch_t *prefetch;      // extiende la ventana en segundo plano
+  bool doc_table_mode; // una fila por documento
+  table_view_t table;  // columnas/anchos de la ventana actual
 
   // filtros
   char filter_json[INPUT_MAX_LENGTH];
   bson_t *current_filter;
 
+  // orden en el servidor
+  char sort_spec[256];
+  bson_t *current_sort;
+  char sort_hint[128];  // índice forzado (vacío = el planner elige)
+  bool sort_allow_disk; // sort en memoria grande: permitir disco
+
+  // búsqueda en los documentos cargados
+  char search_text[256];
+  search_match_t *search_matches;
+  int search_match_count;
+  int search_current;
+
   // mensajes
   char message[512];
   msg_type_t message_type;
@@ -56,6 +95,11 @@ app_state_t *app_state_new(void);
 // liberar estado de app
 void app_state_free(app_state_t *state);
 
+// estado para una pestaña nueva: misma conexión (compartida), namespace,
+// filtro y orden que state, con su propia ventana de documentos. NULL si
+// no hay memoria
+app_state_t *app_state_clone(const app_state_t *state);
+
 // pantalla de conexión
 screen_id_t screen_connection(app_state_t *state);
 
@@ -77,6 +121,13 @@ screen_id_t screen_help(app_state_t *state);
 // configurar mensaje de app
 void app_set_message(app_state_t *state, const char *message, msg_type_t type);
 
+// abrir en el namespace, filtro, orden y posición de una sesión (al
+// arrancar); lo que no se puede leer se descarta con un aviso
+void app_restore_session(app_state_t *state, const session_t *session);
+
+// guardar dónde quedó el usuario para la próxima vez
+void app_save_session(const app_state_t *state);
+
 // cargar documentos de la colección actual
 bool load_documents(app_state_t *state);
 
@@ -0,0 +1,140 @@
+#include "search.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool search_compile(search_pattern_t *pattern, const char *needle,
+                    bool smart_case) {
+  if (!pattern || !needle || needle[0] == '\0') {
+    return false;
+  }
+
+  size_t length = strlen(needle);
+  pattern->needle = malloc(length);
+  if (!pattern->needle) {
+    return false;
+  }
+  pattern->length = length;
+
+  // smart case: sólo distinguir mayúsculas si el patrón tiene alguna
+  pattern->ignore_case = false;
+  if (smart_case) {
+    pattern->ignore_case = true;
+    for (size_t i = 0; i < length; i++) {
+      if (isupper((unsigned char)needle[i])) {
+        pattern->ignore_case = false;
+        break;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    unsigned char c = (unsigned char)needle[i];
+    pattern->needle[i] = pattern->ignore_case ? (unsigned char)tolower(c) : c;
+  }
+
+  // tabla de saltos de Horspool (por el último byte de la ventana)
+  for (int i = 0; i < 256; i++) {
+    pattern->skip[i] = length;
+  }
+  for (size_t i = 0; i + 1 < length; i++) {
+    unsigned char c = pattern->needle[i];
+    pattern->skip[c] = length - 1 - i;
+    if (pattern->ignore_case) {
+      pattern->skip[toupper(c)] = length - 1 - i;
+    }
+  }
+
+  return true;
+}
+
+void search_free(search_pattern_t *pattern) {
+  if (!pattern) {
+    return;
+  }
+
+  free(pattern->needle);
+  pattern->needle = NULL;
+  pattern->length = 0;
+}
+
+static const char *find_exact(const search_pattern_t *pattern,
+                              const char *haystack, size_t length) {
+  const unsigned char *h = (const unsigned char *)haystack;
+  const unsigned char *n = pattern->needle;
+  size_t m = pattern->length;
+
+  if (m == 1) {
+    return memchr(haystack, n[0], length);
+  }
+
+  size_t pos = 0;
+  while (pos + m <= length) {
+    // memchr (vectorizado en libc) salta directo al próximo candidato
+    const unsigned char *c = memchr(h + pos, n[0], length - m - pos + 1);
+    if (!c) {
+      return NULL;
+    }
+    pos = c - h;
+
+    unsigned char last = h[pos + m - 1];
+    if (last == n[m - 1] && memcmp(h + pos + 1, n + 1, m - 2) == 0) {
+      return haystack + pos;
+    }
+    pos += pattern->skip[last];
+  }
+
+  return NULL;
+}
+
+static const char *find_folded(const search_pattern_t *pattern,
+                               const char *haystack, size_t length) {
+  const unsigned char *h = (const unsigned char *)haystack;
+  const unsigned char *n = pattern->needle;
+  size_t m = pattern->length;
+
+  size_t pos = 0;
+  while (pos + m <= length) {
+    size_t i = m;
+    while (i > 0 && tolower(h[pos + i - 1]) == n[i - 1]) {
+      i--;
+    }
+    if (i == 0) {
+      return haystack + pos;
+    }
+    pos += pattern->skip[h[pos + m - 1]];
+  }
+
+  return NULL;
+}
+
+const char *search_find(const search_pattern_t *pattern, const char *haystack,
+                        size_t length) {
+  if (!pattern || !pattern->needle || !haystack ||
+      length < pattern->length) {
+    return NULL;
+  }
+
+  if (pattern->ignore_case) {
+    return find_folded(pattern, haystack, length);
+  }
+  return find_exact(pattern, haystack, length);
+}
+
+size_t search_count(const search_pattern_t *pattern, const char *haystack,
+                    size_t length) {
+  size_t count = 0;
+  const char *end = haystack + length;
+  const char *p = haystack;
+
+  while (p < end) {
+    const char *match = search_find(pattern, p, end - p);
+    if (!match) {
+      break;
+    }
+    count++;
+    p = match + pattern->length;
+  }
+
+  return count;
+}
@@ -0,0 +1,31 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// patrón de búsqueda precompilado (Boyer-Moore-Horspool)
+typedef struct {
+  unsigned char *needle; // ya en minúsculas si ignore_case
+  size_t length;
+  size_t skip[256];
+  bool ignore_case;
+} search_pattern_t;
+
+// compilar patrón; con smart_case ignora mayúsculas si el texto buscado
+// está todo en minúsculas
+bool search_compile(search_pattern_t *pattern, const char *needle,
+                    bool smart_case);
+
+// liberar patrón
+void search_free(search_pattern_t *pattern);
+
+// buscar la primera aparición en haystack[0..length); NULL si no hay
+const char *search_find(const search_pattern_t *pattern, const char *haystack,
+                        size_t length);
+
+// contar apariciones (sin solaparse)
+size_t search_count(const search_pattern_t *pattern, const char *haystack,
+                    size_t length);
+
+#endif // SEARCH_H
@@ -0,0 +1,152 @@
+#include "session.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#define SESSION_HEADER "# mongodb-tui session"
+
+// $MONGODB_TUI_SESSION, o ~/.mongodb-tui-session
+static bool session_path(char *path, size_t size) {
+  const char *env = getenv("MONGODB_TUI_SESSION");
+  if (env && *env) {
+    return snprintf(path, size, "%s", env) < (int)size;
+  }
+
+  const char *home = getenv("HOME");
+#ifdef _WIN32
+  if (!home || !*home) {
+    home = getenv("USERPROFILE");
+  }
+#endif
+  if (!home || !*home) {
+    return false;
+  }
+  return snprintf(path, size, "%s/.mongodb-tui-session", home) < (int)size;
+}
+
+void session_strip_password(const char *uri, char *out, size_t size) {
+  safe_strncpy(out, uri, size);
+
+  // la contraseña va entre el primer ':' y el '@' de "usuario:clave@hosts"
+  const char *scheme = strstr(uri, "://");
+  if (!scheme) {
+    return;
+  }
+  const char *hosts = scheme + 3;
+  const char *end = hosts + strcspn(hosts, "/?");
+  const char *at = NULL;
+  for (const char *p = hosts; p < end; p++) {
+    if (*p == '@') {
+      at = p;
+    }
+  }
+  const char *colon = at ? memchr(hosts, ':', (size_t)(at - hosts)) : NULL;
+  if (!colon) {
+    return;
+  }
+
+  size_t keep = (size_t)(colon - uri);
+  if (keep < size) {
+    snprintf(out + keep, size - keep, "%s", at);
+  }
+}
+
+bool session_load(session_t *session) {
+  memset(session, 0, sizeof(*session));
+
+  char path[1024];
+  if (!session_path(path, sizeof(path))) {
+    return false;
+  }
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    return false;
+  }
+
+  char line[2048];
+  bool valid = fgets(line, sizeof(line), file) &&
+               strncmp(line, SESSION_HEADER, strlen(SESSION_HEADER)) == 0;
+  while (valid && fgets(line, sizeof(line), file)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    char *value = strchr(line, '=');
+    if (!value) {
+      continue;
+    }
+    *value++ = '\0';
+
+    if (strcmp(line, "uri") == 0) {
+      safe_strncpy(session->uri, value, sizeof(session->uri));
+    } else if (strcmp(line, "db") == 0) {
+      safe_strncpy(session->db, value, sizeof(session->db));
+    } else if (strcmp(line, "collection") == 0) {
+      safe_strncpy(session->collection, value, sizeof(session->collection));
+    } else if (strcmp(line, "filter") == 0) {
+      safe_strncpy(session->filter, value, sizeof(session->filter));
+    } else if (strcmp(line, "sort") == 0) {
+      safe_strncpy(session->sort, value, sizeof(session->sort));
+    } else if (strcmp(line, "hint") == 0) {
+      safe_strncpy(session->hint, value, sizeof(session->hint));
+    } else if (strcmp(line, "allow_disk") == 0) {
+      session->allow_disk = strcmp(value, "1") == 0;
+    } else if (strcmp(line, "anchor") == 0) {
+      safe_strncpy(session->anchor, value, sizeof(session->anchor));
+    } else if (strcmp(line, "position") == 0) {
+      session->position = strtoll(value, NULL, 10);
+      if (session->position < 0) {
+        session->position = 0;
+      }
+    }
+  }
+
+  fclose(file);
+  return valid && session->uri[0] != '\0';
+}
+
+bool session_save(const session_t *session) {
+  char path[1024];
+  char tmp[1040];
+  if (!session_path(path, sizeof(path))) {
+    return false;
+  }
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+  FILE *file = fopen(tmp, "w");
+  if (!file) {
+    return false;
+  }
+#ifndef _WIN32
+  // el filtro puede tener datos de los documentos
+  chmod(tmp, 0600);
+#endif
+
+  // un valor con salto de línea rompería el formato: se omite
+  const char *filter = strchr(session->filter, '\n') ? "" : session->filter;
+  fprintf(file, "%s\n", SESSION_HEADER);
+  fprintf(file, "uri=%s\n", session->uri);
+  fprintf(file, "db=%s\n", session->db);
+  fprintf(file, "collection=%s\n", session->collection);
+  fprintf(file, "filter=%s\n", filter);
+  fprintf(file, "sort=%s\n", session->sort);
+  fprintf(file, "hint=%s\n", session->hint);
+  fprintf(file, "allow_disk=%d\n", session->allow_disk ? 1 : 0);
+  fprintf(file, "position=%lld\n", session->position);
+  if (session->anchor[0] != '\0' && !strchr(session->anchor, '\n')) {
+    fprintf(file, "anchor=%s\n", session->anchor);
+  }
+
+  bool ok = !ferror(file);
+  ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+  // rename no pisa un archivo existente en Windows
+  remove(path);
+#endif
+  if (!ok || rename(tmp, path) != 0) {
+    remove(tmp);
+    return false;
+  }
+  return true;
+}
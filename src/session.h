@@ -0,0 +1,31 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// dónde quedó el usuario la última vez, para volver a abrir directo ahí.
+// el URI se guarda sin contraseña
+typedef struct {
+  char uri[512];
+  char db[256];
+  char collection[256];
+  char filter[1024]; // JSON en una línea
+  char sort[256];
+  char hint[128];
+  bool allow_disk;
+  long long position; // documento seleccionado en el resultado
+  char anchor[512];   // sus claves del orden en JSON, si termina en _id
+} session_t;
+
+// leer la sesión guardada; false si no hay
+bool session_load(session_t *session);
+
+// guardar (reemplaza la anterior de una vez)
+bool session_save(const session_t *session);
+
+// copiar uri sin la contraseña ("mongodb://ana:secreto@h" ->
+// "mongodb://ana@h")
+void session_strip_password(const char *uri, char *out, size_t size);
+
+#endif // SESSION_H
@@ -0,0 +1,283 @@
+#include "table_view.h"
+#include "json_display.h"
+#include "tui.h"
+#include <stdlib.h>
+#include <string.h>
+
+// candidatos a columna antes de quedarnos con los más frecuentes
+#define TABLE_MAX_CANDIDATES 256
+// subdocumentos con más campos que esto no se aplanan
+#define TABLE_FLATTEN_MAX_KEYS 8
+
+typedef struct {
+  char path[128];
+  int frequency;
+  int order; // orden de aparición, para desempatar
+} table_candidate_t;
+
+typedef struct {
+  table_candidate_t items[TABLE_MAX_CANDIDATES];
+  int count;
+} candidate_set_t;
+
+static void candidate_add(candidate_set_t *set, const char *path) {
+  for (int i = 0; i < set->count; i++) {
+    if (strcmp(set->items[i].path, path) == 0) {
+      set->items[i].frequency++;
+      return;
+    }
+  }
+
+  if (set->count < TABLE_MAX_CANDIDATES && strlen(path) < 128) {
+    table_candidate_t *c = &set->items[set->count];
+    strcpy(c->path, path);
+    c->frequency = 1;
+    c->order = set->count;
+    set->count++;
+  }
+}
+
+static int compare_candidates(const void *a, const void *b) {
+  const table_candidate_t *x = a;
+  const table_candidate_t *y = b;
+
+  // _id siempre primero
+  bool x_id = strcmp(x->path, "_id") == 0;
+  bool y_id = strcmp(y->path, "_id") == 0;
+  if (x_id != y_id) {
+    return x_id ? -1 : 1;
+  }
+
+  if (x->frequency != y->frequency) {
+    return y->frequency - x->frequency;
+  }
+  return x->order - y->order;
+}
+
+// contar claves de un subdocumento (hasta limit + 1)
+static int small_document_keys(const bson_iter_t *iter, int limit) {
+  bson_iter_t child;
+  int n = 0;
+  if (bson_iter_recurse(iter, &child)) {
+    while (n <= limit && bson_iter_next(&child)) {
+      n++;
+    }
+  }
+  return n;
+}
+
+// campos de primer nivel; subdocumentos chicos se aplanan un nivel
+static void collect_fields(candidate_set_t *set, const bson_t *doc) {
+  bson_iter_t iter;
+  if (!bson_iter_init(&iter, doc)) {
+    return;
+  }
+
+  while (bson_iter_next(&iter)) {
+    const char *key = bson_iter_key(&iter);
+    int keys = BSON_ITER_HOLDS_DOCUMENT(&iter)
+                   ? small_document_keys(&iter, TABLE_FLATTEN_MAX_KEYS)
+                   : 0;
+
+    if (keys == 0 || keys > TABLE_FLATTEN_MAX_KEYS) {
+      candidate_add(set, key);
+      continue;
+    }
+
+    bson_iter_t child;
+    bson_iter_recurse(&iter, &child);
+    while (bson_iter_next(&child)) {
+      char path[256];
+      snprintf(path, sizeof(path), "%s.%s", key, bson_iter_key(&child));
+      candidate_add(set, path);
+    }
+  }
+}
+
+// ubicar el valor de una columna en un documento
+static bool find_cell(const bson_t *doc, const char *path, bson_iter_t *out) {
+  bson_iter_t iter;
+  if (bson_iter_init_find(out, doc, path)) {
+    return true;
+  }
+  return strchr(path, '.') && bson_iter_init(&iter, doc) &&
+         bson_iter_find_descendant(&iter, path, out);
+}
+
+void table_view_invalidate(table_view_t *table) {
+  if (table) {
+    table->valid = false;
+  }
+}
+
+void table_view_prepare(table_view_t *table, bson_t **docs, int count) {
+  if (!table || table->valid) {
+    return;
+  }
+
+  candidate_set_t *set = calloc(1, sizeof(candidate_set_t));
+  if (!set) {
+    return;
+  }
+
+  for (int i = 0; i < count; i++) {
+    collect_fields(set, docs[i]);
+  }
+
+  qsort(set->items, set->count, sizeof(table_candidate_t), compare_candidates);
+
+  table->column_count =
+      set->count < TABLE_MAX_COLUMNS ? set->count : TABLE_MAX_COLUMNS;
+
+  // ancho = el mayor entre el nombre y los valores de la página
+  for (int c = 0; c < table->column_count; c++) {
+    table_column_t *col = &table->columns[c];
+    strcpy(col->path, set->items[c].path);
+    col->frequency = set->items[c].frequency;
+    col->width = (int)strlen(col->path);
+
+    for (int i = 0; i < count && col->width < TABLE_MAX_WIDTH; i++) {
+      bson_iter_t cell;
+      if (find_cell(docs[i], col->path, &cell)) {
+        char value[TABLE_MAX_WIDTH + 2];
+        json_format_scalar(&cell, value, sizeof(value));
+        int len = (int)strlen(value);
+        if (len > col->width) {
+          col->width = len;
+        }
+      }
+    }
+
+    if (col->width < TABLE_MIN_WIDTH) {
+      col->width = TABLE_MIN_WIDTH;
+    } else if (col->width > TABLE_MAX_WIDTH) {
+      col->width = TABLE_MAX_WIDTH;
+    }
+  }
+
+  free(set);
+
+  if (table->first_column >= table->column_count) {
+    table->first_column = 0;
+  }
+  table->valid = true;
+}
+
+void table_view_scroll(table_view_t *table, int delta) {
+  if (!table) {
+    return;
+  }
+
+  table->first_column += delta;
+  if (table->first_column > table->column_count - 1) {
+    table->first_column = table->column_count - 1;
+  }
+  if (table->first_column < 0) {
+    table->first_column = 0;
+  }
+}
+
+// escribir una celda recortada al ancho de la columna ('~' si no entra)
+static void draw_cell(WINDOW *win, int y, int x, const char *text, int width) {
+  int len = (int)strlen(text);
+  if (len > width) {
+    mvwaddnstr(win, y, x, text, width - 1);
+    waddch(win, '~');
+  } else {
+    mvwaddnstr(win, y, x, text, len);
+  }
+}
+
+// fin (exclusivo) de las columnas que entran desde first_column
+static int visible_columns_end(const table_view_t *table, int max_width) {
+  int last = table->first_column;
+  int used = 0;
+  while (last < table->column_count &&
+         used + table->columns[last].width <= max_width) {
+    used += table->columns[last].width + 1;
+    last++;
+  }
+  if (last == table->first_column) {
+    last++; // al menos una columna, recortada
+  }
+  return last;
+}
+
+int table_view_first_row(int selected, int rows) {
+  return selected >= rows ? selected - rows + 1 : 0;
+}
+
+void table_view_draw_row(WINDOW *win, const table_view_t *table, bson_t **docs,
+                         int index, bool selected, int y, int start_x,
+                         int max_width) {
+  mvwhline(win, y, start_x, ' ', max_width);
+
+  if (selected) {
+    wattron(win, COLOR_PAIR(COLOR_PAIR_SELECTED));
+    mvwprintw(win, y, start_x, "%*s", max_width, "");
+  }
+
+  int last = visible_columns_end(table, max_width);
+  int x = start_x;
+  for (int c = table->first_column; c < last; c++) {
+    int width = table->columns[c].width;
+    if (x + width > start_x + max_width) {
+      width = start_x + max_width - x;
+    }
+
+    bson_iter_t cell;
+    if (find_cell(docs[index], table->columns[c].path, &cell)) {
+      char value[TABLE_MAX_WIDTH * 2];
+      int color = json_format_scalar(&cell, value, sizeof(value));
+      if (!selected && has_colors()) {
+        wattron(win, COLOR_PAIR(color));
+      }
+      draw_cell(win, y, x, value, width);
+      if (!selected && has_colors()) {
+        wattroff(win, COLOR_PAIR(color));
+      }
+    }
+    x += width + 1;
+  }
+
+  if (selected) {
+    wattroff(win, COLOR_PAIR(COLOR_PAIR_SELECTED));
+  }
+}
+
+void table_view_draw(WINDOW *win, const table_view_t *table, bson_t **docs,
+                     int count, int selected, int start_y, int start_x,
+                     int max_height, int max_width) {
+  if (!win || !table || max_height < 2 || max_width < TABLE_MIN_WIDTH) {
+    return;
+  }
+
+  if (table->column_count == 0) {
+    mvwprintw(win, start_y, start_x, "(no fields)");
+    return;
+  }
+
+  // encabezado
+  int last = visible_columns_end(table, max_width);
+  wattron(win, COLOR_PAIR(COLOR_PAIR_HEADER) | A_BOLD);
+  int x = start_x;
+  for (int c = table->first_column; c < last; c++) {
+    int width = table->columns[c].width;
+    if (x + width > start_x + max_width) {
+      width = start_x + max_width - x;
+    }
+    draw_cell(win, start_y, x, table->columns[c].path, width);
+    x += width + 1;
+  }
+  wattroff(win, COLOR_PAIR(COLOR_PAIR_HEADER) | A_BOLD);
+
+  // filas; si no entran todas, mantener visible la seleccionada
+  int rows = max_height - 1;
+  int first_row = table_view_first_row(selected, rows);
+
+  for (int r = 0; r < rows && first_row + r < count; r++) {
+    int i = first_row + r;
+    table_view_draw_row(win, table, docs, i, i == selected, start_y + 1 + r,
+                        start_x, max_width);
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef TABLE_VIEW_H
+#define TABLE_VIEW_H
+
+#include <mongoc/mongoc.h>
+#include <stdbool.h>
+
+// header de curses multiplataforma
+#ifdef _WIN32
+#include <curses.h> // PDCurses en Windows
+#else
+#include <ncurses.h> // ncurses en Unix
+#endif
+
+#define TABLE_MAX_COLUMNS 32
+#define TABLE_MIN_WIDTH 4
+#define TABLE_MAX_WIDTH 32
+
+// columna de la tabla: campo de primer nivel o ruta con puntos
+typedef struct {
+  char path[128];
+  int frequency; // documentos de la página que tienen el campo
+  int width;
+} table_column_t;
+
+// columnas y anchos calculados una vez por página
+typedef struct {
+  table_column_t columns[TABLE_MAX_COLUMNS];
+  int column_count;
+  int first_column; // scroll horizontal
+  bool valid;       // false = recalcular en el próximo prepare
+} table_view_t;
+
+// invalidar el cache (página nueva)
+void table_view_invalidate(table_view_t *table);
+
+// elegir columnas por frecuencia y medir anchos si el cache no es válido
+void table_view_prepare(table_view_t *table, bson_t **docs, int count);
+
+// mover el scroll horizontal en columnas
+void table_view_scroll(table_view_t *table, int delta);
+
+// dibujar encabezado y una fila por documento a partir de start_y
+void table_view_draw(WINDOW *win, const table_view_t *table, bson_t **docs,
+                     int count, int selected, int start_y, int start_x,
+                     int max_height, int max_width);
+
+// primera fila visible para que selected entre en rows filas
+int table_view_first_row(int selected, int rows);
+
+// dibujar sólo la fila de un documento (para repintar la selección)
+void table_view_draw_row(WINDOW *win, const table_view_t *table, bson_t **docs,
+                         int index, bool selected, int y, int start_x,
+                         int max_width);
+
+#endif // TABLE_VIEW_H
@@ -0,0 +1,116 @@
+#include "tabs.h"
+#include <stdio.h>
+#include <string.h>
+
+// " 1 [2] 3 " en cada pestaña (cada una se ve a sí misma como actual)
+static void update_bars(tabs_t *tabs) {
+  for (int t = 0; t < tabs->count; t++) {
+    char *bar = tabs->states[t]->tab_bar;
+    size_t size = sizeof(tabs->states[t]->tab_bar);
+    bar[0] = '\0';
+    if (tabs->count == 1) {
+      continue;
+    }
+    size_t len = 0;
+    for (int i = 0; i < tabs->count && len < size; i++) {
+      len += snprintf(bar + len, size - len, i == t ? "[%d]" : " %d ", i + 1);
+    }
+  }
+}
+
+void tabs_init(tabs_t *tabs, app_state_t *state) {
+  memset(tabs, 0, sizeof(*tabs));
+  tabs->states[0] = state;
+  tabs->screens[0] = SCREEN_CONNECTION;
+  tabs->count = 1;
+  update_bars(tabs);
+}
+
+void tabs_free(tabs_t *tabs) {
+  for (int i = 0; i < tabs->count; i++) {
+    app_state_free(tabs->states[i]);
+  }
+  memset(tabs, 0, sizeof(*tabs));
+}
+
+app_state_t *tabs_current(const tabs_t *tabs) {
+  return tabs->states[tabs->current];
+}
+
+// pestaña nueva a la derecha de la actual, en el mismo lugar; false si no
+// se pudo (con el motivo como mensaje)
+static bool open_tab(tabs_t *tabs, screen_id_t from) {
+  app_state_t *state = tabs->states[tabs->current];
+  if (tabs->count == TABS_MAX) {
+    app_set_message(state, "Too many tabs", MSG_WARNING);
+    return false;
+  }
+
+  app_state_t *clone = app_state_clone(state);
+  if (!clone) {
+    app_set_message(state, "Memory allocation failed", MSG_ERROR);
+    return false;
+  }
+
+  int at = tabs->current + 1;
+  memmove(&tabs->states[at + 1], &tabs->states[at],
+          (tabs->count - at) * sizeof(app_state_t *));
+  memmove(&tabs->screens[at + 1], &tabs->screens[at],
+          (tabs->count - at) * sizeof(screen_id_t));
+  tabs->states[at] = clone;
+  // sin conexión compartida empieza por conectar
+  tabs->screens[at] = clone->conn ? from : SCREEN_CONNECTION;
+  tabs->count++;
+  tabs->current = at;
+  return true;
+}
+
+static void close_tab(tabs_t *tabs) {
+  if (tabs->count == 1) {
+    app_set_message(tabs->states[0], "This is the only tab", MSG_INFO);
+    return;
+  }
+
+  // si otra pestaña usa la misma conexión, sigue abierta
+  int at = tabs->current;
+  app_state_free(tabs->states[at]);
+  memmove(&tabs->states[at], &tabs->states[at + 1],
+          (tabs->count - at - 1) * sizeof(app_state_t *));
+  memmove(&tabs->screens[at], &tabs->screens[at + 1],
+          (tabs->count - at - 1) * sizeof(screen_id_t));
+  tabs->count--;
+  if (tabs->current == tabs->count) {
+    tabs->current--;
+  }
+}
+
+screen_id_t tabs_apply(tabs_t *tabs, screen_id_t from) {
+  app_state_t *state = tabs->states[tabs->current];
+  tab_request_t request = state->tab_request;
+  state->tab_request = TAB_NONE;
+  tabs->screens[tabs->current] = from;
+
+  bool opened = false;
+  switch (request) {
+  case TAB_NEW:
+    opened = open_tab(tabs, from);
+    break;
+  case TAB_CLOSE:
+    close_tab(tabs);
+    break;
+  case TAB_NEXT:
+    tabs->current = (tabs->current + 1) % tabs->count;
+    break;
+  case TAB_PREV:
+    tabs->current = (tabs->current + tabs->count - 1) % tabs->count;
+    break;
+  case TAB_NONE:
+  default:
+    break;
+  }
+
+  // una pestaña que ya existía vuelve tal como quedó; la nueva carga lo suyo
+  tabs->states[tabs->current]->resume = !opened;
+  update_bars(tabs);
+  return tabs->screens[tabs->current];
+}
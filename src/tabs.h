@@ -0,0 +1,33 @@
+#ifndef TABS_H
+#define TABS_H
+
+#include "screens.h"
+
+// pestañas abiertas como máximo
+#define TABS_MAX 9
+
+// pestañas: cada una con su estado completo (conexión, namespace, filtro,
+// ventana de documentos, posición) y la pantalla donde quedó. volver a
+// una no trae nada del servidor: la pantalla retoma lo que tenía
+typedef struct {
+  app_state_t *states[TABS_MAX];
+  screen_id_t screens[TABS_MAX];
+  int count;
+  int current;
+} tabs_t;
+
+// empezar con una pestaña (state pasa a ser de tabs)
+void tabs_init(tabs_t *tabs, app_state_t *state);
+
+// liberar todas las pestañas
+void tabs_free(tabs_t *tabs);
+
+// estado de la pestaña actual
+app_state_t *tabs_current(const tabs_t *tabs);
+
+// atender el pedido de la pestaña actual (state->tab_request), que dejó
+// en la pantalla from; devuelve la pantalla de la pestaña que queda
+// actual
+screen_id_t tabs_apply(tabs_t *tabs, screen_id_t from);
+
+#endif // TABS_H
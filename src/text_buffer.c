@@ -0,0 +1,69 @@
+#include "text_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+void text_buffer_init(text_buffer_t *tb) { memset(tb, 0, sizeof(*tb)); }
+
+void text_buffer_free(text_buffer_t *tb) {
+  text_chunk_t *chunk = tb->head;
+  while (chunk) {
+    text_chunk_t *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  memset(tb, 0, sizeof(*tb));
+}
+
+bool text_buffer_append(text_buffer_t *tb, const char *text, size_t length) {
+  while (length > 0) {
+    if (!tb->tail || tb->tail->length == TEXT_BUFFER_CHUNK) {
+      text_chunk_t *chunk = malloc(sizeof(text_chunk_t));
+      if (!chunk) {
+        return false;
+      }
+      chunk->next = NULL;
+      chunk->length = 0;
+      if (tb->tail) {
+        tb->tail->next = chunk;
+      } else {
+        tb->head = chunk;
+      }
+      tb->tail = chunk;
+    }
+
+    size_t n = TEXT_BUFFER_CHUNK - tb->tail->length;
+    if (n > length) {
+      n = length;
+    }
+    memcpy(tb->tail->data + tb->tail->length, text, n);
+    tb->tail->length += n;
+    tb->length += n;
+    text += n;
+    length -= n;
+  }
+  return true;
+}
+
+char *text_buffer_join(const text_buffer_t *tb) {
+  char *text = malloc(tb->length + 1);
+  if (!text) {
+    return NULL;
+  }
+
+  size_t pos = 0;
+  for (const text_chunk_t *chunk = tb->head; chunk; chunk = chunk->next) {
+    memcpy(text + pos, chunk->data, chunk->length);
+    pos += chunk->length;
+  }
+  text[pos] = '\0';
+  return text;
+}
+
+bool text_buffer_write(const text_buffer_t *tb, FILE *out) {
+  for (const text_chunk_t *chunk = tb->head; chunk; chunk = chunk->next) {
+    if (fwrite(chunk->data, 1, chunk->length, out) != chunk->length) {
+      return false;
+    }
+  }
+  return true;
+}
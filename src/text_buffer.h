@@ -0,0 +1,40 @@
+#ifndef TEXT_BUFFER_H
+#define TEXT_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// tamaño de cada tramo
+#define TEXT_BUFFER_CHUNK (64 * 1024)
+
+typedef struct text_chunk {
+  struct text_chunk *next;
+  size_t length;
+  char data[TEXT_BUFFER_CHUNK];
+} text_chunk_t;
+
+// texto que crece de a tramos fijos: agregar nunca copia lo ya escrito,
+// así que sirve igual para un documento de 1KB que para uno de 16MB
+typedef struct {
+  text_chunk_t *head;
+  text_chunk_t *tail;
+  size_t length;
+} text_buffer_t;
+
+// inicializar vacío
+void text_buffer_init(text_buffer_t *tb);
+
+// liberar los tramos
+void text_buffer_free(text_buffer_t *tb);
+
+// agregar length bytes
+bool text_buffer_append(text_buffer_t *tb, const char *text, size_t length);
+
+// todo el texto contiguo y terminado en '\0' (liberar con free)
+char *text_buffer_join(const text_buffer_t *tb);
+
+// escribir el texto en un archivo
+bool text_buffer_write(const text_buffer_t *tb, FILE *out);
+
+#endif // TEXT_BUFFER_H
@@ -0,0 +1,504 @@
+#include "tree_view.h"
+#include "json_display.h"
+#include "tui.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// mapa offset -> entero (direccionamiento abierto). los nodos se identifican
+// por el offset de su valor dentro del documento raíz, que no cambia
+typedef struct {
+  uint32_t *keys; // 0 = libre (ningún valor anidado está en el offset 0)
+  int *values;
+  int capacity;
+  int count;
+} offset_map_t;
+
+// fila visible del árbol
+typedef struct {
+  bson_iter_t iter; // iterador posicionado en el elemento
+  int depth;
+  int parent_row; // -1 en el primer nivel
+  bool container;
+  bool expanded;
+  uint32_t offset;
+} tree_row_t;
+
+typedef struct {
+  const bson_t *doc;
+  const uint8_t *base;
+  offset_map_t expanded; // nodos abiertos
+  offset_map_t rows;     // filas visibles bajo un nodo abierto (cache)
+  offset_map_t children; // cantidad de hijos (cache)
+} tree_t;
+
+static uint32_t hash_offset(uint32_t key) {
+  key ^= key >> 16;
+  key *= 0x45d9f3b;
+  key ^= key >> 16;
+  return key;
+}
+
+static bool map_get(const offset_map_t *map, uint32_t key, int *value) {
+  if (map->capacity == 0) {
+    return false;
+  }
+  int mask = map->capacity - 1;
+  for (int i = (int)(hash_offset(key) & mask);; i = (i + 1) & mask) {
+    if (map->keys[i] == 0) {
+      return false;
+    }
+    if (map->keys[i] == key) {
+      if (value) {
+        *value = map->values[i];
+      }
+      return true;
+    }
+  }
+}
+
+static bool map_put(offset_map_t *map, uint32_t key, int value);
+
+static bool map_grow(offset_map_t *map) {
+  offset_map_t grown = {0};
+  grown.capacity = map->capacity ? map->capacity * 2 : 64;
+  grown.keys = calloc(grown.capacity, sizeof(uint32_t));
+  grown.values = calloc(grown.capacity, sizeof(int));
+  if (!grown.keys || !grown.values) {
+    free(grown.keys);
+    free(grown.values);
+    return false;
+  }
+
+  for (int i = 0; i < map->capacity; i++) {
+    if (map->keys[i] != 0) {
+      map_put(&grown, map->keys[i], map->values[i]);
+    }
+  }
+
+  free(map->keys);
+  free(map->values);
+  *map = grown;
+  return true;
+}
+
+static bool map_put(offset_map_t *map, uint32_t key, int value) {
+  if ((map->count + 1) * 2 > map->capacity && !map_grow(map)) {
+    return false;
+  }
+  int mask = map->capacity - 1;
+  int i = (int)(hash_offset(key) & mask);
+  while (map->keys[i] != 0 && map->keys[i] != key) {
+    i = (i + 1) & mask;
+  }
+  if (map->keys[i] == 0) {
+    map->keys[i] = key;
+    map->count++;
+  }
+  map->values[i] = value;
+  return true;
+}
+
+static void map_remove(offset_map_t *map, uint32_t key) {
+  if (map->capacity == 0) {
+    return;
+  }
+  int mask = map->capacity - 1;
+  int i = (int)(hash_offset(key) & mask);
+  while (map->keys[i] != key) {
+    if (map->keys[i] == 0) {
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+
+  // borrar y reinsertar el resto del grupo
+  map->keys[i] = 0;
+  map->count--;
+  for (i = (i + 1) & mask; map->keys[i] != 0; i = (i + 1) & mask) {
+    uint32_t k = map->keys[i];
+    int v = map->values[i];
+    map->keys[i] = 0;
+    map->count--;
+    map_put(map, k, v);
+  }
+}
+
+static void map_clear(offset_map_t *map) {
+  if (map->capacity > 0) {
+    memset(map->keys, 0, map->capacity * sizeof(uint32_t));
+  }
+  map->count = 0;
+}
+
+static void map_free(offset_map_t *map) {
+  free(map->keys);
+  free(map->values);
+  memset(map, 0, sizeof(*map));
+}
+
+static bool is_container(const bson_iter_t *iter) {
+  return BSON_ITER_HOLDS_DOCUMENT(iter) || BSON_ITER_HOLDS_ARRAY(iter);
+}
+
+// offset del valor de un subdocumento/array dentro del documento raíz
+static uint32_t value_offset(const tree_t *tree, const bson_iter_t *iter,
+                             uint32_t *length) {
+  uint32_t len = 0;
+  const uint8_t *data = NULL;
+  if (BSON_ITER_HOLDS_DOCUMENT(iter)) {
+    bson_iter_document(iter, &len, &data);
+  } else {
+    bson_iter_array(iter, &len, &data);
+  }
+  if (length) {
+    *length = len;
+  }
+  return data ? (uint32_t)(data - tree->base) : 0;
+}
+
+static int child_count(tree_t *tree, const bson_iter_t *iter,
+                       uint32_t offset) {
+  int n;
+  if (map_get(&tree->children, offset, &n)) {
+    return n;
+  }
+
+  n = 0;
+  bson_iter_t child;
+  if (bson_iter_recurse(iter, &child)) {
+    while (bson_iter_next(&child)) {
+      n++;
+    }
+  }
+  map_put(&tree->children, offset, n);
+  return n;
+}
+
+// filas visibles debajo de un contenedor abierto
+static int visible_rows(tree_t *tree, const bson_iter_t *iter,
+                        uint32_t offset) {
+  int n;
+  if (map_get(&tree->rows, offset, &n)) {
+    return n;
+  }
+
+  n = 0;
+  bson_iter_t child;
+  if (bson_iter_recurse(iter, &child)) {
+    while (bson_iter_next(&child)) {
+      n++;
+      if (is_container(&child)) {
+        uint32_t off = value_offset(tree, &child, NULL);
+        if (map_get(&tree->expanded, off, NULL)) {
+          n += visible_rows(tree, &child, off);
+        }
+      }
+    }
+  }
+  map_put(&tree->rows, offset, n);
+  return n;
+}
+
+// recorrer hijos desde la fila *row y copiar en out las filas del rango
+// [first, first + max); los subárboles abiertos que quedan antes del rango
+// se saltan con el conteo cacheado
+static bool walk(tree_t *tree, bson_iter_t *children, int depth,
+                 int parent_row, int *row, int first, int max, tree_row_t *out,
+                 int *out_count) {
+  while (bson_iter_next(children)) {
+    if (*row >= first + max) {
+      return false;
+    }
+
+    int this_row = (*row)++;
+    bool container = is_container(children);
+    uint32_t offset = container ? value_offset(tree, children, NULL) : 0;
+    bool expanded = container && map_get(&tree->expanded, offset, NULL);
+
+    if (this_row >= first) {
+      tree_row_t *r = &out[(*out_count)++];
+      r->iter = *children;
+      r->depth = depth;
+      r->parent_row = parent_row;
+      r->container = container;
+      r->expanded = expanded;
+      r->offset = offset;
+    }
+
+    if (!expanded) {
+      continue;
+    }
+
+    int below = visible_rows(tree, children, offset);
+    if (*row + below <= first) {
+      *row += below;
+      continue;
+    }
+
+    bson_iter_t child;
+    if (bson_iter_recurse(children, &child) &&
+        !walk(tree, &child, depth + 1, this_row, row, first, max, out,
+              out_count)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// generar las filas [first, first + max); devuelve cuántas hay
+static int tree_rows(tree_t *tree, int first, int max, tree_row_t *out) {
+  bson_iter_t iter;
+  int row = 0, count = 0;
+  if (bson_iter_init(&iter, tree->doc)) {
+    walk(tree, &iter, 0, -1, &row, first, max, out, &count);
+  }
+  return count;
+}
+
+static int tree_total_rows(tree_t *tree) {
+  bson_iter_t iter;
+  int n = 0;
+  if (!bson_iter_init(&iter, tree->doc)) {
+    return 0;
+  }
+  while (bson_iter_next(&iter)) {
+    n++;
+    if (is_container(&iter)) {
+      uint32_t off = value_offset(tree, &iter, NULL);
+      if (map_get(&tree->expanded, off, NULL)) {
+        n += visible_rows(tree, &iter, off);
+      }
+    }
+  }
+  return n;
+}
+
+static void tree_set_expanded(tree_t *tree, uint32_t offset, bool expanded) {
+  if (expanded) {
+    map_put(&tree->expanded, offset, 1);
+  } else {
+    map_remove(&tree->expanded, offset);
+  }
+  // los conteos de los ancestros cambian: se recalculan a demanda
+  map_clear(&tree->rows);
+}
+
+static void format_bytes(uint32_t bytes, char *buffer, size_t size) {
+  if (bytes < 1024) {
+    snprintf(buffer, size, "%u B", (unsigned)bytes);
+  } else if (bytes < 1024 * 1024) {
+    snprintf(buffer, size, "%.1f KB", bytes / 1024.0);
+  } else {
+    snprintf(buffer, size, "%.1f MB", bytes / (1024.0 * 1024.0));
+  }
+}
+
+static void draw_row(WINDOW *win, tree_t *tree, tree_row_t *r, int y,
+                     int width, bool selected, bool in_array) {
+  char line[512];
+  const char *key = bson_iter_key(&r->iter);
+  const char *marker = r->container ? (r->expanded ? "- " : "+ ") : "  ";
+
+  if (selected) {
+    wattron(win, COLOR_PAIR(COLOR_PAIR_SELECTED));
+    mvwprintw(win, y, 2, "%*s", width, "");
+  }
+
+  int x = 2 + r->depth * 2;
+  if (x >= 2 + width) {
+    x = 2 + width - 1;
+  }
+  mvwprintw(win, y, x, "%s", marker);
+
+  if (!selected && has_colors()) {
+    wattron(win, COLOR_PAIR(JSON_COLOR_KEY));
+  }
+  snprintf(line, sizeof(line), in_array ? "[%s]" : "%s", key);
+  waddnstr(win, line, width - (x - 2) - 2);
+  if (!selected && has_colors()) {
+    wattroff(win, COLOR_PAIR(JSON_COLOR_KEY));
+  }
+  waddstr(win, ": ");
+
+  int color;
+  if (r->container) {
+    uint32_t bytes;
+    value_offset(tree, &r->iter, &bytes);
+    int n = child_count(tree, &r->iter, r->offset);
+    bool array = BSON_ITER_HOLDS_ARRAY(&r->iter);
+    char size[32];
+    format_bytes(bytes, size, sizeof(size));
+    snprintf(line, sizeof(line), array ? "[%d items, %s]" : "{%d fields, %s}",
+             n, size);
+    color = JSON_COLOR_BRACKET;
+  } else {
+    color = json_format_scalar(&r->iter, line, sizeof(line));
+  }
+
+  int used = getcurx(win) - 2;
+  if (used < width) {
+    if (!selected && has_colors()) {
+      wattron(win, COLOR_PAIR(color));
+    }
+    waddnstr(win, line, width - used);
+    if (!selected && has_colors()) {
+      wattroff(win, COLOR_PAIR(color));
+    }
+  }
+
+  if (selected) {
+    wattroff(win, COLOR_PAIR(COLOR_PAIR_SELECTED));
+  }
+}
+
+void tree_view_show(const bson_t *doc, const char *title) {
+  if (!doc) {
+    return;
+  }
+
+  tree_t tree = {0};
+  tree.doc = doc;
+  tree.base = bson_get_data(doc);
+
+  WINDOW *win = newwin(LINES, COLS, 0, 0);
+  keypad(win, TRUE);
+
+  int visible = LINES - 5;
+  if (visible < 1) {
+    visible = 1;
+  }
+  tree_row_t *rows = calloc(visible, sizeof(tree_row_t));
+  if (!rows) {
+    delwin(win);
+    return;
+  }
+
+  int cursor = 0;
+  int top = 0;
+  bool running = true;
+
+  while (running) {
+    int total = tree_total_rows(&tree);
+    if (cursor >= total) {
+      cursor = total > 0 ? total - 1 : 0;
+    }
+    if (cursor < top) {
+      top = cursor;
+    } else if (cursor >= top + visible) {
+      top = cursor - visible + 1;
+    }
+
+    int count = tree_rows(&tree, top, visible, rows);
+
+    werase(win);
+    tui_draw_box(win, title);
+    tui_draw_status(win, "UP/DOWN: Move | ENTER/SPACE: Toggle | RIGHT/LEFT: "
+                         "Expand/Collapse | B/ESC: Back");
+    mvwprintw(win, 1, 2, "Row %d/%d | %u bytes", total ? cursor + 1 : 0, total,
+              (unsigned)doc->len);
+    tui_draw_hline(win, 2, 1, COLS - 2);
+
+    int offscreen_parent = -1;
+    bool offscreen_is_array = false;
+    for (int i = 0; i < count; i++) {
+      // las claves de arrays se muestran como [i]; si el padre quedó
+      // arriba de la pantalla se genera sólo esa fila
+      bool in_array = false;
+      if (rows[i].parent_row >= top) {
+        in_array = BSON_ITER_HOLDS_ARRAY(&rows[rows[i].parent_row - top].iter);
+      } else if (rows[i].parent_row >= 0) {
+        if (rows[i].parent_row != offscreen_parent) {
+          tree_row_t parent;
+          offscreen_parent = rows[i].parent_row;
+          offscreen_is_array =
+              tree_rows(&tree, offscreen_parent, 1, &parent) == 1 &&
+              BSON_ITER_HOLDS_ARRAY(&parent.iter);
+        }
+        in_array = offscreen_is_array;
+      }
+      draw_row(win, &tree, &rows[i], 3 + i, COLS - 4, top + i == cursor,
+               in_array);
+    }
+
+    wrefresh(win);
+
+    int ch = wgetch(win);
+    tree_row_t *current =
+        cursor - top >= 0 && cursor - top < count ? &rows[cursor - top] : NULL;
+
+    switch (ch) {
+    case KEY_UP:
+    case 450:
+      if (cursor > 0) {
+        cursor--;
+      }
+      break;
+    case KEY_DOWN:
+    case 456:
+      if (cursor < total - 1) {
+        cursor++;
+      }
+      break;
+    case KEY_PPAGE:
+    case 451:
+      cursor = cursor > visible ? cursor - visible : 0;
+      break;
+    case KEY_NPAGE:
+    case 457:
+      cursor = cursor + visible < total ? cursor + visible : total - 1;
+      break;
+    case KEY_HOME:
+      cursor = 0;
+      break;
+    case KEY_END:
+      cursor = total - 1;
+      break;
+    case '\n':
+    case KEY_ENTER:
+    case 13:
+    case ' ':
+      if (current && current->container) {
+        tree_set_expanded(&tree, current->offset, !current->expanded);
+      }
+      break;
+    case KEY_RIGHT:
+    case 454:
+      if (current && current->container && !current->expanded) {
+        tree_set_expanded(&tree, current->offset, true);
+      } else if (current && current->expanded) {
+        cursor++; // bajar al primer hijo
+      }
+      break;
+    case KEY_LEFT:
+    case 452:
+      if (current && current->expanded) {
+        tree_set_expanded(&tree, current->offset, false);
+      } else if (current && current->parent_row >= 0) {
+        cursor = current->parent_row; // subir al padre
+      }
+      break;
+    case 27:
+    case 'b':
+    case 'B':
+    case 'q':
+    case 'Q':
+      running = false;
+      break;
+    default:
+      break;
+    }
+
+    if (cursor < 0) {
+      cursor = 0;
+    }
+  }
+
+  free(rows);
+  map_free(&tree.expanded);
+  map_free(&tree.rows);
+  map_free(&tree.children);
+  delwin(win);
+  touchwin(stdscr);
+  refresh();
+}
@@ -0,0 +1,11 @@
+#ifndef TREE_VIEW_H
+#define TREE_VIEW_H
+
+#include <mongoc/mongoc.h>
+
+// mostrar un documento como árbol colapsable (modal, a pantalla completa).
+// las filas se generan al vuelo recorriendo sólo la parte visible, así que
+// la memoria depende de lo que hay en pantalla y no del tamaño del documento
+void tree_view_show(const bson_t *doc, const char *title);
+
+#endif // TREE_VIEW_H
@@ -92,6 +92,37 @@ void tui_draw_status(WINDOW *win, const char *message) {
   wattroff(win, COLOR_PAIR(COLOR_PAIR_STATUS));
 }
 
+void tui_update_status(WINDOW *win, tui_line_cache_t *cache,
+                       const char *message) {
+  if (!win || !cache || !message) {
+    return;
+  }
+
+  if (cache->valid && strcmp(cache->text, message) == 0) {
+    return;
+  }
+
+  tui_draw_status(win, message);
+  safe_strncpy(cache->text, message, sizeof(cache->text));
+  cache->valid = true;
+}
+
+void tui_update_line(WINDOW *win, int y, tui_line_cache_t *cache,
+                     const char *text) {
+  if (!win || !cache || !text) {
+    return;
+  }
+
+  if (cache->valid && strcmp(cache->text, text) == 0) {
+    return;
+  }
+
+  tui_clear_line(win, y);
+  mvwprintw(win, y, 2, "%s", text);
+  safe_strncpy(cache->text, text, sizeof(cache->text));
+  cache->valid = true;
+}
+
 void tui_show_message(WINDOW *win, int y, const char *message,
                       msg_type_t type) {
   if (!win || !message) {
@@ -21,6 +21,7 @@ typedef enum {
   SCREEN_DOCUMENT_DELETE,
   SCREEN_FILTER,
   SCREEN_HELP,
+  SCREEN_TABS, // la pantalla dejó un pedido de pestañas (state->tab_request)
   SCREEN_QUIT
 } screen_id_t;
 
@@ -42,6 +43,20 @@ void tui_draw_hline(WINDOW *win, int y, int x, int width);
 // dibujar barra de estado
 void tui_draw_status(WINDOW *win, const char *message);
 
+// línea que sólo se repinta cuando cambia su texto
+typedef struct {
+  char text[512];
+  bool valid;
+} tui_line_cache_t;
+
+// dibujar la barra de estado si el texto cambió
+void tui_update_status(WINDOW *win, tui_line_cache_t *cache,
+                       const char *message);
+
+// dibujar una línea de texto (desde x = 2) si cambió
+void tui_update_line(WINDOW *win, int y, tui_line_cache_t *cache,
+                     const char *text);
+
 // mostrar mensaje con color
 void tui_show_message(WINDOW *win, int y, const char *message, msg_type_t type);
 
@@ -87,6 +87,49 @@ void free_string_array(char ***arr, int count) {
   *arr = NULL;
 }
 
+char **pack_string_array(const char *const *src, int count) {
+  if (count < 0) {
+    return NULL;
+  }
+
+  size_t total = (size_t)(count + 1) * sizeof(char *);
+  for (int i = 0; i < count; i++) {
+    total += strlen(src[i]) + 1;
+  }
+
+  char **arr = malloc(total);
+  if (!arr) {
+    return NULL;
+  }
+
+  char *text = (char *)(arr + count + 1);
+  for (int i = 0; i < count; i++) {
+    size_t len = strlen(src[i]) + 1;
+    memcpy(text, src[i], len);
+    arr[i] = text;
+    text += len;
+  }
+  arr[count] = NULL;
+  return arr;
+}
+
+bool split_namespace(const char *ns, char *db, size_t db_size, char *coll,
+                     size_t coll_size) {
+  const char *dot = strchr(ns, '.');
+  if (!dot || dot == ns || dot[1] == '\0') {
+    return false;
+  }
+
+  size_t db_len = dot - ns;
+  if (db_len >= db_size || strlen(dot + 1) >= coll_size) {
+    return false;
+  }
+
+  memcpy(db, ns, db_len);
+  db[db_len] = '\0';
+  return safe_strncpy(coll, dot + 1, coll_size);
+}
+
 void format_number(long long n, char *buffer, size_t size) {
   if (!buffer || size == 0) {
     return;
@@ -19,6 +19,15 @@ char *str_dup(const char *str);
 // liberar array de strings
 void free_string_array(char ***arr, int count);
 
+// copiar strings a un solo bloque: el array y el texto juntos, se libera
+// con un free
+char **pack_string_array(const char *const *src, int count);
+
+// separar "db.collection" en sus dos partes (la colección puede tener
+// puntos); false, sin tocar nada, si falta alguna o no entra
+bool split_namespace(const char *ns, char *db, size_t db_size, char *coll,
+                     size_t coll_size);
+
 // formatear números con comas
 void format_number(long long n, char *buffer, size_t size);
 